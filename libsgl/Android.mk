@@ -3,7 +3,7 @@ THIS_PATH := $(call my-dir)
 # LOCAL_PATH := $(THIS_PATH)
 # include $(CLEAR_VARS) 
 
-include $(call all-named-subdir-makefiles, libfimg)
+include $(call all-named-subdir-makefiles, libfimg tests)
 
 #
 # Build the hardware OpenGL ES library
@@ -22,7 +22,8 @@ LOCAL_ARM_MODE := arm
 LOCAL_SRC_FILES:= \
 	eglBase.cpp eglMem.cpp \
 	glesBase.cpp glesFrame.cpp glesGet.cpp glesMatrix.cpp \
-	glesPixel.cpp glesTex.cpp fglmatrix.cpp
+	glesPixel.cpp glesTex.cpp fglmatrix.cpp fgltranscode.cpp \
+	fglpmem.cpp fglmipmap.cpp
 
 LOCAL_CFLAGS += -DLOG_TAG=\"libsgl\"
 LOCAL_CFLAGS += -DGL_GLEXT_PROTOTYPES -DEGL_EGLEXT_PROTOTYPES
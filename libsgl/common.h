@@ -24,14 +24,20 @@
 
 #define FGL_NPOT_TEXTURES
 
-#define FGL_MAX_TEXTURE_UNITS		2
+#define FGL_MAX_TEXTURE_UNITS		4
 #define FGL_MAX_TEXTURE_OBJECTS		1024
 #define FGL_MAX_BUFFER_OBJECTS		1024
 #define FGL_MAX_FRAMEBUFFER_OBJECTS	1024
 #define FGL_MAX_RENDERBUFFER_OBJECTS	1024
+#define FGL_MAX_PROGRAM_OBJECTS		64
 #define FGL_MAX_MIPMAP_LEVEL		11
 #define FGL_MAX_LIGHTS			8
-#define FGL_MAX_CLIP_PLANES		1
+#define FGL_MAX_CLIP_PLANES		3
+#define FGL_MAX_PALETTE_MATRICES	16
+#define FGL_MAX_VERTEX_UNITS		4
+#define FGL_MAX_POINT_SIZE		2048
+#define FGL_DRAW_TEX_BATCH		32
+#define FGL_MAX_RETIRED_SURFACES	16
 #define FGL_MAX_MODELVIEW_STACK_DEPTH	16
 #define FGL_MAX_PROJECTION_STACK_DEPTH	2
 #define FGL_MAX_TEXTURE_STACK_DEPTH	2
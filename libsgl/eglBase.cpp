@@ -43,6 +43,7 @@
 #include <EGL/eglext.h>
 #include <GLES/gl.h>
 #include <GLES/glext.h>
+#include "fglext.h"
 
 #include <private/ui/sw_gralloc_handle.h>
 #include <ui/android_native_buffer.h>
@@ -2291,6 +2292,8 @@ EGLAPI EGLBoolean EGLAPIENTRY eglSwapBuffers(EGLDisplay dpy, EGLSurface surface)
 	// if it's bound to a context, update the buffer
 	if (d->ctx != EGL_NO_CONTEXT) {
 		FGLContext* c = (FGLContext*)d->ctx;
+		// textures used before are no longer needed by this frame
+		fglAdvanceTextureFrame(c);
 		d->bindDrawSurface(c);
 		// if this surface is also the read surface of the context
 		// it is bound to, make sure to update the read buffer as well.
@@ -2401,6 +2404,9 @@ EGLImageKHR eglCreateImageKHR(EGLDisplay dpy, EGLContext ctx, EGLenum target,
 		case HAL_PIXEL_FORMAT_BGRA_8888:
 		case HAL_PIXEL_FORMAT_RGBA_5551:
 		case HAL_PIXEL_FORMAT_RGBA_4444:
+		/* Packed 4:2:2 YUV is sampled by the texture unit directly */
+		case HAL_PIXEL_FORMAT_YCbCr_422_I:
+		case HAL_PIXEL_FORMAT_CbYCrY_422_I:
 			break;
 		default:
 			setError(EGL_BAD_PARAMETER);
@@ -2461,6 +2467,32 @@ static const FGLExtensionMap gExtensionMap[] = {
 	{ "glQueryMatrixxOES",
 		(__eglMustCastToProperFunctionPointerType)&glQueryMatrixxOES },
 #endif
+	{ "glCurrentPaletteMatrixOES",
+		(__eglMustCastToProperFunctionPointerType)&glCurrentPaletteMatrixOES },
+	{ "glLoadPaletteFromModelViewMatrixOES",
+		(__eglMustCastToProperFunctionPointerType)&glLoadPaletteFromModelViewMatrixOES },
+	{ "glMatrixIndexPointerOES",
+		(__eglMustCastToProperFunctionPointerType)&glMatrixIndexPointerOES },
+	{ "glWeightPointerOES",
+		(__eglMustCastToProperFunctionPointerType)&glWeightPointerOES },
+	{ "glTexGenfOES",
+		(__eglMustCastToProperFunctionPointerType)&glTexGenfOES },
+	{ "glTexGenfvOES",
+		(__eglMustCastToProperFunctionPointerType)&glTexGenfvOES },
+	{ "glTexGeniOES",
+		(__eglMustCastToProperFunctionPointerType)&glTexGeniOES },
+	{ "glTexGenivOES",
+		(__eglMustCastToProperFunctionPointerType)&glTexGenivOES },
+	{ "glTexGenxOES",
+		(__eglMustCastToProperFunctionPointerType)&glTexGenxOES },
+	{ "glTexGenxvOES",
+		(__eglMustCastToProperFunctionPointerType)&glTexGenxvOES },
+	{ "glGetTexGenfvOES",
+		(__eglMustCastToProperFunctionPointerType)&glGetTexGenfvOES },
+	{ "glGetTexGenivOES",
+		(__eglMustCastToProperFunctionPointerType)&glGetTexGenivOES },
+	{ "glGetTexGenxvOES",
+		(__eglMustCastToProperFunctionPointerType)&glGetTexGenxvOES },
 	{ "glEGLImageTargetTexture2DOES",
 		(__eglMustCastToProperFunctionPointerType)&glEGLImageTargetTexture2DOES },
 #if 0
@@ -2471,6 +2503,18 @@ static const FGLExtensionMap gExtensionMap[] = {
 	{ "glClipPlanex",
 		(__eglMustCastToProperFunctionPointerType)&glClipPlanex },
 #endif
+	{ "glGenProgramsFIMG",
+		(__eglMustCastToProperFunctionPointerType)&glGenProgramsFIMG },
+	{ "glDeleteProgramsFIMG",
+		(__eglMustCastToProperFunctionPointerType)&glDeleteProgramsFIMG },
+	{ "glBindProgramFIMG",
+		(__eglMustCastToProperFunctionPointerType)&glBindProgramFIMG },
+	{ "glProgramBinaryFIMG",
+		(__eglMustCastToProperFunctionPointerType)&glProgramBinaryFIMG },
+	{ "glProgramConstantfvFIMG",
+		(__eglMustCastToProperFunctionPointerType)&glProgramConstantfvFIMG },
+	{ "glProgramMatrixFIMG",
+		(__eglMustCastToProperFunctionPointerType)&glProgramMatrixFIMG },
 	{ "glBindBuffer",
 		(__eglMustCastToProperFunctionPointerType)&glBindBuffer },
 	{ "glBufferData",
@@ -24,6 +24,8 @@
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
 
 #include "eglMem.h"
 
@@ -99,22 +101,32 @@ unsigned long fglGetBufferPhysicalAddress(android_native_buffer_t *buffer)
  * NEW SURFACE SUBSYSTEM
  */
 
-FGLLocalSurface::FGLLocalSurface(unsigned long size)
-	: fd(-1)
+/*
+ * Chunks of /dev/pmem_gpu1 (cached), suballocated by FGLPmemAllocator
+ */
+struct FGLPmemDevice : public FGLPmemBackend {
+	virtual bool map(unsigned long size, int *handle,
+					void **vaddr, unsigned long *paddr);
+	virtual void unmap(int handle, void *vaddr, unsigned long size);
+	virtual void flush(int handle, unsigned long offset,
+					unsigned long size);
+};
+
+bool FGLPmemDevice::map(unsigned long size, int *handle,
+					void **vaddr, unsigned long *paddr)
 {
 	int fd;
-	void *vaddr;
+	void *addr;
 	pmem_region region;
 
-	// create a buffer file (cached)
 	fd = open("/dev/pmem_gpu1", O_RDWR, 0);
 	if(fd < 0) {
 		LOGE("EGL: Could not open PMEM device (%s)", strerror(errno));
-		return;
+		return false;
 	}
 
 	// allocate and map the memory
-	if ((vaddr = mmap(NULL, size, PROT_WRITE | PROT_READ,
+	if ((addr = mmap(NULL, size, PROT_WRITE | PROT_READ,
 				MAP_SHARED, fd, NULL)) == MAP_FAILED) {
 		LOGE("EGL: PMEM buffer allocation failed (%s)", strerror(errno));
 		goto err_mmap;
@@ -125,26 +137,69 @@ FGLLocalSurface::FGLLocalSurface(unsigned long size)
 		goto err_phys;
 	}
 
+	*handle	= fd;
+	*vaddr	= addr;
+	*paddr	= region.offset;
+
+	return true;
+
+err_phys:
+	munmap(addr, size);
+err_mmap:
+	close(fd);
+	return false;
+}
+
+void FGLPmemDevice::unmap(int handle, void *vaddr, unsigned long size)
+{
+	munmap(vaddr, size);
+	close(handle);
+}
+
+void FGLPmemDevice::flush(int handle, unsigned long offset,
+						unsigned long size)
+{
+	struct pmem_region region;
+
+	region.offset = offset;
+	region.len = size;
+
+	if (ioctl(handle, PMEM_CACHE_FLUSH, &region) != 0)
+		LOGW("Could not flush PMEM surface %d", handle);
+}
+
+static FGLPmemAllocator *fglPmemAllocator;
+static pthread_once_t fglPmemAllocatorOnce = PTHREAD_ONCE_INIT;
+
+static void fglCreatePmemAllocator(void)
+{
+	fglPmemAllocator = new FGLPmemAllocator(new FGLPmemDevice(),
+							FGL_PMEM_CHUNK_SIZE);
+}
+
+static inline FGLPmemAllocator *fglGetPmemAllocator(void)
+{
+	pthread_once(&fglPmemAllocatorOnce, fglCreatePmemAllocator);
+	return fglPmemAllocator;
+}
+
+FGLLocalSurface::FGLLocalSurface(unsigned long size)
+{
+	if (!fglGetPmemAllocator()->alloc(size, &block))
+		return;
+
 	/* Clear the buffer (NOTE: Is it needed?) */
-	memset((char*)vaddr, 0, size);
+	memset((char*)block.vaddr, 0, size);
 
 	/* Setup surface struct */
 	this->size	= size;
-	this->fd	= fd;
-	this->vaddr	= vaddr;
-	this->paddr	= region.offset;
+	this->vaddr	= block.vaddr;
+	this->paddr	= block.paddr;
 
 	//LOGD("FGLLocalSurface (vaddr = %p, paddr = %08x, size = %u)",
-	//			vaddr, (unsigned int)region.offset, size);
+	//			vaddr, (unsigned int)paddr, size);
 
 	flush();
-
-	return;
-
-err_phys:
-	munmap(vaddr, size);
-err_mmap:
-	close(fd);
 }
 
 FGLLocalSurface::~FGLLocalSurface()
@@ -152,8 +207,7 @@ FGLLocalSurface::~FGLLocalSurface()
 	if (!isValid())
 		return;
 
-	munmap(vaddr, size);
-	close(fd);
+	fglGetPmemAllocator()->free(&block);
 
 	//LOGD("~FGLLocalSurface (vaddr = %p, paddr = %08x, size = %u)",
 	//			vaddr, (unsigned int)paddr, size);
@@ -171,13 +225,20 @@ int FGLLocalSurface::unlock(void)
 
 void FGLLocalSurface::flush(void)
 {
-	struct pmem_region region;
+	unsigned long offset, len;
 
-	region.offset = 0;
-	region.len = size;
+	getFlushRange(&offset, &len);
+	fglGetPmemAllocator()->flush(&block, offset, len);
+}
+
+unsigned long FGLLocalSurface::getFreeSpan(void)
+{
+	return fglGetPmemAllocator()->freeSpan(&block);
+}
 
-	if (ioctl(fd, PMEM_CACHE_FLUSH, &region) != 0)
-		LOGW("Could not flush PMEM surface %d", fd);
+unsigned long FGLLocalSurface::getChunkUsed(void)
+{
+	return fglGetPmemAllocator()->chunkUsed(block.chunk);
 }
 
 FGLExternalSurface::FGLExternalSurface(void *v, unsigned long p, unsigned long s)
@@ -207,7 +268,40 @@ int FGLExternalSurface::unlock(void)
 
 void FGLExternalSurface::flush(void)
 {
-	cacheflush((intptr_t)vaddr, (intptr_t)((uint8_t *)vaddr + size), 0);
+	unsigned long offset, len;
+
+	getFlushRange(&offset, &len);
+	cacheflush((intptr_t)((uint8_t *)vaddr + offset),
+			(intptr_t)((uint8_t *)vaddr + offset + len), 0);
+}
+
+FGLSystemSurface::FGLSystemSurface(unsigned long s)
+{
+	vaddr = malloc(s);
+	paddr = 0;
+	size = s;
+}
+
+FGLSystemSurface::~FGLSystemSurface()
+{
+	free(vaddr);
+}
+
+int FGLSystemSurface::lock(int usage)
+{
+	return 0;
+}
+
+int FGLSystemSurface::unlock(void)
+{
+	return 0;
+}
+
+void FGLSystemSurface::flush(void)
+{
+	dirtyStart = ~0UL;
+	dirtyEnd = 0;
+	/* Not accessed by hardware */
 }
 
 FGLImageSurface::FGLImageSurface(EGLImageKHR img)
@@ -283,9 +377,11 @@ void FGLImageSurface::flush(void)
 	const private_handle_t* hnd =
 			static_cast<const private_handle_t*>(buffer->handle);
 	struct pmem_region region;
+	unsigned long offset, len;
 
-	region.offset = 0;
-	region.len = size;
+	getFlushRange(&offset, &len);
+	region.offset = offset;
+	region.len = len;
 
 	if (ioctl(hnd->fd, PMEM_CACHE_FLUSH, &region) != 0)
 		LOGW("Could not flush PMEM surface %d", hnd->fd);
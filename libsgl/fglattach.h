@@ -39,6 +39,7 @@ public:
 	inline void unattach(FGLAttach *a);
 	inline void attach(FGLAttach *a);
 	inline bool isAttached(FGLAttach *a);
+	inline bool hasAttachments(void) { return list != 0; }
 	friend class FGLAttach;
 };
 
@@ -0,0 +1,82 @@
+/**
+ * libsgl/fglext.h
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2010 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Vendor extensions of libsgl. Applications can copy this file and obtain
+ * the entry points using eglGetProcAddress.
+ */
+
+#ifndef _LIBSGL_FGLEXT_H_
+#define _LIBSGL_FGLEXT_H_
+
+#include <GLES/gl.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * GL_FIMG_program
+ *
+ * Replaces the fixed-function pipeline with an application supplied pair
+ * of precompiled FIMG-3DSE vertex and pixel shaders, as produced by
+ * the fimgasm tool (four 32-bit words per instruction).
+ *
+ * Vertex shader inputs follow the fixed-function arrays: v0 position,
+ * v1 normal, v2 color, v3 point size and v4 onwards texture coordinates.
+ * Vertex shader output o0 is the position and outputs from o1 onwards
+ * are passed to pixel shader inputs from v0 onwards. Texture units
+ * enabled with glEnable(GL_TEXTURE_2D) are bound to samplers s0 onwards.
+ *
+ * Matrices bound with glProgramMatrixFIMG are loaded into four
+ * consecutive vertex shader constants, one column per register, and are
+ * kept up to date with the matrix stacks.
+ */
+#ifndef GL_FIMG_program
+#define GL_FIMG_program 1
+
+#define GL_VERTEX_PROGRAM_FIMG			0x8620
+#define GL_FRAGMENT_PROGRAM_FIMG		0x8804
+#define GL_MODELVIEW_PROJECTION_FIMG		0x8629
+#define GL_MODELVIEW_INVERSE_FIMG		0x862B
+#define GL_PROGRAM_BINDING_FIMG			0x8677
+
+#ifdef GL_GLEXT_PROTOTYPES
+GL_API void GL_APIENTRY glGenProgramsFIMG (GLsizei n, GLuint *programs);
+GL_API void GL_APIENTRY glDeleteProgramsFIMG (GLsizei n, const GLuint *programs);
+GL_API void GL_APIENTRY glBindProgramFIMG (GLuint program);
+GL_API void GL_APIENTRY glProgramBinaryFIMG (GLuint program, GLenum target, const GLvoid *binary, GLsizei length);
+GL_API void GL_APIENTRY glProgramConstantfvFIMG (GLuint program, GLenum target, GLuint index, GLsizei count, const GLfloat *values);
+GL_API void GL_APIENTRY glProgramMatrixFIMG (GLuint program, GLenum matrix, GLint index);
+#endif
+typedef void (GL_APIENTRYP PFNGLGENPROGRAMSFIMGPROC) (GLsizei n, GLuint *programs);
+typedef void (GL_APIENTRYP PFNGLDELETEPROGRAMSFIMGPROC) (GLsizei n, const GLuint *programs);
+typedef void (GL_APIENTRYP PFNGLBINDPROGRAMFIMGPROC) (GLuint program);
+typedef void (GL_APIENTRYP PFNGLPROGRAMBINARYFIMGPROC) (GLuint program, GLenum target, const GLvoid *binary, GLsizei length);
+typedef void (GL_APIENTRYP PFNGLPROGRAMCONSTANTFVFIMGPROC) (GLuint program, GLenum target, GLuint index, GLsizei count, const GLfloat *values);
+typedef void (GL_APIENTRYP PFNGLPROGRAMMATRIXFIMGPROC) (GLuint program, GLenum matrix, GLint index);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -417,3 +417,45 @@ void FGLmatrix::transpose(void)
 
 	*this = mat;
 }
+
+/**
+ *	Vector transformation
+ */
+
+void FGLmatrix::transform(const GLfloat *in, GLfloat *out) const
+{
+	for(int i = 0; i < 4; i++)
+		out[i] = (*this)[0][i]*in[0] + (*this)[1][i]*in[1]
+			+ (*this)[2][i]*in[2] + (*this)[3][i]*in[3];
+}
+
+void FGLmatrix::transformRow(const GLfloat *in, GLfloat *out) const
+{
+	for(int i = 0; i < 4; i++)
+		out[i] = (*this)[i][0]*in[0] + (*this)[i][1]*in[1]
+			+ (*this)[i][2]*in[2] + (*this)[i][3]*in[3];
+}
+
+/**
+ *	Matrix classification
+ */
+
+int FGLmatrix::classify(void) const
+{
+	const FGLmatrix &m = *this;
+
+	/* Projective row or z depending on x/y (or the other way) */
+	if (m[0][3] != 0 || m[1][3] != 0 || m[2][3] != 0 || m[3][3] != 1
+	    || m[0][2] != 0 || m[1][2] != 0 || m[2][0] != 0 || m[2][1] != 0)
+		return FGL_MATRIX_CLASS_GENERAL;
+
+	/* Rotation or shear in xy plane */
+	if (m[0][1] != 0 || m[1][0] != 0)
+		return FGL_MATRIX_CLASS_AFFINE_2D;
+
+	if (m[0][0] != 1 || m[1][1] != 1 || m[2][2] != 1
+	    || m[3][0] != 0 || m[3][1] != 0 || m[3][2] != 0)
+		return FGL_MATRIX_CLASS_SCALE_TRANSLATE;
+
+	return FGL_MATRIX_CLASS_IDENTITY;
+}
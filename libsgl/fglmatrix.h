@@ -5,6 +5,15 @@
 #include "types.h"
 
 #define MAT4(x, y)	(4*(x) + (y))
+
+/* Matrix classes, ordered from the most to the least specific */
+enum {
+	FGL_MATRIX_CLASS_IDENTITY = 0,
+	FGL_MATRIX_CLASS_SCALE_TRANSLATE,
+	FGL_MATRIX_CLASS_AFFINE_2D,
+	FGL_MATRIX_CLASS_GENERAL
+};
+
 struct FGLmatrix {
 	GLfloat data[16];
 
@@ -32,6 +41,9 @@ struct FGLmatrix {
 	void inverseOrtho(GLfloat l, GLfloat r, GLfloat b, GLfloat t, GLfloat n, GLfloat f);
 	void inverse(void);
 	void transpose(void);
+	int classify(void) const;
+	void transform(const GLfloat *in, GLfloat *out) const;
+	void transformRow(const GLfloat *in, GLfloat *out) const;
 
 	inline GLfloat *operator[](unsigned int i) { return &data[MAT4(i, 0)]; };
 	inline const GLfloat *operator[](unsigned int i) const { return &data[MAT4(i, 0)]; };
@@ -0,0 +1,434 @@
+/**
+ * libsgl/fglmipmap.cpp
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2010 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "libfimg/fimg.h"
+#include "fglmipmap.h"
+
+#if defined(__ARM_ARCH_6__) || defined(__ARM_ARCH_6J__) \
+    || defined(__ARM_ARCH_6K__) || defined(__ARM_ARCH_6Z__) \
+    || defined(__ARM_ARCH_6ZK__) || defined(__ARM_ARCH_7A__)
+#define FGL_HAVE_ARM_SIMD
+#endif
+
+/* Maximum number of helper threads */
+#ifndef FGL_MIPMAP_MAX_WORKERS
+#define FGL_MIPMAP_MAX_WORKERS	3
+#endif
+/* Destination images smaller than this (in pixels) are not split */
+#ifndef FGL_MIPMAP_SPLIT_SIZE
+#define FGL_MIPMAP_SPLIT_SIZE	(128*128)
+#endif
+
+/**
+	SIMD within a register
+
+	Byte formats are averaged four channels at a time. All the helpers
+	round down, exactly like summing four values and shifting by two.
+*/
+
+/* Average of each byte lane, rounded down */
+static inline uint32_t fglHalvingAdd8(uint32_t a, uint32_t b)
+{
+#ifdef FGL_HAVE_ARM_SIMD
+	uint32_t res;
+
+	asm ("uhadd8 %0, %1, %2" : "=r"(res) : "r"(a), "r"(b));
+	return res;
+#else
+	return (a & b) + (((a ^ b) >> 1) & 0x7f7f7f7f);
+#endif
+}
+
+/* Average of four values in each byte lane, rounded down */
+static inline uint32_t fglAverage4(uint32_t a, uint32_t b,
+						uint32_t c, uint32_t d)
+{
+	uint32_t ab = fglHalvingAdd8(a, b);
+	uint32_t cd = fglHalvingAdd8(c, d);
+
+	// Each halving drops a bit, which together can make a whole unit
+	uint32_t carry = (a ^ b) & (c ^ d) & (ab ^ cd) & 0x01010101;
+
+	return fglHalvingAdd8(ab, cd) + carry;
+}
+
+/**
+	Row filters
+
+	Each destination pixel is made of two pixels of top and bottom
+	source lines. Step is the distance between horizontal neighbours,
+	which is zero for sources one pixel wide.
+*/
+
+typedef void (*FGLDownsampleRow)(const void *top, const void *bottom,
+				void *dst, unsigned width, unsigned step);
+
+static void fglDownsampleRow565(const void *top, const void *bottom,
+				void *dst, unsigned width, unsigned step)
+{
+	const uint16_t *t = (const uint16_t *)top;
+	const uint16_t *b = (const uint16_t *)bottom;
+	uint16_t *d = (uint16_t *)dst;
+	const uint32_t mask = 0x07e0f81f;
+
+	do {
+		uint32_t p00 = t[0];
+		uint32_t p10 = t[step];
+		uint32_t p01 = b[0];
+		uint32_t p11 = b[step];
+
+		// Green goes to the upper half to leave room for carries
+		p00 = (p00 | (p00 << 16)) & mask;
+		p10 = (p10 | (p10 << 16)) & mask;
+		p01 = (p01 | (p01 << 16)) & mask;
+		p11 = (p11 | (p11 << 16)) & mask;
+
+		uint32_t grb = ((p00 + p10 + p01 + p11) >> 2) & mask;
+		*(d++) = (grb & 0xffff) | (grb >> 16);
+
+		t += 2;
+		b += 2;
+	} while (--width);
+}
+
+static void fglDownsampleRow5551(const void *top, const void *bottom,
+				void *dst, unsigned width, unsigned step)
+{
+	const uint16_t *t = (const uint16_t *)top;
+	const uint16_t *b = (const uint16_t *)bottom;
+	uint16_t *d = (uint16_t *)dst;
+
+	do {
+		uint32_t p00 = t[0];
+		uint32_t p10 = t[step];
+		uint32_t p01 = b[0];
+		uint32_t p11 = b[step];
+
+		uint32_t r = ((p00 >> 11) + (p10 >> 11)
+				+ (p01 >> 11) + (p11 >> 11) + 2) >> 2;
+		uint32_t g = (((p00 >> 6) & 0x1f) + ((p10 >> 6) & 0x1f)
+				+ ((p01 >> 6) & 0x1f) + ((p11 >> 6) & 0x1f)
+				+ 2) >> 2;
+		uint32_t bl = ((p00 & 0x3e) + (p10 & 0x3e)
+				+ (p01 & 0x3e) + (p11 & 0x3e) + 4) >> 3;
+		uint32_t a = ((p00 & 1) + (p10 & 1)
+				+ (p01 & 1) + (p11 & 1) + 2) >> 2;
+		*(d++) = (r << 11) | (g << 6) | (bl << 1) | a;
+
+		t += 2;
+		b += 2;
+	} while (--width);
+}
+
+static void fglDownsampleRow4444(const void *top, const void *bottom,
+				void *dst, unsigned width, unsigned step)
+{
+	const uint16_t *t = (const uint16_t *)top;
+	const uint16_t *b = (const uint16_t *)bottom;
+	uint16_t *d = (uint16_t *)dst;
+
+	do {
+		uint32_t p00 = t[0];
+		uint32_t p10 = t[step];
+		uint32_t p01 = b[0];
+		uint32_t p11 = b[step];
+
+		// Every channel gets a byte of its own
+		p00 = ((p00 << 12) & 0x0f0f0000) | (p00 & 0x0f0f);
+		p10 = ((p10 << 12) & 0x0f0f0000) | (p10 & 0x0f0f);
+		p01 = ((p01 << 12) & 0x0f0f0000) | (p01 & 0x0f0f);
+		p11 = ((p11 << 12) & 0x0f0f0000) | (p11 & 0x0f0f);
+
+		uint32_t rbga = (p00 + p10 + p01 + p11) >> 2;
+		*(d++) = (rbga & 0x0f0f) | ((rbga >> 12) & 0xf0f0);
+
+		t += 2;
+		b += 2;
+	} while (--width);
+}
+
+static void fglDownsampleRow8888(const void *top, const void *bottom,
+				void *dst, unsigned width, unsigned step)
+{
+	const uint32_t *t = (const uint32_t *)top;
+	const uint32_t *b = (const uint32_t *)bottom;
+	uint32_t *d = (uint32_t *)dst;
+
+	do {
+		*(d++) = fglAverage4(t[0], t[step], b[0], b[step]);
+		t += 2;
+		b += 2;
+	} while (--width);
+}
+
+static void fglDownsampleRow88(const void *top, const void *bottom,
+				void *dst, unsigned width, unsigned step)
+{
+	const uint8_t *t = (const uint8_t *)top;
+	const uint8_t *b = (const uint8_t *)bottom;
+	uint8_t *d = (uint8_t *)dst;
+
+	// Two source pixels in a word give one destination pixel
+	if (step && !(((uintptr_t)t | (uintptr_t)b) & 3)
+	    && !((uintptr_t)d & 1)) {
+		const uint32_t *t32 = (const uint32_t *)t;
+		const uint32_t *b32 = (const uint32_t *)b;
+		uint16_t *d16 = (uint16_t *)d;
+
+		do {
+			uint32_t tw = *(t32++);
+			uint32_t bw = *(b32++);
+			*(d16++) = fglAverage4(tw, tw >> 16, bw, bw >> 16);
+		} while (--width);
+
+		return;
+	}
+
+	step *= 2;
+	do {
+		d[0] = (t[0] + t[step] + b[0] + b[step]) >> 2;
+		d[1] = (t[1] + t[step + 1] + b[1] + b[step + 1]) >> 2;
+		d += 2;
+		t += 4;
+		b += 4;
+	} while (--width);
+}
+
+static void fglDownsampleRow8(const void *top, const void *bottom,
+				void *dst, unsigned width, unsigned step)
+{
+	const uint8_t *t = (const uint8_t *)top;
+	const uint8_t *b = (const uint8_t *)bottom;
+	uint8_t *d = (uint8_t *)dst;
+
+	// Four source pixels in a word give two destination pixels
+	if (step && !(((uintptr_t)t | (uintptr_t)b) & 3)
+	    && !((uintptr_t)d & 1)) {
+		const uint32_t *t32 = (const uint32_t *)t;
+		const uint32_t *b32 = (const uint32_t *)b;
+		uint16_t *d16 = (uint16_t *)d;
+
+		for (; width >= 2; width -= 2) {
+			uint32_t tw = *(t32++);
+			uint32_t bw = *(b32++);
+			uint32_t avg = fglAverage4(tw, tw >> 8, bw, bw >> 8);
+			*(d16++) = (avg & 0xff) | ((avg >> 8) & 0xff00);
+		}
+
+		t = (const uint8_t *)t32;
+		b = (const uint8_t *)b32;
+		d = (uint8_t *)d16;
+	}
+
+	while (width--) {
+		*(d++) = (t[0] + t[step] + b[0] + b[step]) >> 2;
+		t += 2;
+		b += 2;
+	}
+}
+
+/**
+	Worker pool
+
+	Every line of destination image depends only on two lines of the
+	source, so images are split into horizontal bands. The calling
+	thread processes the first band and waits for the others.
+*/
+
+struct FGLDownsampleJob {
+	FGLDownsampleRow	func;
+	const uint8_t		*src;
+	uint8_t			*dst;
+	unsigned		bpp;
+	unsigned		srcWidth;
+	unsigned		srcHeight;
+	unsigned		width;
+	unsigned		height;
+};
+
+static void fglDownsampleBand(const FGLDownsampleJob *job,
+					unsigned band, unsigned bands)
+{
+	unsigned first = job->height * band / bands;
+	unsigned last = job->height * (band + 1) / bands;
+	size_t srcStride = job->srcWidth * job->bpp;
+	size_t dstStride = job->width * job->bpp;
+	unsigned step = (job->srcWidth > 1) ? 1 : 0;
+	size_t bottom = (job->srcHeight > 1) ? srcStride : 0;
+
+	for (unsigned y = first; y < last; ++y) {
+		const uint8_t *top = job->src + 2*y*srcStride;
+		job->func(top, top + bottom, job->dst + y*dstStride,
+							job->width, step);
+	}
+}
+
+static pthread_once_t fglMipmapOnce = PTHREAD_ONCE_INIT;
+/* Serializes users of the pool */
+static pthread_mutex_t fglMipmapSubmitMutex = PTHREAD_MUTEX_INITIALIZER;
+/* Protects the job and counters below */
+static pthread_mutex_t fglMipmapMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fglMipmapStart = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t fglMipmapDone = PTHREAD_COND_INITIALIZER;
+static FGLDownsampleJob fglMipmapJob;
+static unsigned fglMipmapGeneration;
+static unsigned fglMipmapPending;
+static unsigned fglMipmapWorkers;
+
+static void *fglMipmapWorker(void *arg)
+{
+	unsigned band = (unsigned)(uintptr_t)arg;
+	unsigned generation = 0;
+
+	pthread_mutex_lock(&fglMipmapMutex);
+
+	while (1) {
+		while (fglMipmapGeneration == generation)
+			pthread_cond_wait(&fglMipmapStart, &fglMipmapMutex);
+
+		generation = fglMipmapGeneration;
+		FGLDownsampleJob job = fglMipmapJob;
+		unsigned bands = fglMipmapWorkers + 1;
+
+		pthread_mutex_unlock(&fglMipmapMutex);
+		fglDownsampleBand(&job, band, bands);
+		pthread_mutex_lock(&fglMipmapMutex);
+
+		if (!--fglMipmapPending)
+			pthread_cond_signal(&fglMipmapDone);
+	}
+
+	return 0;
+}
+
+/* Helpers only make sense with more than one core */
+static void fglInitMipmapWorkers(void)
+{
+#ifdef FGL_MIPMAP_FORCE_WORKERS
+	/* Tests exercise the pool regardless of the number of cores */
+	unsigned count = FGL_MIPMAP_MAX_WORKERS;
+#else
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned count = (cpus > 1) ? cpus - 1 : 0;
+
+	if (count > FGL_MIPMAP_MAX_WORKERS)
+		count = FGL_MIPMAP_MAX_WORKERS;
+#endif
+
+	pthread_mutex_lock(&fglMipmapMutex);
+
+	for (unsigned i = 0; i < count; ++i) {
+		pthread_attr_t attr;
+		pthread_t thread;
+		int ret;
+
+		pthread_attr_init(&attr);
+		pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+		ret = pthread_create(&thread, &attr, fglMipmapWorker,
+						(void *)(uintptr_t)(i + 1));
+		pthread_attr_destroy(&attr);
+		if (ret)
+			break;
+
+		++fglMipmapWorkers;
+	}
+
+	pthread_mutex_unlock(&fglMipmapMutex);
+}
+
+static void fglRunDownsampleJob(const FGLDownsampleJob *job)
+{
+	pthread_once(&fglMipmapOnce, fglInitMipmapWorkers);
+
+	if (!fglMipmapWorkers
+	    || job->width * job->height < FGL_MIPMAP_SPLIT_SIZE) {
+		fglDownsampleBand(job, 0, 1);
+		return;
+	}
+
+	pthread_mutex_lock(&fglMipmapSubmitMutex);
+
+	pthread_mutex_lock(&fglMipmapMutex);
+	fglMipmapJob = *job;
+	fglMipmapPending = fglMipmapWorkers;
+	++fglMipmapGeneration;
+	pthread_cond_broadcast(&fglMipmapStart);
+	pthread_mutex_unlock(&fglMipmapMutex);
+
+	fglDownsampleBand(job, 0, fglMipmapWorkers + 1);
+
+	pthread_mutex_lock(&fglMipmapMutex);
+	while (fglMipmapPending)
+		pthread_cond_wait(&fglMipmapDone, &fglMipmapMutex);
+	pthread_mutex_unlock(&fglMipmapMutex);
+
+	pthread_mutex_unlock(&fglMipmapSubmitMutex);
+}
+
+bool fglDownsampleImage(unsigned format, const void *src,
+			unsigned width, unsigned height, void *dst)
+{
+	FGLDownsampleJob job;
+
+	switch (format) {
+	case FGTU_TSTA_TEXTURE_FORMAT_565:
+		job.func = fglDownsampleRow565;
+		job.bpp = 2;
+		break;
+	case FGTU_TSTA_TEXTURE_FORMAT_1555:
+		job.func = fglDownsampleRow5551;
+		job.bpp = 2;
+		break;
+	case FGTU_TSTA_TEXTURE_FORMAT_4444:
+		job.func = fglDownsampleRow4444;
+		job.bpp = 2;
+		break;
+	case FGTU_TSTA_TEXTURE_FORMAT_8888:
+		job.func = fglDownsampleRow8888;
+		job.bpp = 4;
+		break;
+	case FGTU_TSTA_TEXTURE_FORMAT_88:
+		job.func = fglDownsampleRow88;
+		job.bpp = 2;
+		break;
+	case FGTU_TSTA_TEXTURE_FORMAT_8:
+		job.func = fglDownsampleRow8;
+		job.bpp = 1;
+		break;
+	default:
+		return false;
+	}
+
+	job.src = (const uint8_t *)src;
+	job.dst = (uint8_t *)dst;
+	job.srcWidth = width;
+	job.srcHeight = height;
+	job.width = (width >> 1) ? : 1;
+	job.height = (height >> 1) ? : 1;
+
+	fglRunDownsampleJob(&job);
+	return true;
+}
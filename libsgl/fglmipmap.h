@@ -0,0 +1,34 @@
+/**
+ * libsgl/fglmipmap.h
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2010 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LIBSGL_FGLMIPMAP_
+#define _LIBSGL_FGLMIPMAP_
+
+/*
+ * Box filters image in given texture format (FGTU_TSTA_TEXTURE_FORMAT_*)
+ * to half of its size in each dimension, but at least one pixel. Large
+ * images are split between worker threads on multicore systems.
+ * Returns false if the format is not supported.
+ */
+bool fglDownsampleImage(unsigned format, const void *src,
+			unsigned width, unsigned height, void *dst);
+
+#endif
@@ -0,0 +1,342 @@
+/**
+ * libsgl/fglpmem.cpp
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2010 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <pthread.h>
+#include "fglpmem.h"
+
+#define FGL_PMEM_PAGE_SIZE	4096
+
+struct FGLPmemFree {
+	FGLPmemFree	*next;
+	unsigned long	offset;
+	unsigned long	size;
+};
+
+struct FGLPmemChunk {
+	FGLPmemChunk	*next;
+	int		handle;
+	void		*vaddr;
+	unsigned long	paddr;
+	unsigned long	size;
+	unsigned long	used;
+	/* Free ranges, sorted by offset */
+	FGLPmemFree	*free;
+};
+
+/**
+	Size classes
+*/
+
+unsigned long FGLPmemAllocator::roundSize(unsigned long size)
+{
+	unsigned long step;
+
+	if (size <= 4096) {
+		step = 256;
+	} else {
+		// Four classes per power of two, but at most 64 KiB apart
+		step = 1UL << (31 - __builtin_clz(size));
+		step /= 4;
+		if (step > 64*1024)
+			step = 64*1024;
+	}
+
+	return (size + step - 1) & ~(step - 1);
+}
+
+/**
+	Chunks
+*/
+
+FGLPmemChunk *FGLPmemAllocator::createChunk(unsigned long size)
+{
+	FGLPmemChunk *chunk = new FGLPmemChunk;
+	if (!chunk)
+		return 0;
+
+	if (!backend->map(size, &chunk->handle, &chunk->vaddr, &chunk->paddr)) {
+		delete chunk;
+		return 0;
+	}
+
+	chunk->free = new FGLPmemFree;
+	if (!chunk->free) {
+		backend->unmap(chunk->handle, chunk->vaddr, size);
+		delete chunk;
+		return 0;
+	}
+
+	chunk->free->next = 0;
+	chunk->free->offset = 0;
+	chunk->free->size = size;
+	chunk->size = size;
+	chunk->used = 0;
+
+	chunk->next = chunks;
+	chunks = chunk;
+
+	return chunk;
+}
+
+void FGLPmemAllocator::destroyChunk(FGLPmemChunk *chunk)
+{
+	backend->unmap(chunk->handle, chunk->vaddr, chunk->size);
+
+	while (chunk->free) {
+		FGLPmemFree *next = chunk->free->next;
+		delete chunk->free;
+		chunk->free = next;
+	}
+
+	delete chunk;
+}
+
+/* Unmaps empty chunks, keeping one regular chunk for next allocations */
+void FGLPmemAllocator::releaseChunks(void)
+{
+	FGLPmemChunk **link = &chunks;
+	bool spare = false;
+
+	while (*link) {
+		FGLPmemChunk *chunk = *link;
+
+		if (chunk->used || (!spare && chunk->size == chunkSize)) {
+			if (!chunk->used)
+				spare = true;
+			link = &chunk->next;
+			continue;
+		}
+
+		*link = chunk->next;
+		destroyChunk(chunk);
+	}
+}
+
+bool FGLPmemAllocator::allocFromChunk(FGLPmemChunk *chunk,
+				unsigned long size, FGLPmemBlock *block)
+{
+	FGLPmemFree **link = &chunk->free;
+	unsigned long pad = 0;
+
+	// First fit, starting at aligned offset
+	for (; *link; link = &(*link)->next) {
+		pad = -(*link)->offset & (FGL_PMEM_ALIGN - 1);
+		if ((*link)->size >= pad + size)
+			break;
+	}
+
+	FGLPmemFree *range = *link;
+	if (!range)
+		return false;
+
+	unsigned long offset = range->offset + pad;
+
+	if (!pad) {
+		range->offset += size;
+		range->size -= size;
+		if (!range->size) {
+			*link = range->next;
+			delete range;
+		}
+	} else if (range->size > pad + size) {
+		// Padding stays free in front of the block
+		FGLPmemFree *rest = new FGLPmemFree;
+		if (!rest)
+			return false;
+
+		rest->offset = offset + size;
+		rest->size = range->size - pad - size;
+		rest->next = range->next;
+		range->next = rest;
+		range->size = pad;
+	} else {
+		range->size = pad;
+	}
+
+	block->chunk = chunk;
+	block->offset = offset;
+	block->size = size;
+	block->vaddr = (char *)chunk->vaddr + offset;
+	block->paddr = chunk->paddr + offset;
+
+	chunk->used += size;
+	return true;
+}
+
+/**
+	Allocator
+*/
+
+FGLPmemAllocator::FGLPmemAllocator(FGLPmemBackend *backend,
+						unsigned long chunkSize) :
+	backend(backend), chunks(0), chunkSize(chunkSize)
+{
+	pthread_mutex_init(&mutex, NULL);
+}
+
+FGLPmemAllocator::~FGLPmemAllocator()
+{
+	while (chunks) {
+		FGLPmemChunk *next = chunks->next;
+		destroyChunk(chunks);
+		chunks = next;
+	}
+
+	pthread_mutex_destroy(&mutex);
+	delete backend;
+}
+
+bool FGLPmemAllocator::alloc(unsigned long size, FGLPmemBlock *block)
+{
+	FGLPmemChunk *chunk;
+	bool ret = false;
+
+	size = roundSize(size ? size : 1);
+
+	pthread_mutex_lock(&mutex);
+
+	for (chunk = chunks; chunk; chunk = chunk->next)
+		if ((ret = allocFromChunk(chunk, size, block)))
+			break;
+
+	if (!ret) {
+		// Big surfaces get chunks of their own
+		unsigned long newSize = chunkSize;
+		if (size > chunkSize / 2)
+			newSize = (size + FGL_PMEM_PAGE_SIZE - 1)
+						& ~(FGL_PMEM_PAGE_SIZE - 1);
+
+		chunk = createChunk(newSize);
+		if (chunk)
+			ret = allocFromChunk(chunk, size, block);
+	}
+
+	pthread_mutex_unlock(&mutex);
+
+	return ret;
+}
+
+void FGLPmemAllocator::free(FGLPmemBlock *block)
+{
+	FGLPmemChunk *chunk = block->chunk;
+
+	if (!chunk)
+		return;
+
+	pthread_mutex_lock(&mutex);
+
+	FGLPmemFree *prev = 0;
+	FGLPmemFree *next = chunk->free;
+	while (next && next->offset < block->offset) {
+		prev = next;
+		next = next->next;
+	}
+
+	// Merge with neighbouring free ranges where possible
+	if (prev && prev->offset + prev->size == block->offset) {
+		prev->size += block->size;
+		if (next && prev->offset + prev->size == next->offset) {
+			prev->size += next->size;
+			prev->next = next->next;
+			delete next;
+		}
+	} else if (next && block->offset + block->size == next->offset) {
+		next->offset = block->offset;
+		next->size += block->size;
+	} else {
+		FGLPmemFree *range = new FGLPmemFree;
+		if (range) {
+			range->offset = block->offset;
+			range->size = block->size;
+			range->next = next;
+			if (prev)
+				prev->next = range;
+			else
+				chunk->free = range;
+		}
+	}
+
+	chunk->used -= block->size;
+	if (!chunk->used)
+		releaseChunks();
+
+	pthread_mutex_unlock(&mutex);
+
+	block->chunk = 0;
+}
+
+unsigned long FGLPmemAllocator::freeSpan(const FGLPmemBlock *block)
+{
+	FGLPmemChunk *chunk = block->chunk;
+	unsigned long span = block->size;
+
+	if (!chunk)
+		return 0;
+
+	pthread_mutex_lock(&mutex);
+
+	FGLPmemFree *prev = 0;
+	FGLPmemFree *next = chunk->free;
+	while (next && next->offset < block->offset) {
+		prev = next;
+		next = next->next;
+	}
+
+	if (prev && prev->offset + prev->size == block->offset)
+		span += prev->size;
+	if (next && block->offset + block->size == next->offset)
+		span += next->size;
+
+	pthread_mutex_unlock(&mutex);
+
+	return span;
+}
+
+unsigned long FGLPmemAllocator::chunkUsed(const FGLPmemChunk *chunk)
+{
+	unsigned long used;
+
+	pthread_mutex_lock(&mutex);
+	used = chunk->used;
+	pthread_mutex_unlock(&mutex);
+
+	return used;
+}
+
+void FGLPmemAllocator::flush(FGLPmemBlock *block)
+{
+	if (!block->chunk)
+		return;
+
+	backend->flush(block->chunk->handle, block->offset, block->size);
+}
+
+void FGLPmemAllocator::flush(FGLPmemBlock *block, unsigned long offset,
+							unsigned long len)
+{
+	if (!block->chunk || offset >= block->size)
+		return;
+
+	if (len > block->size - offset)
+		len = block->size - offset;
+
+	backend->flush(block->chunk->handle, block->offset + offset, len);
+}
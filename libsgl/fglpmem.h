@@ -0,0 +1,94 @@
+/**
+ * libsgl/fglpmem.h
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2010 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LIBSGL_FGLPMEM_
+#define _LIBSGL_FGLPMEM_
+
+#include <pthread.h>
+
+/* Size of chunks mapped from the device */
+#define FGL_PMEM_CHUNK_SIZE	(2*1024*1024)
+/* Alignment of suballocated surfaces (texture unit and cache lines) */
+#define FGL_PMEM_ALIGN		64
+
+/*
+ * Source of physically contiguous memory. Chunks are only mapped and
+ * unmapped as a whole, while cache flushes work on ranges of them.
+ */
+struct FGLPmemBackend {
+	virtual		~FGLPmemBackend() {};
+
+	virtual bool	map(unsigned long size, int *handle,
+				void **vaddr, unsigned long *paddr) = 0;
+	virtual void	unmap(int handle, void *vaddr, unsigned long size) = 0;
+	virtual void	flush(int handle, unsigned long offset,
+				unsigned long size) = 0;
+};
+
+struct FGLPmemChunk;
+
+struct FGLPmemBlock {
+	FGLPmemChunk	*chunk;
+	unsigned long	offset;
+	unsigned long	size;
+	void		*vaddr;
+	unsigned long	paddr;
+
+	FGLPmemBlock() :
+		chunk(0), offset(0), size(0), vaddr(0), paddr(0) {};
+};
+
+/*
+ * Suballocates blocks from large chunks mapped once from the backend,
+ * to avoid a device open, mmap and close for every surface. Sizes are
+ * rounded to size classes, which keeps freed space reusable.
+ */
+class FGLPmemAllocator {
+	FGLPmemBackend	*backend;
+	FGLPmemChunk	*chunks;
+	unsigned long	chunkSize;
+	pthread_mutex_t	mutex;
+
+	FGLPmemChunk	*createChunk(unsigned long size);
+	void		destroyChunk(FGLPmemChunk *chunk);
+	bool		allocFromChunk(FGLPmemChunk *chunk,
+					unsigned long size, FGLPmemBlock *block);
+	void		releaseChunks(void);
+public:
+			FGLPmemAllocator(FGLPmemBackend *backend,
+					unsigned long chunkSize);
+			~FGLPmemAllocator();
+
+	bool		alloc(unsigned long size, FGLPmemBlock *block);
+	void		free(FGLPmemBlock *block);
+	void		flush(FGLPmemBlock *block);
+	void		flush(FGLPmemBlock *block, unsigned long offset,
+							unsigned long len);
+
+	/* Size of free range the block would be part of after freeing it */
+	unsigned long	freeSpan(const FGLPmemBlock *block);
+	/* Bytes allocated from given chunk */
+	unsigned long	chunkUsed(const FGLPmemChunk *chunk);
+
+	static unsigned long roundSize(unsigned long size);
+};
+
+#endif
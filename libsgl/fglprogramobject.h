@@ -0,0 +1,112 @@
+/**
+ * libsgl/fglprogramobject.h
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2010 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LIBSGL_FGLPROGRAMOBJECT_
+#define _LIBSGL_FGLPROGRAMOBJECT_
+
+#include <cstdlib>
+#include <cstring>
+#include "common.h"
+#include "fglobject.h"
+#include "libfimg/fimg.h"
+
+struct FGLProgram {
+	uint32_t *code[FGFP_PROGRAM_STAGES];
+	float consts[FGFP_PROGRAM_STAGES][FIMG_NUM_CONST_FLOAT][4];
+	fimgProgram desc;
+	/* Changes on every modification, 0 means fixed pipeline */
+	unsigned serial;
+
+	static unsigned lastSerial;
+
+	FGLProgram() :
+		serial(0)
+	{
+		memset(&desc, 0, sizeof(desc));
+
+		for (int i = 0; i < FGFP_PROGRAM_STAGES; ++i) {
+			code[i] = 0;
+			desc.consts[i] = &consts[i][0][0];
+		}
+
+		for (int i = 0; i < 3 + FIMG_NUM_TEXTURE_UNITS; ++i)
+			desc.matrix[i] = -1;
+	}
+
+	~FGLProgram()
+	{
+		for (int i = 0; i < FGFP_PROGRAM_STAGES; ++i)
+			free(code[i]);
+	}
+
+	int setCode(int stage, const GLvoid *data, uint32_t len)
+	{
+		uint32_t *buf = (uint32_t *)malloc(16*len);
+
+		if (unlikely(buf == 0))
+			return -1;
+
+		memcpy(buf, data, 16*len);
+		free(code[stage]);
+		code[stage] = buf;
+
+		desc.code[stage] = buf;
+		desc.len[stage] = len;
+		modified();
+
+		return 0;
+	}
+
+	void setConsts(int stage, uint32_t index,
+					const GLfloat *values, uint32_t count)
+	{
+		memcpy(consts[stage][index], values, 16*count);
+
+		if (index + count > desc.numConsts[stage])
+			desc.numConsts[stage] = index + count;
+		modified();
+	}
+
+	void setMatrix(uint32_t matrix, GLint index)
+	{
+		desc.matrix[matrix] = index;
+		modified();
+	}
+
+	inline void modified(void)
+	{
+		/* Skip 0 on wrap-around */
+		if (!++lastSerial)
+			++lastSerial;
+		serial = lastSerial;
+	}
+
+	inline bool isValid(void)
+	{
+		return code[FGFP_PROGRAM_VERTEX] != 0
+			&& code[FGFP_PROGRAM_PIXEL] != 0;
+	}
+};
+
+typedef FGLObject<FGLProgram> FGLProgramObject;
+typedef FGLObjectBinding<FGLProgram> FGLProgramObjectBinding;
+
+#endif
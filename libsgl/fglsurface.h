@@ -29,6 +29,7 @@
 #include <errno.h>
 
 #include "eglMem.h"
+#include "fglpmem.h"
 #include <private/ui/sw_gralloc_handle.h>
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
@@ -40,18 +41,53 @@ public:
 	void		*vaddr;
 	unsigned long	size;
 
-			FGLSurface() {};
+			FGLSurface() : dirtyStart(~0UL), dirtyEnd(0) {};
 	virtual		~FGLSurface() {};
 
+	/* Records a CPU write, so flush() can be limited to written bytes */
+	void		markDirty(unsigned long offset, unsigned long len)
+	{
+		if (offset < dirtyStart)
+			dirtyStart = offset;
+		if (offset + len > dirtyEnd)
+			dirtyEnd = offset + len;
+	}
+
+	void		markDirty(void) { markDirty(0, size); };
+
 	virtual void	flush(void) = 0;
 	virtual int	lock(int usage = 0) = 0;
 	virtual int	unlock(void) = 0;
 
 	virtual bool	isValid(void) = 0;
+
+protected:
+	unsigned long	dirtyStart;
+	unsigned long	dirtyEnd;
+
+	/*
+	 * Returns the range to be flushed and forgets it. Unknown writes and
+	 * ranges covering most of the surface are flushed as a whole, which
+	 * costs less than walking such range line by line.
+	 */
+	void		getFlushRange(unsigned long *offset, unsigned long *len)
+	{
+		if (dirtyStart >= dirtyEnd || dirtyEnd > size
+		    || dirtyEnd - dirtyStart > size / 2) {
+			*offset = 0;
+			*len = size;
+		} else {
+			*offset = dirtyStart;
+			*len = dirtyEnd - dirtyStart;
+		}
+
+		dirtyStart = ~0UL;
+		dirtyEnd = 0;
+	}
 };
 
 class FGLLocalSurface : public FGLSurface {
-	int		fd;
+	FGLPmemBlock	block;
 public:
 			FGLLocalSurface(unsigned long size);
 	virtual		~FGLLocalSurface();
@@ -60,7 +96,13 @@ public:
 	virtual int	lock(int usage = 0);
 	virtual int	unlock(void);
 
-	virtual bool	isValid(void) { return fd != -1; };
+	virtual bool	isValid(void) { return block.chunk != 0; };
+
+	/* Placement in pmem, to find what freeing the surface gives back */
+	FGLPmemChunk	*getChunk(void) const { return block.chunk; };
+	unsigned long	getBlockSize(void) const { return block.size; };
+	unsigned long	getFreeSpan(void);
+	unsigned long	getChunkUsed(void);
 };
 
 class FGLExternalSurface : public FGLSurface {
@@ -75,6 +117,18 @@ public:
 	virtual bool	isValid(void) { return true; };
 };
 
+class FGLSystemSurface : public FGLSurface {
+public:
+			FGLSystemSurface(unsigned long size);
+	virtual		~FGLSystemSurface();
+
+	virtual void	flush(void);
+	virtual int	lock(int usage = 0);
+	virtual int	unlock(void);
+
+	virtual bool	isValid(void) { return vaddr != 0; };
+};
+
 class FGLImageSurface : public FGLSurface {
 	gralloc_module_t const* module;
 	EGLImageKHR	image;
@@ -26,10 +26,22 @@
 #include "fglobject.h"
 #include "fglattach.h"
 
+#define FGL_CUBE_FACES		6
+
+struct FGLTexture;
+struct FGLContext;
+
+/* Texture residency in local memory (glesTex.cpp) */
+bool fglMakeTextureResident(FGLContext *ctx, FGLTexture *tex);
+void fglUnregisterTexture(FGLTexture *tex);
+void fglAdvanceTextureFrame(FGLContext *ctx);
+void fglReleaseResidentTextures(FGLContext *ctx);
+
 struct FGLTexture : public FGLAttachable {
 	/* GL state */
+	GLenum		target;
 	GLboolean	compressed;
-	GLint		levels;
+	GLint		levels[FGL_CUBE_FACES];
 	GLint		maxLevel;
 	GLenum		format;
 	GLenum		type;
@@ -45,16 +57,33 @@ struct FGLTexture : public FGLAttachable {
 	fimgTexture	*fimg;
 	uint32_t	fglFormat;
 	bool		convert;
+	/* Palette of paletted textures, in hardware format */
+	uint32_t	*palette;
+	unsigned	paletteSize;
+	/* Size of each cube face with its mipmaps */
+	size_t		faceSize;
 	bool		valid;
 	bool		dirty;
+	/* Residency in local memory */
+	bool		local;
+	FGLContext	*lruContext;
+	FGLTexture	*lruPrev;
+	FGLTexture	*lruNext;
+	unsigned	lastUsed;
+	bool		evicted;
 
 	FGLTexture() :
-		compressed(0), levels(0), maxLevel(0), format(GL_RGB),
+		target(GL_TEXTURE_2D), compressed(0), maxLevel(0), format(GL_RGB),
 		type(GL_UNSIGNED_BYTE), minFilter(GL_NEAREST_MIPMAP_LINEAR),
 		magFilter(GL_LINEAR), sWrap(GL_REPEAT), tWrap(GL_REPEAT),
 		genMipmap(0), useMipmap(GL_TRUE), eglImage(0),
-		fimg(NULL), valid(false), dirty(false)
+		fimg(NULL), palette(NULL), paletteSize(0), faceSize(0),
+		valid(false), dirty(false), local(false), lruContext(0),
+		lruPrev(0), lruNext(0), lastUsed(0), evicted(false)
 	{
+		for (int i = 0; i < FGL_CUBE_FACES; ++i)
+			levels[i] = 0;
+
 		fimg = fimgCreateTexture();
 		if(fimg == NULL)
 			return;
@@ -64,6 +93,9 @@ struct FGLTexture : public FGLAttachable {
 
 	~FGLTexture()
 	{
+		fglUnregisterTexture(this);
+		delete[] palette;
+
 		if(!isValid())
 			return;
 
@@ -75,12 +107,26 @@ struct FGLTexture : public FGLAttachable {
 		return valid;
 	}
 
+	inline int getFaces(void)
+	{
+		if (target == GL_TEXTURE_CUBE_MAP_OES)
+			return FGL_CUBE_FACES;
+
+		return 1;
+	}
+
 	inline bool isComplete(void)
 	{
-		if (!useMipmap)
-			return levels & 1;
+		GLint mask = 1;
+
+		if (useMipmap)
+			mask = (1 << (maxLevel + 1)) - 1;
+
+		for (int i = 0; i < getFaces(); ++i)
+			if ((levels[i] & mask) != mask)
+				return false;
 
-		return levels == ((1 << (maxLevel + 1)) - 1);
+		return true;
 	}
 };
 
@@ -0,0 +1,274 @@
+/**
+ * libsgl/fgltranscode.cpp
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2010 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <ETC1/etc1.h>
+
+#include "common.h"
+#include "fgltranscode.h"
+
+/**
+	DXT1 encoder
+*/
+
+static inline uint16_t fglPack565(const int *c)
+{
+	return ((c[0] & 0xf8) << 8) | ((c[1] & 0xfc) << 3) | (c[2] >> 3);
+}
+
+static inline void fglUnpack565(uint16_t v, int *c)
+{
+	c[0] = (v >> 11) & 0x1f;
+	c[0] = (c[0] << 3) | (c[0] >> 2);
+	c[1] = (v >> 5) & 0x3f;
+	c[1] = (c[1] << 2) | (c[1] >> 4);
+	c[2] = v & 0x1f;
+	c[2] = (c[2] << 3) | (c[2] >> 2);
+}
+
+/*
+ * Encodes 4x4 RGB888 pixels into a DXT1 block. Endpoints are taken from
+ * slightly inset bounding box of the block colors, which is cheap and
+ * close enough for content that went through ETC1 already.
+ */
+static void fglEncodeDXT1Block(const uint8_t *rgb, uint8_t *out)
+{
+	int lo[3] = { 255, 255, 255 };
+	int hi[3] = { 0, 0, 0 };
+	int i, c;
+
+	for (i = 0; i < 16; ++i) {
+		for (c = 0; c < 3; ++c) {
+			lo[c] = min<int>(lo[c], rgb[3*i + c]);
+			hi[c] = max<int>(hi[c], rgb[3*i + c]);
+		}
+	}
+
+	for (c = 0; c < 3; ++c) {
+		int inset = (hi[c] - lo[c]) >> 4;
+		lo[c] += inset;
+		hi[c] -= inset;
+	}
+
+	uint16_t c0 = fglPack565(hi);
+	uint16_t c1 = fglPack565(lo);
+	uint32_t indices = 0;
+
+	// Four color mode requires c0 > c1
+	if (c0 < c1) {
+		uint16_t tmp = c0;
+		c0 = c1;
+		c1 = tmp;
+	}
+
+	if (c0 != c1) {
+		int pal[4][3];
+
+		fglUnpack565(c0, pal[0]);
+		fglUnpack565(c1, pal[1]);
+		for (c = 0; c < 3; ++c) {
+			pal[2][c] = (2*pal[0][c] + pal[1][c]) / 3;
+			pal[3][c] = (pal[0][c] + 2*pal[1][c]) / 3;
+		}
+
+		for (i = 0; i < 16; ++i) {
+			int best = 0, bestDist = INT_MAX;
+
+			for (int j = 0; j < 4; ++j) {
+				int dist = 0;
+				for (c = 0; c < 3; ++c) {
+					int d = rgb[3*i + c] - pal[j][c];
+					dist += d*d;
+				}
+				if (dist < bestDist) {
+					bestDist = dist;
+					best = j;
+				}
+			}
+
+			indices |= best << (2*i);
+		}
+	}
+
+	out[0] = c0 & 0xff;
+	out[1] = c0 >> 8;
+	out[2] = c1 & 0xff;
+	out[3] = c1 >> 8;
+	out[4] = indices & 0xff;
+	out[5] = (indices >> 8) & 0xff;
+	out[6] = (indices >> 16) & 0xff;
+	out[7] = indices >> 24;
+}
+
+static void fglConvertETC1(uint8_t *dst, const uint8_t *src, size_t blocks)
+{
+	etc1_byte rgb[ETC1_DECODED_BLOCK_SIZE];
+
+	while (blocks--) {
+		etc1_decode_block(src, rgb);
+		fglEncodeDXT1Block(rgb, dst);
+		src += ETC1_ENCODED_BLOCK_SIZE;
+		dst += 8;
+	}
+}
+
+/**
+	Transcode cache
+*/
+
+/* Bump the version whenever the encoder output changes */
+#define FGL_CACHE_MAGIC		0x31544746	/* 'FGT1' */
+
+struct FGLCacheHeader {
+	uint32_t magic;
+	uint32_t width;
+	uint32_t height;
+	uint32_t size;
+};
+
+static char fglCacheDir[PATH_MAX];
+static pthread_once_t fglCacheOnce = PTHREAD_ONCE_INIT;
+
+/* Cache lives in cache directory of the application using the driver */
+static void fglInitCacheDir(void)
+{
+	char name[128];
+	char dir[PATH_MAX];
+
+	int fd = open("/proc/self/cmdline", O_RDONLY);
+	if (fd < 0)
+		return;
+
+	ssize_t len = read(fd, name, sizeof(name) - 1);
+	close(fd);
+	if (len <= 0)
+		return;
+	name[len] = '\0';
+
+	// Secondary processes share data directory of the package
+	char *colon = strchr(name, ':');
+	if (colon)
+		*colon = '\0';
+
+	if (!name[0] || strchr(name, '/'))
+		return;
+
+	snprintf(dir, sizeof(dir), "/data/data/%s/cache/fglTextures", name);
+	if (mkdir(dir, 0700) && errno != EEXIST)
+		return;
+
+	strcpy(fglCacheDir, dir);
+}
+
+/* 64-bit FNV-1a, application data does not have to be aligned */
+static uint64_t fglHashData(const void *data, size_t size)
+{
+	const uint8_t *src8 = (const uint8_t *)data;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	while (size--) {
+		hash ^= *(src8++);
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static bool fglReadCache(const char *path, void *dst, unsigned width,
+					unsigned height, size_t size)
+{
+	FGLCacheHeader hdr;
+	bool ret = false;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	if (read(fd, &hdr, sizeof(hdr)) == sizeof(hdr)
+	    && hdr.magic == FGL_CACHE_MAGIC && hdr.width == width
+	    && hdr.height == height && hdr.size == size)
+		ret = read(fd, dst, size) == (ssize_t)size;
+
+	close(fd);
+	return ret;
+}
+
+static void fglWriteCache(const char *path, const void *src,
+			unsigned width, unsigned height, size_t size)
+{
+	char tmp[PATH_MAX];
+	FGLCacheHeader hdr;
+
+	hdr.magic = FGL_CACHE_MAGIC;
+	hdr.width = width;
+	hdr.height = height;
+	hdr.size = size;
+
+	// Write to temporary file first, so readers never see partial data
+	snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+	int fd = mkstemp(tmp);
+	if (fd < 0)
+		return;
+
+	bool ok = write(fd, &hdr, sizeof(hdr)) == sizeof(hdr)
+			&& write(fd, src, size) == (ssize_t)size;
+	close(fd);
+
+	if (!ok || rename(tmp, path)) {
+		LOGW("Failed to store transcoded texture in %s", path);
+		unlink(tmp);
+	}
+}
+
+void fglTranscodeETC1(void *dst, const void *src,
+				unsigned width, unsigned height)
+{
+	size_t blocks = ((width + 3) / 4) * ((height + 3) / 4);
+	size_t size = blocks * ETC1_ENCODED_BLOCK_SIZE;
+	char path[PATH_MAX];
+
+	pthread_once(&fglCacheOnce, fglInitCacheDir);
+
+	if (!fglCacheDir[0]) {
+		fglConvertETC1((uint8_t *)dst, (const uint8_t *)src, blocks);
+		return;
+	}
+
+	snprintf(path, sizeof(path), "%s/%016llx-%ux%u", fglCacheDir,
+		(unsigned long long)fglHashData(src, size), width, height);
+
+	if (fglReadCache(path, dst, width, height, size))
+		return;
+
+	fglConvertETC1((uint8_t *)dst, (const uint8_t *)src, blocks);
+	fglWriteCache(path, dst, width, height, size);
+}
@@ -0,0 +1,33 @@
+/**
+ * libsgl/fgltranscode.h
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2010 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LIBSGL_FGLTRANSCODE_
+#define _LIBSGL_FGLTRANSCODE_
+
+/*
+ * Converts ETC1 image to DXT1 blocks of the same layout. Results are
+ * kept in a per-application cache on disk, keyed by hash of ETC1 data,
+ * so every image gets transcoded only once.
+ */
+void fglTranscodeETC1(void *dst, const void *src,
+				unsigned width, unsigned height);
+
+#endif
@@ -21,12 +21,14 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cmath>
 #include <errno.h>
 #include <pthread.h>
 #include <fcntl.h>
 #include <cutils/log.h>
 #include <GLES/gl.h>
 #include <GLES/glext.h>
+#include "fglext.h"
 #include "glesCommon.h"
 #include "fglobjectmanager.h"
 #include "libfimg/fimg.h"
@@ -57,7 +59,7 @@ GL_API GLenum GL_APIENTRY glGetError (void)
 	Vertex state
 */
 
-FGLvec4f FGLContext::defaultVertex[4 + FGL_MAX_TEXTURE_UNITS] = {
+FGLvec4f FGLContext::defaultVertex[FGL_ARRAY_NUM] = {
 	/* Vertex - unused */
 	{ 0.0f, 0.0f, 0.0f, 0.0f },
 	/* Normal */
@@ -70,6 +72,14 @@ FGLvec4f FGLContext::defaultVertex[4 + FGL_MAX_TEXTURE_UNITS] = {
 	{ 0.0f, 0.0f, 0.0f, 1.0f },
 	/* Texture 1 */
 	{ 0.0f, 0.0f, 0.0f, 1.0f },
+	/* Texture 2 */
+	{ 0.0f, 0.0f, 0.0f, 1.0f },
+	/* Texture 3 */
+	{ 0.0f, 0.0f, 0.0f, 1.0f },
+	/* Matrix indices */
+	{ 0.0f, 0.0f, 0.0f, 0.0f },
+	/* Weights */
+	{ 0.0f, 0.0f, 0.0f, 0.0f },
 };
 
 GL_API void GL_APIENTRY glColor4f (GLfloat red, GLfloat green,
@@ -467,6 +477,7 @@ GL_API void GL_APIENTRY glPointSizePointerOES (GLenum type, GLsizei stride,
 	case GL_FIXED:
 		fglType = FGHI_ATTRIB_DT_FIXED;
 		fglStride = 4;
+		break;
 	case GL_FLOAT:
 		fglType = FGHI_ATTRIB_DT_FLOAT;
 		fglStride = 4;
@@ -535,6 +546,72 @@ GL_API void GL_APIENTRY glTexCoordPointer (GLint size, GLenum type,
 				size, fglType, stride, fglStride, pointer);
 }
 
+GL_API void GL_APIENTRY glMatrixIndexPointerOES (GLint size, GLenum type,
+					GLsizei stride, const GLvoid *pointer)
+{
+	GLint fglType, fglStride;
+
+	if(size < 1 || size > FGL_MAX_VERTEX_UNITS) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	switch(type) {
+	case GL_UNSIGNED_BYTE:
+		fglType = FGHI_ATTRIB_DT_UBYTE;
+		fglStride = size;
+		break;
+	default:
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	if(stride < 0) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+
+	fglSetupAttribute(ctx, FGL_ARRAY_MATRIX_INDEX, size, fglType, stride,
+							fglStride, pointer);
+}
+
+GL_API void GL_APIENTRY glWeightPointerOES (GLint size, GLenum type,
+					GLsizei stride, const GLvoid *pointer)
+{
+	GLint fglType, fglStride;
+
+	if(size < 1 || size > FGL_MAX_VERTEX_UNITS) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	switch(type) {
+	case GL_FIXED:
+		fglType = FGHI_ATTRIB_DT_FIXED;
+		fglStride = 4*size;
+		break;
+	case GL_FLOAT:
+		fglType = FGHI_ATTRIB_DT_FLOAT;
+		fglStride = 4*size;
+		break;
+	default:
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	if(stride < 0) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+
+	fglSetupAttribute(ctx, FGL_ARRAY_WEIGHT, size, fglType, stride,
+							fglStride, pointer);
+}
+
 static void fglEnableClientState(FGLContext *ctx, GLint idx)
 {
 	ctx->array[idx].enabled = GL_TRUE;
@@ -562,6 +639,12 @@ GL_API void GL_APIENTRY glEnableClientState (GLenum array)
 	case GL_TEXTURE_COORD_ARRAY:
 		idx = FGL_ARRAY_TEXTURE(ctx->clientActiveTexture);
 		break;
+	case GL_MATRIX_INDEX_ARRAY_OES:
+		idx = FGL_ARRAY_MATRIX_INDEX;
+		break;
+	case GL_WEIGHT_ARRAY_OES:
+		idx = FGL_ARRAY_WEIGHT;
+		break;
 	default:
 		setError(GL_INVALID_ENUM);
 		return;
@@ -570,8 +653,8 @@ GL_API void GL_APIENTRY glEnableClientState (GLenum array)
 	fglEnableClientState(ctx, idx);
 }
 
-static const GLint fglDefaultAttribSize[4 + FGL_MAX_TEXTURE_UNITS] = {
-	4, 3, 4, 1, 4, 4
+static const GLint fglDefaultAttribSize[FGL_ARRAY_NUM] = {
+	4, 3, 4, 1, 4, 4, 4, 4, 4, 4
 };
 
 static void fglDisableClientState(FGLContext *ctx, GLint idx)
@@ -601,6 +684,12 @@ GL_API void GL_APIENTRY glDisableClientState (GLenum array)
 	case GL_TEXTURE_COORD_ARRAY:
 		idx = FGL_ARRAY_TEXTURE(ctx->clientActiveTexture);
 		break;
+	case GL_MATRIX_INDEX_ARRAY_OES:
+		idx = FGL_ARRAY_MATRIX_INDEX;
+		break;
+	case GL_WEIGHT_ARRAY_OES:
+		idx = FGL_ARRAY_WEIGHT;
+		break;
 	default:
 		setError(GL_INVALID_ENUM);
 		return;
@@ -652,16 +741,24 @@ static inline void fglSetupMatrices(FGLContext *ctx)
 		transform = &ctx->matrix.transformMatrix;
 		proj = &ctx->matrix.stack[FGL_MATRIX_PROJECTION].top();
 		modview = &ctx->matrix.stack[FGL_MATRIX_MODELVIEW].top();
+		/* Palette matrices transform vertices to eye space */
+		if (ctx->matrix.paletteEnabled)
+			modview = &ctx->matrix.identityMatrix;
 		transform->multiply(*proj, *modview);
 
 		fimgLoadMatrix(ctx->fimg, FGFP_MATRIX_TRANSFORM, transform->data);
+		fimgSetMatrixClass(ctx->fimg, FGFP_MATRIX_TRANSFORM,
+				(fimgMatrixClass)transform->classify());
 
 		/* Load lighting matrix */
 		FGLmatrix *light;
 
 		light = &ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].top();
+		if (ctx->matrix.paletteEnabled)
+			light = &ctx->matrix.identityMatrix;
 
 		fimgLoadMatrix(ctx->fimg, FGFP_MATRIX_LIGHTING, light->data);
+		fimgLoadMatrix(ctx->fimg, FGFP_MATRIX_MODELVIEW, modview->data);
 
 		/* Mark transformation matrices as clean */
 		ctx->matrix.dirty[FGL_MATRIX_MODELVIEW] = GL_FALSE;
@@ -677,25 +774,330 @@ static inline void fglSetupMatrices(FGLContext *ctx)
 
 		FGLmatrix *tex = &ctx->matrix.stack[FGL_MATRIX_TEXTURE(i)].top();
 		fimgLoadMatrix(ctx->fimg, FGFP_MATRIX_TEXTURE(i), tex->data);
+		fimgSetMatrixClass(ctx->fimg, FGFP_MATRIX_TEXTURE(i),
+					(fimgMatrixClass)tex->classify());
 		ctx->matrix.dirty[FGL_MATRIX_TEXTURE(i)] = GL_FALSE;
 	} while (i--);
 }
 
+/* Loads changed palette matrices and selects vertex skinning */
+static inline void fglSetupPalette(FGLContext *ctx)
+{
+	if (!ctx->matrix.paletteEnabled) {
+		fimgCompatSetMatrixPalette(ctx->fimg, 0);
+		return;
+	}
+
+	for (int i = 0; i < ctx->matrix.paletteCount; ++i) {
+		GLint idx = FGL_MATRIX_PALETTE(i);
+		GLint inv = FGL_MATRIX_PALETTE_INVERSE(i);
+
+		if (!ctx->matrix.dirty[idx] && !ctx->matrix.dirty[inv])
+			continue;
+
+		fimgCompatSetPaletteMatrix(ctx->fimg, i,
+					ctx->matrix.stack[idx].top().data,
+					ctx->matrix.stack[inv].top().data);
+		ctx->matrix.dirty[idx] = GL_FALSE;
+		ctx->matrix.dirty[inv] = GL_FALSE;
+	}
+
+	/* Vertices without weight array get no weights at all */
+	GLint units = FGL_MAX_VERTEX_UNITS;
+	if (ctx->array[FGL_ARRAY_WEIGHT].enabled)
+		units = ctx->array[FGL_ARRAY_WEIGHT].size;
+
+	fimgCompatSetVertexUnits(ctx->fimg, units);
+	fimgCompatSetMatrixPalette(ctx->fimg, ctx->matrix.paletteCount);
+}
+
+/* Matrix index and weight attributes are only sent for vertex skinning */
+static inline int fglAttribCount(FGLContext *ctx)
+{
+	if (ctx->matrix.paletteEnabled)
+		return FGL_ARRAY_NUM;
+
+	return FGL_ARRAY_MATRIX_INDEX;
+}
+
+/* Switches between fixed pipeline and bound application program */
+static inline void fglSetupProgram(FGLContext *ctx)
+{
+	FGLProgram *prog = ctx->program.get();
+	unsigned serial = 0;
+
+	if (prog && prog->isValid())
+		serial = prog->serial;
+
+	if (likely(serial == ctx->programSerial))
+		return;
+
+	if (serial == 0 || fimgCompatSetProgram(ctx->fimg, &prog->desc)) {
+		fimgCompatSetProgram(ctx->fimg, NULL);
+		serial = 0;
+	}
+
+	ctx->programSerial = serial;
+}
+
+static inline void fglNormalize(GLfloat *v)
+{
+	GLfloat len = sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+
+	if (len == 0.0f)
+		return;
+
+	len = 1.0f / len;
+	v[0] *= len;
+	v[1] *= len;
+	v[2] *= len;
+}
+
+static inline void fglSetupLight(FGLContext *ctx, int i)
+{
+	FGLLightState *light = &ctx->lighting.light[i];
+	FGLMaterialState *material = &ctx->lighting.material;
+	GLfloat vec[4];
+
+	if (light->position[3] == 0.0f) {
+		fimgCompatSetLightType(ctx->fimg, i, FGFP_LIGHT_DIRECTIONAL);
+
+		vec[0] = light->position[0];
+		vec[1] = light->position[1];
+		vec[2] = light->position[2];
+		vec[3] = 0.0f;
+		fglNormalize(vec);
+		fimgCompatSetLightParam(ctx->fimg, i, FGFP_LIGHT_POSITION, vec);
+
+		/* Half vector for infinite viewer */
+		vec[2] += 1.0f;
+		fglNormalize(vec);
+		fimgCompatSetLightParam(ctx->fimg, i, FGFP_LIGHT_HALF_VECTOR, vec);
+	} else {
+		fimgCompatSetLightType(ctx->fimg, i, (light->cutoff == 180.0f)
+					? FGFP_LIGHT_POINT : FGFP_LIGHT_SPOT);
+
+		vec[0] = light->position[0] / light->position[3];
+		vec[1] = light->position[1] / light->position[3];
+		vec[2] = light->position[2] / light->position[3];
+		vec[3] = 1.0f;
+		fimgCompatSetLightParam(ctx->fimg, i, FGFP_LIGHT_POSITION, vec);
+
+		vec[0] = light->direction[0];
+		vec[1] = light->direction[1];
+		vec[2] = light->direction[2];
+		vec[3] = cosf(light->cutoff * M_PI / 180.0f);
+		fglNormalize(vec);
+		fimgCompatSetLightParam(ctx->fimg, i,
+					FGFP_LIGHT_SPOT_DIRECTION, vec);
+
+		vec[0] = light->attenuation[0];
+		vec[1] = light->attenuation[1];
+		vec[2] = light->attenuation[2];
+		vec[3] = light->exponent;
+		fimgCompatSetLightParam(ctx->fimg, i,
+					FGFP_LIGHT_ATTENUATION, vec);
+	}
+
+	/* Light colors premultiplied by material, alpha comes from scene */
+	vec[3] = 0.0f;
+
+	for (int c = 0; c < 3; ++c)
+		vec[c] = light->ambient[c] * material->ambient[c];
+	fimgCompatSetLightParam(ctx->fimg, i, FGFP_LIGHT_AMBIENT, vec);
+
+	for (int c = 0; c < 3; ++c)
+		vec[c] = light->diffuse[c] * material->diffuse[c];
+	fimgCompatSetLightParam(ctx->fimg, i, FGFP_LIGHT_DIFFUSE, vec);
+
+	for (int c = 0; c < 3; ++c)
+		vec[c] = light->specular[c] * material->specular[c];
+	fimgCompatSetLightParam(ctx->fimg, i, FGFP_LIGHT_SPECULAR, vec);
+}
+
+static inline void fglSetupLighting(FGLContext *ctx)
+{
+	FGLLightingState *lighting = &ctx->lighting;
+	FGLMaterialState *material = &lighting->material;
+	GLfloat color[4];
+
+	fimgCompatSetLightingEnable(ctx->fimg, lighting->enabled);
+
+	if (!lighting->enabled || !lighting->dirty)
+		return;
+
+	for (int c = 0; c < 3; ++c)
+		color[c] = material->emission[c]
+				+ material->ambient[c] * lighting->ambient[c];
+	color[3] = material->diffuse[3];
+
+	fimgCompatSetSceneColor(ctx->fimg, color);
+	fimgCompatSetShininess(ctx->fimg, material->shininess);
+
+	for (int i = 0; i < FGL_MAX_LIGHTS; ++i) {
+		fimgCompatSetLightEnable(ctx->fimg, i,
+						lighting->light[i].enabled);
+		if (lighting->light[i].enabled)
+			fglSetupLight(ctx, i);
+	}
+
+	lighting->dirty = GL_FALSE;
+}
+
+static inline void fglSetupClipPlanes(FGLContext *ctx)
+{
+	FGLClipPlaneState *clip = &ctx->clipPlane;
+
+	/* Planes are applied to object coordinates of vertices */
+	if (!clip->dirty && !ctx->matrix.dirty[FGL_MATRIX_MODELVIEW])
+		return;
+
+	FGLmatrix *modview = &ctx->matrix.stack[FGL_MATRIX_MODELVIEW].top();
+	/* Vertices are skinned to eye space */
+	if (ctx->matrix.paletteEnabled)
+		modview = &ctx->matrix.identityMatrix;
+
+	for (int i = 0; i < FGL_MAX_CLIP_PLANES; ++i) {
+		fimgCompatSetClipPlaneEnable(ctx->fimg, i, clip->enabled[i]);
+		if (!clip->enabled[i])
+			continue;
+
+		modview->transformRow(clip->eye[i], clip->object[i]);
+		fimgCompatSetClipPlane(ctx->fimg, i, clip->object[i]);
+	}
+
+	clip->dirty = GL_FALSE;
+}
+
+static inline void fglSetupPoints(FGLContext *ctx, bool points)
+{
+	FGLPointState *point = &ctx->point;
+
+	/* Per-vertex size is only computed when drawing points */
+	fimgCompatSetPointSizeEnable(ctx->fimg, points);
+
+	if (!points || !point->dirty)
+		return;
+
+	bool attenuate = point->attenuation[0] != 1.0f
+		|| point->attenuation[1] != 0.0f
+		|| point->attenuation[2] != 0.0f;
+
+	fimgCompatSetPointAttenuationEnable(ctx->fimg, attenuate);
+	if (attenuate)
+		fimgCompatSetPointAttenuation(ctx->fimg, point->attenuation);
+
+	fimgSetMinimumPointWidth(ctx->fimg, point->sizeMin);
+	fimgSetMaximumPointWidth(ctx->fimg, point->sizeMax);
+
+	point->dirty = GL_FALSE;
+}
+
+/* Texture unit getting point sprite coordinates or -1 if none */
+static inline int fglPointSpriteUnit(FGLContext *ctx)
+{
+	if (!ctx->point.sprite)
+		return -1;
+
+	/* Hardware can replace coordinates of a single attribute only */
+	for (int i = 0; i < FGL_MAX_TEXTURE_UNITS; ++i)
+		if (ctx->point.coordReplace[i])
+			return i;
+
+	return -1;
+}
+
+/* Largest draw scanned on CPU for being entirely clipped away */
+#define FGL_CLIP_REJECT_MAX	64
+
+static bool fglClipReject(FGLContext *ctx, GLint first, GLsizei count)
+{
+	FGLClipPlaneState *clip = &ctx->clipPlane;
+	FGLArrayState *array = &ctx->array[FGL_ARRAY_VERTEX];
+	const GLubyte *ptr;
+	GLint stride, size;
+
+	if (count > FGL_CLIP_REJECT_MAX)
+		return false;
+
+	/* Skinned positions are only known to the vertex shader */
+	if (ctx->matrix.paletteEnabled)
+		return false;
+
+	if (array->enabled) {
+		if (array->type != FGHI_ATTRIB_DT_FLOAT)
+			return false;
+		ptr = (const GLubyte *)array->pointer + first*array->stride;
+		stride = array->stride;
+		size = array->width / sizeof(GLfloat);
+	} else {
+		ptr = (const GLubyte *)ctx->vertex[FGL_ARRAY_VERTEX];
+		stride = 0;
+		size = 4;
+		count = 1;
+	}
+
+	for (int i = 0; i < FGL_MAX_CLIP_PLANES; ++i) {
+		if (!clip->enabled[i])
+			continue;
+
+		const GLfloat *eq = clip->object[i];
+		const GLubyte *v = ptr;
+		GLsizei n;
+
+		for (n = 0; n < count; ++n, v += stride) {
+			const GLfloat *pos = (const GLfloat *)v;
+			GLfloat dist = eq[0]*pos[0] + eq[1]*pos[1] + eq[3];
+
+			if (size > 2)
+				dist += eq[2]*pos[2];
+			if (size > 3)
+				dist += eq[3]*(pos[3] - 1.0f);
+
+			if (dist >= 0.0f)
+				break;
+		}
+
+		/* All vertices behind this plane */
+		if (n == count)
+			return true;
+	}
+
+	return false;
+}
+
+static inline fimgTexGenMode fglTexGenMode(FGLTextureState *unit)
+{
+	if (!unit->texGen)
+		return FGFP_TEXGEN_NONE;
+
+	if (unit->texGenMode == GL_NORMAL_MAP_OES)
+		return FGFP_TEXGEN_NORMAL_MAP;
+
+	return FGFP_TEXGEN_REFLECTION_MAP;
+}
+
 static inline void fglSetupTextures(FGLContext *ctx)
 {
 	bool flush = false;
 	int i = FGL_MAX_TEXTURE_UNITS - 1;
 
 	do {
-		bool enabled = ctx->texture[i].enabled;
-		FGLTexture *tex = ctx->texture[i].getTexture();
+		FGLTexture *tex = ctx->texture[i].getEnabledTexture();
 
-		if(enabled && tex->surface && tex->isComplete()) {
+		fimgCompatSetTexGen(ctx->fimg, i, fglTexGenMode(&ctx->texture[i]));
+
+		if(tex && tex->surface && tex->isComplete()
+		    && fglMakeTextureResident(ctx, tex)) {
 			/* Texture is ready */
 			if (tex->dirty)
 				tex->surface->flush();
 			fimgCompatSetupTexture(ctx->fimg, tex->fimg, i, tex->swap);
 			fimgCompatSetTextureEnable(ctx->fimg, i, 1);
+			/* Only one palette in hardware, lowest unit wins */
+			if (tex->paletteSize)
+				fimgCompatSetTexturePalette(ctx->fimg,
+					tex->palette, tex->paletteSize);
 			ctx->busyTexture[i] = tex;
 			flush = true;
 			if (!tex->eglImage)
@@ -708,11 +1110,23 @@ static inline void fglSetupTextures(FGLContext *ctx)
 
 	if (flush)
 		fimgInvalidateFlushCache(ctx->fimg, 0, 1, 0, 0);
+
+	/*
+	 * Constant white primary color lets the shader skip modulation,
+	 * but only if it is not replaced by the lit color
+	 */
+	GLfloat *color = ctx->vertex[FGL_ARRAY_COLOR];
+	bool white = !ctx->lighting.enabled
+		&& !ctx->array[FGL_ARRAY_COLOR].enabled
+		&& color[FGL_COMP_RED] == 1.0f && color[FGL_COMP_GREEN] == 1.0f
+		&& color[FGL_COMP_BLUE] == 1.0f && color[FGL_COMP_ALPHA] == 1.0f;
+	fimgCompatSetPrimaryWhite(ctx->fimg, white);
 }
 
 GL_API void GL_APIENTRY glDrawArrays (GLenum mode, GLint first, GLsizei count)
 {
 	uint32_t fglMode;
+	int unit;
 
 	if(first < 0) {
 		setError(GL_INVALID_VALUE);
@@ -726,8 +1140,8 @@ GL_API void GL_APIENTRY glDrawArrays (GLenum mode, GLint first, GLsizei count)
 		return;
 	}
 
-	fimgArray arrays[4 + FGL_MAX_TEXTURE_UNITS];
-	for(int i = 0; i < (4 + FGL_MAX_TEXTURE_UNITS); ++i) {
+	fimgArray arrays[FGL_ARRAY_NUM];
+	for(int i = 0; i < FGL_ARRAY_NUM; ++i) {
 		if(ctx->array[i].enabled) {
 			arrays[i].pointer	= ctx->array[i].pointer;
 			arrays[i].stride	= ctx->array[i].stride;
@@ -739,16 +1153,26 @@ GL_API void GL_APIENTRY glDrawArrays (GLenum mode, GLint first, GLsizei count)
 		}
 	}
 
+	fglSetupClipPlanes(ctx);
 	fglSetupMatrices(ctx);
+	fglSetupPalette(ctx);
+	fglSetupLighting(ctx);
 	fglSetupTextures(ctx);
+	fglSetupProgram(ctx);
 
-	fimgSetAttribCount(ctx->fimg, 4 + FGL_MAX_TEXTURE_UNITS);
+	fimgSetAttribCount(ctx->fimg, fglAttribCount(ctx));
+
+	fglSetupPoints(ctx, mode == GL_POINTS);
 
 	switch (mode) {
 	case GL_POINTS:
 		if (count < 1)
 			return;
 		fglMode = FGPE_POINTS;
+		if ((unit = fglPointSpriteUnit(ctx)) >= 0) {
+			fimgCompatSetCoordReplace(ctx->fimg, unit);
+			fglMode = FGPE_POINT_SPRITE;
+		}
 		break;
 	case GL_LINE_STRIP:
 		if (count < 2)
@@ -787,6 +1211,9 @@ GL_API void GL_APIENTRY glDrawArrays (GLenum mode, GLint first, GLsizei count)
 		return;
 	}
 
+	if (fglClipReject(ctx, first, count))
+		return;
+
 #ifndef FIMG_USE_VERTEX_BUFFER
 	fimgDrawArrays(ctx->fimg, fglMode, arrays, first, count);
 #else
@@ -803,6 +1230,7 @@ GL_API void GL_APIENTRY glDrawElements (GLenum mode, GLsizei count, GLenum type,
 							const GLvoid *indices)
 {
 	uint32_t fglMode;
+	int unit;
 
 	FGLContext *ctx = getContext();
 	if (!ctx->framebuffer.isComplete()) {
@@ -810,11 +1238,11 @@ GL_API void GL_APIENTRY glDrawElements (GLenum mode, GLsizei count, GLenum type,
 		return;
 	}
 
-	fimgArray arrays[4 + FGL_MAX_TEXTURE_UNITS];
+	fimgArray arrays[FGL_ARRAY_NUM];
 	if(ctx->elementArrayBuffer.isBound())
 		indices = ctx->elementArrayBuffer.get()->getAddress(indices);
 
-	for(int i = 0; i < (4 + FGL_MAX_TEXTURE_UNITS); ++i) {
+	for(int i = 0; i < FGL_ARRAY_NUM; ++i) {
 		if(ctx->array[i].enabled) {
 			arrays[i].pointer	= ctx->array[i].pointer;
 			arrays[i].stride	= ctx->array[i].stride;
@@ -826,16 +1254,26 @@ GL_API void GL_APIENTRY glDrawElements (GLenum mode, GLsizei count, GLenum type,
 		}
 	}
 
+	fglSetupClipPlanes(ctx);
 	fglSetupMatrices(ctx);
+	fglSetupPalette(ctx);
+	fglSetupLighting(ctx);
 	fglSetupTextures(ctx);
+	fglSetupProgram(ctx);
 
-	fimgSetAttribCount(ctx->fimg, 4 + FGL_MAX_TEXTURE_UNITS);
+	fimgSetAttribCount(ctx->fimg, fglAttribCount(ctx));
+
+	fglSetupPoints(ctx, mode == GL_POINTS);
 
 	switch (mode) {
 	case GL_POINTS:
 		if (count < 1)
 			return;
 		fglMode = FGPE_POINTS;
+		if ((unit = fglPointSpriteUnit(ctx)) >= 0) {
+			fimgCompatSetCoordReplace(ctx->fimg, unit);
+			fglMode = FGPE_POINT_SPRITE;
+		}
 		break;
 	case GL_LINE_STRIP:
 		if (count < 2)
@@ -910,82 +1348,44 @@ GL_API void GL_APIENTRY glDrawElements (GLenum mode, GLsizei count, GLenum type,
 	Draw texture
 */
 
-GL_API void GL_APIENTRY glDrawTexfOES (GLfloat x, GLfloat y, GLfloat z, GLfloat width, GLfloat height)
-{
-	FGLContext *ctx = getContext();
-	if (!ctx->framebuffer.isComplete()) {
-		setError(GL_INVALID_FRAMEBUFFER_OPERATION_OES);
-		return;
-	}
-
-	GLboolean arrayEnabled[4 + FGL_MAX_TEXTURE_UNITS];
-	GLfloat vertices[3*4];
-	GLfloat texcoords[2][2*4];
-
-	// Save current state and prepare to drawing
-
-	GLint viewportX = ctx->viewport.x;
-	GLint viewportY = ctx->viewport.y;
-	GLsizei viewportW = ctx->viewport.width;
-	GLsizei viewportH = ctx->viewport.height;
-	GLfloat zNear = ctx->viewport.zNear;
-	GLfloat zFar = ctx->viewport.zFar;
+/*
+ * Consecutive glDrawTex*OES calls are collected into a single triangle list
+ * drawn with the resident draw texture vertex shader. Any other GL call
+ * (see getContext()) submits the batch and restores the state.
+ */
 
+static void fglBeginDrawTex(FGLContext *ctx)
+{
 	fimgSetDepthRange(ctx->fimg, 0.0f, 1.0f);
-	fimgSetViewportParams(ctx->fimg, 0, 0, ctx->surface.width, ctx->surface.height);
-
-	for (int i = 0; i < 4 + FGL_MAX_TEXTURE_UNITS; i++) {
-		arrayEnabled[i] = ctx->array[i].enabled;
-		fglDisableClientState(ctx, i);
-	}
-
-	/* TODO: Replace this with dedicated shader or conditional operation */
-	FGLmatrix *matrix = &ctx->matrix.transformMatrix;
-	matrix->identity();
-
-	fimgLoadMatrix(ctx->fimg, FGFP_MATRIX_TRANSFORM, matrix->data);
-	fimgLoadMatrix(ctx->fimg, FGFP_MATRIX_LIGHTING, matrix->data);
-	ctx->matrix.dirty[FGL_MATRIX_MODELVIEW] = 1;
-	fimgLoadMatrix(ctx->fimg, FGFP_MATRIX_TEXTURE(0), matrix->data);
-	ctx->matrix.dirty[FGL_MATRIX_TEXTURE(0)] = 1;
-	fimgLoadMatrix(ctx->fimg, FGFP_MATRIX_TEXTURE(1), matrix->data);
-	ctx->matrix.dirty[FGL_MATRIX_TEXTURE(1)] = 1;
-
-	// fimgCompatLightingEnable(ctx->fimg, 0);
-	/* End of TODO */
+	fimgSetViewportParams(ctx->fimg, 0, 0,
+				ctx->surface.width, ctx->surface.height);
 
-	float zD;
+	fimgSetAttribute(ctx->fimg, FGL_ARRAY_VERTEX, FGHI_ATTRIB_DT_FLOAT, 3);
+	for (int i = FGL_ARRAY_NORMAL; i < FGL_ARRAY_TEXTURE; i++)
+		fimgSetAttribute(ctx->fimg, i, FGHI_ATTRIB_DT_FLOAT,
+						fglDefaultAttribSize[i]);
+	for (int i = 0; i < FGL_MAX_TEXTURE_UNITS; i++)
+		fimgSetAttribute(ctx->fimg, FGL_ARRAY_TEXTURE(i),
+						FGHI_ATTRIB_DT_FLOAT, 2);
 
-	if (z <= 0)
-		zD = zNear;
-	else if (z >= 1)
-		zD = zFar;
-	else
-		zD = zNear + z*(zFar - zNear);
+	/* Bound textures can't change until the batch is submitted */
+	fglSetupTextures(ctx);
 
-	float invWidth = 2.0f/ctx->surface.width;
-	float invHeight = 2.0f/ctx->surface.height;
-	vertices[ 0] = invWidth * x - 1;
-	vertices[ 1] = invHeight * (y + height) - 1;
-	vertices[ 2] = zD;
-	vertices[ 3] = invWidth * (x + width) - 1;
-	vertices[ 4] = vertices[ 1];
-	vertices[ 5] = zD;
-	vertices[ 6] = vertices[ 3];
-	vertices[ 7] = invHeight * y - 1;
-	vertices[ 8] = zD;
-	vertices[ 9] = vertices[ 0];
-	vertices[10] = vertices[ 7];
-	vertices[11] = zD;
-
-	// Proceed with drawing
+	fimgCompatSetDrawTexture(ctx->fimg, 1);
+	fimgCompatSetPointSizeEnable(ctx->fimg, 0);
+}
 
+void fglFlushDrawTex(FGLContext *ctx)
+{
+	FGLDrawTexState *batch = &ctx->drawTex;
 	fimgArray arrays[4 + FGL_MAX_TEXTURE_UNITS];
+	GLsizei count = 6*batch->count;
 
-	arrays[FGL_ARRAY_VERTEX].pointer	= vertices;
+	batch->count = 0;
+
+	arrays[FGL_ARRAY_VERTEX].pointer	= batch->vertices;
 	arrays[FGL_ARRAY_VERTEX].stride		= 12;
 	arrays[FGL_ARRAY_VERTEX].width		= 12;
-	fimgSetAttribute(ctx->fimg, FGL_ARRAY_VERTEX, FGHI_ATTRIB_DT_FLOAT, 3);
 
 	for (int i = FGL_ARRAY_NORMAL; i < FGL_ARRAY_TEXTURE; i++) {
 		arrays[i].pointer	= &ctx->vertex[i];
@@ -994,88 +1394,149 @@ GL_API void GL_APIENTRY glDrawTexfOES (GLfloat x, GLfloat y, GLfloat z, GLfloat
 	}
 
 	for (int i = 0; i < FGL_MAX_TEXTURE_UNITS; i++) {
-		FGLTexture *tex = ctx->texture[i].getTexture();
-		if (ctx->texture[i].enabled && tex->surface) {
-			float invHeight = 1.0f/tex->height;
-			float invWidth = 1.0f/tex->width;
-			texcoords[i][0]	= invWidth*tex->cropRect[0];
-			texcoords[i][1] = 1 - invHeight*(tex->cropRect[1]);
-			texcoords[i][2] = invWidth*(tex->cropRect[0] + tex->cropRect[2]);
-			texcoords[i][3] = texcoords[i][1];
-			texcoords[i][4] = texcoords[i][2];
-			texcoords[i][5] = 1 - invHeight*(tex->cropRect[1] + tex->cropRect[3]);
-			texcoords[i][6] = texcoords[i][0];
-			texcoords[i][7] = texcoords[i][5];
-			arrays[FGL_ARRAY_TEXTURE(i)].stride = 8;
-		} else {
-			texcoords[i][0] = 0;
-			texcoords[i][1] = 0;
-			arrays[FGL_ARRAY_TEXTURE(i)].stride = 0;
-		}
-		arrays[FGL_ARRAY_TEXTURE(i)].pointer	= texcoords[i];
+		arrays[FGL_ARRAY_TEXTURE(i)].pointer	= batch->texcoords[i];
+		arrays[FGL_ARRAY_TEXTURE(i)].stride	= 8;
 		arrays[FGL_ARRAY_TEXTURE(i)].width	= 8;
-		fimgSetAttribute(ctx->fimg, FGL_ARRAY_TEXTURE(i), FGHI_ATTRIB_DT_FLOAT, 2);
 	}
 
-	fglSetupTextures(ctx);
-
 	fimgSetAttribCount(ctx->fimg, 4 + FGL_MAX_TEXTURE_UNITS);
 
 #ifndef FIMG_USE_VERTEX_BUFFER
-	fimgDrawArrays(ctx->fimg, FGPE_TRIANGLE_FAN, arrays, 0, 4);
+	fimgDrawArrays(ctx->fimg, FGPE_TRIANGLES, arrays, 0, count);
 #else
-	fimgDrawArraysBuffered(ctx->fimg, FGPE_TRIANGLE_FAN, arrays, 0, 4);
+	if (count <= 24)
+		fimgDrawArraysBuffered(ctx->fimg, FGPE_TRIANGLES,
+							arrays, 0, count);
+	else
+		fimgDrawArrays(ctx->fimg, FGPE_TRIANGLES, arrays, 0, count);
 #endif
+
 	// Restore previous state
 
-	for (int i = 0; i < 4 + FGL_MAX_TEXTURE_UNITS; i++) {
-		if (arrayEnabled[i])
+	for (int i = 0; i < FGL_ARRAY_NUM; i++) {
+		if (ctx->array[i].enabled)
 			fglEnableClientState(ctx, i);
 		else
 			fglDisableClientState(ctx, i);
 	}
 
-	fimgSetDepthRange(ctx->fimg, zNear, zFar);
-	fimgSetViewportParams(ctx->fimg, viewportX, viewportY, viewportW, viewportH);
+	fimgCompatSetDrawTexture(ctx->fimg, 0);
+	fimgSetDepthRange(ctx->fimg, ctx->viewport.zNear, ctx->viewport.zFar);
+	fimgSetViewportParams(ctx->fimg, ctx->viewport.x, ctx->viewport.y,
+				ctx->viewport.width, ctx->viewport.height);
 }
 
-GL_API void GL_APIENTRY glDrawTexsOES (GLshort x, GLshort y, GLshort z, GLshort width, GLshort height)
+static inline void fglSetRect(GLfloat *v, GLint stride, GLfloat left,
+			GLfloat top, GLfloat right, GLfloat bottom)
 {
-	glDrawTexfOES(x, y, z, width, height);
+	/* Two triangles: (left, top), (right, top), (right, bottom)
+			  and (left, top), (right, bottom), (left, bottom) */
+	v[0*stride] = left;	v[0*stride + 1] = top;
+	v[1*stride] = right;	v[1*stride + 1] = top;
+	v[2*stride] = right;	v[2*stride + 1] = bottom;
+	v[3*stride] = left;	v[3*stride + 1] = top;
+	v[4*stride] = right;	v[4*stride + 1] = bottom;
+	v[5*stride] = left;	v[5*stride + 1] = bottom;
 }
 
-GL_API void GL_APIENTRY glDrawTexiOES (GLint x, GLint y, GLint z, GLint width, GLint height)
+GL_API void GL_APIENTRY glDrawTexfOES (GLfloat x, GLfloat y, GLfloat z, GLfloat width, GLfloat height)
 {
-	glDrawTexfOES(x, y, z, width, height);
-}
+	if (width <= 0 || height <= 0) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
 
-GL_API void GL_APIENTRY glDrawTexxOES (GLfixed x, GLfixed y, GLfixed z, GLfixed width, GLfixed height)
-{
-	glDrawTexfOES(floatFromFixed(x), floatFromFixed(y), floatFromFixed(z),
-		      floatFromFixed(width), floatFromFixed(height));
-}
+	FGLContext *ctx = getCurrentContext();
+	FGLDrawTexState *batch = &ctx->drawTex;
 
-GL_API void GL_APIENTRY glDrawTexsvOES (const GLshort *coords)
-{
-	glDrawTexfOES(coords[0], coords[1], coords[2], coords[3], coords[4]);
-}
+	if (batch->count == FGL_DRAW_TEX_BATCH)
+		fglFlushDrawTex(ctx);
 
-GL_API void GL_APIENTRY glDrawTexivOES (const GLint *coords)
-{
-	glDrawTexfOES(coords[0], coords[1], coords[2], coords[3], coords[4]);
-}
+	if (!batch->count) {
+		if (!ctx->framebuffer.isComplete()) {
+			setError(GL_INVALID_FRAMEBUFFER_OPERATION_OES);
+			return;
+		}
 
-GL_API void GL_APIENTRY glDrawTexxvOES (const GLfixed *coords)
-{
-	glDrawTexfOES(floatFromFixed(coords[0]), floatFromFixed(coords[1]),
-		      floatFromFixed(coords[2]), floatFromFixed(coords[3]),
-		      floatFromFixed(coords[4]));
-}
+		fglBeginDrawTex(ctx);
+	}
 
-GL_API void GL_APIENTRY glDrawTexfvOES (const GLfloat *coords)
-{
-	glDrawTexfOES(coords[0], coords[1], coords[2], coords[3], coords[4]);
-}
+	GLfloat *v = batch->vertices[batch->count];
+	float zD;
+
+	/* Depth range is [0, 1] while drawing */
+	if (z <= 0)
+		zD = ctx->viewport.zNear;
+	else if (z >= 1)
+		zD = ctx->viewport.zFar;
+	else
+		zD = ctx->viewport.zNear
+				+ z*(ctx->viewport.zFar - ctx->viewport.zNear);
+	zD = 2*zD - 1;
+
+	float invWidth = 2.0f/ctx->surface.width;
+	float invHeight = 2.0f/ctx->surface.height;
+	fglSetRect(v, 3, invWidth * x - 1, invHeight * (y + height) - 1,
+			invWidth * (x + width) - 1, invHeight * y - 1);
+	for (int i = 0; i < 6; i++)
+		v[3*i + 2] = zD;
+
+	for (int i = 0; i < FGL_MAX_TEXTURE_UNITS; i++) {
+		FGLTexture *tex = ctx->texture[i].getTexture();
+		GLfloat *t = batch->texcoords[i][batch->count];
+
+		if (ctx->texture[i].enabled && tex->surface) {
+			float invHeight = 1.0f/tex->height;
+			float invWidth = 1.0f/tex->width;
+			fglSetRect(t, 2, invWidth*tex->cropRect[0],
+				1 - invHeight*(tex->cropRect[1]),
+				invWidth*(tex->cropRect[0] + tex->cropRect[2]),
+				1 - invHeight*(tex->cropRect[1] + tex->cropRect[3]));
+		} else {
+			fglSetRect(t, 2, 0, 0, 0, 0);
+		}
+	}
+
+	++batch->count;
+}
+
+GL_API void GL_APIENTRY glDrawTexsOES (GLshort x, GLshort y, GLshort z, GLshort width, GLshort height)
+{
+	glDrawTexfOES(x, y, z, width, height);
+}
+
+GL_API void GL_APIENTRY glDrawTexiOES (GLint x, GLint y, GLint z, GLint width, GLint height)
+{
+	glDrawTexfOES(x, y, z, width, height);
+}
+
+GL_API void GL_APIENTRY glDrawTexxOES (GLfixed x, GLfixed y, GLfixed z, GLfixed width, GLfixed height)
+{
+	glDrawTexfOES(floatFromFixed(x), floatFromFixed(y), floatFromFixed(z),
+		      floatFromFixed(width), floatFromFixed(height));
+}
+
+GL_API void GL_APIENTRY glDrawTexsvOES (const GLshort *coords)
+{
+	glDrawTexfOES(coords[0], coords[1], coords[2], coords[3], coords[4]);
+}
+
+GL_API void GL_APIENTRY glDrawTexivOES (const GLint *coords)
+{
+	glDrawTexfOES(coords[0], coords[1], coords[2], coords[3], coords[4]);
+}
+
+GL_API void GL_APIENTRY glDrawTexxvOES (const GLfixed *coords)
+{
+	glDrawTexfOES(floatFromFixed(coords[0]), floatFromFixed(coords[1]),
+		      floatFromFixed(coords[2]), floatFromFixed(coords[3]),
+		      floatFromFixed(coords[4]));
+}
+
+GL_API void GL_APIENTRY glDrawTexfvOES (const GLfloat *coords)
+{
+	glDrawTexfOES(coords[0], coords[1], coords[2], coords[3], coords[4]);
+}
 
 /**
 	Transformations
@@ -1573,6 +2034,12 @@ static inline void fglSet(GLenum cap, bool state)
 	case GL_TEXTURE_2D:
 		ctx->texture[ctx->activeTexture].enabled = state;
 		break;
+	case GL_TEXTURE_CUBE_MAP_OES:
+		ctx->texture[ctx->activeTexture].cubeEnabled = state;
+		break;
+	case GL_TEXTURE_GEN_STR_OES:
+		ctx->texture[ctx->activeTexture].texGen = state;
+		break;
 	case GL_CULL_FACE:
 		fimgSetFaceCullEnable(ctx->fimg, state);
 		break;
@@ -1619,6 +2086,8 @@ static inline void fglSet(GLenum cap, bool state)
 		fimgSetLogicalOpEnable(ctx->fimg, state);
 		break;
 	case GL_LIGHTING:
+		ctx->lighting.enabled = state;
+		break;
 	case GL_LIGHT0:
 	case GL_LIGHT1:
 	case GL_LIGHT2:
@@ -1627,7 +2096,30 @@ static inline void fglSet(GLenum cap, bool state)
 	case GL_LIGHT5:
 	case GL_LIGHT6:
 	case GL_LIGHT7:
+		ctx->lighting.light[cap - GL_LIGHT0].enabled = state;
+		ctx->lighting.dirty = GL_TRUE;
+		break;
+	case GL_FOG:
+		ctx->fog.enabled = state;
+		fimgCompatSetFogEnable(ctx->fimg, state);
+		break;
+	case GL_CLIP_PLANE0:
+	case GL_CLIP_PLANE1:
+	case GL_CLIP_PLANE2:
+		ctx->clipPlane.enabled[cap - GL_CLIP_PLANE0] = state;
+		ctx->clipPlane.dirty = GL_TRUE;
+		break;
+	case GL_POINT_SPRITE_OES:
+		ctx->point.sprite = state;
+		break;
+	case GL_MATRIX_PALETTE_OES:
+		ctx->matrix.paletteEnabled = state;
+		/* Reload transformation and clip planes */
+		ctx->matrix.dirty[FGL_MATRIX_MODELVIEW] = GL_TRUE;
+		break;
 	case GL_NORMALIZE:
+	case GL_RESCALE_NORMAL:
+		/* Normals are always normalized */
 		break;
 	default:
 		LOGD("Unimplemented or unsupported enum %d in %s", cap, __func__);
@@ -1651,7 +2143,8 @@ GL_API void GL_APIENTRY glDisable (GLenum cap)
 
 GL_API void GL_APIENTRY glFlush (void)
 {
-	//FUNC_UNIMPLEMENTED;
+	/* Submits pending glDrawTex*OES batch */
+	getContext();
 }
 
 GL_API void GL_APIENTRY glFinish (void)
@@ -1662,199 +2155,819 @@ GL_API void GL_APIENTRY glFinish (void)
 
 	for (int i = 0; i < FGL_MAX_TEXTURE_UNITS; ++i)
 		ctx->busyTexture[i] = 0;
+
+	fglReleaseRetiredSurfaces(ctx);
 }
 
 /**
-	Stubs
+	Lighting
 */
 
-GL_API void GL_APIENTRY glClipPlanef (GLenum plane, const GLfloat *equation)
+GL_API void GL_APIENTRY glLightModelf (GLenum pname, GLfloat param)
 {
-	FUNC_UNIMPLEMENTED;
-}
+	FGLContext *ctx = getContext();
 
-GL_API void GL_APIENTRY glClipPlanex (GLenum plane, const GLfixed *equation)
-{
-	FUNC_UNIMPLEMENTED;
+	switch (pname) {
+	case GL_LIGHT_MODEL_TWO_SIDE:
+		ctx->lighting.twoSide = (param != 0.0f);
+		break;
+	default:
+		setError(GL_INVALID_ENUM);
+	}
 }
 
-GL_API void GL_APIENTRY glColorMask (GLboolean red, GLboolean green,
-						GLboolean blue, GLboolean alpha)
+GL_API void GL_APIENTRY glLightModelfv (GLenum pname, const GLfloat *params)
 {
 	FGLContext *ctx = getContext();
 
-	ctx->perFragment.mask.red = red;
-	ctx->perFragment.mask.green = green;
-	ctx->perFragment.mask.blue = blue;
-	ctx->perFragment.mask.alpha = alpha;
+	switch (pname) {
+	case GL_LIGHT_MODEL_AMBIENT:
+		memcpy(ctx->lighting.ambient, params, 4*sizeof(GLfloat));
+		ctx->lighting.dirty = GL_TRUE;
+		break;
+	default:
+		glLightModelf(pname, *params);
+	}
+}
 
-	if (ctx->surface.draw)
-		fimgSetColorBufWriteMask(ctx->fimg, red, green, blue, alpha);
+GL_API void GL_APIENTRY glLightModelx (GLenum pname, GLfixed param)
+{
+	glLightModelf(pname, floatFromFixed(param));
 }
 
-GL_API void GL_APIENTRY glDepthMask (GLboolean flag)
+GL_API void GL_APIENTRY glLightModelxv (GLenum pname, const GLfixed *params)
 {
-	FGLContext *ctx = getContext();
+	GLfloat floatParams[4];
 
-	ctx->perFragment.mask.depth = flag;
+	switch (pname) {
+	case GL_LIGHT_MODEL_AMBIENT:
+		for (int i = 0; i < 4; ++i)
+			floatParams[i] = floatFromFixed(params[i]);
+		break;
+	default:
+		floatParams[0] = floatFromFixed(params[0]);
+	}
 
-	if (ctx->surface.depthFormat & 0xff)
-		fimgSetZBufWriteMask(ctx->fimg, flag);
+	glLightModelfv(pname, floatParams);
 }
 
-GL_API void GL_APIENTRY glFogf (GLenum pname, GLfloat param)
+GL_API void GL_APIENTRY glLightf (GLenum light, GLenum pname, GLfloat param)
 {
-	FUNC_UNIMPLEMENTED;
-}
+	if (light < GL_LIGHT0 || light >= GL_LIGHT0 + FGL_MAX_LIGHTS) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
 
-GL_API void GL_APIENTRY glFogfv (GLenum pname, const GLfloat *params)
-{
-	FUNC_UNIMPLEMENTED;
-}
+	FGLContext *ctx = getContext();
+	FGLLightState *l = &ctx->lighting.light[light - GL_LIGHT0];
 
-GL_API void GL_APIENTRY glFogx (GLenum pname, GLfixed param)
-{
-	FUNC_UNIMPLEMENTED;
-}
+	switch (pname) {
+	case GL_SPOT_EXPONENT:
+		if (param < 0.0f || param > 128.0f) {
+			setError(GL_INVALID_VALUE);
+			return;
+		}
+		l->exponent = param;
+		break;
+	case GL_SPOT_CUTOFF:
+		if ((param < 0.0f || param > 90.0f) && param != 180.0f) {
+			setError(GL_INVALID_VALUE);
+			return;
+		}
+		l->cutoff = param;
+		break;
+	case GL_CONSTANT_ATTENUATION:
+	case GL_LINEAR_ATTENUATION:
+	case GL_QUADRATIC_ATTENUATION:
+		if (param < 0.0f) {
+			setError(GL_INVALID_VALUE);
+			return;
+		}
+		l->attenuation[pname - GL_CONSTANT_ATTENUATION] = param;
+		break;
+	default:
+		setError(GL_INVALID_ENUM);
+		return;
+	}
 
-GL_API void GL_APIENTRY glFogxv (GLenum pname, const GLfixed *params)
-{
-	FUNC_UNIMPLEMENTED;
+	ctx->lighting.dirty = GL_TRUE;
 }
 
-GL_API void GL_APIENTRY glGetBufferParameteriv (GLenum target,
-						GLenum pname, GLint *params)
+GL_API void GL_APIENTRY glLightfv (GLenum light, GLenum pname,
+							const GLfloat *params)
 {
-	FUNC_UNIMPLEMENTED;
-}
+	if (light < GL_LIGHT0 || light >= GL_LIGHT0 + FGL_MAX_LIGHTS) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
 
-GL_API void GL_APIENTRY glGetClipPlanef (GLenum pname, GLfloat eqn[4])
-{
-	FUNC_UNIMPLEMENTED;
+	FGLContext *ctx = getContext();
+	FGLLightState *l = &ctx->lighting.light[light - GL_LIGHT0];
+	FGLmatrix *modelview = &ctx->matrix.stack[FGL_MATRIX_MODELVIEW].top();
+	GLfloat vec[4], eye[4];
+
+	switch (pname) {
+	case GL_AMBIENT:
+		memcpy(l->ambient, params, 4*sizeof(GLfloat));
+		break;
+	case GL_DIFFUSE:
+		memcpy(l->diffuse, params, 4*sizeof(GLfloat));
+		break;
+	case GL_SPECULAR:
+		memcpy(l->specular, params, 4*sizeof(GLfloat));
+		break;
+	case GL_POSITION:
+		/* Stored in eye coordinates */
+		modelview->transform(params, l->position);
+		break;
+	case GL_SPOT_DIRECTION:
+		vec[0] = params[0];
+		vec[1] = params[1];
+		vec[2] = params[2];
+		vec[3] = 0.0f;
+		modelview->transform(vec, eye);
+		memcpy(l->direction, eye, 3*sizeof(GLfloat));
+		break;
+	default:
+		glLightf(light, pname, *params);
+		return;
+	}
+
+	ctx->lighting.dirty = GL_TRUE;
 }
 
-GL_API void GL_APIENTRY glGetClipPlanex (GLenum pname, GLfixed eqn[4])
+GL_API void GL_APIENTRY glLightx (GLenum light, GLenum pname, GLfixed param)
 {
-	FUNC_UNIMPLEMENTED;
+	glLightf(light, pname, floatFromFixed(param));
 }
 
-GL_API void GL_APIENTRY glGetLightfv (GLenum light, GLenum pname,
-							GLfloat *params)
+GL_API void GL_APIENTRY glLightxv (GLenum light, GLenum pname,
+							const GLfixed *params)
 {
-	FUNC_UNIMPLEMENTED;
+	GLfloat floatParams[4];
+	int count;
+
+	switch (pname) {
+	case GL_AMBIENT:
+	case GL_DIFFUSE:
+	case GL_SPECULAR:
+	case GL_POSITION:
+		count = 4;
+		break;
+	case GL_SPOT_DIRECTION:
+		count = 3;
+		break;
+	default:
+		count = 1;
+	}
+
+	for (int i = 0; i < count; ++i)
+		floatParams[i] = floatFromFixed(params[i]);
+
+	glLightfv(light, pname, floatParams);
 }
 
-GL_API void GL_APIENTRY glGetMaterialfv (GLenum face, GLenum pname,
+GL_API void GL_APIENTRY glGetLightfv (GLenum light, GLenum pname,
 							GLfloat *params)
 {
-	FUNC_UNIMPLEMENTED;
-}
+	if (light < GL_LIGHT0 || light >= GL_LIGHT0 + FGL_MAX_LIGHTS) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
 
-GL_API void GL_APIENTRY glHint (GLenum target, GLenum mode)
-{
-	FUNC_UNIMPLEMENTED;
-}
+	FGLContext *ctx = getContext();
+	FGLLightState *l = &ctx->lighting.light[light - GL_LIGHT0];
 
-GL_API void GL_APIENTRY glLightModelf (GLenum pname, GLfloat param)
-{
-	FUNC_UNIMPLEMENTED;
+	switch (pname) {
+	case GL_AMBIENT:
+		memcpy(params, l->ambient, 4*sizeof(GLfloat));
+		break;
+	case GL_DIFFUSE:
+		memcpy(params, l->diffuse, 4*sizeof(GLfloat));
+		break;
+	case GL_SPECULAR:
+		memcpy(params, l->specular, 4*sizeof(GLfloat));
+		break;
+	case GL_POSITION:
+		memcpy(params, l->position, 4*sizeof(GLfloat));
+		break;
+	case GL_SPOT_DIRECTION:
+		memcpy(params, l->direction, 3*sizeof(GLfloat));
+		break;
+	case GL_SPOT_EXPONENT:
+		params[0] = l->exponent;
+		break;
+	case GL_SPOT_CUTOFF:
+		params[0] = l->cutoff;
+		break;
+	case GL_CONSTANT_ATTENUATION:
+	case GL_LINEAR_ATTENUATION:
+	case GL_QUADRATIC_ATTENUATION:
+		params[0] = l->attenuation[pname - GL_CONSTANT_ATTENUATION];
+		break;
+	default:
+		setError(GL_INVALID_ENUM);
+	}
 }
 
-GL_API void GL_APIENTRY glLightModelfv (GLenum pname, const GLfloat *params)
+GL_API void GL_APIENTRY glMaterialf (GLenum face, GLenum pname, GLfloat param)
 {
-	FUNC_UNIMPLEMENTED;
-}
+	if (face != GL_FRONT_AND_BACK) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
 
-GL_API void GL_APIENTRY glLightModelx (GLenum pname, GLfixed param)
-{
-	FUNC_UNIMPLEMENTED;
-}
+	FGLContext *ctx = getContext();
 
-GL_API void GL_APIENTRY glLightModelxv (GLenum pname, const GLfixed *params)
-{
-	FUNC_UNIMPLEMENTED;
-}
+	switch (pname) {
+	case GL_SHININESS:
+		if (param < 0.0f || param > 128.0f) {
+			setError(GL_INVALID_VALUE);
+			return;
+		}
+		ctx->lighting.material.shininess = param;
+		break;
+	default:
+		setError(GL_INVALID_ENUM);
+		return;
+	}
 
-GL_API void GL_APIENTRY glLightf (GLenum light, GLenum pname, GLfloat param)
-{
-	FUNC_UNIMPLEMENTED;
+	ctx->lighting.dirty = GL_TRUE;
 }
 
-GL_API void GL_APIENTRY glLightfv (GLenum light, GLenum pname,
+GL_API void GL_APIENTRY glMaterialfv (GLenum face, GLenum pname,
 							const GLfloat *params)
 {
-	FUNC_UNIMPLEMENTED;
+	if (face != GL_FRONT_AND_BACK) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+	FGLMaterialState *material = &ctx->lighting.material;
+
+	switch (pname) {
+	case GL_AMBIENT:
+		memcpy(material->ambient, params, 4*sizeof(GLfloat));
+		break;
+	case GL_DIFFUSE:
+		memcpy(material->diffuse, params, 4*sizeof(GLfloat));
+		break;
+	case GL_AMBIENT_AND_DIFFUSE:
+		memcpy(material->ambient, params, 4*sizeof(GLfloat));
+		memcpy(material->diffuse, params, 4*sizeof(GLfloat));
+		break;
+	case GL_SPECULAR:
+		memcpy(material->specular, params, 4*sizeof(GLfloat));
+		break;
+	case GL_EMISSION:
+		memcpy(material->emission, params, 4*sizeof(GLfloat));
+		break;
+	default:
+		glMaterialf(face, pname, *params);
+		return;
+	}
+
+	ctx->lighting.dirty = GL_TRUE;
 }
 
-GL_API void GL_APIENTRY glLightx (GLenum light, GLenum pname, GLfixed param)
+GL_API void GL_APIENTRY glMaterialx (GLenum face, GLenum pname, GLfixed param)
 {
-	FUNC_UNIMPLEMENTED;
+	glMaterialf(face, pname, floatFromFixed(param));
 }
 
-GL_API void GL_APIENTRY glLightxv (GLenum light, GLenum pname,
+GL_API void GL_APIENTRY glMaterialxv (GLenum face, GLenum pname,
 							const GLfixed *params)
 {
-	FUNC_UNIMPLEMENTED;
-}
+	GLfloat floatParams[4];
+	int count = (pname == GL_SHININESS) ? 1 : 4;
 
-GL_API void GL_APIENTRY glLineWidth (GLfloat width)
-{
-	FUNC_UNIMPLEMENTED;
+	for (int i = 0; i < count; ++i)
+		floatParams[i] = floatFromFixed(params[i]);
+
+	glMaterialfv(face, pname, floatParams);
 }
 
-GL_API void GL_APIENTRY glLineWidthx (GLfixed width)
+GL_API void GL_APIENTRY glGetMaterialfv (GLenum face, GLenum pname,
+							GLfloat *params)
 {
-	FUNC_UNIMPLEMENTED;
+	if (face != GL_FRONT && face != GL_BACK) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+	FGLMaterialState *material = &ctx->lighting.material;
+
+	switch (pname) {
+	case GL_AMBIENT:
+		memcpy(params, material->ambient, 4*sizeof(GLfloat));
+		break;
+	case GL_DIFFUSE:
+		memcpy(params, material->diffuse, 4*sizeof(GLfloat));
+		break;
+	case GL_SPECULAR:
+		memcpy(params, material->specular, 4*sizeof(GLfloat));
+		break;
+	case GL_EMISSION:
+		memcpy(params, material->emission, 4*sizeof(GLfloat));
+		break;
+	case GL_SHININESS:
+		params[0] = material->shininess;
+		break;
+	default:
+		setError(GL_INVALID_ENUM);
+	}
 }
 
-GL_API void GL_APIENTRY glMaterialf (GLenum face, GLenum pname, GLfloat param)
+/**
+	Fog
+*/
+
+GL_API void GL_APIENTRY glFogf (GLenum pname, GLfloat param)
 {
-	FUNC_UNIMPLEMENTED;
+	FGLContext *ctx = getContext();
+	FGLFogState *fog = &ctx->fog;
+
+	switch (pname) {
+	case GL_FOG_MODE:
+		switch ((GLenum)param) {
+		case GL_LINEAR:
+			fimgCompatSetFogMode(ctx->fimg, FGFP_FOG_LINEAR);
+			break;
+		case GL_EXP:
+			fimgCompatSetFogMode(ctx->fimg, FGFP_FOG_EXP);
+			break;
+		case GL_EXP2:
+			fimgCompatSetFogMode(ctx->fimg, FGFP_FOG_EXP2);
+			break;
+		default:
+			setError(GL_INVALID_ENUM);
+			return;
+		}
+		fog->mode = (GLenum)param;
+		return;
+	case GL_FOG_DENSITY:
+		if (param < 0.0f) {
+			setError(GL_INVALID_VALUE);
+			return;
+		}
+		fog->density = param;
+		break;
+	case GL_FOG_START:
+		fog->start = param;
+		break;
+	case GL_FOG_END:
+		fog->end = param;
+		break;
+	default:
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	fimgCompatSetFogParams(ctx->fimg, fog->start, fog->end, fog->density);
 }
 
-GL_API void GL_APIENTRY glMaterialfv (GLenum face, GLenum pname,
-							const GLfloat *params)
+GL_API void GL_APIENTRY glFogfv (GLenum pname, const GLfloat *params)
 {
-	FUNC_UNIMPLEMENTED;
+	FGLContext *ctx = getContext();
+
+	switch (pname) {
+	case GL_FOG_COLOR:
+		memcpy(ctx->fog.color, params, 4*sizeof(GLfloat));
+		fimgCompatSetFogColor(ctx->fimg, params[0], params[1],
+							params[2], params[3]);
+		break;
+	default:
+		glFogf(pname, *params);
+	}
 }
 
-GL_API void GL_APIENTRY glMaterialx (GLenum face, GLenum pname, GLfixed param)
+GL_API void GL_APIENTRY glFogx (GLenum pname, GLfixed param)
 {
-	FUNC_UNIMPLEMENTED;
+	/* Fog mode is an enum, not a fixed point value */
+	if (pname == GL_FOG_MODE)
+		glFogf(pname, (GLfloat)param);
+	else
+		glFogf(pname, floatFromFixed(param));
 }
 
-GL_API void GL_APIENTRY glMaterialxv (GLenum face, GLenum pname,
-							const GLfixed *params)
+GL_API void GL_APIENTRY glFogxv (GLenum pname, const GLfixed *params)
 {
-	FUNC_UNIMPLEMENTED;
+	GLfloat color[4];
+
+	switch (pname) {
+	case GL_FOG_COLOR:
+		for (int i = 0; i < 4; ++i)
+			color[i] = floatFromFixed(params[i]);
+		glFogfv(pname, color);
+		break;
+	default:
+		glFogx(pname, *params);
+	}
+}
+
+/**
+	Clipping
+*/
+
+GL_API void GL_APIENTRY glClipPlanef (GLenum plane, const GLfloat *equation)
+{
+	if (plane < GL_CLIP_PLANE0
+	    || plane >= GL_CLIP_PLANE0 + FGL_MAX_CLIP_PLANES) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+	FGLClipPlaneState *clip = &ctx->clipPlane;
+	FGLmatrix *inv = &ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].top();
+
+	/* Store in eye coordinates, as specified */
+	inv->transformRow(equation, clip->eye[plane - GL_CLIP_PLANE0]);
+	clip->dirty = GL_TRUE;
+}
+
+GL_API void GL_APIENTRY glClipPlanex (GLenum plane, const GLfixed *equation)
+{
+	GLfloat eq[4];
+
+	for (int i = 0; i < 4; ++i)
+		eq[i] = floatFromFixed(equation[i]);
+
+	glClipPlanef(plane, eq);
+}
+
+GL_API void GL_APIENTRY glGetClipPlanef (GLenum pname, GLfloat eqn[4])
+{
+	if (pname < GL_CLIP_PLANE0
+	    || pname >= GL_CLIP_PLANE0 + FGL_MAX_CLIP_PLANES) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+
+	memcpy(eqn, ctx->clipPlane.eye[pname - GL_CLIP_PLANE0],
+							4*sizeof(GLfloat));
+}
+
+GL_API void GL_APIENTRY glGetClipPlanex (GLenum pname, GLfixed eqn[4])
+{
+	GLfloat eq[4];
+
+	if (pname < GL_CLIP_PLANE0
+	    || pname >= GL_CLIP_PLANE0 + FGL_MAX_CLIP_PLANES) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	glGetClipPlanef(pname, eq);
+
+	for (int i = 0; i < 4; ++i)
+		eqn[i] = fixedFromFloat(eq[i]);
+}
+
+/**
+	Points
+*/
+
+GL_API void GL_APIENTRY glPointSize (GLfloat size)
+{
+	if (size <= 0.0f) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+
+	/* Fed to vertex shader as point size attribute if no array is used */
+	ctx->vertex[FGL_ARRAY_POINT_SIZE][0] = size;
+	fimgSetPointWidth(ctx->fimg, size);
+}
+
+GL_API void GL_APIENTRY glPointSizex (GLfixed size)
+{
+	glPointSize(floatFromFixed(size));
+}
+
+static inline GLfloat fglClampPointSize(GLfloat size)
+{
+	if (size < 1.0f)
+		return 1.0f;
+	if (size > FGL_MAX_POINT_SIZE)
+		return FGL_MAX_POINT_SIZE;
+	return size;
 }
 
 GL_API void GL_APIENTRY glPointParameterf (GLenum pname, GLfloat param)
 {
-	FUNC_UNIMPLEMENTED;
+	FGLContext *ctx = getContext();
+	FGLPointState *point = &ctx->point;
+
+	switch (pname) {
+	case GL_POINT_SIZE_MIN:
+	case GL_POINT_SIZE_MAX:
+	case GL_POINT_FADE_THRESHOLD_SIZE:
+		if (param < 0.0f) {
+			setError(GL_INVALID_VALUE);
+			return;
+		}
+		break;
+	default:
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	switch (pname) {
+	case GL_POINT_SIZE_MIN:
+		point->sizeMin = fglClampPointSize(param);
+		break;
+	case GL_POINT_SIZE_MAX:
+		point->sizeMax = fglClampPointSize(param);
+		break;
+	case GL_POINT_FADE_THRESHOLD_SIZE:
+		/* Fading only applies to multisampled points */
+		point->fadeThreshold = param;
+		break;
+	}
+
+	point->dirty = GL_TRUE;
 }
 
 GL_API void GL_APIENTRY glPointParameterfv (GLenum pname, const GLfloat *params)
 {
-	FUNC_UNIMPLEMENTED;
+	FGLContext *ctx = getContext();
+
+	switch (pname) {
+	case GL_POINT_DISTANCE_ATTENUATION:
+		memcpy(ctx->point.attenuation, params, 3*sizeof(GLfloat));
+		ctx->point.dirty = GL_TRUE;
+		break;
+	default:
+		glPointParameterf(pname, *params);
+	}
 }
 
 GL_API void GL_APIENTRY glPointParameterx (GLenum pname, GLfixed param)
 {
-	FUNC_UNIMPLEMENTED;
+	glPointParameterf(pname, floatFromFixed(param));
 }
 
 GL_API void GL_APIENTRY glPointParameterxv (GLenum pname, const GLfixed *params)
+{
+	GLfloat coeffs[3];
+
+	switch (pname) {
+	case GL_POINT_DISTANCE_ATTENUATION:
+		for (int i = 0; i < 3; ++i)
+			coeffs[i] = floatFromFixed(params[i]);
+		glPointParameterfv(pname, coeffs);
+		break;
+	default:
+		glPointParameterx(pname, *params);
+	}
+}
+
+/**
+	Programs
+*/
+
+FGLObjectManager<FGLProgram, FGL_MAX_PROGRAM_OBJECTS> fglProgramObjects;
+unsigned FGLProgram::lastSerial = 0;
+
+GL_API void GL_APIENTRY glGenProgramsFIMG (GLsizei n, GLuint *programs)
+{
+	if(n <= 0)
+		return;
+
+	int name;
+	GLsizei i = n;
+	GLuint *cur = programs;
+	FGLContext *ctx = getContext();
+
+	do {
+		name = fglProgramObjects.get(ctx);
+		if(name < 0) {
+			glDeleteProgramsFIMG(n - i, programs);
+			setError(GL_OUT_OF_MEMORY);
+			return;
+		}
+		fglProgramObjects[name] = NULL;
+		*cur = name;
+		cur++;
+	} while (--i);
+}
+
+GL_API void GL_APIENTRY glDeleteProgramsFIMG (GLsizei n, const GLuint *programs)
+{
+	unsigned name;
+
+	if(n <= 0)
+		return;
+
+	while(n--) {
+		name = *programs;
+		programs++;
+
+		if(!fglProgramObjects.isValid(name))
+			continue;
+
+		/* Bindings are cleared, libfimg keeps its own copy until draw */
+		delete (fglProgramObjects[name]);
+		fglProgramObjects.put(name);
+	}
+}
+
+static FGLProgramObject *fglGetProgramObject(GLuint program)
+{
+	if(program == 0 || !fglProgramObjects.isValid(program)) {
+		setError(GL_INVALID_VALUE);
+		return NULL;
+	}
+
+	FGLProgramObject *obj = fglProgramObjects[program];
+	if(obj == NULL) {
+		obj = new FGLProgramObject(program);
+		if (obj == NULL) {
+			setError(GL_OUT_OF_MEMORY);
+			return NULL;
+		}
+		fglProgramObjects[program] = obj;
+	}
+
+	return obj;
+}
+
+GL_API void GL_APIENTRY glBindProgramFIMG (GLuint program)
+{
+	FGLContext *ctx = getContext();
+
+	if(program == 0) {
+		ctx->program.unbind();
+		return;
+	}
+
+	FGLProgramObject *obj = fglGetProgramObject(program);
+	if(obj == NULL)
+		return;
+
+	obj->bind(&ctx->program);
+}
+
+static inline GLint fglProgramStage(GLenum target)
+{
+	switch (target) {
+	case GL_VERTEX_PROGRAM_FIMG:
+		return FGFP_PROGRAM_VERTEX;
+	case GL_FRAGMENT_PROGRAM_FIMG:
+		return FGFP_PROGRAM_PIXEL;
+	default:
+		return -1;
+	}
+}
+
+GL_API void GL_APIENTRY glProgramBinaryFIMG (GLuint program, GLenum target,
+					const GLvoid *binary, GLsizei length)
+{
+	GLint stage = fglProgramStage(target);
+
+	if(stage < 0) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	/* Whole instructions, fitting next to resident shaders */
+	if(length <= 0 || length % 16 || (GLuint)length / 16
+			> fimgCompatGetProgramSlots((fimgProgramStage)stage)) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	FGLProgramObject *obj = fglGetProgramObject(program);
+	if(obj == NULL)
+		return;
+
+	if(obj->object.setCode(stage, binary, length / 16))
+		setError(GL_OUT_OF_MEMORY);
+}
+
+GL_API void GL_APIENTRY glProgramConstantfvFIMG (GLuint program, GLenum target,
+			GLuint index, GLsizei count, const GLfloat *values)
+{
+	GLint stage = fglProgramStage(target);
+
+	if(stage < 0) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	GLuint max = fimgCompatGetProgramConsts((fimgProgramStage)stage);
+	if(count < 0 || index >= max || (GLuint)count > max - index) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+
+	FGLProgramObject *obj = fglGetProgramObject(program);
+	if(obj == NULL)
+		return;
+
+	FGLProgram *prog = &obj->object;
+	bool loaded = ctx->program.get() == prog
+				&& ctx->programSerial == prog->serial;
+
+	prog->setConsts(stage, index, values, count);
+
+	/* Constants of active program are updated without reloading it */
+	if (loaded) {
+		fimgCompatSetProgramConst(ctx->fimg, (fimgProgramStage)stage,
+							index, values, count);
+		ctx->programSerial = prog->serial;
+	}
+}
+
+GL_API void GL_APIENTRY glProgramMatrixFIMG (GLuint program, GLenum matrix,
+								GLint index)
+{
+	GLint fglMatrix, unit;
+
+	switch (matrix) {
+	case GL_MODELVIEW_PROJECTION_FIMG:
+		fglMatrix = FGFP_MATRIX_TRANSFORM;
+		break;
+	case GL_MODELVIEW_INVERSE_FIMG:
+		fglMatrix = FGFP_MATRIX_LIGHTING;
+		break;
+	case GL_MODELVIEW:
+		fglMatrix = FGFP_MATRIX_MODELVIEW;
+		break;
+	default:
+		if((unit = unitFromTextureEnum(matrix)) < 0) {
+			setError(GL_INVALID_ENUM);
+			return;
+		}
+		fglMatrix = FGFP_MATRIX_TEXTURE(unit);
+	}
+
+	if(index < -1 || index > FIMG_NUM_CONST_FLOAT - 4) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	FGLProgramObject *obj = fglGetProgramObject(program);
+	if(obj == NULL)
+		return;
+
+	obj->object.setMatrix(fglMatrix, index);
+}
+
+/**
+	Stubs
+*/
+
+GL_API void GL_APIENTRY glColorMask (GLboolean red, GLboolean green,
+						GLboolean blue, GLboolean alpha)
+{
+	FGLContext *ctx = getContext();
+
+	ctx->perFragment.mask.red = red;
+	ctx->perFragment.mask.green = green;
+	ctx->perFragment.mask.blue = blue;
+	ctx->perFragment.mask.alpha = alpha;
+
+	if (ctx->surface.draw)
+		fimgSetColorBufWriteMask(ctx->fimg, red, green, blue, alpha);
+}
+
+GL_API void GL_APIENTRY glDepthMask (GLboolean flag)
+{
+	FGLContext *ctx = getContext();
+
+	ctx->perFragment.mask.depth = flag;
+
+	if (ctx->surface.depthFormat & 0xff)
+		fimgSetZBufWriteMask(ctx->fimg, flag);
+}
+
+GL_API void GL_APIENTRY glGetBufferParameteriv (GLenum target,
+						GLenum pname, GLint *params)
 {
 	FUNC_UNIMPLEMENTED;
 }
 
-GL_API void GL_APIENTRY glPointSize (GLfloat size)
+GL_API void GL_APIENTRY glHint (GLenum target, GLenum mode)
 {
 	FUNC_UNIMPLEMENTED;
 }
 
-GL_API void GL_APIENTRY glPointSizex (GLfixed size)
+GL_API void GL_APIENTRY glLineWidth (GLfloat width)
+{
+	FUNC_UNIMPLEMENTED;
+}
+
+GL_API void GL_APIENTRY glLineWidthx (GLfixed width)
 {
 	FUNC_UNIMPLEMENTED;
 }
@@ -1900,7 +3013,7 @@ FGLContext *fglCreateContext(void)
 		return NULL;
 	}
 
-	for(int i = 0; i < 4 + FGL_MAX_TEXTURE_UNITS; i++)
+	for(int i = 0; i < FGL_ARRAY_NUM; i++)
 		fimgSetAttribute(ctx->fimg, i, FGHI_ATTRIB_DT_FLOAT,
 						fglDefaultAttribSize[i]);
 
@@ -1911,6 +3024,7 @@ void fglDestroyContext(FGLContext *ctx)
 {
 	fglBufferObjects.clean(ctx);
 	fglCleanTextureObjects(ctx);
+	fglReleaseRetiredSurfaces(ctx);
 	fimgDestroyContext(ctx->fimg);
 	delete ctx;
 }
@@ -36,13 +36,13 @@ static inline GLint unitFromTextureEnum(GLenum texture)
 	case GL_TEXTURE1:
 		unit = 1;
 		break;
-#if 0
-	case TEXTURE2:
+	case GL_TEXTURE2:
 		unit = 2;
 		break;
-	case TEXTURE3:
+	case GL_TEXTURE3:
 		unit = 3;
 		break;
+#if 0
 	case TEXTURE4:
 		unit = 4;
 		break;
@@ -67,6 +67,20 @@ static inline GLint unitFromTextureEnum(GLenum texture)
 	Context management
 */
 
+extern void fglFlushDrawTex(FGLContext *ctx);
+
+static inline FGLContext *getCurrentContext(void)
+{
+	FGLContext *ctx = getGlThreadSpecific();
+
+	if(!ctx) {
+		LOGE("GL context is NULL!");
+		exit(EINVAL);
+	}
+
+	return ctx;
+}
+
 #ifdef GLES_DEBUG
 #define getContext() ( \
 	LOGD("%s called getContext()", __func__), \
@@ -76,12 +90,11 @@ static inline FGLContext *_getContext(void)
 static inline FGLContext *getContext(void)
 #endif
 {
-	FGLContext *ctx = getGlThreadSpecific();
+	FGLContext *ctx = getCurrentContext();
 
-	if(!ctx) {
-		LOGE("GL context is NULL!");
-		exit(EINVAL);
-	}
+	/* Any other call ends a run of glDrawTex*OES calls */
+	if(unlikely(ctx->drawTex.count))
+		fglFlushDrawTex(ctx);
 
 	return ctx;
 }
@@ -132,4 +145,7 @@ struct FGLColorConfigDesc {
 
 extern const FGLColorConfigDesc fglColorConfigs[];
 extern void fglCleanTextureObjects(FGLContext *ctx);
+extern void fglReleaseRetiredSurfaces(FGLContext *ctx);
+extern void fglReadColorLine(FGLContext *ctx, uint8_t *dst,
+				unsigned x, unsigned y, unsigned width);
 #endif
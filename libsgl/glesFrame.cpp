@@ -700,6 +700,11 @@ GL_API void GL_APIENTRY glFramebufferTexture2DOES (GLenum target, GLenum attachm
 	if (attach)
 	{
 		if (tx) {
+			// Rendering needs the texture in local memory
+			if (tx->surface && !fglMakeTextureResident(ctx, tx)) {
+				setError(GL_OUT_OF_MEMORY);
+				return;
+			}
 			*name = texture;
 			*type = FGLFramebuffer::TEXTURE;
 			tx->attach(attach);
@@ -27,6 +27,7 @@
 #include <cutils/log.h>
 #include <GLES/gl.h>
 #include <GLES/glext.h>
+#include "fglext.h"
 #include "glesCommon.h"
 #include "fglobjectmanager.h"
 #include "libfimg/fimg.h"
@@ -41,7 +42,6 @@ static char const * const gRendererString   = "S3C6410 FIMG-3DSE";
 static char const * const gVersionString    = "OpenGL ES-CM 1.1";
 static char const * const gExtensionsString =
 #if 0
-	"GL_OES_point_sprite "                  // TODO
 	"GL_ARB_texture_env_combine "		// TODO
 	"GL_ARB_texture_env_crossbar "		// TODO
 	"GL_ARB_texture_env_dot3 "		// TODO
@@ -53,7 +53,6 @@ static char const * const gExtensionsString =
 	"GL_EXT_blend_minmax "			// TODO
 	"GL_EXT_blend_subtract "		// TODO
 	"GL_EXT_stencil_wrap "			// TODO
-	"GL_OES_matrix_palette "		// TODO
 	"GL_OES_vertex_buffer_object "		// TODO
 	"GL_QUALCOMM_vertex_buffer_object "	// TODO
 	"GL_QUALCOMM_direct_texture "		// TODO
@@ -62,13 +61,16 @@ static char const * const gExtensionsString =
 	"GL_OES_fixed_point "
 	"GL_OES_single_precision "
 	"GL_OES_read_format "
-	//"GL_OES_compressed_paletted_texture "   // TODO
+	"GL_OES_compressed_paletted_texture "
 	"GL_OES_draw_texture "
+	"GL_OES_matrix_palette "
+	"GL_OES_texture_cube_map "
+	"GL_EXT_texture_compression_dxt1 "
 	//"GL_OES_matrix_get "                    // TODO
 	//"GL_OES_query_matrix "                  // TODO
 	"GL_OES_EGL_image "
 	"GL_EXT_texture_format_BGRA8888 "
-	//"GL_OES_compressed_ETC1_RGB8_texture "  // TODO
+	"GL_OES_compressed_ETC1_RGB8_texture "
 	//"GL_ARB_texture_compression "           // TODO IMPORTANT
 #ifdef FGL_NPOT_TEXTURES
 	"GL_ARB_texture_non_power_of_two "
@@ -76,12 +78,13 @@ static char const * const gExtensionsString =
 	//"GL_ANDROID_user_clip_plane "           // TODO
 	//"GL_ANDROID_vertex_buffer_object "      // TODO
 	//"GL_ANDROID_generate_mipmap "           // TODO
+	"GL_OES_point_sprite "
 	"GL_OES_point_size_array "
+	"GL_FIMG_program "
 	"GL_OES_framebuffer_object"
 ;
 
 static const GLint fglCompressedTextureFormats[] = {
-#if 0
 	GL_PALETTE4_RGB8_OES,
 	GL_PALETTE4_RGBA8_OES,
 	GL_PALETTE4_R5_G6_B5_OES,
@@ -92,9 +95,9 @@ static const GLint fglCompressedTextureFormats[] = {
 	GL_PALETTE8_R5_G6_B5_OES,
 	GL_PALETTE8_RGBA4_OES,
 	GL_PALETTE8_RGB5_A1_OES,
-	GL_RGB_S3TC_OES,
-	GL_RGBA_S3TC_OES
-#endif
+	GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+	GL_COMPRESSED_RGBA_S3TC_DXT1_EXT,
+	GL_ETC1_RGB8_OES,
 };
 
 const FGLColorConfigDesc fglColorConfigs[] = {
@@ -180,6 +183,11 @@ GL_API void GL_APIENTRY glGetIntegerv (GLenum pname, GLint *params)
 		if (ctx->elementArrayBuffer.isBound())
 			params[0] = ctx->elementArrayBuffer.getName();
 		break;
+	case GL_PROGRAM_BINDING_FIMG:
+		params[0] = 0;
+		if (ctx->program.isBound())
+			params[0] = ctx->program.getName();
+		break;
 	case GL_VIEWPORT:
 		params[0] = ctx->viewport.x;
 		params[1] = ctx->viewport.y;
@@ -231,6 +239,14 @@ GL_API void GL_APIENTRY glGetIntegerv (GLenum pname, GLint *params)
 		else
 			params[0] = 0.0f;
 		break; }
+	case GL_TEXTURE_BINDING_CUBE_MAP_OES: {
+		FGLTextureObjectBinding *b =
+				&ctx->texture[ctx->activeTexture].cubeBinding;
+		if (b->isBound())
+			params[0] = b->getName();
+		else
+			params[0] = 0;
+		break; }
 
 	case GL_FRAMEBUFFER_BINDING_OES: {
 		FGLFramebufferObjectBinding *b =
@@ -476,6 +492,7 @@ GL_API void GL_APIENTRY glGetIntegerv (GLenum pname, GLint *params)
 		params[0] = FGL_MAX_SUBPIXEL_BITS;
 		break;
 	case GL_MAX_TEXTURE_SIZE:
+	case GL_MAX_CUBE_MAP_TEXTURE_SIZE_OES:
 		params[0] = FGL_MAX_TEXTURE_SIZE;
 		break;
 	case GL_MAX_RENDERBUFFER_SIZE_OES:
@@ -505,6 +522,18 @@ GL_API void GL_APIENTRY glGetIntegerv (GLenum pname, GLint *params)
 	case GL_MAX_LIGHTS:
 		params[0] = FGL_MAX_LIGHTS;
 		break;
+	case GL_MAX_CLIP_PLANES:
+		params[0] = FGL_MAX_CLIP_PLANES;
+		break;
+	case GL_MAX_PALETTE_MATRICES_OES:
+		params[0] = FGL_MAX_PALETTE_MATRICES;
+		break;
+	case GL_MAX_VERTEX_UNITS_OES:
+		params[0] = FGL_MAX_VERTEX_UNITS;
+		break;
+	case GL_CURRENT_PALETTE_MATRIX_OES:
+		params[0] = ctx->matrix.activePalette;
+		break;
 	case GL_SAMPLE_BUFFERS :
 		params[0] = 0;
 		break;
@@ -570,6 +599,23 @@ GL_API void GL_APIENTRY glGetIntegerv (GLenum pname, GLint *params)
 	case GL_BLEND:
 	case GL_DITHER:
 	case GL_COLOR_LOGIC_OP:
+	case GL_LIGHTING:
+	case GL_LIGHT0:
+	case GL_LIGHT1:
+	case GL_LIGHT2:
+	case GL_LIGHT3:
+	case GL_LIGHT4:
+	case GL_LIGHT5:
+	case GL_LIGHT6:
+	case GL_LIGHT7:
+	case GL_FOG:
+	case GL_CLIP_PLANE0:
+	case GL_CLIP_PLANE1:
+	case GL_CLIP_PLANE2:
+	case GL_POINT_SPRITE_OES:
+	case GL_MATRIX_PALETTE_OES:
+	case GL_TEXTURE_CUBE_MAP_OES:
+	case GL_TEXTURE_GEN_STR_OES:
 		params[0] = glIsEnabled(pname);
 		break;
 	default:
@@ -681,9 +727,11 @@ GL_API void GL_APIENTRY glGetBooleanv (GLenum pname, GLboolean *params)
 	case GL_IMPLEMENTATION_COLOR_READ_FORMAT_OES:
 	case GL_ARRAY_BUFFER_BINDING:
 	case GL_ELEMENT_ARRAY_BUFFER_BINDING:
+	case GL_PROGRAM_BINDING_FIMG:
 	case GL_CULL_FACE_MODE:
 	case GL_FRONT_FACE:
 	case GL_TEXTURE_BINDING_2D:
+	case GL_TEXTURE_BINDING_CUBE_MAP_OES:
 	case GL_ACTIVE_TEXTURE:
 	case GL_STENCIL_CLEAR_VALUE:
 	case GL_DEPTH_WRITEMASK:
@@ -700,8 +748,13 @@ GL_API void GL_APIENTRY glGetBooleanv (GLenum pname, GLboolean *params)
 	case GL_PACK_ALIGNMENT:
 	case GL_SUBPIXEL_BITS:
 	case GL_MAX_TEXTURE_SIZE:
+	case GL_MAX_CUBE_MAP_TEXTURE_SIZE_OES:
 	case GL_MAX_TEXTURE_UNITS:
 	case GL_MAX_LIGHTS:
+	case GL_MAX_CLIP_PLANES:
+	case GL_MAX_PALETTE_MATRICES_OES:
+	case GL_MAX_VERTEX_UNITS_OES:
+	case GL_CURRENT_PALETTE_MATRIX_OES:
 	case GL_SAMPLE_BUFFERS :
 	case GL_SAMPLES :
 	case GL_RED_BITS :
@@ -727,6 +780,23 @@ GL_API void GL_APIENTRY glGetBooleanv (GLenum pname, GLboolean *params)
 	case GL_BLEND:
 	case GL_DITHER:
 	case GL_COLOR_LOGIC_OP:
+	case GL_LIGHTING:
+	case GL_LIGHT0:
+	case GL_LIGHT1:
+	case GL_LIGHT2:
+	case GL_LIGHT3:
+	case GL_LIGHT4:
+	case GL_LIGHT5:
+	case GL_LIGHT6:
+	case GL_LIGHT7:
+	case GL_FOG:
+	case GL_CLIP_PLANE0:
+	case GL_CLIP_PLANE1:
+	case GL_CLIP_PLANE2:
+	case GL_POINT_SPRITE_OES:
+	case GL_MATRIX_PALETTE_OES:
+	case GL_TEXTURE_CUBE_MAP_OES:
+	case GL_TEXTURE_GEN_STR_OES:
 		params[0] = glIsEnabled(pname);
 		break;
 	default:
@@ -822,7 +892,9 @@ GL_API void GL_APIENTRY glGetFixedv (GLenum pname, GLfixed *params)
 #endif
 	case GL_ARRAY_BUFFER_BINDING:
 	case GL_ELEMENT_ARRAY_BUFFER_BINDING:
+	case GL_PROGRAM_BINDING_FIMG:
 	case GL_TEXTURE_BINDING_2D:
+	case GL_TEXTURE_BINDING_CUBE_MAP_OES:
 	case GL_ACTIVE_TEXTURE:
 	case GL_STENCIL_CLEAR_VALUE:
 	case GL_DEPTH_WRITEMASK:
@@ -834,8 +906,13 @@ GL_API void GL_APIENTRY glGetFixedv (GLenum pname, GLfixed *params)
 	case GL_PACK_ALIGNMENT:
 	case GL_SUBPIXEL_BITS:
 	case GL_MAX_TEXTURE_SIZE:
+	case GL_MAX_CUBE_MAP_TEXTURE_SIZE_OES:
 	case GL_MAX_TEXTURE_UNITS:
 	case GL_MAX_LIGHTS:
+	case GL_MAX_CLIP_PLANES:
+	case GL_MAX_PALETTE_MATRICES_OES:
+	case GL_MAX_VERTEX_UNITS_OES:
+	case GL_CURRENT_PALETTE_MATRIX_OES:
 	case GL_SAMPLE_BUFFERS :
 	case GL_SAMPLES :
 	case GL_RED_BITS :
@@ -887,6 +964,23 @@ GL_API void GL_APIENTRY glGetFixedv (GLenum pname, GLfixed *params)
 	case GL_BLEND:
 	case GL_DITHER:
 	case GL_COLOR_LOGIC_OP:
+	case GL_LIGHTING:
+	case GL_LIGHT0:
+	case GL_LIGHT1:
+	case GL_LIGHT2:
+	case GL_LIGHT3:
+	case GL_LIGHT4:
+	case GL_LIGHT5:
+	case GL_LIGHT6:
+	case GL_LIGHT7:
+	case GL_FOG:
+	case GL_CLIP_PLANE0:
+	case GL_CLIP_PLANE1:
+	case GL_CLIP_PLANE2:
+	case GL_POINT_SPRITE_OES:
+	case GL_MATRIX_PALETTE_OES:
+	case GL_TEXTURE_CUBE_MAP_OES:
+	case GL_TEXTURE_GEN_STR_OES:
 		params[0] = fixedFromBool(glIsEnabled(pname));
 		break;
 	default:
@@ -899,6 +993,43 @@ GL_API void GL_APIENTRY glGetFloatv (GLenum pname, GLfloat *params)
 	FGLContext *ctx = getContext();
 
 	switch (pname) {
+	case GL_LIGHT_MODEL_AMBIENT:
+		memcpy(params, ctx->lighting.ambient, 4*sizeof(GLfloat));
+		break;
+	case GL_LIGHT_MODEL_TWO_SIDE:
+		params[0] = ctx->lighting.twoSide;
+		break;
+	case GL_FOG_MODE:
+		params[0] = ctx->fog.mode;
+		break;
+	case GL_FOG_DENSITY:
+		params[0] = ctx->fog.density;
+		break;
+	case GL_FOG_START:
+		params[0] = ctx->fog.start;
+		break;
+	case GL_FOG_END:
+		params[0] = ctx->fog.end;
+		break;
+	case GL_FOG_COLOR:
+		memcpy(params, ctx->fog.color, 4*sizeof(GLfloat));
+		break;
+	case GL_POINT_SIZE_MIN:
+		params[0] = ctx->point.sizeMin;
+		break;
+	case GL_POINT_SIZE_MAX:
+		params[0] = ctx->point.sizeMax;
+		break;
+	case GL_POINT_FADE_THRESHOLD_SIZE:
+		params[0] = ctx->point.fadeThreshold;
+		break;
+	case GL_POINT_DISTANCE_ATTENUATION:
+		memcpy(params, ctx->point.attenuation, 3*sizeof(GLfloat));
+		break;
+	case GL_ALIASED_POINT_SIZE_RANGE:
+		params[0] = 1.0f;
+		params[1] = FGL_MAX_POINT_SIZE;
+		break;
 	case GL_VIEWPORT:
 		params[0] = ctx->viewport.x;
 		params[1] = ctx->viewport.y;
@@ -993,9 +1124,11 @@ GL_API void GL_APIENTRY glGetFloatv (GLenum pname, GLfloat *params)
 	case GL_IMPLEMENTATION_COLOR_READ_FORMAT_OES:
 	case GL_ARRAY_BUFFER_BINDING:
 	case GL_ELEMENT_ARRAY_BUFFER_BINDING:
+	case GL_PROGRAM_BINDING_FIMG:
 	case GL_CULL_FACE_MODE:
 	case GL_FRONT_FACE:
 	case GL_TEXTURE_BINDING_2D:
+	case GL_TEXTURE_BINDING_CUBE_MAP_OES:
 	case GL_ACTIVE_TEXTURE:
 	case GL_STENCIL_CLEAR_VALUE:
 	case GL_DEPTH_WRITEMASK:
@@ -1012,8 +1145,13 @@ GL_API void GL_APIENTRY glGetFloatv (GLenum pname, GLfloat *params)
 	case GL_PACK_ALIGNMENT:
 	case GL_SUBPIXEL_BITS:
 	case GL_MAX_TEXTURE_SIZE:
+	case GL_MAX_CUBE_MAP_TEXTURE_SIZE_OES:
 	case GL_MAX_TEXTURE_UNITS:
 	case GL_MAX_LIGHTS:
+	case GL_MAX_CLIP_PLANES:
+	case GL_MAX_PALETTE_MATRICES_OES:
+	case GL_MAX_VERTEX_UNITS_OES:
+	case GL_CURRENT_PALETTE_MATRIX_OES:
 	case GL_SAMPLE_BUFFERS :
 	case GL_SAMPLES :
 	case GL_RED_BITS :
@@ -1039,6 +1177,23 @@ GL_API void GL_APIENTRY glGetFloatv (GLenum pname, GLfloat *params)
 	case GL_BLEND:
 	case GL_DITHER:
 	case GL_COLOR_LOGIC_OP:
+	case GL_LIGHTING:
+	case GL_LIGHT0:
+	case GL_LIGHT1:
+	case GL_LIGHT2:
+	case GL_LIGHT3:
+	case GL_LIGHT4:
+	case GL_LIGHT5:
+	case GL_LIGHT6:
+	case GL_LIGHT7:
+	case GL_FOG:
+	case GL_CLIP_PLANE0:
+	case GL_CLIP_PLANE1:
+	case GL_CLIP_PLANE2:
+	case GL_POINT_SPRITE_OES:
+	case GL_MATRIX_PALETTE_OES:
+	case GL_TEXTURE_CUBE_MAP_OES:
+	case GL_TEXTURE_GEN_STR_OES:
 		params[0] = glIsEnabled(pname);
 		break;
 	default:
@@ -1068,6 +1223,12 @@ GL_API void GL_APIENTRY glGetPointerv (GLenum pname, void **params)
 	case GL_POINT_SIZE_ARRAY_POINTER_OES:
 		id = FGL_ARRAY_POINT_SIZE;
 		break;
+	case GL_MATRIX_INDEX_ARRAY_POINTER_OES:
+		id = FGL_ARRAY_MATRIX_INDEX;
+		break;
+	case GL_WEIGHT_ARRAY_POINTER_OES:
+		id = FGL_ARRAY_WEIGHT;
+		break;
 	default:
 		setError(GL_INVALID_ENUM);
 		return;
@@ -1118,10 +1279,39 @@ GL_API GLboolean GL_APIENTRY glIsEnabled (GLenum cap)
 	case GL_COLOR_LOGIC_OP:
 		return fimgGetFragmentState(ctx->fimg, FIMG_COLOR_LOGIC_OP);
 		break;
-#if 0
-	case GL_POINT_SPRITE_OES_EXP:
+	case GL_LIGHTING:
+		return ctx->lighting.enabled;
+		break;
+	case GL_LIGHT0:
+	case GL_LIGHT1:
+	case GL_LIGHT2:
+	case GL_LIGHT3:
+	case GL_LIGHT4:
+	case GL_LIGHT5:
+	case GL_LIGHT6:
+	case GL_LIGHT7:
+		return ctx->lighting.light[cap - GL_LIGHT0].enabled;
+		break;
+	case GL_FOG:
+		return ctx->fog.enabled;
+		break;
+	case GL_CLIP_PLANE0:
+	case GL_CLIP_PLANE1:
+	case GL_CLIP_PLANE2:
+		return ctx->clipPlane.enabled[cap - GL_CLIP_PLANE0];
+		break;
+	case GL_POINT_SPRITE_OES:
+		return ctx->point.sprite;
+		break;
+	case GL_MATRIX_PALETTE_OES:
+		return ctx->matrix.paletteEnabled;
+		break;
+	case GL_TEXTURE_CUBE_MAP_OES:
+		return ctx->texture[ctx->activeTexture].cubeEnabled;
+		break;
+	case GL_TEXTURE_GEN_STR_OES:
+		return ctx->texture[ctx->activeTexture].texGen;
 		break;
-#endif
 	default:
 		setError(GL_INVALID_ENUM);
 		return GL_FALSE;
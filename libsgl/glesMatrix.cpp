@@ -41,9 +41,37 @@ unsigned int FGLMatrixState::stackSizes[3 + FGL_MAX_TEXTURE_UNITS] = {
 	16,	// Model-view matrices
 	16,	// Inverted model-view matrices
 	2,	// Texture 0 matrices
-	2	// Texture 1 matrices
+	2,	// Texture 1 matrices
+	2,	// Texture 2 matrices
+	2	// Texture 3 matrices
 };
 
+/* Index of matrix affected by matrix operations */
+static inline GLint fglActiveMatrix(FGLContext *ctx)
+{
+	GLint idx = ctx->matrix.activeMatrix;
+
+	if(idx == FGL_MATRIX_TEXTURE)
+		return FGL_MATRIX_TEXTURE(ctx->activeTexture);
+
+	if(idx == FGL_MATRIX_PALETTE(0))
+		return FGL_MATRIX_PALETTE(ctx->matrix.activePalette);
+
+	return idx;
+}
+
+/* Index of matrix kept inverted along given one or -1 if none */
+static inline GLint fglInverseMatrix(GLint idx)
+{
+	if(idx == FGL_MATRIX_MODELVIEW)
+		return FGL_MATRIX_MODELVIEW_INVERSE;
+
+	if(idx >= FGL_MATRIX_PALETTE(0))
+		return idx + 1;
+
+	return -1;
+}
+
 GL_API void GL_APIENTRY glMatrixMode (GLenum mode)
 {
 	GLint fglMode;
@@ -58,6 +86,9 @@ GL_API void GL_APIENTRY glMatrixMode (GLenum mode)
 	case GL_TEXTURE:
 		fglMode = FGL_MATRIX_TEXTURE;
 		break;
+	case GL_MATRIX_PALETTE_OES:
+		fglMode = FGL_MATRIX_PALETTE(0);
+		break;
 	default:
 		setError(GL_INVALID_ENUM);
 		return;
@@ -71,108 +102,95 @@ GL_API void GL_APIENTRY glMatrixMode (GLenum mode)
 GL_API void GL_APIENTRY glLoadMatrixf (const GLfloat *m)
 {
 	FGLContext *ctx = getContext();
-	GLint idx = ctx->matrix.activeMatrix;
-
-	if(idx == FGL_MATRIX_TEXTURE)
-		idx = FGL_MATRIX_TEXTURE(ctx->activeTexture);
+	GLint idx = fglActiveMatrix(ctx);
 
 	ctx->matrix.stack[idx].top().load(m);
 	ctx->matrix.dirty[idx] = GL_TRUE;
 
-	if(idx != FGL_MATRIX_MODELVIEW)
+	GLint inv = fglInverseMatrix(idx);
+	if(inv < 0)
 		return;
 
-	ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].top().load(m);
-	ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].top().inverse();
-	ctx->matrix.dirty[FGL_MATRIX_MODELVIEW_INVERSE] = GL_TRUE;
+	ctx->matrix.stack[inv].top().load(m);
+	ctx->matrix.stack[inv].top().inverse();
+	ctx->matrix.dirty[inv] = GL_TRUE;
 }
 
 GL_API void GL_APIENTRY glLoadMatrixx (const GLfixed *m)
 {
 	FGLContext *ctx = getContext();
-	GLint idx = ctx->matrix.activeMatrix;
-
-	if(idx == FGL_MATRIX_TEXTURE)
-		idx = FGL_MATRIX_TEXTURE(ctx->activeTexture);
+	GLint idx = fglActiveMatrix(ctx);
 
 	ctx->matrix.stack[idx].top().load(m);
 	ctx->matrix.dirty[idx] = GL_TRUE;
 
-	if(idx != FGL_MATRIX_MODELVIEW)
+	GLint inv = fglInverseMatrix(idx);
+	if(inv < 0)
 		return;
 
-	ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].top().load(m);
-	ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].top().inverse();
-	ctx->matrix.dirty[FGL_MATRIX_MODELVIEW_INVERSE] = GL_TRUE;
+	ctx->matrix.stack[inv].top().load(m);
+	ctx->matrix.stack[inv].top().inverse();
+	ctx->matrix.dirty[inv] = GL_TRUE;
 }
 
 GL_API void GL_APIENTRY glMultMatrixf (const GLfloat *m)
 {
 	FGLContext *ctx = getContext();
-	GLint idx = ctx->matrix.activeMatrix;
-
-	if(idx == FGL_MATRIX_TEXTURE)
-		idx = FGL_MATRIX_TEXTURE(ctx->activeTexture);
+	GLint idx = fglActiveMatrix(ctx);
 
 	FGLmatrix *mat = &ctx->matrix.stack[idx].top();
 	mat->multiply(m);
 	ctx->matrix.dirty[idx] = GL_TRUE;
 
-	if(idx != FGL_MATRIX_MODELVIEW)
+	GLint inv = fglInverseMatrix(idx);
+	if(inv < 0)
 		return;
 
-	FGLmatrix *inv = &ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].top();
-	inv->load(*mat);
-	inv->inverse();
-	ctx->matrix.dirty[FGL_MATRIX_MODELVIEW_INVERSE] = GL_TRUE;
+	FGLmatrix *invMat = &ctx->matrix.stack[inv].top();
+	invMat->load(*mat);
+	invMat->inverse();
+	ctx->matrix.dirty[inv] = GL_TRUE;
 }
 
 GL_API void GL_APIENTRY glMultMatrixx (const GLfixed *m)
 {
 	FGLContext *ctx = getContext();
-	GLint idx = ctx->matrix.activeMatrix;
-
-	if(idx == FGL_MATRIX_TEXTURE)
-		idx = FGL_MATRIX_TEXTURE(ctx->activeTexture);
+	GLint idx = fglActiveMatrix(ctx);
 
 	FGLmatrix *mat = &ctx->matrix.stack[idx].top();
 	mat->multiply(m);
 	ctx->matrix.dirty[idx] = GL_TRUE;
 
-	if(idx != FGL_MATRIX_MODELVIEW)
+	GLint inv = fglInverseMatrix(idx);
+	if(inv < 0)
 		return;
 
-	FGLmatrix *inv = &ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].top();
-	inv->load(*mat);
-	inv->inverse();
-	ctx->matrix.dirty[FGL_MATRIX_MODELVIEW_INVERSE] = GL_TRUE;
+	FGLmatrix *invMat = &ctx->matrix.stack[inv].top();
+	invMat->load(*mat);
+	invMat->inverse();
+	ctx->matrix.dirty[inv] = GL_TRUE;
 }
 
 GL_API void GL_APIENTRY glLoadIdentity (void)
 {
 	FGLContext *ctx = getContext();
-	GLint idx = ctx->matrix.activeMatrix;
-
-	if(idx == FGL_MATRIX_TEXTURE)
-		idx = FGL_MATRIX_TEXTURE(ctx->activeTexture);
+	GLint idx = fglActiveMatrix(ctx);
 
 	ctx->matrix.stack[idx].top().identity();
 	ctx->matrix.dirty[idx] = GL_TRUE;
 
-	if(idx != FGL_MATRIX_MODELVIEW)
+	GLint inv = fglInverseMatrix(idx);
+	if(inv < 0)
 		return;
 
-	ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].top().identity();
-	ctx->matrix.dirty[FGL_MATRIX_MODELVIEW_INVERSE] = GL_TRUE;
+	ctx->matrix.stack[inv].top().identity();
+	ctx->matrix.dirty[inv] = GL_TRUE;
 }
 
 GL_API void GL_APIENTRY glRotatef (GLfloat angle, GLfloat x, GLfloat y, GLfloat z)
 {
 	FGLContext *ctx = getContext();
-	GLint idx = ctx->matrix.activeMatrix;
-
-	if(idx == FGL_MATRIX_TEXTURE)
-		idx = FGL_MATRIX_TEXTURE(ctx->activeTexture);
+	GLint idx = fglActiveMatrix(ctx);
 
 	FGLmatrix mat;
 	mat.rotate(angle, x, y, z);
@@ -180,13 +198,14 @@ GL_API void GL_APIENTRY glRotatef (GLfloat angle, GLfloat x, GLfloat y, GLfloat
 	ctx->matrix.stack[idx].top().multiply(mat);
 	ctx->matrix.dirty[idx] = GL_TRUE;
 
-	if(idx != FGL_MATRIX_MODELVIEW)
+	GLint inv = fglInverseMatrix(idx);
+	if(inv < 0)
 		return;
 
 	mat.transpose();
 
-	ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].top().leftMultiply(mat);
-	ctx->matrix.dirty[FGL_MATRIX_MODELVIEW_INVERSE] = GL_TRUE;
+	ctx->matrix.stack[inv].top().leftMultiply(mat);
+	ctx->matrix.dirty[inv] = GL_TRUE;
 }
 
 GL_API void GL_APIENTRY glRotatex (GLfixed angle, GLfixed x, GLfixed y, GLfixed z)
@@ -198,10 +217,7 @@ GL_API void GL_APIENTRY glRotatex (GLfixed angle, GLfixed x, GLfixed y, GLfixed
 GL_API void GL_APIENTRY glTranslatef (GLfloat x, GLfloat y, GLfloat z)
 {
 	FGLContext *ctx = getContext();
-	GLint idx = ctx->matrix.activeMatrix;
-
-	if(idx == FGL_MATRIX_TEXTURE)
-		idx = FGL_MATRIX_TEXTURE(ctx->activeTexture);
+	GLint idx = fglActiveMatrix(ctx);
 
 	FGLmatrix mat;
 	mat.translate(x, y, z);
@@ -209,13 +225,14 @@ GL_API void GL_APIENTRY glTranslatef (GLfloat x, GLfloat y, GLfloat z)
 	ctx->matrix.stack[idx].top().multiply(mat);
 	ctx->matrix.dirty[idx] = GL_TRUE;
 
-	if(idx != FGL_MATRIX_MODELVIEW)
+	GLint inv = fglInverseMatrix(idx);
+	if(inv < 0)
 		return;
 
 	mat.inverseTranslate(x, y, z);
 
-	ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].top().leftMultiply(mat);
-	ctx->matrix.dirty[FGL_MATRIX_MODELVIEW_INVERSE] = GL_TRUE;
+	ctx->matrix.stack[inv].top().leftMultiply(mat);
+	ctx->matrix.dirty[inv] = GL_TRUE;
 }
 
 GL_API void GL_APIENTRY glTranslatex (GLfixed x, GLfixed y, GLfixed z)
@@ -226,10 +243,7 @@ GL_API void GL_APIENTRY glTranslatex (GLfixed x, GLfixed y, GLfixed z)
 GL_API void GL_APIENTRY glScalef (GLfloat x, GLfloat y, GLfloat z)
 {
 	FGLContext *ctx = getContext();
-	GLint idx = ctx->matrix.activeMatrix;
-
-	if(idx == FGL_MATRIX_TEXTURE)
-		idx = FGL_MATRIX_TEXTURE(ctx->activeTexture);
+	GLint idx = fglActiveMatrix(ctx);
 
 	FGLmatrix mat;
 	mat.scale(x, y, z);
@@ -237,13 +251,14 @@ GL_API void GL_APIENTRY glScalef (GLfloat x, GLfloat y, GLfloat z)
 	ctx->matrix.stack[idx].top().multiply(mat);
 	ctx->matrix.dirty[idx] = GL_TRUE;
 
-	if(idx != FGL_MATRIX_MODELVIEW)
+	GLint inv = fglInverseMatrix(idx);
+	if(inv < 0)
 		return;
 
 	mat.inverseScale(x, y, z);
 
-	ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].top().leftMultiply(mat);
-	ctx->matrix.dirty[FGL_MATRIX_MODELVIEW_INVERSE] = GL_TRUE;
+	ctx->matrix.stack[inv].top().leftMultiply(mat);
+	ctx->matrix.dirty[inv] = GL_TRUE;
 }
 
 GL_API void GL_APIENTRY glScalex (GLfixed x, GLfixed y, GLfixed z)
@@ -260,10 +275,7 @@ GL_API void GL_APIENTRY glFrustumf (GLfloat left, GLfloat right,
 	}
 
 	FGLContext *ctx = getContext();
-	GLint idx = ctx->matrix.activeMatrix;
-
-	if(idx == FGL_MATRIX_TEXTURE)
-		idx = FGL_MATRIX_TEXTURE(ctx->activeTexture);
+	GLint idx = fglActiveMatrix(ctx);
 
 	FGLmatrix mat;
 	mat.frustum(left, right, bottom, top, zNear, zFar);
@@ -271,13 +283,14 @@ GL_API void GL_APIENTRY glFrustumf (GLfloat left, GLfloat right,
 	ctx->matrix.stack[idx].top().multiply(mat);
 	ctx->matrix.dirty[idx] = GL_TRUE;
 
-	if(idx != FGL_MATRIX_MODELVIEW)
+	GLint inv = fglInverseMatrix(idx);
+	if(inv < 0)
 		return;
 
 	mat.inverseFrustum(left, right, bottom, top, zNear, zFar);
 
-	ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].top().leftMultiply(mat);
-	ctx->matrix.dirty[FGL_MATRIX_MODELVIEW_INVERSE] = GL_TRUE;
+	ctx->matrix.stack[inv].top().leftMultiply(mat);
+	ctx->matrix.dirty[inv] = GL_TRUE;
 }
 
 GL_API void GL_APIENTRY glFrustumx (GLfixed left, GLfixed right,
@@ -297,10 +310,7 @@ GL_API void GL_APIENTRY glOrthof (GLfloat left, GLfloat right,
 	}
 
 	FGLContext *ctx = getContext();
-	GLint idx = ctx->matrix.activeMatrix;
-
-	if(idx == FGL_MATRIX_TEXTURE)
-		idx = FGL_MATRIX_TEXTURE(ctx->activeTexture);
+	GLint idx = fglActiveMatrix(ctx);
 
 	FGLmatrix mat;
 	mat.ortho(left, right, bottom, top, zNear, zFar);
@@ -308,13 +318,14 @@ GL_API void GL_APIENTRY glOrthof (GLfloat left, GLfloat right,
 	ctx->matrix.stack[idx].top().multiply(mat);
 	ctx->matrix.dirty[idx] = GL_TRUE;
 
-	if(idx != FGL_MATRIX_MODELVIEW)
+	GLint inv = fglInverseMatrix(idx);
+	if(inv < 0)
 		return;
 
 	mat.inverseOrtho(left, right, bottom, top, zNear, zFar);
 
-	ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].top().leftMultiply(mat);
-	ctx->matrix.dirty[FGL_MATRIX_MODELVIEW_INVERSE] = GL_TRUE;
+	ctx->matrix.stack[inv].top().leftMultiply(mat);
+	ctx->matrix.dirty[inv] = GL_TRUE;
 }
 
 GL_API void GL_APIENTRY glOrthox (GLfixed left, GLfixed right, GLfixed bottom, GLfixed top, GLfixed zNear, GLfixed zFar)
@@ -341,10 +352,14 @@ GL_API void GL_APIENTRY glActiveTexture (GLenum texture)
 GL_API void GL_APIENTRY glPopMatrix (void)
 {
 	FGLContext *ctx = getContext();
-	GLint idx = ctx->matrix.activeMatrix;
 
-	if(idx == FGL_MATRIX_TEXTURE)
-		idx = FGL_MATRIX_TEXTURE(ctx->activeTexture);
+	/* Palette matrices have no stacks (OES_matrix_palette) */
+	if(ctx->matrix.activeMatrix == FGL_MATRIX_PALETTE(0)) {
+		setError(GL_INVALID_OPERATION);
+		return;
+	}
+
+	GLint idx = fglActiveMatrix(ctx);
 
 	if(ctx->matrix.stack[idx].pop()) {
 		setError(GL_STACK_UNDERFLOW);
@@ -353,29 +368,65 @@ GL_API void GL_APIENTRY glPopMatrix (void)
 
 	ctx->matrix.dirty[idx] = GL_TRUE;
 
-	if(idx != FGL_MATRIX_MODELVIEW)
+	GLint inv = fglInverseMatrix(idx);
+	if(inv < 0)
 		return;
 
-	ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].pop();
-	ctx->matrix.dirty[FGL_MATRIX_MODELVIEW_INVERSE] = GL_TRUE;
+	ctx->matrix.stack[inv].pop();
+	ctx->matrix.dirty[inv] = GL_TRUE;
 }
 
 GL_API void GL_APIENTRY glPushMatrix (void)
 {
 	FGLContext *ctx = getContext();
-	GLint idx = ctx->matrix.activeMatrix;
 
-	if(idx == FGL_MATRIX_TEXTURE)
-		idx = FGL_MATRIX_TEXTURE(ctx->activeTexture);
+	/* Palette matrices have no stacks (OES_matrix_palette) */
+	if(ctx->matrix.activeMatrix == FGL_MATRIX_PALETTE(0)) {
+		setError(GL_INVALID_OPERATION);
+		return;
+	}
+
+	GLint idx = fglActiveMatrix(ctx);
 
 	if(ctx->matrix.stack[idx].push()) {
 		setError(GL_STACK_OVERFLOW);
 		return;
 	}
 
-	if(idx != FGL_MATRIX_MODELVIEW)
+	GLint inv = fglInverseMatrix(idx);
+	if(inv < 0)
 		return;
 
-	ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].push();
+	ctx->matrix.stack[inv].push();
 }
 
+
+GL_API void GL_APIENTRY glCurrentPaletteMatrixOES (GLuint matrixpaletteindex)
+{
+	if(matrixpaletteindex >= FGL_MAX_PALETTE_MATRICES) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+
+	ctx->matrix.activePalette = matrixpaletteindex;
+
+	/* Vertex shader blends only matrices referenced so far */
+	if((GLint)matrixpaletteindex >= ctx->matrix.paletteCount)
+		ctx->matrix.paletteCount = matrixpaletteindex + 1;
+}
+
+GL_API void GL_APIENTRY glLoadPaletteFromModelViewMatrixOES (void)
+{
+	FGLContext *ctx = getContext();
+	GLint idx = FGL_MATRIX_PALETTE(ctx->matrix.activePalette);
+	GLint inv = FGL_MATRIX_PALETTE_INVERSE(ctx->matrix.activePalette);
+
+	ctx->matrix.stack[idx].top() =
+			ctx->matrix.stack[FGL_MATRIX_MODELVIEW].top();
+	ctx->matrix.stack[inv].top() =
+			ctx->matrix.stack[FGL_MATRIX_MODELVIEW_INVERSE].top();
+	ctx->matrix.dirty[idx] = GL_TRUE;
+	ctx->matrix.dirty[inv] = GL_TRUE;
+}
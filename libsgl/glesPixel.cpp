@@ -202,6 +202,47 @@ static void convertToUByteRGBA1555(FGLContext *ctx, uint8_t *dst,
 	} while (--height);
 }
 
+/* Unpacks part of line y (in window coordinates) to RGBA8888 bytes */
+void fglReadColorLine(FGLContext *ctx, uint8_t *dst,
+				unsigned x, unsigned y, unsigned width)
+{
+	unsigned bpp = fglColorConfigs[ctx->surface.format].pixelSize;
+	unsigned line = ctx->surface.height - y - 1;
+	const uint8_t *src8 = (const uint8_t *)ctx->surface.draw->vaddr
+					+ (line*ctx->surface.stride + x)*bpp;
+	const uint16_t *src16 = (const uint16_t *)src8;
+
+	switch (ctx->surface.format) {
+	case FGPF_COLOR_MODE_555:
+		do {
+			unpackPixel555(dst, *src16++);
+			dst += 4;
+		} while (--width);
+		break;
+	case FGPF_COLOR_MODE_565:
+		do {
+			unpackPixel565(dst, *src16++);
+			dst += 4;
+		} while (--width);
+		break;
+	case FGPF_COLOR_MODE_4444:
+		do {
+			unpackPixel4444(dst, *src16++);
+			dst += 4;
+		} while (--width);
+		break;
+	case FGPF_COLOR_MODE_1555:
+		do {
+			unpackPixel1555(dst, *src16++);
+			dst += 4;
+		} while (--width);
+		break;
+	default:
+		// 32-bit modes are read as RGBA bytes already
+		memcpy(dst, src8, 4*width);
+	}
+}
+
 static void fallbackCopy(uint8_t *dst, const uint8_t *src, unsigned len)
 {
 	while (len--)
@@ -718,6 +759,9 @@ static void fglClear(FGLContext *ctx, GLbitfield mode)
 	if (!h || !w)
 		return;
 
+	// Only the cleared lines need to be written back from the cache
+	uint32_t lines = h;
+
 	//lineByLine |= (l > 0);
 	lineByLine |= (w < ctx->surface.width);
 	//lineByLine &= (ctx->perFragment.scissor.enabled == GL_TRUE);
@@ -726,6 +770,9 @@ static void fglClear(FGLContext *ctx, GLbitfield mode)
 		bool is32bpp = false;
 		uint32_t mask = 0;
 		uint32_t color = getFillColor(ctx, &mask, &is32bpp);
+		uint32_t pitch = stride * (is32bpp ? 4 : 2);
+
+		draw->markDirty(t * pitch, lines * pitch);
 
 		if (lineByLine) {
 			if (!is32bpp) {
@@ -790,6 +837,8 @@ static void fglClear(FGLContext *ctx, GLbitfield mode)
 		uint32_t mask;
 		uint32_t val = getFillDepth(ctx, &mask, mode);
 
+		depth->markDirty(t * stride * 4, lines * stride * 4);
+
 		if (lineByLine) {
 			uint32_t *buf32 = (uint32_t *)depth->vaddr;
 			buf32 += t * stride;
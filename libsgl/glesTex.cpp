@@ -24,11 +24,14 @@
 #include <errno.h>
 #include <pthread.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <cutils/log.h>
 #include <GLES/gl.h>
 #include <GLES/glext.h>
 #include "glesCommon.h"
 #include "fglobjectmanager.h"
+#include "fgltranscode.h"
+#include "fglmipmap.h"
 #include "libfimg/fimg.h"
 #include "s3c_g2d.h"
 
@@ -88,18 +91,28 @@ GL_API void GL_APIENTRY glDeleteTextures (GLsizei n, const GLuint *textures)
 void fglCleanTextureObjects(FGLContext *ctx)
 {
 	fglTextureObjects.clean(ctx);
+	fglReleaseResidentTextures(ctx);
 }
 
 GL_API void GL_APIENTRY glBindTexture (GLenum target, GLuint texture)
 {
-	if(target != GL_TEXTURE_2D) {
+	FGLTextureObjectBinding *binding;
+	FGLContext *ctx = getContext();
+
+	switch (target) {
+	case GL_TEXTURE_2D:
+		binding = &ctx->texture[ctx->activeTexture].binding;
+		break;
+	case GL_TEXTURE_CUBE_MAP_OES:
+		binding = &ctx->texture[ctx->activeTexture].cubeBinding;
+		break;
+	default:
 		setError(GL_INVALID_ENUM);
 		return;
 	}
 
 	if(texture == 0) {
-		FGLContext *ctx = getContext();
-		ctx->texture[ctx->activeTexture].binding.unbind();
+		binding->unbind();
 		return;
 	}
 
@@ -108,8 +121,6 @@ GL_API void GL_APIENTRY glBindTexture (GLenum target, GLuint texture)
 		return;
 	}
 
-	FGLContext *ctx = getContext();
-
 	FGLTextureObject *obj = fglTextureObjects[texture];
 	if(obj == NULL) {
 		obj = new FGLTextureObject(texture);
@@ -117,10 +128,57 @@ GL_API void GL_APIENTRY glBindTexture (GLenum target, GLuint texture)
 			setError(GL_OUT_OF_MEMORY);
 			return;
 		}
+		// Texture target is determined by the first binding
+		obj->object.target = target;
 		fglTextureObjects[texture] = obj;
 	}
 
-	obj->bind(&ctx->texture[ctx->activeTexture].binding);
+	if (obj->object.target != target) {
+		setError(GL_INVALID_OPERATION);
+		return;
+	}
+
+	obj->bind(binding);
+}
+
+/* Returns texture bound to given target of active texture unit */
+static FGLTexture *fglGetBoundTexture(FGLContext *ctx, GLenum target)
+{
+	switch (target) {
+	case GL_TEXTURE_2D:
+		return ctx->texture[ctx->activeTexture].getTexture();
+	case GL_TEXTURE_CUBE_MAP_OES:
+		return ctx->texture[ctx->activeTexture].getCubeTexture();
+	default:
+		return 0;
+	}
+}
+
+/* Returns texture holding image of given target and the face of image */
+static FGLTexture *fglGetImageTexture(FGLContext *ctx, GLenum target,
+							unsigned *face)
+{
+	if (target == GL_TEXTURE_2D) {
+		*face = 0;
+		return ctx->texture[ctx->activeTexture].getTexture();
+	}
+
+	if (target < GL_TEXTURE_CUBE_MAP_POSITIVE_X_OES
+	    || target > GL_TEXTURE_CUBE_MAP_NEGATIVE_Z_OES)
+		return 0;
+
+	*face = target - GL_TEXTURE_CUBE_MAP_POSITIVE_X_OES;
+	return ctx->texture[ctx->activeTexture].getCubeTexture();
+}
+
+/*
+ * Cube map faces are stored one after another, each with its complete
+ * mipmap chain, which is the layout expected by the texture unit.
+ */
+static inline size_t fglImageOffset(FGLTexture *obj, unsigned face,
+							unsigned level)
+{
+	return face*obj->faceSize + fimgGetTexMipmapOffset(obj->fimg, level);
 }
 
 static int fglGetFormatInfo(GLenum format, GLenum type,
@@ -182,163 +240,120 @@ static int fglGetFormatInfo(GLenum format, GLenum type,
 	}
 }
 
-static void fglGenerateMipmapsSW(FGLTexture *obj)
+static void fglGenerateMipmapsSW(FGLTexture *obj, unsigned face)
 {
  //FUNCTION_TRACER;
-	int level = 0;
-
-	int w = obj->width;
-	int h = obj->height;
-	if ((w&h) == 1)
-		return;
-
-	w = (w>>1) ? : 1;
-	h = (h>>1) ? : 1;
-
-	void *curLevel = obj->surface->vaddr;
-	void *nextLevel = (uint8_t *)obj->surface->vaddr
-				+ fimgGetTexMipmapOffset(obj->fimg, 1);
-
-	while(true) {
-		++level;
-		int stride = w;
-		int bs = w;
-
-		if (obj->fglFormat == FGTU_TSTA_TEXTURE_FORMAT_565) {
-			uint16_t const * src = (uint16_t const *)curLevel;
-			uint16_t* dst = (uint16_t*)nextLevel;
-			const uint32_t mask = 0x07E0F81F;
-			for (int y=0 ; y<h ; y++) {
-				size_t offset = (y*2) * bs;
-				for (int x=0 ; x<w ; x++) {
-					uint32_t p00 = src[offset];
-					uint32_t p10 = src[offset+1];
-					uint32_t p01 = src[offset+bs];
-					uint32_t p11 = src[offset+bs+1];
-					p00 = (p00 | (p00 << 16)) & mask;
-					p01 = (p01 | (p01 << 16)) & mask;
-					p10 = (p10 | (p10 << 16)) & mask;
-					p11 = (p11 | (p11 << 16)) & mask;
-					uint32_t grb = ((p00 + p10 + p01 + p11) >> 2) & mask;
-					uint32_t rgb = (grb & 0xFFFF) | (grb >> 16);
-					dst[x + y*stride] = rgb;
-					offset += 2;
-				}
-			}
-		} else if (obj->fglFormat == FGTU_TSTA_TEXTURE_FORMAT_1555) {
-			uint16_t const * src = (uint16_t const *)curLevel;
-			uint16_t* dst = (uint16_t*)nextLevel;
-			for (int y=0 ; y<h ; y++) {
-				size_t offset = (y*2) * bs;
-				for (int x=0 ; x<w ; x++) {
-					uint32_t p00 = src[offset];
-					uint32_t p10 = src[offset+1];
-					uint32_t p01 = src[offset+bs];
-					uint32_t p11 = src[offset+bs+1];
-					uint32_t r = ((p00>>11)+(p10>>11)+(p01>>11)+(p11>>11)+2)>>2;
-					uint32_t g = (((p00>>6)+(p10>>6)+(p01>>6)+(p11>>6)+2)>>2)&0x3F;
-					uint32_t b = ((p00&0x3E)+(p10&0x3E)+(p01&0x3E)+(p11&0x3E)+4)>>3;
-					uint32_t a = ((p00&1)+(p10&1)+(p01&1)+(p11&1)+2)>>2;
-					dst[x + y*stride] = (r<<11)|(g<<6)|(b<<1)|a;
-					offset += 2;
-				}
-			}
-		} else if (obj->fglFormat == FGTU_TSTA_TEXTURE_FORMAT_8888) {
-			uint32_t const * src = (uint32_t const *)curLevel;
-			uint32_t* dst = (uint32_t*)nextLevel;
-			for (int y=0 ; y<h ; y++) {
-				size_t offset = (y*2) * bs;
-				for (int x=0 ; x<w ; x++) {
-					uint32_t p00 = src[offset];
-					uint32_t p10 = src[offset+1];
-					uint32_t p01 = src[offset+bs];
-					uint32_t p11 = src[offset+bs+1];
-					uint32_t rb00 = p00 & 0x00FF00FF;
-					uint32_t rb01 = p01 & 0x00FF00FF;
-					uint32_t rb10 = p10 & 0x00FF00FF;
-					uint32_t rb11 = p11 & 0x00FF00FF;
-					uint32_t ga00 = (p00 >> 8) & 0x00FF00FF;
-					uint32_t ga01 = (p01 >> 8) & 0x00FF00FF;
-					uint32_t ga10 = (p10 >> 8) & 0x00FF00FF;
-					uint32_t ga11 = (p11 >> 8) & 0x00FF00FF;
-					uint32_t rb = (rb00 + rb01 + rb10 + rb11)>>2;
-					uint32_t ga = (ga00 + ga01 + ga10 + ga11)>>2;
-					uint32_t rgba = (rb & 0x00FF00FF) | ((ga & 0x00FF00FF)<<8);
-					dst[x + y*stride] = rgba;
-					offset += 2;
-				}
-			}
-		} else if ((obj->fglFormat == FGTU_TSTA_TEXTURE_FORMAT_88) ||
-		(obj->fglFormat == FGTU_TSTA_TEXTURE_FORMAT_8)) {
-			int skip;
-			switch (obj->fglFormat) {
-			case FGTU_TSTA_TEXTURE_FORMAT_88:	skip = 2;   break;
-			default:				skip = 1;   break;
-			}
-			uint8_t const * src = (uint8_t const *)curLevel;
-			uint8_t* dst = (uint8_t*)nextLevel;
-			bs *= skip;
-			stride *= skip;
-			for (int y=0 ; y<h ; y++) {
-				size_t offset = (y*2) * bs;
-				for (int x=0 ; x<w ; x++) {
-					for (int c=0 ; c<skip ; c++) {
-						uint32_t p00 = src[c+offset];
-						uint32_t p10 = src[c+offset+skip];
-						uint32_t p01 = src[c+offset+bs];
-						uint32_t p11 = src[c+offset+bs+skip];
-						dst[x + y*stride + c] = (p00 + p10 + p01 + p11) >> 2;
-					}
-					offset += 2*skip;
-				}
-			}
-		} else if (obj->fglFormat == FGTU_TSTA_TEXTURE_FORMAT_4444) {
-			uint16_t const * src = (uint16_t const *)curLevel;
-			uint16_t* dst = (uint16_t*)nextLevel;
-			for (int y=0 ; y<h ; y++) {
-				size_t offset = (y*2) * bs;
-				for (int x=0 ; x<w ; x++) {
-					uint32_t p00 = src[offset];
-					uint32_t p10 = src[offset+1];
-					uint32_t p01 = src[offset+bs];
-					uint32_t p11 = src[offset+bs+1];
-					p00 = ((p00 << 12) & 0x0F0F0000) | (p00 & 0x0F0F);
-					p10 = ((p10 << 12) & 0x0F0F0000) | (p10 & 0x0F0F);
-					p01 = ((p01 << 12) & 0x0F0F0000) | (p01 & 0x0F0F);
-					p11 = ((p11 << 12) & 0x0F0F0000) | (p11 & 0x0F0F);
-					uint32_t rbga = (p00 + p10 + p01 + p11) >> 2;
-					uint32_t rgba = (rbga & 0x0F0F) | ((rbga>>12) & 0xF0F0);
-					dst[x + y*stride] = rgba;
-					offset += 2;
-				}
-			}
-		} else {
+	unsigned w = obj->width;
+	unsigned h = obj->height;
+
+	for (int level = 1; (w | h) > 1; ++level) {
+		const void *curLevel = (uint8_t *)obj->surface->vaddr
+					+ fglImageOffset(obj, face, level - 1);
+		void *nextLevel = (uint8_t *)obj->surface->vaddr
+					+ fglImageOffset(obj, face, level);
+
+		if (!fglDownsampleImage(obj->fglFormat, curLevel,
+							w, h, nextLevel)) {
 			LOGE("Unsupported format (%d)", obj->fglFormat);
 			return;
 		}
 
-		// exit condition: we just processed the 1x1 LODs
-		if ((w&h) == 1)
-		break;
+		w = (w >> 1) ? : 1;
+		h = (h >> 1) ? : 1;
+	}
+}
+
+/**
+	G2D
+
+	The device is opened once per process, in nonblocking mode. Blits
+	are then started without waiting for completion and the driver
+	rejects new ones with EWOULDBLOCK until the previous one finishes.
+	Idle device is signalled by poll() as writable.
+*/
+
+/* Maximum time to wait for completion of single operation in ms */
+#define FGL_G2D_TIMEOUT		1000
+
+static pthread_once_t fglG2DOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t fglG2DMutex = PTHREAD_MUTEX_INITIALIZER;
+static int fglG2DDevice = -1;
+
+static void fglG2DInit(void)
+{
+	fglG2DDevice = open("/dev/s3c-g2d", O_RDWR | O_NONBLOCK, 0);
+	if (fglG2DDevice < 0)
+		LOGW("Failed to open G2D device. Falling back to software.");
+}
+
+/*
+ * Parameters like transformation are stored per file descriptor, so
+ * the device is used by one thread at a time. Returns descriptor of
+ * the device or -1 if it is not available.
+ */
+static int fglG2DLock(void)
+{
+	pthread_once(&fglG2DOnce, fglG2DInit);
+
+	if (fglG2DDevice < 0)
+		return -1;
+
+	pthread_mutex_lock(&fglG2DMutex);
+	return fglG2DDevice;
+}
+
+static inline void fglG2DUnlock(void)
+{
+	pthread_mutex_unlock(&fglG2DMutex);
+}
+
+/* Waits for the device to finish the last operation */
+static int fglG2DWait(int fd)
+{
+	struct pollfd pfd;
+	int ret;
+
+	pfd.fd = fd;
+	pfd.events = POLLOUT;
+
+	do {
+		ret = poll(&pfd, 1, FGL_G2D_TIMEOUT);
+	} while (ret < 0 && errno == EINTR);
+
+	if (ret <= 0) {
+		LOGW("Timeout while waiting for G2D operation.");
+		return -1;
+	}
 
-		w = (w>>1) ? : 1;
-		h = (h>>1) ? : 1;
+	return 0;
+}
 
-		curLevel = nextLevel;
-		nextLevel = (uint8_t *)obj->surface->vaddr
-				+ fimgGetTexMipmapOffset(obj->fimg, level + 1);
+/* Starts a blit, after the previous one if the device is busy */
+static int fglG2DBlit(int fd, struct s3c_g2d_req *req)
+{
+	while (ioctl(fd, S3C_G2D_BITBLT, req) < 0) {
+		if (errno != EWOULDBLOCK || fglG2DWait(fd))
+			return -1;
 	}
+
+	return 0;
 }
 
-static int fglGenerateMipmapsG2D(FGLTexture *obj, unsigned int format)
+static int fglGenerateMipmapsG2D(FGLTexture *obj, unsigned face,
+							unsigned int format)
 {
  //FUNCTION_TRACER;
 	int fd;
+	int ret = 0;
 	struct s3c_g2d_req req;
 
+	// Textures in system memory can not be accessed by G2D
+	if (!obj->surface->paddr)
+		return -1;
+
 	// Setup source image (level 0 image)
 	req.src.base	= obj->surface->paddr;
-	req.src.offs	= 0;
+	req.src.offs	= fglImageOffset(obj, face, 0);
 	req.src.w	= obj->width;
 	req.src.h	= obj->height;
 	req.src.l	= 0;
@@ -353,21 +368,24 @@ static int fglGenerateMipmapsG2D(FGLTexture *obj, unsigned int format)
 	req.dst.t	= 0;
 	req.dst.fmt	= format;
 
-	fd = open("/dev/s3c-g2d", O_RDWR, 0);
-	if (fd < 0) {
-		LOGW("Failed to open G2D device. Falling back to software.");
+	fd = fglG2DLock();
+	if (fd < 0)
 		return -1;
-	}
 
-	if (ioctl(fd, S3C_G2D_SET_BLENDING, G2D_NO_ALPHA) < 0) {
+	if (ioctl(fd, S3C_G2D_SET_BLENDING, G2D_NO_ALPHA) < 0
+	    || ioctl(fd, S3C_G2D_SET_TRANSFORM, G2D_ROT_0) < 0) {
 		LOGW("Failed to set G2D parameters. Falling back to software.");
-		close(fd);
+		fglG2DUnlock();
 		return -1;
 	}
 
+	// Level 0 has been just written by the CPU and marked dirty by caller
+	obj->surface->flush();
+
 	unsigned width = obj->width;
 	unsigned height = obj->height;
 
+	// All levels are read from level 0, so they can be queued at once
 	for (int lvl = 1; lvl <= obj->maxLevel; lvl++) {
 		if (width > 1)
 			width /= 2;
@@ -375,45 +393,49 @@ static int fglGenerateMipmapsG2D(FGLTexture *obj, unsigned int format)
 		if (height > 1)
 			height /= 2;
 
-		req.dst.offs	= fimgGetTexMipmapOffset(obj->fimg, lvl);
+		req.dst.offs	= fglImageOffset(obj, face, lvl);
 		req.dst.w	= width;
 		req.dst.h	= height;
 		req.dst.r	= width - 1;
 		req.dst.b	= height - 1;
 
-		if (ioctl(fd, S3C_G2D_BITBLT, &req) < 0) {
+		if (fglG2DBlit(fd, &req) < 0) {
 			LOGW("Failed to perform G2D blit operation. "
 			     "Falling back to software.");
-			close(fd);
-			return -1;
+			ret = -1;
+			break;
 		}
 	}
 
-	close(fd);
-	return 0;
+	// Blits already started have to finish before anything else
+	if (fglG2DWait(fd) < 0)
+		ret = -1;
+
+	fglG2DUnlock();
+	return ret;
 }
 
-static void fglGenerateMipmaps(FGLTexture *obj)
+static void fglGenerateMipmaps(FGLTexture *obj, unsigned face)
 {
  //FUNCTION_TRACER;
 	/* Handle cases supported by G2D hardware */
 	switch (obj->fglFormat) {
 	case FGTU_TSTA_TEXTURE_FORMAT_565:
-		if(fglGenerateMipmapsG2D(obj, G2D_RGB16))
+		if(fglGenerateMipmapsG2D(obj, face, G2D_RGB16))
 			break;
 		return;
 	case FGTU_TSTA_TEXTURE_FORMAT_1555:
-		if(fglGenerateMipmapsG2D(obj, G2D_RGBA16))
+		if(fglGenerateMipmapsG2D(obj, face, G2D_RGBA16))
 			break;
 		return;
 	case FGTU_TSTA_TEXTURE_FORMAT_8888:
-		if(fglGenerateMipmapsG2D(obj, G2D_ARGB32))
+		if(fglGenerateMipmapsG2D(obj, face, G2D_ARGB32))
 			break;
 		return;
 	}
 
 	/* Handle other cases (including G2D failure) */
-	fglGenerateMipmapsSW(obj);
+	fglGenerateMipmapsSW(obj, face);
 }
 
 static size_t fglCalculateMipmaps(FGLTexture *obj, unsigned int width,
@@ -455,11 +477,11 @@ static size_t fglCalculateMipmaps(FGLTexture *obj, unsigned int width,
 	return offset;
 }
 
-static void fglLoadTextureDirect(FGLTexture *obj, unsigned level,
-						const GLvoid *pixels)
+static void fglLoadTextureDirect(FGLTexture *obj, unsigned face,
+				unsigned level, const GLvoid *pixels)
 {
  //FUNCTION_TRACER;
-	unsigned offset = fimgGetTexMipmapOffset(obj->fimg, level);
+	unsigned offset = fglImageOffset(obj, face, level);
 
 	unsigned width = obj->width >> level;
 	if (!width)
@@ -474,11 +496,11 @@ static void fglLoadTextureDirect(FGLTexture *obj, unsigned level,
 	memcpy((uint8_t *)obj->surface->vaddr + offset, pixels, size);
 }
 
-static void fglLoadTexture(FGLTexture *obj, unsigned level,
+static void fglLoadTexture(FGLTexture *obj, unsigned face, unsigned level,
 		    const GLvoid *pixels, unsigned alignment)
 {
  //FUNCTION_TRACER;
-	unsigned offset = fimgGetTexMipmapOffset(obj->fimg, level);
+	unsigned offset = fglImageOffset(obj, face, level);
 
 	unsigned width = obj->width >> level;
 	if (!width)
@@ -511,11 +533,11 @@ static inline uint16_t fglPackLA88(uint8_t l, uint8_t a)
 	return (l << 8) | a;
 }
 
-static void fglConvertTexture(FGLTexture *obj, unsigned level,
+static void fglConvertTexture(FGLTexture *obj, unsigned face, unsigned level,
 			const GLvoid *pixels, unsigned alignment)
 {
  //FUNCTION_TRACER;
-	unsigned offset = fimgGetTexMipmapOffset(obj->fimg, level);
+	unsigned offset = fglImageOffset(obj, face, level);
 
 	unsigned width = obj->width >> level;
 	if (!width)
@@ -580,14 +602,329 @@ static void fglConvertTexture(FGLTexture *obj, unsigned level,
 	}
 }
 
-static inline void fglWaitForTexture(FGLContext *ctx, FGLTexture *tex)
+static inline bool fglTextureBusy(FGLContext *ctx, FGLTexture *tex)
 {
-	for (int i = 0; i < FGL_MAX_TEXTURE_UNITS; ++i) {
-		if (ctx->busyTexture[i] == tex) {
-			glFlush();
-			break;
+	for (int i = 0; i < FGL_MAX_TEXTURE_UNITS; ++i)
+		if (ctx->busyTexture[i] == tex)
+			return true;
+
+	return false;
+}
+
+/**
+	Texture residency
+
+	Textures in local (pmem) memory are kept on a list of the context
+	which allocated their storage, ordered by use. When local memory
+	runs out, least recently used textures of the context, which were
+	not used in current frame, are moved to system memory. They are
+	moved back when used for rendering again. Textures of other contexts
+	are never evicted, as their threads might be writing to them.
+*/
+
+static pthread_mutex_t fglResidencyMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void fglLinkTexture(FGLContext *ctx, FGLTexture *tex)
+{
+	tex->lruPrev = ctx->residentLast;
+	tex->lruNext = 0;
+	if (ctx->residentLast)
+		ctx->residentLast->lruNext = tex;
+	else
+		ctx->residentFirst = tex;
+	ctx->residentLast = tex;
+	tex->lruContext = ctx;
+}
+
+static void fglUnlinkTexture(FGLTexture *tex)
+{
+	FGLContext *ctx = tex->lruContext;
+
+	if (!ctx)
+		return;
+
+	if (tex->lruPrev)
+		tex->lruPrev->lruNext = tex->lruNext;
+	else
+		ctx->residentFirst = tex->lruNext;
+
+	if (tex->lruNext)
+		tex->lruNext->lruPrev = tex->lruPrev;
+	else
+		ctx->residentLast = tex->lruPrev;
+
+	tex->lruContext = 0;
+}
+
+void fglUnregisterTexture(FGLTexture *tex)
+{
+	pthread_mutex_lock(&fglResidencyMutex);
+	fglUnlinkTexture(tex);
+	pthread_mutex_unlock(&fglResidencyMutex);
+}
+
+void fglAdvanceTextureFrame(FGLContext *ctx)
+{
+	pthread_mutex_lock(&fglResidencyMutex);
+	++ctx->textureFrame;
+	pthread_mutex_unlock(&fglResidencyMutex);
+}
+
+/*
+ * Forgets shared textures left on the list of destroyed context. They are
+ * picked up again by the next context using them.
+ */
+void fglReleaseResidentTextures(FGLContext *ctx)
+{
+	pthread_mutex_lock(&fglResidencyMutex);
+	while (ctx->residentFirst)
+		fglUnlinkTexture(ctx->residentFirst);
+	pthread_mutex_unlock(&fglResidencyMutex);
+}
+
+static inline bool fglTextureEvictable(FGLContext *ctx, FGLTexture *tex)
+{
+	// Textures rendered to or used in this frame must stay in place
+	return tex->surface && tex->lastUsed != ctx->textureFrame
+		&& !tex->hasAttachments();
+}
+
+/* Only textures with storage in local memory are on residency lists */
+static inline FGLLocalSurface *fglLocalSurface(FGLTexture *tex)
+{
+	return static_cast<FGLLocalSurface *>(tex->surface);
+}
+
+/* Moves texture to system memory */
+static bool fglEvictTexture(FGLTexture *tex)
+{
+	FGLSurface *sys = new FGLSystemSurface(tex->surface->size);
+	if (!sys || !sys->isValid()) {
+		delete sys;
+		return false;
+	}
+
+	memcpy(sys->vaddr, tex->surface->vaddr, tex->surface->size);
+	delete tex->surface;
+	tex->surface = sys;
+	tex->local = false;
+	tex->evicted = true;
+	fglUnlinkTexture(tex);
+	return true;
+}
+
+/*
+ * Evicts least recently used textures of given context to make room for
+ * surface of given size. Freed pmem only returns to the device as whole
+ * chunks, so textures are evicted only if that leaves a free range big
+ * enough for the surface or empties their chunk.
+ */
+static bool fglEvictTextures(FGLContext *ctx, unsigned long size)
+{
+	FGLTexture *tex, *next;
+	bool ret = false;
+
+	size = FGLPmemAllocator::roundSize(size);
+
+	pthread_mutex_lock(&fglResidencyMutex);
+
+	for (tex = ctx->residentFirst; tex; tex = tex->lruNext) {
+		if (fglTextureEvictable(ctx, tex)
+		    && fglLocalSurface(tex)->getFreeSpan() >= size) {
+			ret = fglEvictTexture(tex);
+			goto out;
+		}
+	}
+
+	for (tex = ctx->residentFirst; tex; tex = tex->lruNext) {
+		if (!fglTextureEvictable(ctx, tex))
+			continue;
+
+		// Earlier textures of this chunk can not be evicted
+		FGLLocalSurface *surface = fglLocalSurface(tex);
+		FGLPmemChunk *chunk = surface->getChunk();
+		unsigned long evictable = 0;
+
+		for (next = tex; next; next = next->lruNext)
+			if (fglTextureEvictable(ctx, next)
+			    && fglLocalSurface(next)->getChunk() == chunk)
+				evictable += fglLocalSurface(next)->getBlockSize();
+
+		// Chunk holds surfaces of other contexts or framebuffers
+		if (evictable != surface->getChunkUsed())
+			continue;
+
+		for (; tex; tex = next) {
+			next = tex->lruNext;
+			if (fglTextureEvictable(ctx, tex)
+			    && fglLocalSurface(tex)->getChunk() == chunk
+			    && fglEvictTexture(tex))
+				ret = true;
 		}
+		break;
+	}
+
+out:
+	pthread_mutex_unlock(&fglResidencyMutex);
+
+	return ret;
+}
+
+/* Allocates local memory for texture, evicting other textures if needed */
+static FGLSurface *fglAllocTextureSurface(FGLContext *ctx, FGLTexture *tex,
+							unsigned long size)
+{
+	FGLSurface *surface;
+
+	fglUnregisterTexture(tex);
+
+	do {
+		surface = new FGLLocalSurface(size);
+		if (surface && surface->isValid())
+			break;
+
+		delete surface;
+		surface = 0;
+	} while (fglEvictTextures(ctx, size));
+
+	if (!surface)
+		return 0;
+
+	pthread_mutex_lock(&fglResidencyMutex);
+	tex->local = true;
+	tex->evicted = false;
+	tex->lastUsed = ctx->textureFrame;
+	fglLinkTexture(ctx, tex);
+	pthread_mutex_unlock(&fglResidencyMutex);
+
+	return surface;
+}
+
+bool fglMakeTextureResident(FGLContext *ctx, FGLTexture *tex)
+{
+	if (unlikely(tex->evicted)) {
+		FGLSurface *sys = tex->surface;
+		FGLSurface *surface = fglAllocTextureSurface(ctx, tex,
+								sys->size);
+		if (!surface)
+			return false;
+
+		memcpy(surface->vaddr, sys->vaddr, sys->size);
+		delete sys;
+		tex->surface = surface;
+		fimgSetTexBaseAddr(tex->fimg, surface->paddr);
+		tex->dirty = true;
+		return true;
+	}
+
+	if (!tex->local)
+		return true;
+
+	// Also picks up textures left by destroyed contexts
+	pthread_mutex_lock(&fglResidencyMutex);
+	tex->lastUsed = ctx->textureFrame;
+	if (tex->lruContext != ctx || tex != ctx->residentLast) {
+		fglUnlinkTexture(tex);
+		fglLinkTexture(ctx, tex);
+	}
+	pthread_mutex_unlock(&fglResidencyMutex);
+
+	return true;
+}
+
+/**
+	Texture renaming
+
+	Writing to a texture still used by queued rendering would require
+	waiting for the hardware. Instead, the texture gets new storage and
+	the old one is retired until the hardware is done with it, which is
+	known for sure after glFinish.
+*/
+
+void fglReleaseRetiredSurfaces(FGLContext *ctx)
+{
+	while (ctx->numRetiredSurfaces)
+		delete ctx->retiredSurface[--ctx->numRetiredSurfaces];
+}
+
+static void fglRetireSurface(FGLContext *ctx, FGLSurface *surface)
+{
+	// Too much memory waiting for the hardware
+	if (ctx->numRetiredSurfaces == FGL_MAX_RETIRED_SURFACES)
+		glFinish();
+
+	ctx->retiredSurface[ctx->numRetiredSurfaces++] = surface;
+}
+
+static void fglClearTextureBusy(FGLContext *ctx, FGLTexture *tex)
+{
+	for (int i = 0; i < FGL_MAX_TEXTURE_UNITS; ++i)
+		if (ctx->busyTexture[i] == tex)
+			ctx->busyTexture[i] = 0;
+}
+
+/* Drops texture storage, without waiting for rendering using it */
+static void fglReleaseTextureSurface(FGLContext *ctx, FGLTexture *tex)
+{
+	if (tex->surface && fglTextureBusy(ctx, tex)) {
+		fglRetireSurface(ctx, tex->surface);
+		fglClearTextureBusy(ctx, tex);
+	} else {
+		delete tex->surface;
+	}
+
+	tex->surface = 0;
+	tex->local = false;
+	fglUnregisterTexture(tex);
+}
+
+/*
+ * Makes texture storage safe for writing by the CPU. Contents of levels
+ * not listed in levelMask are copied to the new storage. Storage shared
+ * with EGL images or framebuffers can not be replaced, so we wait then.
+ */
+static void fglPrepareTextureWrite(FGLContext *ctx, FGLTexture *tex,
+					unsigned face, unsigned levelMask)
+{
+	// Take over the texture, so other contexts do not evict it
+	pthread_mutex_lock(&fglResidencyMutex);
+	if (tex->local && tex->lruContext != ctx) {
+		fglUnlinkTexture(tex);
+		fglLinkTexture(ctx, tex);
+		tex->lastUsed = ctx->textureFrame;
 	}
+	pthread_mutex_unlock(&fglResidencyMutex);
+
+	if (!tex->surface || !fglTextureBusy(ctx, tex))
+		return;
+
+	if (tex->eglImage || tex->evicted || tex->hasAttachments()) {
+		glFinish();
+		return;
+	}
+
+	FGLSurface *surface = fglAllocTextureSurface(ctx, tex,
+							tex->surface->size);
+	if (!surface) {
+		// Keep the old storage tracked
+		pthread_mutex_lock(&fglResidencyMutex);
+		fglLinkTexture(ctx, tex);
+		pthread_mutex_unlock(&fglResidencyMutex);
+		glFinish();
+		return;
+	}
+
+	if (tex->getFaces() > 1 || (tex->levels[face] & ~levelMask)) {
+		memcpy(surface->vaddr, tex->surface->vaddr, surface->size);
+		surface->markDirty();
+	}
+
+	fglRetireSurface(ctx, tex->surface);
+	fglClearTextureBusy(ctx, tex);
+
+	tex->surface = surface;
+	fimgSetTexBaseAddr(tex->fimg, surface->paddr);
+	tex->dirty = true;
 }
 
 GL_API void GL_APIENTRY glTexImage2D (GLenum target, GLint level,
@@ -596,11 +933,6 @@ GL_API void GL_APIENTRY glTexImage2D (GLenum target, GLint level,
 {
  //FUNCTION_TRACER;
 	// Check conditions required by specification
-	if (target != GL_TEXTURE_2D) {
-		setError(GL_INVALID_ENUM);
-		return;
-	}
-
 	if (level < 0) {
 		setError(GL_INVALID_VALUE);
 		return;
@@ -617,12 +949,22 @@ GL_API void GL_APIENTRY glTexImage2D (GLenum target, GLint level,
 	}
 
 	FGLContext *ctx = getContext();
-	FGLTexture *obj =
-		ctx->texture[ctx->activeTexture].getTexture();
+	unsigned face;
+	FGLTexture *obj = fglGetImageTexture(ctx, target, &face);
+	if (!obj) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	// Cube map faces must be square
+	if (obj->target == GL_TEXTURE_CUBE_MAP_OES && width != height) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
 
 	if (!width || !height) {
 		// Null texture specified
-		obj->levels &= ~(1 << level);
+		obj->levels[face] &= ~(1 << level);
 		return;
 	}
 
@@ -660,20 +1002,22 @@ GL_API void GL_APIENTRY glTexImage2D (GLenum target, GLint level,
 
 		// Copy the image (with conversion if needed)
 		if (pixels != NULL) {
-			fglWaitForTexture(ctx, obj);
+			fglPrepareTextureWrite(ctx, obj, face, 1 << level);
 
 			if (obj->convert) {
-				fglConvertTexture(obj, level, pixels,
+				fglConvertTexture(obj, face, level, pixels,
 							ctx->unpackAlignment);
 			} else {
 				if (ctx->unpackAlignment <= obj->bpp)
-					fglLoadTextureDirect(obj, level, pixels);
+					fglLoadTextureDirect(obj, face, level,
+									pixels);
 				else
-					fglLoadTexture(obj, level, pixels,
+					fglLoadTexture(obj, face, level, pixels,
 						       ctx->unpackAlignment);
 			}
 
-			obj->levels |= (1 << level);
+			obj->levels[face] |= (1 << level);
+			obj->surface->markDirty();
 			obj->dirty = true;
 		}
 
@@ -712,12 +1056,15 @@ GL_API void GL_APIENTRY glTexImage2D (GLenum target, GLint level,
 		return;
 	}
 
-	fglWaitForTexture(ctx, obj);
-
 	// Level 0 with different size or bpp means dropping whole texture
-	if (width != obj->width || height != obj->height || bpp != obj->bpp) {
-		delete obj->surface;
-		obj->surface = 0;
+	if (width != obj->width || height != obj->height || bpp != obj->bpp
+	    || obj->compressed) {
+		fglReleaseTextureSurface(ctx, obj);
+	} else if (pixels != NULL) {
+		unsigned levelMask = 1 << 0;
+		if (obj->genMipmap)
+			levelMask = (1 << (obj->maxLevel + 1)) - 1;
+		fglPrepareTextureWrite(ctx, obj, face, levelMask);
 	}
 
 	// (Re)allocate the texture
@@ -734,15 +1081,16 @@ GL_API void GL_APIENTRY glTexImage2D (GLenum target, GLint level,
 		obj->type = type;
 		obj->fglFormat = fglFormat;
 		obj->convert = convert;
+		obj->compressed = GL_FALSE;
+		obj->paletteSize = 0;
 
 		// Calculate mipmaps
-		unsigned size = fglCalculateMipmaps(obj, width, height, bpp);
+		obj->faceSize = fglCalculateMipmaps(obj, width, height, bpp);
 
 		// Setup surface
-		obj->surface = new FGLLocalSurface(size);
-		if(!obj->surface || !obj->surface->isValid()) {
-			delete obj->surface;
-			obj->surface = 0;
+		obj->surface = fglAllocTextureSurface(ctx, obj,
+					obj->getFaces()*obj->faceSize);
+		if(!obj->surface) {
 			setError(GL_OUT_OF_MEMORY);
 			return;
 		}
@@ -750,40 +1098,52 @@ GL_API void GL_APIENTRY glTexImage2D (GLenum target, GLint level,
 		fimgInitTexture(obj->fimg, obj->fglFormat, obj->maxLevel,
 							obj->surface->paddr);
 		fimgSetTex2DSize(obj->fimg, width, height);
+		if (obj->target == GL_TEXTURE_CUBE_MAP_OES)
+			fimgSetTexType(obj->fimg, FGTU_TSTA_TYPE_CUBE);
+		else
+			fimgSetTexType(obj->fimg, FGTU_TSTA_TYPE_2D);
 
-		obj->levels = (1 << 0);
+		for (int i = 0; i < FGL_CUBE_FACES; ++i)
+			obj->levels[i] = 0;
 		obj->dirty = true;
 		obj->eglImage = 0;
 
 		obj->changed();
 	}
 
+	obj->levels[face] |= (1 << 0);
+
 	// Copy the image (with conversion if needed)
 	if (pixels != NULL) {
 		if (obj->convert) {
-			fglConvertTexture(obj, level, pixels,
+			fglConvertTexture(obj, face, level, pixels,
 						ctx->unpackAlignment);
 		} else {
 			if (ctx->unpackAlignment <= bpp)
-				fglLoadTextureDirect(obj, level, pixels);
+				fglLoadTextureDirect(obj, face, level, pixels);
 			else
-				fglLoadTexture(obj, level, pixels,
+				fglLoadTexture(obj, face, level, pixels,
 						ctx->unpackAlignment);
 		}
 
-		if (obj->genMipmap)
-			fglGenerateMipmaps(obj);
+		// Mipmap generation flushes what is marked
+		obj->surface->markDirty();
+
+		if (obj->genMipmap) {
+			fglGenerateMipmaps(obj, face);
+			obj->levels[face] = (1 << (obj->maxLevel + 1)) - 1;
+		}
 
 		obj->dirty = true;
 	}
 }
 
-static void fglLoadTexturePartial(FGLTexture *obj, unsigned level,
-			const GLvoid *pixels, unsigned alignment,
+static void fglLoadTexturePartial(FGLTexture *obj, unsigned face,
+			unsigned level, const GLvoid *pixels, unsigned alignment,
 			unsigned x, unsigned y, unsigned w, unsigned h)
 {
  //FUNCTION_TRACER;
-	unsigned offset = fimgGetTexMipmapOffset(obj->fimg, level);
+	unsigned offset = fglImageOffset(obj, face, level);
 
 	unsigned width = obj->width >> level;
 	if (!width)
@@ -807,12 +1167,12 @@ static void fglLoadTexturePartial(FGLTexture *obj, unsigned level,
 	} while (--h);
 }
 
-static void fglConvertTexturePartial(FGLTexture *obj, unsigned level,
-			const GLvoid *pixels, unsigned alignment,
+static void fglConvertTexturePartial(FGLTexture *obj, unsigned face,
+			unsigned level, const GLvoid *pixels, unsigned alignment,
 			unsigned x, unsigned y, unsigned w, unsigned h)
 {
  //FUNCTION_TRACER;
-	unsigned offset = fimgGetTexMipmapOffset(obj->fimg, level);
+	unsigned offset = fglImageOffset(obj, face, level);
 
 	unsigned width = obj->width >> level;
 	if (!width)
@@ -869,127 +1229,1038 @@ static void fglConvertTexturePartial(FGLTexture *obj, unsigned level,
 		} while (--h);
 		break;
 	}
-	case GL_LUMINANCE: {
-		size_t line = w;
-		size_t srcStride = (line + alignment - 1) & ~(alignment - 1);
-		size_t dstStride = 2*width;
-		size_t xOffset = 2*x;
-		size_t yOffset = y*dstStride;
-		size_t srcPad = srcStride - line;
-		size_t dstPad = width - w;
-		const uint8_t *src8 = (const uint8_t *)pixels;
-		uint16_t *dst16 = (uint16_t *)((uint8_t *)obj->surface->vaddr
-						+ offset + yOffset + xOffset);
+	case GL_LUMINANCE: {
+		size_t line = w;
+		size_t srcStride = (line + alignment - 1) & ~(alignment - 1);
+		size_t dstStride = 2*width;
+		size_t xOffset = 2*x;
+		size_t yOffset = y*dstStride;
+		size_t srcPad = srcStride - line;
+		size_t dstPad = width - w;
+		const uint8_t *src8 = (const uint8_t *)pixels;
+		uint16_t *dst16 = (uint16_t *)((uint8_t *)obj->surface->vaddr
+						+ offset + yOffset + xOffset);
+		do {
+			unsigned x = w;
+			do {
+				*(dst16++) = fglPackLA88(*(src8++), 255);
+			} while (--x);
+			src8 += srcPad;
+			dst16 += dstPad;
+		} while (--h);
+		break;
+	}
+	default:
+		LOGW("Unsupported texture conversion %d", obj->format);
+		return;
+	}
+}
+
+GL_API void GL_APIENTRY glTexSubImage2D (GLenum target, GLint level,
+		GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+		GLenum format, GLenum type, const GLvoid *pixels)
+{
+ //FUNCTION_TRACER;
+	FGLContext *ctx = getContext();
+	unsigned face;
+	FGLTexture *obj = fglGetImageTexture(ctx, target, &face);
+	if (!obj) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	if (!obj->surface || obj->compressed) {
+		setError(GL_INVALID_OPERATION);
+		return;
+	}
+
+	if (level > obj->maxLevel) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	GLint mipmapW, mipmapH;
+
+	mipmapW = obj->width >> level;
+	if (!mipmapW)
+		mipmapW = 1;
+
+	mipmapH = obj->height >> level;
+	if (!mipmapH)
+		mipmapH = 1;
+
+	//LOGD("glTexSubImage2D: x = %d, y = %d, w = %d, h = %d",
+	//				xoffset, yoffset, width, height);
+
+	if (!xoffset && !yoffset && mipmapW == width && mipmapH == height) {
+		glTexImage2D(target, level, format, width, height,
+						0, format, type, pixels);
+		return;
+	}
+
+	if (format != obj->format || type != obj->type) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	if (xoffset < 0 || yoffset < 0) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	if (xoffset + width > mipmapW || yoffset + height > mipmapH) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	if (!pixels)
+		return;
+
+	fglPrepareTextureWrite(ctx, obj, face, 0);
+
+	if (obj->convert)
+		fglConvertTexturePartial(obj, face, level, pixels,
+			ctx->unpackAlignment, xoffset, yoffset, width, height);
+	else
+		fglLoadTexturePartial(obj, face, level, pixels,
+			ctx->unpackAlignment, xoffset, yoffset, width, height);
+
+	// Only lines touched by the update need cache maintenance
+	size_t pitch = mipmapW * obj->bpp;
+	obj->surface->markDirty(fglImageOffset(obj, face, level)
+					+ yoffset*pitch, height*pitch);
+	obj->dirty = true;
+}
+
+/* Size of image of given compressed format */
+static size_t fglCompressedImageSize(GLenum format,
+					unsigned width, unsigned height)
+{
+	switch (format) {
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_ETC1_RGB8_OES:
+		/* 4x4 pixel blocks of 8 bytes */
+		return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+	case GL_PALETTE4_RGB8_OES:
+	case GL_PALETTE4_RGBA8_OES:
+	case GL_PALETTE4_R5_G6_B5_OES:
+	case GL_PALETTE4_RGBA4_OES:
+	case GL_PALETTE4_RGB5_A1_OES:
+		/* Indices only, two pixels per byte */
+		return (width * height + 1) / 2;
+	case GL_PALETTE8_RGB8_OES:
+	case GL_PALETTE8_RGBA8_OES:
+	case GL_PALETTE8_R5_G6_B5_OES:
+	case GL_PALETTE8_RGBA4_OES:
+	case GL_PALETTE8_RGB5_A1_OES:
+		/* Indices only */
+		return width * height;
+	default:
+		return 0;
+	}
+}
+
+static size_t fglCalculateCompressedMipmaps(FGLTexture *obj,
+					unsigned int width, unsigned int height)
+{
+	size_t offset;
+	unsigned int lvl, check;
+
+	offset = 0;
+	check = max(width, height);
+	lvl = 0;
+
+	do {
+		fimgSetTexMipmapOffset(obj->fimg, lvl, offset);
+		offset += fglCompressedImageSize(obj->format, width, height);
+
+		if(lvl == FGL_MAX_MIPMAP_LEVEL)
+			break;
+
+		check /= 2;
+		if(check == 0)
+			break;
+
+		++lvl;
+
+		if (width >= 2)
+			width /= 2;
+
+		if (height >= 2)
+			height /= 2;
+	} while (1);
+
+	obj->maxLevel = lvl;
+	return offset;
+}
+
+/* Prepares storage of compressed texture for level 0 of given size */
+static bool fglAllocCompressedTexture(FGLContext *ctx, FGLTexture *obj,
+		GLenum format, int fglFormat, GLint width, GLint height)
+{
+	// Level 0 with different size or format means dropping whole texture
+	if (width != obj->width || height != obj->height
+	    || !obj->compressed || format != obj->format)
+		fglReleaseTextureSurface(ctx, obj);
+
+	if (obj->surface)
+		return true;
+
+	obj->width = width;
+	obj->height = height;
+	// Compressed textures can not be rendered to
+	obj->attachmentMask = 0;
+	obj->bpp = 0;
+	obj->swap = 0;
+
+	obj->format = format;
+	obj->type = GL_UNSIGNED_BYTE;
+	obj->fglFormat = fglFormat;
+	obj->convert = 0;
+	obj->compressed = GL_TRUE;
+	obj->paletteSize = 0;
+
+	// Calculate mipmaps
+	obj->faceSize = fglCalculateCompressedMipmaps(obj, width, height);
+
+	// Setup surface
+	obj->surface = fglAllocTextureSurface(ctx, obj,
+					obj->getFaces()*obj->faceSize);
+	if(!obj->surface) {
+		setError(GL_OUT_OF_MEMORY);
+		return false;
+	}
+
+	fimgInitTexture(obj->fimg, obj->fglFormat, obj->maxLevel,
+						obj->surface->paddr);
+	fimgSetTex2DSize(obj->fimg, width, height);
+	if (obj->target == GL_TEXTURE_CUBE_MAP_OES)
+		fimgSetTexType(obj->fimg, FGTU_TSTA_TYPE_CUBE);
+	else
+		fimgSetTexType(obj->fimg, FGTU_TSTA_TYPE_2D);
+
+	for (int i = 0; i < FGL_CUBE_FACES; ++i)
+		obj->levels[i] = 0;
+	obj->dirty = true;
+	obj->eglImage = 0;
+
+	obj->changed();
+	return true;
+}
+
+static int fglGetPaletteInfo(GLenum format, unsigned *bits,
+					unsigned *entrySize, unsigned *palFormat)
+{
+	switch (format) {
+	case GL_PALETTE4_RGB8_OES:
+	case GL_PALETTE4_RGBA8_OES:
+	case GL_PALETTE4_R5_G6_B5_OES:
+	case GL_PALETTE4_RGBA4_OES:
+	case GL_PALETTE4_RGB5_A1_OES:
+		*bits = 4;
+		break;
+	case GL_PALETTE8_RGB8_OES:
+	case GL_PALETTE8_RGBA8_OES:
+	case GL_PALETTE8_R5_G6_B5_OES:
+	case GL_PALETTE8_RGBA4_OES:
+	case GL_PALETTE8_RGB5_A1_OES:
+		*bits = 8;
+		break;
+	default:
+		return -1;
+	}
+
+	switch (format) {
+	case GL_PALETTE4_RGB8_OES:
+	case GL_PALETTE8_RGB8_OES:
+		*entrySize = 3;
+		*palFormat = FGTU_TSTA_PAL_TEX_FORMAT_8888;
+		break;
+	case GL_PALETTE4_RGBA8_OES:
+	case GL_PALETTE8_RGBA8_OES:
+		*entrySize = 4;
+		*palFormat = FGTU_TSTA_PAL_TEX_FORMAT_8888;
+		break;
+	case GL_PALETTE4_R5_G6_B5_OES:
+	case GL_PALETTE8_R5_G6_B5_OES:
+		*entrySize = 2;
+		*palFormat = FGTU_TSTA_PAL_TEX_FORMAT_565;
+		break;
+	case GL_PALETTE4_RGBA4_OES:
+	case GL_PALETTE8_RGBA4_OES:
+		*entrySize = 2;
+		*palFormat = FGTU_TSTA_PAL_TEX_FORMAT_4444;
+		break;
+	default:
+		*entrySize = 2;
+		*palFormat = FGTU_TSTA_PAL_TEX_FORMAT_1555;
+		break;
+	}
+
+	if (*bits == 4)
+		return FGTU_TSTA_TEXTURE_FORMAT_4BPP;
+
+	return FGTU_TSTA_TEXTURE_FORMAT_8BPP;
+}
+
+/* Converts palette entries to format expected by hardware */
+static void fglLoadPalette(FGLTexture *obj, const uint8_t *src8,
+					unsigned count, unsigned entrySize)
+{
+	uint32_t *dst32 = obj->palette;
+
+	switch (entrySize) {
+	case 3:
+		do {
+			*(dst32++) = fglPackRGBA8888(src8[0],
+						src8[1], src8[2], 255);
+			src8 += 3;
+		} while (--count);
+		break;
+	case 4:
+		do {
+			*(dst32++) = fglPackRGBA8888(src8[0],
+						src8[1], src8[2], src8[3]);
+			src8 += 4;
+		} while (--count);
+		break;
+	default:
+		do {
+			*(dst32++) = src8[0] | (src8[1] << 8);
+			src8 += 2;
+		} while (--count);
+	}
+}
+
+/* Stores image of non-paletted compressed texture */
+static void fglLoadCompressedImage(FGLTexture *obj, unsigned face,
+		unsigned level, const GLvoid *data, unsigned width,
+		unsigned height, size_t size)
+{
+	uint8_t *dst8 = (uint8_t *)obj->surface->vaddr
+					+ fglImageOffset(obj, face, level);
+
+	// ETC1 is not supported by hardware, DXT1 has the same block layout
+	if (obj->format == GL_ETC1_RGB8_OES) {
+		fglTranscodeETC1(dst8, data, width, height);
+		return;
+	}
+
+	// Other formats are stored as is
+	memcpy(dst8, data, size);
+}
+
+/*
+ * Paletted textures are stored as indices and sampled through the
+ * hardware palette. Negative level gives the number of mipmaps
+ * following level 0 in the data.
+ */
+static void fglCompressedPalettedTexImage2D(FGLContext *ctx,
+		FGLTexture *obj, unsigned face, GLint level, GLenum format,
+		GLsizei width, GLsizei height, GLsizei imageSize,
+		const GLvoid *data)
+{
+	unsigned bits, entrySize, palFormat;
+	int fglFormat = fglGetPaletteInfo(format, &bits,
+						&entrySize, &palFormat);
+
+	if (level > 0 || level < -FGL_MAX_MIPMAP_LEVEL) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	unsigned count = 1 << bits;
+	unsigned levels = 1 - level;
+	size_t size = count * entrySize;
+	unsigned w = width;
+	unsigned h = height;
+
+	for (unsigned i = 0; i < levels; ++i) {
+		size += fglCompressedImageSize(format, w, h);
+		if (w == 1 && h == 1 && i + 1 < levels) {
+			// More mipmaps than the texture can have
+			setError(GL_INVALID_VALUE);
+			return;
+		}
+		w = (w >> 1) ? : 1;
+		h = (h >> 1) ? : 1;
+	}
+
+	if (imageSize < 0 || (size_t)imageSize != size) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	if (!width || !height) {
+		// Null texture specified
+		obj->levels[face] &= ~(1 << 0);
+		return;
+	}
+
+	if (!fglAllocCompressedTexture(ctx, obj, format, fglFormat,
+							width, height))
+		return;
+
+	fimgSetTexPaletteFormat(obj->fimg, palFormat);
+	obj->levels[face] |= (1 << levels) - 1;
+
+	if (data == NULL)
+		return;
+
+	fglPrepareTextureWrite(ctx, obj, face, (1 << levels) - 1);
+
+	if (!obj->palette) {
+		obj->palette = new uint32_t[FIMG_PALETTE_SIZE];
+		if (!obj->palette) {
+			setError(GL_OUT_OF_MEMORY);
+			return;
+		}
+	}
+
+	const uint8_t *src8 = (const uint8_t *)data;
+	fglLoadPalette(obj, src8, count, entrySize);
+	obj->paletteSize = count;
+	src8 += count * entrySize;
+
+	// Indices are stored as is
+	w = width;
+	h = height;
+	for (unsigned i = 0; i < levels; ++i) {
+		size_t len = fglCompressedImageSize(format, w, h);
+		memcpy((uint8_t *)obj->surface->vaddr
+				+ fglImageOffset(obj, face, i), src8, len);
+		src8 += len;
+		w = (w >> 1) ? : 1;
+		h = (h >> 1) ? : 1;
+	}
+
+	obj->surface->markDirty();
+	obj->dirty = true;
+}
+
+GL_API void GL_APIENTRY glCompressedTexImage2D (GLenum target, GLint level,
+		GLenum internalformat, GLsizei width, GLsizei height,
+		GLint border, GLsizei imageSize, const GLvoid *data)
+{
+	// Check conditions required by specification
+	if (border != 0) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	if (width < 0 || height < 0 || width > FGL_MAX_TEXTURE_SIZE
+	    || height > FGL_MAX_TEXTURE_SIZE) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+	unsigned face;
+	FGLTexture *obj = fglGetImageTexture(ctx, target, &face);
+	if (!obj) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	// Cube map faces must be square
+	if (obj->target == GL_TEXTURE_CUBE_MAP_OES && width != height) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	int fglFormat;
+
+	switch (internalformat) {
+	case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+	case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+	case GL_ETC1_RGB8_OES:
+		fglFormat = FGTU_TSTA_TEXTURE_FORMAT_S3TC;
+		break;
+	case GL_PALETTE4_RGB8_OES:
+	case GL_PALETTE4_RGBA8_OES:
+	case GL_PALETTE4_R5_G6_B5_OES:
+	case GL_PALETTE4_RGBA4_OES:
+	case GL_PALETTE4_RGB5_A1_OES:
+	case GL_PALETTE8_RGB8_OES:
+	case GL_PALETTE8_RGBA8_OES:
+	case GL_PALETTE8_R5_G6_B5_OES:
+	case GL_PALETTE8_RGBA4_OES:
+	case GL_PALETTE8_RGB5_A1_OES:
+		fglCompressedPalettedTexImage2D(ctx, obj, face, level,
+			internalformat, width, height, imageSize, data);
+		return;
+	default:
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	if (level < 0 || level > FGL_MAX_MIPMAP_LEVEL) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	size_t size = fglCompressedImageSize(internalformat, width, height);
+	if (imageSize < 0 || (size_t)imageSize != size) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	if (!width || !height) {
+		// Null texture specified
+		obj->levels[face] &= ~(1 << level);
+		return;
+	}
+
+	// Specifying mipmaps
+	if (level > 0) {
+		GLint mipmapW, mipmapH;
+
+		if (!obj->surface || !obj->compressed
+		    || obj->format != internalformat) {
+			// Mipmaps can be specified only if the texture exists
+			setError(GL_INVALID_OPERATION);
+			return;
+		}
+
+		mipmapW = obj->width >> level;
+		if (!mipmapW)
+			mipmapW = 1;
+
+		mipmapH = obj->height >> level;
+		if (!mipmapH)
+			mipmapH = 1;
+
+		// Check dimensions
+		if (mipmapW != width || mipmapH != height) {
+			// Invalid size
+			setError(GL_INVALID_VALUE);
+			return;
+		}
+
+		if (data != NULL) {
+			fglPrepareTextureWrite(ctx, obj, face, 1 << level);
+			fglLoadCompressedImage(obj, face, level, data,
+							width, height, size);
+			obj->levels[face] |= (1 << level);
+			obj->surface->markDirty();
+			obj->dirty = true;
+		}
+
+		return;
+	}
+
+	// level == 0
+
+	if (!fglAllocCompressedTexture(ctx, obj, internalformat, fglFormat,
+							width, height))
+		return;
+
+	obj->levels[face] |= (1 << 0);
+
+	if (data != NULL) {
+		fglPrepareTextureWrite(ctx, obj, face, 1 << 0);
+		fglLoadCompressedImage(obj, face, 0, data,
+						width, height, size);
+		obj->surface->markDirty();
+		obj->dirty = true;
+	}
+}
+
+GL_API void GL_APIENTRY glCompressedTexSubImage2D (GLenum target, GLint level,
+		GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
+		GLenum format, GLsizei imageSize, const GLvoid *data)
+{
+	FGLContext *ctx = getContext();
+	unsigned face;
+	FGLTexture *obj = fglGetImageTexture(ctx, target, &face);
+	if (!obj) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	// Paletted and ETC1 textures can not be partially updated
+	if (!obj->surface || !obj->compressed || format != obj->format
+	    || obj->paletteSize || format == GL_ETC1_RGB8_OES) {
+		setError(GL_INVALID_OPERATION);
+		return;
+	}
+
+	if (level < 0 || level > obj->maxLevel) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	GLint mipmapW, mipmapH;
+
+	mipmapW = obj->width >> level;
+	if (!mipmapW)
+		mipmapW = 1;
+
+	mipmapH = obj->height >> level;
+	if (!mipmapH)
+		mipmapH = 1;
+
+	if (xoffset < 0 || yoffset < 0 || width < 0 || height < 0) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	if (xoffset + width > mipmapW || yoffset + height > mipmapH) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	// Only whole blocks can be replaced
+	if ((xoffset % 4) || (yoffset % 4)
+	    || ((width % 4) && xoffset + width != mipmapW)
+	    || ((height % 4) && yoffset + height != mipmapH)) {
+		setError(GL_INVALID_OPERATION);
+		return;
+	}
+
+	if (imageSize < 0 || (size_t)imageSize
+			!= fglCompressedImageSize(format, width, height)) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	if (!data || !width || !height)
+		return;
+
+	fglPrepareTextureWrite(ctx, obj, face, 0);
+
+	size_t srcStride = fglCompressedImageSize(format, width, 4);
+	size_t dstStride = fglCompressedImageSize(format, mipmapW, 4);
+	unsigned rows = (height + 3) / 4;
+	const uint8_t *src8 = (const uint8_t *)data;
+	unsigned long offset = fglImageOffset(obj, face, level)
+						+ (yoffset / 4)*dstStride;
+	uint8_t *dst8 = (uint8_t *)obj->surface->vaddr + offset
+				+ fglCompressedImageSize(format, xoffset, 4);
+
+	obj->surface->markDirty(offset, rows*dstStride);
+	do {
+		memcpy(dst8, src8, srcStride);
+		src8 += srcStride;
+		dst8 += dstStride;
+	} while (--rows);
+
+	obj->dirty = true;
+}
+
+/**
+	Copying from color buffer
+*/
+
+/* Texture storage uses the same layout as the color buffer */
+static inline bool fglMatchesColorBuffer(FGLContext *ctx, FGLTexture *obj)
+{
+	return (obj->attachmentMask & FGL_COLOR0_ATTACHABLE)
+			&& obj->fglFbFormat == ctx->surface.format;
+}
+
+static int fglG2DColorFormat(unsigned fbFormat)
+{
+	switch (fbFormat) {
+	case FGPF_COLOR_MODE_565:
+		return G2D_RGB16;
+	case FGPF_COLOR_MODE_1555:
+		return G2D_ARGB16;
+	default:
+		return -1;
+	}
+}
+
+static int fglG2DTextureFormat(FGLTexture *obj)
+{
+	switch (obj->fglFormat) {
+	case FGTU_TSTA_TEXTURE_FORMAT_565:
+		return G2D_RGB16;
+	case FGTU_TSTA_TEXTURE_FORMAT_1555:
+		return G2D_RGBA16;
+	case FGTU_TSTA_TEXTURE_FORMAT_8888:
+		// Only converted (GL_RGB) textures are packed as words
+		if (!obj->swap)
+			return G2D_RGBA32;
+	default:
+		return -1;
+	}
+}
+
+static bool fglCopyTextureG2D(FGLContext *ctx, FGLTexture *obj,
+		unsigned face, unsigned level, unsigned xoffset,
+		unsigned yoffset, unsigned x, unsigned y,
+		unsigned width, unsigned height)
+{
+	FGLSurface *draw = ctx->surface.draw;
+	struct s3c_g2d_req req;
+	int srcFormat, dstFormat;
+	int fd;
+
+	// Textures in system memory can not be accessed by G2D
+	if (!draw->paddr || !obj->surface->paddr)
+		return false;
+
+	if (fglMatchesColorBuffer(ctx, obj)) {
+		// Plain copy, any format of the same size will do
+		srcFormat = (obj->bpp == 4) ? G2D_ARGB32 : G2D_RGB16;
+		dstFormat = srcFormat;
+	} else {
+		srcFormat = fglG2DColorFormat(ctx->surface.format);
+		dstFormat = fglG2DTextureFormat(obj);
+		if (srcFormat < 0 || dstFormat < 0)
+			return false;
+	}
+
+	unsigned mipmapW = (obj->width >> level) ? : 1;
+	unsigned mipmapH = (obj->height >> level) ? : 1;
+
+	// Color buffer lines are stored top-down
+	req.src.base	= draw->paddr;
+	req.src.offs	= 0;
+	req.src.w	= ctx->surface.stride;
+	req.src.h	= ctx->surface.height;
+	req.src.l	= x;
+	req.src.t	= ctx->surface.height - y - height;
+	req.src.r	= x + width - 1;
+	req.src.b	= ctx->surface.height - y - 1;
+	req.src.fmt	= srcFormat;
+
+	req.dst.base	= obj->surface->paddr;
+	req.dst.offs	= fglImageOffset(obj, face, level);
+	req.dst.w	= mipmapW;
+	req.dst.h	= mipmapH;
+	req.dst.l	= xoffset;
+	req.dst.t	= yoffset;
+	req.dst.r	= xoffset + width - 1;
+	req.dst.b	= yoffset + height - 1;
+	req.dst.fmt	= dstFormat;
+
+	fd = fglG2DLock();
+	if (fd < 0)
+		return false;
+
+	if (ioctl(fd, S3C_G2D_SET_BLENDING, G2D_NO_ALPHA) < 0
+	    || ioctl(fd, S3C_G2D_SET_TRANSFORM, G2D_ROT_FLIP_X) < 0) {
+		LOGW("Failed to set G2D parameters. Falling back to software.");
+		fglG2DUnlock();
+		return false;
+	}
+
+	// Dirty cache lines must not overwrite results of the blit later
+	draw->flush();
+	obj->surface->flush();
+
+	if (fglG2DBlit(fd, &req) < 0 || fglG2DWait(fd) < 0) {
+		LOGW("Failed to perform G2D blit operation. "
+		     "Falling back to software.");
+		fglG2DUnlock();
+		return false;
+	}
+
+	fglG2DUnlock();
+	return true;
+}
+
+/*
+ * Packs RGBA8888 pixels in place to given external format. Returns size
+ * of packed pixel.
+ */
+static unsigned fglPackPixels(uint8_t *buf, unsigned count,
+					GLenum format, GLenum type)
+{
+	const uint8_t *src8 = buf;
+	uint8_t *dst8 = buf;
+	uint16_t *dst16 = (uint16_t *)buf;
+
+	switch (type) {
+	case GL_UNSIGNED_BYTE:
+		switch (format) {
+		case GL_RGB:
+			do {
+				dst8[0] = src8[0];
+				dst8[1] = src8[1];
+				dst8[2] = src8[2];
+				dst8 += 3;
+				src8 += 4;
+			} while (--count);
+			return 3;
+		case GL_ALPHA:
+			do {
+				*(dst8++) = src8[3];
+				src8 += 4;
+			} while (--count);
+			return 1;
+		case GL_LUMINANCE:
+			do {
+				*(dst8++) = src8[0];
+				src8 += 4;
+			} while (--count);
+			return 1;
+		case GL_LUMINANCE_ALPHA:
+			do {
+				dst8[0] = src8[0];
+				dst8[1] = src8[3];
+				dst8 += 2;
+				src8 += 4;
+			} while (--count);
+			return 2;
+		}
+		return 4;
+	case GL_UNSIGNED_SHORT_5_6_5:
+		do {
+			*(dst16++) = ((src8[0] & 0xf8) << 8)
+					| ((src8[1] & 0xfc) << 3)
+					| (src8[2] >> 3);
+			src8 += 4;
+		} while (--count);
+		return 2;
+	case GL_UNSIGNED_SHORT_4_4_4_4:
+		do {
+			*(dst16++) = ((src8[0] & 0xf0) << 8)
+					| ((src8[1] & 0xf0) << 4)
+					| (src8[2] & 0xf0) | (src8[3] >> 4);
+			src8 += 4;
+		} while (--count);
+		return 2;
+	case GL_UNSIGNED_SHORT_5_5_5_1:
+		do {
+			*(dst16++) = ((src8[0] & 0xf8) << 8)
+					| ((src8[1] & 0xf8) << 3)
+					| ((src8[2] & 0xf8) >> 2) | (src8[3] >> 7);
+			src8 += 4;
+		} while (--count);
+		return 2;
+	}
+
+	return 4;
+}
+
+static void fglCopyTextureSW(FGLContext *ctx, FGLTexture *obj,
+		unsigned face, unsigned level, unsigned xoffset,
+		unsigned yoffset, unsigned x, unsigned y,
+		unsigned width, unsigned height)
+{
+	FGLSurface *draw = ctx->surface.draw;
+	unsigned mipmapW = (obj->width >> level) ? : 1;
+
+	draw->flush();
+
+	if (fglMatchesColorBuffer(ctx, obj)) {
+		size_t dstStride = mipmapW*obj->bpp;
+		size_t srcStride = ctx->surface.stride*obj->bpp;
+		uint8_t *dst8 = (uint8_t *)obj->surface->vaddr
+			+ fglImageOffset(obj, face, level)
+			+ yoffset*dstStride + xoffset*obj->bpp;
+		const uint8_t *src8 = (const uint8_t *)draw->vaddr
+			+ (ctx->surface.height - y - 1)*srcStride
+			+ x*obj->bpp;
+		unsigned h = height;
+
 		do {
-			unsigned x = w;
-			do {
-				*(dst16++) = fglPackLA88(*(src8++), 255);
-			} while (--x);
-			src8 += srcPad;
-			dst16 += dstPad;
+			memcpy(dst8, src8, width*obj->bpp);
+			dst8 += dstStride;
+			src8 -= srcStride;
 		} while (--h);
-		break;
-	}
-	default:
-		LOGW("Unsupported texture conversion %d", obj->format);
-		return;
+	} else {
+		// Convert through external format of the texture
+		uint8_t *pixels = (uint8_t *)malloc(4*width*height);
+		if (!pixels) {
+			setError(GL_OUT_OF_MEMORY);
+			return;
+		}
+
+		uint8_t *line = pixels;
+		for (unsigned i = 0; i < height; ++i) {
+			fglReadColorLine(ctx, line, x, y + i, width);
+			line += width*fglPackPixels(line, width,
+						obj->format, obj->type);
+		}
+
+		if (obj->convert)
+			fglConvertTexturePartial(obj, face, level, pixels,
+					1, xoffset, yoffset, width, height);
+		else
+			fglLoadTexturePartial(obj, face, level, pixels,
+					1, xoffset, yoffset, width, height);
+
+		free(pixels);
 	}
+
+	size_t pitch = mipmapW*obj->bpp;
+	obj->surface->markDirty(fglImageOffset(obj, face, level)
+					+ yoffset*pitch, height*pitch);
 }
 
-GL_API void GL_APIENTRY glTexSubImage2D (GLenum target, GLint level,
-		GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
-		GLenum format, GLenum type, const GLvoid *pixels)
+static void fglCopyTexture(FGLContext *ctx, FGLTexture *obj,
+		unsigned face, unsigned level, GLint xoffset, GLint yoffset,
+		GLint x, GLint y, GLsizei width, GLsizei height)
 {
- //FUNCTION_TRACER;
-	FGLContext *ctx = getContext();
-	FGLTexture *obj =
-		ctx->texture[ctx->activeTexture].getTexture();
+	// Pixels outside the color buffer are undefined, so just skip them
+	if (x < 0) {
+		xoffset -= x;
+		width += x;
+		x = 0;
+	}
 
-	if (!obj->surface) {
-		setError(GL_INVALID_OPERATION);
-		return;
+	if (y < 0) {
+		yoffset -= y;
+		height += y;
+		y = 0;
 	}
 
-	if (level > obj->maxLevel) {
-		setError(GL_INVALID_VALUE);
+	if (x + width > (GLint)ctx->surface.width)
+		width = ctx->surface.width - x;
+
+	if (y + height > (GLint)ctx->surface.height)
+		height = ctx->surface.height - y;
+
+	if (width <= 0 || height <= 0)
 		return;
-	}
 
-	GLint mipmapW, mipmapH;
+	if (!fglCopyTextureG2D(ctx, obj, face, level, xoffset, yoffset,
+						x, y, width, height))
+		fglCopyTextureSW(ctx, obj, face, level, xoffset, yoffset,
+						x, y, width, height);
 
-	mipmapW = obj->width >> level;
-	if (!mipmapW)
-		mipmapW = 1;
+	obj->levels[face] |= (1 << level);
 
-	mipmapH = obj->height >> level;
-	if (!mipmapH)
-		mipmapH = 1;
+	if (!level && obj->genMipmap) {
+		obj->surface->markDirty();
+		fglGenerateMipmaps(obj, face);
+		obj->levels[face] = (1 << (obj->maxLevel + 1)) - 1;
+	}
 
-	//LOGD("glTexSubImage2D: x = %d, y = %d, w = %d, h = %d",
-	//				xoffset, yoffset, width, height);
+	obj->dirty = true;
+}
 
-	if (!xoffset && !yoffset && mipmapW == width && mipmapH == height) {
-		glTexImage2D(target, level, format, width, height,
-						0, format, type, pixels);
-		return;
+/* Checks if color buffer is complete and has channels of given format */
+static bool fglCheckCopySource(FGLContext *ctx, GLenum format)
+{
+	if (!ctx->framebuffer.isComplete()) {
+		setError(GL_INVALID_FRAMEBUFFER_OPERATION_OES);
+		return false;
 	}
 
-	if (format != obj->format || type != obj->type) {
+	if (!ctx->surface.draw || !ctx->surface.draw->vaddr) {
+		setError(GL_INVALID_OPERATION);
+		return false;
+	}
+
+	switch (format) {
+	case GL_ALPHA:
+	case GL_LUMINANCE_ALPHA:
+	case GL_RGBA:
+		if (!fglColorConfigs[ctx->surface.format].alpha) {
+			setError(GL_INVALID_OPERATION);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+GL_API void GL_APIENTRY glCopyTexImage2D (GLenum target, GLint level,
+		GLenum internalformat, GLint x, GLint y, GLsizei width,
+		GLsizei height, GLint border)
+{
+	FGLContext *ctx = getContext();
+	unsigned face;
+	FGLTexture *obj = fglGetImageTexture(ctx, target, &face);
+	if (!obj) {
 		setError(GL_INVALID_ENUM);
 		return;
 	}
 
-	if (xoffset < 0 || yoffset < 0) {
+	if (level < 0 || level > FGL_MAX_MIPMAP_LEVEL || border != 0
+	    || width < 0 || height < 0) {
 		setError(GL_INVALID_VALUE);
 		return;
 	}
 
-	if (xoffset + width > mipmapW || yoffset + height > mipmapH) {
+	GLenum type = GL_UNSIGNED_BYTE;
+
+	switch (internalformat) {
+	case GL_RGB:
+		if (ctx->surface.format == FGPF_COLOR_MODE_565)
+			type = GL_UNSIGNED_SHORT_5_6_5;
+		break;
+	case GL_RGBA:
+		if (ctx->surface.format == FGPF_COLOR_MODE_4444)
+			type = GL_UNSIGNED_SHORT_4_4_4_4;
+		else if (ctx->surface.format == FGPF_COLOR_MODE_1555)
+			type = GL_UNSIGNED_SHORT_5_5_5_1;
+		break;
+	case GL_ALPHA:
+	case GL_LUMINANCE:
+	case GL_LUMINANCE_ALPHA:
+		break;
+	default:
 		setError(GL_INVALID_VALUE);
 		return;
 	}
 
-	if (!pixels)
+	if (!fglCheckCopySource(ctx, internalformat))
 		return;
 
-	fglWaitForTexture(ctx, obj);
-
-	if (obj->convert)
-		fglConvertTexturePartial(obj, level, pixels,
-			ctx->unpackAlignment, xoffset, yoffset, width, height);
-	else
-		fglLoadTexturePartial(obj, level, pixels,
-			ctx->unpackAlignment, xoffset, yoffset, width, height);
-
-	obj->dirty = true;
-}
+	// Rendering to the color buffer has to be finished
+	glFinish();
 
-GL_API void GL_APIENTRY glCompressedTexImage2D (GLenum target, GLint level,
-		GLenum internalformat, GLsizei width, GLsizei height,
-		GLint border, GLsizei imageSize, const GLvoid *data)
-{
-	FUNC_UNIMPLEMENTED;
-}
+	// Storage of the texture is (re)specified as by glTexImage2D
+	glTexImage2D(target, level, internalformat, width, height, 0,
+						internalformat, type, NULL);
 
-GL_API void GL_APIENTRY glCompressedTexSubImage2D (GLenum target, GLint level,
-		GLint xoffset, GLint yoffset, GLsizei width, GLsizei height,
-		GLenum format, GLsizei imageSize, const GLvoid *data)
-{
-	FUNC_UNIMPLEMENTED;
-}
+	if (!width || !height || !obj->surface || obj->compressed
+	    || obj->format != internalformat || obj->type != type
+	    || level > obj->maxLevel)
+		return;
 
-GL_API void GL_APIENTRY glCopyTexImage2D (GLenum target, GLint level,
-		GLenum internalformat, GLint x, GLint y, GLsizei width,
-		GLsizei height, GLint border)
-{
-	FUNC_UNIMPLEMENTED;
+	fglCopyTexture(ctx, obj, face, level, 0, 0, x, y, width, height);
 }
 
 GL_API void GL_APIENTRY glCopyTexSubImage2D (GLenum target, GLint level,
 		GLint xoffset, GLint yoffset, GLint x, GLint y, GLsizei width,
 		GLsizei height)
 {
-	FUNC_UNIMPLEMENTED;
+	FGLContext *ctx = getContext();
+	unsigned face;
+	FGLTexture *obj = fglGetImageTexture(ctx, target, &face);
+	if (!obj) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	if (!obj->surface || obj->compressed) {
+		setError(GL_INVALID_OPERATION);
+		return;
+	}
+
+	if (level < 0 || level > obj->maxLevel) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	GLint mipmapW = (obj->width >> level) ? : 1;
+	GLint mipmapH = (obj->height >> level) ? : 1;
+
+	if (xoffset < 0 || yoffset < 0 || width < 0 || height < 0
+	    || xoffset + width > mipmapW || yoffset + height > mipmapH) {
+		setError(GL_INVALID_VALUE);
+		return;
+	}
+
+	if (!fglCheckCopySource(ctx, obj->format))
+		return;
+
+	if (!width || !height)
+		return;
+
+	// Rendering to the color buffer and from the texture has to be finished
+	glFinish();
+
+	fglCopyTexture(ctx, obj, face, level, xoffset, yoffset,
+						x, y, width, height);
 }
 
 GL_API void GL_APIENTRY glEGLImageTargetTexture2DOES (GLenum target, GLeglImageOES image)
@@ -1067,12 +2338,33 @@ GL_API void GL_APIENTRY glEGLImageTargetTexture2DOES (GLenum target, GLeglImageO
 		fglFormat = FGTU_TSTA_TEXTURE_FORMAT_4444;
 		bpp = 2;
 		break;
+	/*
+	 * Hardware YUV formats are named from MSB to LSB of 32-bit word,
+	 * so Y0 U Y1 V byte order is VY1UY0 and U Y0 V Y1 is Y1VY0U.
+	 * The texture unit converts to RGB when sampling.
+	 */
+	case HAL_PIXEL_FORMAT_YCbCr_422_I:
+		format = GL_RGB;
+		type = GL_UNSIGNED_BYTE;
+		fglFormat = FGTU_TSTA_TEXTURE_FORMAT_VY1UY0;
+		bpp = 2;
+		break;
+	case HAL_PIXEL_FORMAT_CbYCrY_422_I:
+		format = GL_RGB;
+		type = GL_UNSIGNED_BYTE;
+		fglFormat = FGTU_TSTA_TEXTURE_FORMAT_Y1VY0U;
+		bpp = 2;
+		break;
 	default:
 		setError(GL_INVALID_VALUE);
 		return;
 	}
 
-	delete tex->surface;
+	// Image surfaces are not managed by residency
+	fglUnregisterTexture(tex);
+	tex->evicted = false;
+
+	fglReleaseTextureSurface(ctx, tex);
 	tex->surface = new FGLImageSurface(image);
 	if (!tex->surface || !tex->surface->isValid()) {
 		delete tex->surface;
@@ -1087,8 +2379,10 @@ GL_API void GL_APIENTRY glEGLImageTargetTexture2DOES (GLenum target, GLeglImageO
 	tex->fglFormat	= fglFormat;
 	tex->bpp	= bpp;
 	tex->convert	= 0;
+	tex->compressed	= GL_FALSE;
+	tex->paletteSize = 0;
 	tex->maxLevel	= 0;
-	tex->levels	= (1 << 0);
+	tex->levels[0]	= (1 << 0);
 	tex->dirty	= true;
 	tex->width	= native_buffer->stride;
 	tex->height	= native_buffer->height;
@@ -1109,15 +2403,13 @@ GL_API void GL_APIENTRY glEGLImageTargetRenderbufferStorageOES (GLenum target, G
 
 GL_API void GL_APIENTRY glTexParameteri (GLenum target, GLenum pname, GLint param)
 {
-	if(target != GL_TEXTURE_2D) {
+	FGLContext *ctx = getContext();
+	FGLTexture *obj = fglGetBoundTexture(ctx, target);
+	if (!obj) {
 		setError(GL_INVALID_ENUM);
 		return;
 	}
 
-	FGLContext *ctx = getContext();
-	FGLTexture *obj =
-		ctx->texture[ctx->activeTexture].getTexture();
-
 	switch (pname) {
 	case GL_TEXTURE_WRAP_S:
 		obj->sWrap = param;
@@ -1207,15 +2499,13 @@ GL_API void GL_APIENTRY glTexParameteri (GLenum target, GLenum pname, GLint para
 GL_API void GL_APIENTRY glTexParameteriv (GLenum target, GLenum pname,
 							const GLint *params)
 {
-	if(target != GL_TEXTURE_2D) {
+	FGLContext *ctx = getContext();
+	FGLTexture *obj = fglGetBoundTexture(ctx, target);
+	if (!obj) {
 		setError(GL_INVALID_ENUM);
 		return;
 	}
 
-	FGLContext *ctx = getContext();
-	FGLTexture *obj =
-		ctx->texture[ctx->activeTexture].getTexture();
-
 	switch (pname) {
 	case GL_TEXTURE_CROP_RECT_OES:
 		memcpy(obj->cropRect, params, 4*sizeof(GLint));
@@ -1249,8 +2539,25 @@ GL_API void GL_APIENTRY glTexParameterxv (GLenum target, GLenum pname,
 	glTexParameteri(target, pname, *params);
 }
 
+static void fglPointSpriteEnvi(GLenum pname, GLint param)
+{
+	if (pname != GL_COORD_REPLACE_OES) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+
+	ctx->point.coordReplace[ctx->activeTexture] = !!param;
+}
+
 GL_API void GL_APIENTRY glTexEnvi (GLenum target, GLenum pname, GLint param)
 {
+	if (target == GL_POINT_SPRITE_OES) {
+		fglPointSpriteEnvi(pname, param);
+		return;
+	}
+
 	if (target != GL_TEXTURE_ENV) {
 		setError(GL_INVALID_ENUM);
 		return;
@@ -1620,6 +2927,11 @@ GL_API void GL_APIENTRY glTexEnvi (GLenum target, GLenum pname, GLint param)
 GL_API void GL_APIENTRY glTexEnvfv (GLenum target, GLenum pname,
 							const GLfloat *params)
 {
+	if (target == GL_POINT_SPRITE_OES) {
+		fglPointSpriteEnvi(pname, (GLint)params[0]);
+		return;
+	}
+
 	if (target != GL_TEXTURE_ENV) {
 		setError(GL_INVALID_ENUM);
 		return;
@@ -1640,6 +2952,11 @@ GL_API void GL_APIENTRY glTexEnvfv (GLenum target, GLenum pname,
 
 GL_API void GL_APIENTRY glTexEnvf (GLenum target, GLenum pname, GLfloat param)
 {
+	if (target == GL_POINT_SPRITE_OES) {
+		fglPointSpriteEnvi(pname, (GLint)param);
+		return;
+	}
+
 	if (target != GL_TEXTURE_ENV) {
 		setError(GL_INVALID_ENUM);
 		return;
@@ -1670,6 +2987,11 @@ GL_API void GL_APIENTRY glTexEnvf (GLenum target, GLenum pname, GLfloat param)
 
 GL_API void GL_APIENTRY glTexEnvx (GLenum target, GLenum pname, GLfixed param)
 {
+	if (target == GL_POINT_SPRITE_OES) {
+		fglPointSpriteEnvi(pname, param);
+		return;
+	}
+
 	if (target != GL_TEXTURE_ENV) {
 		setError(GL_INVALID_ENUM);
 		return;
@@ -1701,6 +3023,11 @@ GL_API void GL_APIENTRY glTexEnvx (GLenum target, GLenum pname, GLfixed param)
 GL_API void GL_APIENTRY glTexEnviv (GLenum target, GLenum pname,
 							const GLint *params)
 {
+	if (target == GL_POINT_SPRITE_OES) {
+		fglPointSpriteEnvi(pname, params[0]);
+		return;
+	}
+
 	if (target != GL_TEXTURE_ENV) {
 		setError(GL_INVALID_ENUM);
 		return;
@@ -1723,6 +3050,11 @@ GL_API void GL_APIENTRY glTexEnviv (GLenum target, GLenum pname,
 GL_API void GL_APIENTRY glTexEnvxv (GLenum target, GLenum pname,
 							const GLfixed *params)
 {
+	if (target == GL_POINT_SPRITE_OES) {
+		fglPointSpriteEnvi(pname, params[0]);
+		return;
+	}
+
 	if (target != GL_TEXTURE_ENV) {
 		setError(GL_INVALID_ENUM);
 		return;
@@ -1757,6 +3089,105 @@ GL_API void GL_APIENTRY glGetTexEnvxv (GLenum env, GLenum pname, GLfixed *params
 	FUNC_UNIMPLEMENTED;
 }
 
+GL_API void GL_APIENTRY glTexGeniOES (GLenum coord, GLenum pname, GLint param)
+{
+	if (coord != GL_TEXTURE_GEN_STR_OES) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	if (pname != GL_TEXTURE_GEN_MODE_OES) {
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	switch (param) {
+	case GL_NORMAL_MAP_OES:
+	case GL_REFLECTION_MAP_OES:
+		break;
+	default:
+		setError(GL_INVALID_ENUM);
+		return;
+	}
+
+	FGLContext *ctx = getContext();
+
+	ctx->texture[ctx->activeTexture].texGenMode = param;
+}
+
+GL_API void GL_APIENTRY glTexGenivOES (GLenum coord, GLenum pname,
+							const GLint *params)
+{
+	glTexGeniOES(coord, pname, *params);
+}
+
+GL_API void GL_APIENTRY glTexGenfOES (GLenum coord, GLenum pname, GLfloat param)
+{
+	glTexGeniOES(coord, pname, (GLint)param);
+}
+
+GL_API void GL_APIENTRY glTexGenfvOES (GLenum coord, GLenum pname,
+							const GLfloat *params)
+{
+	glTexGeniOES(coord, pname, (GLint)*params);
+}
+
+GL_API void GL_APIENTRY glTexGenxOES (GLenum coord, GLenum pname, GLfixed param)
+{
+	glTexGeniOES(coord, pname, param);
+}
+
+GL_API void GL_APIENTRY glTexGenxvOES (GLenum coord, GLenum pname,
+							const GLfixed *params)
+{
+	glTexGeniOES(coord, pname, *params);
+}
+
+static bool fglGetTexGen(GLenum coord, GLenum pname, GLint *param)
+{
+	if (coord != GL_TEXTURE_GEN_STR_OES) {
+		setError(GL_INVALID_ENUM);
+		return false;
+	}
+
+	if (pname != GL_TEXTURE_GEN_MODE_OES) {
+		setError(GL_INVALID_ENUM);
+		return false;
+	}
+
+	FGLContext *ctx = getContext();
+
+	*param = ctx->texture[ctx->activeTexture].texGenMode;
+	return true;
+}
+
+GL_API void GL_APIENTRY glGetTexGenivOES (GLenum coord, GLenum pname,
+								GLint *params)
+{
+	GLint param;
+
+	if (fglGetTexGen(coord, pname, &param))
+		params[0] = param;
+}
+
+GL_API void GL_APIENTRY glGetTexGenfvOES (GLenum coord, GLenum pname,
+								GLfloat *params)
+{
+	GLint param;
+
+	if (fglGetTexGen(coord, pname, &param))
+		params[0] = param;
+}
+
+GL_API void GL_APIENTRY glGetTexGenxvOES (GLenum coord, GLenum pname,
+								GLfixed *params)
+{
+	GLint param;
+
+	if (fglGetTexGen(coord, pname, &param))
+		params[0] = param;
+}
+
 GL_API void GL_APIENTRY glGetTexParameterfv (GLenum target, GLenum pname,
 								GLfloat *params)
 {
@@ -1,4 +1,51 @@
 LOCAL_PATH := $(call my-dir)
+
+#
+# Build the shader block assembler (host tool)
+#
+# Regenerate headers with:
+#	fimgasm -o shaders/vert.h shaders/vert.asm
+#	fimgasm -o shaders/frag.h shaders/frag.asm
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS += -Wall -Wno-unused-parameter -O2
+
+LOCAL_SRC_FILES := shaders/fimgasm.c
+
+LOCAL_MODULE := fimgasm
+include $(BUILD_HOST_EXECUTABLE)
+
+FIMGASM := $(LOCAL_INSTALLED_MODULE)
+
+#
+# Check that checked-in shader headers match their sources
+#
+# Run alone with:
+#	make fimg-shaders-check
+#
+
+FIMG_SHADERS_CHECKED := \
+	$(call intermediates-dir-for,STATIC_LIBRARIES,libfimg)/shaders.checked
+
+$(FIMG_SHADERS_CHECKED): PRIVATE_PATH := $(LOCAL_PATH)/shaders
+$(FIMG_SHADERS_CHECKED): PRIVATE_FIMGASM := $(FIMGASM)
+$(FIMG_SHADERS_CHECKED): $(FIMGASM) \
+		$(addprefix $(LOCAL_PATH)/shaders/, vert.asm vert.h frag.asm frag.h)
+	@echo "Check shaders: $(PRIVATE_PATH)"
+	$(hide) $(PRIVATE_FIMGASM) -c $(PRIVATE_PATH)/vert.h $(PRIVATE_PATH)/vert.asm
+	$(hide) $(PRIVATE_FIMGASM) -c $(PRIVATE_PATH)/frag.h $(PRIVATE_PATH)/frag.asm
+	$(hide) mkdir -p $(dir $@) && touch $@
+
+.PHONY: fimg-shaders-check
+fimg-shaders-check: $(FIMG_SHADERS_CHECKED)
+
+#
+# Build the library
+#
+
 include $(CLEAR_VARS)
 
 LOCAL_MODULE_TAGS := optional
@@ -8,11 +55,14 @@ LOCAL_ARM_MODE := arm
 LOCAL_CFLAGS += -Wall -Wno-unused-parameter -O2 -mcpu=arm1176jzf-s -mfloat-abi=softfp -mfpu=vfp
 LOCAL_CFLAGS += -DLOG_TAG=\"libfimg\"
 
+LOCAL_ADDITIONAL_DEPENDENCIES := $(FIMG_SHADERS_CHECKED)
+
 LOCAL_SRC_FILES := \
 	compat.c \
 	fragment.c \
 	global.c \
 	host.c \
+	optimizer.c \
 	primitive.c \
 	raster.c \
 	shaders.c \
@@ -100,6 +100,24 @@ void fimgLoadMatrix(fimgContext *ctx, uint32_t matrix, const float *pfData)
 	ctx->compat.matrixDirty[matrix] = 1;
 }
 
+/*****************************************************************************
+ * FUNCTIONS:	fimgSetMatrixClass
+ * SYNOPSIS:	This function sets the class of the specified matrix, which
+ *		selects the vertex shader code used to apply it.
+ * PARAMETERS:	[IN] matrix - which matrix to set the class of (FGL_MATRIX_*)
+ *		[IN] cls - the most specific class the matrix belongs to
+ *****************************************************************************/
+void fimgSetMatrixClass(fimgContext *ctx, uint32_t matrix, fimgMatrixClass cls)
+{
+	if (ctx->compat.matrixClass[matrix] == cls)
+		return;
+
+	ctx->compat.matrixClass[matrix] = cls;
+	/* Constant layout depends on the class */
+	ctx->compat.matrixDirty[matrix] = 1;
+	ctx->compat.vsDirty = 1;
+}
+
 /*
  * SHADERS
  */
@@ -116,22 +134,92 @@ static const struct shaderBlock vertexConstFloat = SHADER_BLOCK(vert_cfloat);
 static const struct shaderBlock vertexHeader = SHADER_BLOCK(vert_header);
 static const struct shaderBlock vertexFooter = SHADER_BLOCK(vert_footer);
 
+static const struct shaderBlock paletteHeader = SHADER_BLOCK(vert_palette);
+static const struct shaderBlock palettePosition =
+					SHADER_BLOCK(vert_palette_position);
+static const struct shaderBlock paletteNormal =
+					SHADER_BLOCK(vert_palette_normal);
+
+static const struct shaderBlock positionTransform[] = {
+	SHADER_BLOCK(vert_position_identity),	/* IDENTITY */
+	SHADER_BLOCK(vert_position_st),		/* SCALE_TRANSLATE */
+	SHADER_BLOCK(vert_position_a2d),	/* AFFINE_2D */
+	SHADER_BLOCK(vert_position)		/* GENERAL */
+};
+
 static const struct shaderBlock texcoordTransform[] = {
 	SHADER_BLOCK(vert_texture0),
-	SHADER_BLOCK(vert_texture1)
+	SHADER_BLOCK(vert_texture1),
+	SHADER_BLOCK(vert_texture2),
+	SHADER_BLOCK(vert_texture3)
+};
+
+static const struct shaderBlock texcoordGen = SHADER_BLOCK(vert_texgen);
+
+static const struct shaderBlock texcoordPass[] = {
+	SHADER_BLOCK(vert_texture0_identity),
+	SHADER_BLOCK(vert_texture1_identity),
+	SHADER_BLOCK(vert_texture2_identity),
+	SHADER_BLOCK(vert_texture3_identity)
+};
+
+static const struct shaderBlock vertexColor = SHADER_BLOCK(vert_color);
+static const struct shaderBlock lightingHeader = SHADER_BLOCK(vert_lighting);
+static const struct shaderBlock lightingEyePos =
+					SHADER_BLOCK(vert_lighting_eyepos);
+static const struct shaderBlock lightingFooter =
+					SHADER_BLOCK(vert_lighting_end);
+
+static const struct shaderBlock lightFunc[] = {
+	SHADER_BLOCK(vert_light_directional),
+	SHADER_BLOCK(vert_light_point),
+	SHADER_BLOCK(vert_light_spot)
+};
+
+static const struct shaderBlock fogHeader = SHADER_BLOCK(vert_fog);
+
+static const struct shaderBlock fogFunc[] = {
+	SHADER_BLOCK(vert_fog_linear),
+	SHADER_BLOCK(vert_fog_exp),
+	SHADER_BLOCK(vert_fog_exp2)
+};
+
+static const struct shaderBlock pointSize = SHADER_BLOCK(vert_point_size);
+static const struct shaderBlock pointSizeAttenuated =
+				SHADER_BLOCK(vert_point_size_attenuated);
+
+static const struct shaderBlock vertexClip[] = {
+	SHADER_BLOCK(vert_clip0),
+	SHADER_BLOCK(vert_clip1),
+	SHADER_BLOCK(vert_clip2)
 };
 
 static const struct shaderBlock vertexClear = SHADER_BLOCK(vert_clear);
+static const struct shaderBlock vertexDrawTex =
+					SHADER_BLOCK(vert_draw_texture);
+
+/* Resident shaders are kept at the end of instruction memory */
+#define FGFP_CLEAR_VSHADER	(FIMG_SHADER_SLOTS - vertexClear.len)
+#define FGFP_DRAWTEX_VSHADER	(FGFP_CLEAR_VSHADER - vertexDrawTex.len)
 
 /* Pixel shader */
 
 static const struct shaderBlock pixelConstFloat = SHADER_BLOCK(frag_cfloat);
 static const struct shaderBlock pixelHeader = SHADER_BLOCK(frag_header);
 static const struct shaderBlock pixelFooter = SHADER_BLOCK(frag_footer);
+static const struct shaderBlock pixelFog = SHADER_BLOCK(frag_fog);
+
+static const struct shaderBlock pixelClip[] = {
+	SHADER_BLOCK(frag_clip0),
+	SHADER_BLOCK(frag_clip1),
+	SHADER_BLOCK(frag_clip2)
+};
 
 static const struct shaderBlock textureUnit[] = {
 	SHADER_BLOCK(frag_texture0),
-	SHADER_BLOCK(frag_texture1)
+	SHADER_BLOCK(frag_texture1),
+	SHADER_BLOCK(frag_texture2),
+	SHADER_BLOCK(frag_texture3)
 };
 
 static const struct shaderBlock textureFunc[] = {
@@ -223,21 +311,11 @@ static inline volatile void *vsInstAddr(fimgContext *ctx, unsigned int slot)
 	return ctx->base + FGVS_INSTMEM_START + 16*slot;
 }
 
-static inline uint32_t vsInstLen(fimgContext *ctx, volatile void *vaddr)
-{
-	return ((volatile char *)vaddr - (ctx->base + FGVS_INSTMEM_START)) / 16;
-}
-
 static inline volatile void *psInstAddr(fimgContext *ctx, unsigned int slot)
 {
 	return ctx->base + FGPS_INSTMEM_START + 16*slot;
 }
 
-static inline uint32_t psInstLen(fimgContext *ctx, volatile void *vaddr)
-{
-	return ((volatile char *)vaddr - (ctx->base + FGPS_INSTMEM_START)) / 16;
-}
-
 static uint32_t loadShaderBlock(const struct shaderBlock *blk,
 						volatile void *vaddr)
 {
@@ -289,6 +367,50 @@ static inline void setVertexShaderRange(fimgContext *ctx,
 	fimgWrite(ctx, Config.val, FGVS_CONFIG);
 }
 
+/* Selects either generated shader or the resident one for glDrawTexOES */
+static void selectVertexShader(fimgContext *ctx)
+{
+	if (ctx->compat.drawTex)
+		setVertexShaderRange(ctx, FGFP_DRAWTEX_VSHADER,
+					FGFP_CLEAR_VSHADER - 1);
+	else
+		setVertexShaderRange(ctx, ctx->compat.vshaderStart,
+						ctx->compat.vshaderEnd);
+}
+
+/* Vertex shader output holding point size */
+#define FGFP_POINT_SIZE_OUTPUT	9
+/* Index of attribute holding texture coordinates of given unit */
+#define FGFP_TEXCOORD_ATTRIB(unit)	(1 + (unit))
+
+/*
+ * With per-vertex point size enabled, primitive engine expects the size
+ * in attribute following position, so the output holding it is moved
+ * there and remaining outputs are shifted by one.
+ */
+static void setVertexShaderOutputs(fimgContext *ctx, int pointSize)
+{
+	fimgVShaderAttrIdx idx;
+	uint32_t i, out;
+
+	for (i = 0; i < 12; i++) {
+		if (!pointSize || i == 0)
+			out = i;
+		else if (i == 1)
+			out = FGFP_POINT_SIZE_OUTPUT;
+		else if (i <= FGFP_POINT_SIZE_OUTPUT)
+			out = i - 1;
+		else
+			out = i;
+
+		if (i % 4 == 0)
+			idx.val = 0;
+		idx.attrib[i % 4].num = out;
+		if (i % 4 == 3)
+			fimgWrite(ctx, idx.val, FGVS_OUT_ATTR_IDX(i / 4));
+	}
+}
+
 static inline void setPixelShaderState(fimgContext *ctx, int state)
 {
 	fimgWrite(ctx, !!state, FGPS_EXE_MODE);
@@ -309,102 +431,536 @@ static inline void setPixelShaderRange(fimgContext *ctx,
 	fimgWrite(ctx, 1, FGPS_PC_COPY);
 }
 
-void fimgCompatLoadVertexShader(fimgContext *ctx)
+/*
+ * Updates shadow of constant register and tells whether the hardware
+ * needs to be written
+ */
+static inline int constChanged(uint32_t *shadow, uint32_t *valid,
+					uint32_t slot, const uint32_t *data)
 {
-	uint32_t unit;
-	volatile uint32_t *addr;
+	uint32_t bit = 1 << (slot % 32);
+
+	if ((valid[slot / 32] & bit) && shadow[0] == data[0]
+	    && shadow[1] == data[1] && shadow[2] == data[2]
+	    && shadow[3] == data[3])
+		return 0;
+
+	shadow[0] = data[0];
+	shadow[1] = data[1];
+	shadow[2] = data[2];
+	shadow[3] = data[3];
+	valid[slot / 32] |= bit;
+
+	return 1;
+}
+
+static void loadPSConstFloat(fimgContext *ctx, const float *pfData,
+								uint32_t slot)
+{
+	const uint32_t *data = (const uint32_t *)pfData;
+	volatile uint32_t *reg = (volatile uint32_t *)(ctx->base
+						+ FGPS_CFLOAT_START + 16*slot);
+
+	if (!constChanged(ctx->compat.psConst[slot],
+				ctx->compat.psConstValid, slot, data))
+		return;
+#if 0
+	asm ( 	"ldmia %0!, {r0-r3}"
+		"stmia %1!, {r0-r3}"
+		: "=r"(data), "=r"(reg)
+		: "0"(data), "1"(reg)
+		: "r0", "r1", "r2", "r3");
+#else
+	*(reg++) = *(data++);
+	*(reg++) = *(data++);
+	*(reg++) = *(data++);
+	*(reg++) = *(data++);
+#endif
+}
+
+static void loadVSConstFloat(fimgContext *ctx, const float *pfData,
+								uint32_t slot)
+{
+	const uint32_t *data = (const uint32_t *)pfData;
+	volatile uint32_t *reg = (volatile uint32_t *)(ctx->base
+						+ FGVS_CFLOAT_START + 16*slot);
+
+	if (!constChanged(ctx->compat.vsConst[slot],
+				ctx->compat.vsConstValid, slot, data))
+		return;
+
+	*(reg++) = *(data++);
+	*(reg++) = *(data++);
+	*(reg++) = *(data++);
+	*(reg++) = *(data++);
+}
+
+static void loadVSMatrix(fimgContext *ctx, const float *pfData, uint32_t slot)
+{
+	uint32_t i;
+
+	/* Columns are compared separately, as often only some change */
+	for (i = 0; i < 4; i++)
+		loadVSConstFloat(ctx, pfData + 4*i, slot + i);
+}
+
+/* Loads default constants of generated shaders */
+static void loadDefaultConsts(fimgContext *ctx)
+{
+	uint32_t i;
+
+	for (i = 0; i < vertexConstFloat.len; i++)
+		loadVSConstFloat(ctx,
+			(const float *)&vertexConstFloat.data[4*i], i);
+
+	for (i = 0; i < pixelConstFloat.len; i++)
+		loadPSConstFloat(ctx,
+			(const float *)&pixelConstFloat.data[4*i], i);
+}
+
+/* Generated shader code */
+struct shaderBuffer {
+	uint32_t *pos;
+	uint32_t *end;
+	int overflow;
+};
+
+static inline void initShaderBuffer(struct shaderBuffer *buf,
+					uint32_t *code, uint32_t slots)
+{
+	buf->pos = code;
+	buf->end = code + 4*slots;
+	buf->overflow = 0;
+}
+
+/*
+ * Appends block to generated code. Returns the copy or NULL if there
+ * is no room left, in which case the whole program must be dropped.
+ */
+static inline uint32_t *copyShaderBlock(const struct shaderBlock *blk,
+						struct shaderBuffer *buf)
+{
+	uint32_t *code = buf->pos;
+
+	if (buf->overflow || (uint32_t)(buf->end - code) < 4*blk->len) {
+		buf->overflow = 1;
+		return NULL;
+	}
+
+	memcpy(code, blk->data, 16*blk->len);
+	buf->pos += 4*blk->len;
+
+	return code;
+}
+
+#define FGFP_LIGHTMODEL		32
+#define FGFP_FOG_PARAMS		35
+#define FGFP_CLIP_PLANE(plane)	(36 + (plane))
+#define FGFP_POINT_PARAMS	39
+#define FGFP_LIGHT(light)	(40 + 8*(light))
+#define FGFP_PALETTE_UNITS	28
+#define FGFP_PALETTE(matrix)	(104 + 8*(matrix))
+
+/*
+ * Light and palette functions use constants of light 0 and palette
+ * matrix 0 respectively, move those starting from first by offset.
+ */
+static void copyMovedBlock(const struct shaderBlock *blk,
+		struct shaderBuffer *sbuf, uint32_t first, uint32_t offset)
+{
+	uint32_t i, *buf;
+
+	buf = copyShaderBlock(blk, sbuf);
+	if (!buf)
+		return;
+
+	for (i = 0; i < blk->len; i++, buf += 4) {
+		/* Source 0 */
+		if (((buf[1] >> 24) & 0x3f) == 2
+		    && ((buf[1] >> 16) & 0xff) >= first)
+			buf[1] += offset << 16;
+		/* Source 1 */
+		if ((buf[1] & 0x3f) == 2 && (buf[0] >> 24) >= first)
+			buf[0] += offset << 24;
+		/* Source 2 */
+		if (((buf[0] >> 8) & 0x3f) == 2 && (buf[0] & 0xff) >= first)
+			buf[0] += offset;
+	}
+}
+
+/* Temporary registers holding results of matrix palette blending */
+#define FGFP_SKINNED_POSITION	14
+#define FGFP_SKINNED_NORMAL	15
+
+/* Number of sources read by opcodes used in vertex shader blocks */
+static uint32_t vertexSourceCount(uint32_t opcode)
+{
+	switch (opcode) {
+	case 0x01: /* mov */
+	case 0x0c: /* exp */
+	case 0x0e: /* log */
+	case 0x10: /* rcp */
+	case 0x11: /* rsq */
+		return 1;
+	case 0x04: /* add */
+	case 0x06: /* mul */
+	case 0x08: /* dp3 */
+	case 0x09: /* dp4 */
+	case 0x0b: /* dst */
+	case 0x14: /* max */
+	case 0x15: /* min */
+	case 0x16: /* sge */
+	case 0x17: /* slt */
+		return 2;
+	case 0x1d: /* mad */
+		return 3;
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Makes source operand of type and number in given fields read given temp
+ * instead of given attribute
+ */
+static inline void relocateSource(uint32_t *type, int typeShift,
+			uint32_t *num, int numShift, uint32_t attrib, uint32_t reg)
+{
+	if (((*type >> typeShift) & 0x3f) != 0)
+		return;
+
+	if (((*num >> numShift) & 0xff) != attrib)
+		return;
+
+	*type |= 1 << typeShift;
+	*num = (*num & ~(0xff << numShift)) | (reg << numShift);
+}
+
+/* Makes shader code read given temp instead of given attribute */
+static void relocateAttribute(uint32_t *code, uint32_t *end,
+						uint32_t attrib, uint32_t reg)
+{
+	uint32_t n;
+
+	for (; code < end; code += 4) {
+		n = vertexSourceCount((code[2] >> 23) & 0x3f);
+
+		if (n > 0)
+			relocateSource(&code[1], 24, &code[1], 16, attrib, reg);
+		if (n > 1)
+			relocateSource(&code[1], 0, &code[0], 24, attrib, reg);
+		if (n > 2)
+			relocateSource(&code[0], 8, &code[0], 0, attrib, reg);
+	}
+}
+
+/*
+ * With matrix palette enabled, code following the blending functions
+ * takes position and normal from their results instead of attributes.
+ */
+static inline void skinShaderCode(uint32_t *code, uint32_t *end)
+{
+	relocateAttribute(code, end, 0, FGFP_SKINNED_POSITION);
+	relocateAttribute(code, end, 1, FGFP_SKINNED_NORMAL);
+}
+
+/* Vertex shader input holding texture coordinates of given unit */
+#define FGFP_TEXCOORD_INPUT(unit)	(4 + (unit))
+
+/* Temporary registers holding generated texture coordinates */
+static const uint32_t texGenOutput[] = {
+	[FGFP_TEXGEN_REFLECTION_MAP]	= 17,
+	[FGFP_TEXGEN_NORMAL_MAP]	= 16
+};
+
+/*
+ * Loads generated shader code as given variant, placed after the other
+ * resident variant if both fit below the limit. Otherwise the other
+ * variant is overwritten if needed. Programs longer than the limit are
+ * not loaded at all, leaving instruction memory intact.
+ */
+static int loadShaderVariant(fimgShaderVariant *variant,
+			fimgShaderVariant *other, uint32_t *code, uint32_t *end,
+			volatile char *mem, uint32_t limit, uint32_t flags)
+{
+	struct shaderBlock prog;
+	uint32_t start = 0;
+
+	prog.data = code;
+	prog.len = (end - code) / 4;
+#ifdef FIMG_SHADER_OPTIMIZER
+	prog.len = fimgOptimizeShader(code, prog.len, flags);
+#endif
+
+	if (prog.len > limit) {
+		LOGE("FIMG: Generated shader too long (%u > %u instructions)",
+							prog.len, limit);
+		return -1;
+	}
+
+	if (other->valid) {
+		if (other->end + 1 + prog.len <= limit)
+			start = other->end + 1;
+		else if (other->start < prog.len)
+			other->valid = 0;
+	}
+
+	loadShaderBlock(&prog, mem + 16*start);
+
+	variant->start = start;
+	variant->end = start + prog.len - 1;
+	variant->valid = 1;
+
+	return 0;
+}
+
+/* Vertex shader variant matching current state */
+static inline uint32_t vertexShaderVariant(fimgContext *ctx)
+{
+	if (ctx->compat.pointSize)
+		return FGFP_VSHADER_POINT_SIZE;
+
+	return FGFP_VSHADER_DEFAULT;
+}
+
+int fimgCompatLoadVertexShader(fimgContext *ctx)
+{
+	uint32_t unit, light, plane, matrix, index;
+	uint32_t code[4*FIMG_SHADER_SLOTS];
+	uint32_t *skinned, *texcoord;
+	struct shaderBuffer buf;
 	fimgTextureCompat *texture;
+	fimgLightCompat *lights;
+	fimgShaderVariant *variant;
+	int local, texgen;
 
 	texture = ctx->compat.texture;
-	addr = vsInstAddr(ctx, 0);
+	lights = ctx->compat.light;
+	initShaderBuffer(&buf, code, FIMG_SHADER_SLOTS);
+
+	texgen = 0;
+	for (unit = 0; unit < FIMG_NUM_TEXTURE_UNITS; unit++)
+		if (texture[unit].enabled && texture[unit].texGen)
+			texgen = 1;
+
+	copyShaderBlock(&vertexHeader, &buf);
+
+	if (ctx->compat.paletteCount) {
+		copyShaderBlock(&paletteHeader, &buf);
+
+		for (matrix = 0; matrix < ctx->compat.paletteCount; matrix++) {
+			copyMovedBlock(&palettePosition, &buf,
+				FGFP_PALETTE(0), FGFP_PALETTE(matrix)
+							- FGFP_PALETTE(0));
+			if (!ctx->compat.lighting && !texgen)
+				continue;
+
+			copyMovedBlock(&paletteNormal, &buf,
+				FGFP_PALETTE(0), FGFP_PALETTE(matrix)
+							- FGFP_PALETTE(0));
+		}
+	}
+	skinned = buf.pos;
+
+	copyShaderBlock(&positionTransform[
+			ctx->compat.matrixClass[FGFP_MATRIX_TRANSFORM]], &buf);
 
-	addr += loadShaderBlock(&vertexHeader, addr);
+	if (ctx->compat.lighting) {
+		copyShaderBlock(&lightingHeader, &buf);
+
+		local = 0;
+		for (light = 0; light < FIMG_NUM_LIGHTS; light++)
+			if (lights[light].enabled
+			    && lights[light].type != FGFP_LIGHT_DIRECTIONAL)
+				local = 1;
+
+		if (local)
+			copyShaderBlock(&lightingEyePos, &buf);
+
+		for (light = 0; light < FIMG_NUM_LIGHTS; light++) {
+			if (!lights[light].enabled)
+				continue;
+
+			copyMovedBlock(&lightFunc[lights[light].type],
+					&buf, FGFP_LIGHT(0),
+					FGFP_LIGHT(light) - FGFP_LIGHT(0));
+		}
+
+		copyShaderBlock(&lightingFooter, &buf);
+	} else {
+		copyShaderBlock(&vertexColor, &buf);
+	}
+
+	if (texgen)
+		copyShaderBlock(&texcoordGen, &buf);
 
 	for (unit = 0; unit < FIMG_NUM_TEXTURE_UNITS; unit++, texture++) {
 		if (!texture->enabled)
 			continue;
 
-		addr += loadShaderBlock(&texcoordTransform[unit], addr);
+		texcoord = buf.pos;
+
+		if (ctx->compat.matrixClass[FGFP_MATRIX_TEXTURE(unit)]
+						== FGFP_MATRIX_CLASS_IDENTITY)
+			copyShaderBlock(&texcoordPass[unit], &buf);
+		else
+			copyShaderBlock(&texcoordTransform[unit], &buf);
+
+		if (texture->texGen)
+			relocateAttribute(texcoord, buf.pos, FGFP_TEXCOORD_INPUT(unit),
+						texGenOutput[texture->texGen]);
+	}
+
+	if (ctx->compat.fog) {
+		copyShaderBlock(&fogHeader, &buf);
+		copyShaderBlock(&fogFunc[ctx->compat.fogMode], &buf);
+	}
+
+	for (plane = 0; plane < FIMG_NUM_CLIP_PLANES; plane++)
+		if (ctx->compat.clipPlane[plane])
+			copyShaderBlock(&vertexClip[plane], &buf);
+
+	if (ctx->compat.pointSize) {
+		if (ctx->compat.pointAttenuation)
+			copyShaderBlock(&pointSizeAttenuated, &buf);
+		else
+			copyShaderBlock(&pointSize, &buf);
+	}
+
+	if (ctx->compat.paletteCount)
+		skinShaderCode(skinned, buf.pos);
+
+	copyShaderBlock(&vertexFooter, &buf);
+
+	/* Up to 16 palette matrices and 8 lights do not fit together */
+	if (buf.overflow) {
+		LOGE("FIMG: Generated vertex shader does not fit");
+		return -1;
 	}
 
-	addr += loadShaderBlock(&vertexFooter, addr);
+	index = vertexShaderVariant(ctx);
+	variant = &ctx->compat.vsVariant[index];
+	if (loadShaderVariant(variant, &ctx->compat.vsVariant[!index], code,
+			buf.pos, vsInstAddr(ctx, 0), FGFP_DRAWTEX_VSHADER, 0))
+		return -1;
+	ctx->compat.vshaderStart = variant->start;
+	ctx->compat.vshaderEnd = variant->end;
 
-	ctx->compat.vshaderEnd = vsInstLen(ctx, addr) - 1;
+	loadShaderBlock(&vertexClear, vsInstAddr(ctx, FGFP_CLEAR_VSHADER));
+	loadShaderBlock(&vertexDrawTex, vsInstAddr(ctx, FGFP_DRAWTEX_VSHADER));
 
-	setVertexShaderRange(ctx, 0, ctx->compat.vshaderEnd);
+	loadDefaultConsts(ctx);
 
-	loadShaderBlock(&vertexClear, vsInstAddr(ctx, 512 - vertexClear.len));
+	setVertexShaderOutputs(ctx, ctx->compat.pointSize);
 
-	addr = (volatile uint32_t *)(ctx->base + FGVS_CFLOAT_START);
+	return 0;
+}
 
-	loadShaderBlock(&vertexConstFloat, addr);
+/* Pixel shader variant matching current state */
+static inline uint32_t pixelShaderVariant(fimgContext *ctx)
+{
+#ifdef FIMG_SHADER_OPTIMIZER
+	/* v0 is only known if the vertex shader passes the color through */
+	if (ctx->compat.primaryWhite && !ctx->compat.lighting)
+		return FGFP_PSHADER_WHITE;
+#endif
+	return FGFP_PSHADER_DEFAULT;
 }
 
-void fimgCompatLoadPixelShader(fimgContext *ctx)
+int fimgCompatLoadPixelShader(fimgContext *ctx)
 {
-	uint32_t unit, arg;
-	volatile uint32_t *addr;
+	uint32_t unit, arg, plane, flags, index;
+	uint32_t code[4*FIMG_SHADER_SLOTS];
+	struct shaderBuffer buf;
 	fimgTextureCompat *texture;
+	fimgShaderVariant *variant;
 
 	texture = ctx->compat.texture;
-	addr = psInstAddr(ctx, 0);
+	initShaderBuffer(&buf, code, FIMG_SHADER_SLOTS);
 
-	addr += loadShaderBlock(&pixelHeader, addr);
+	copyShaderBlock(&pixelHeader, &buf);
+
+	/* Kill clipped fragments before doing any texturing work on them */
+	for (plane = 0; plane < FIMG_NUM_CLIP_PLANES; plane++)
+		if (ctx->compat.clipPlane[plane])
+			copyShaderBlock(&pixelClip[plane], &buf);
 
 	for (unit = 0; unit < FIMG_NUM_TEXTURE_UNITS; unit++, texture++) {
 		if (!texture->enabled)
 			continue;
 
-		addr += loadShaderBlock(&textureUnit[unit], addr);
-		addr += loadShaderBlock(&textureFunc[texture->func], addr);
+		copyShaderBlock(&textureUnit[unit], &buf);
+		copyShaderBlock(&textureFunc[texture->func], &buf);
 
 		if (texture->func != FGFP_TEXFUNC_COMBINE)
 			continue;
 
 		for (arg = 0; arg < 3; arg++) {
-			addr += loadShaderBlock(&combineArg[arg]
-					[texture->combc.arg[arg].src], addr);
-			addr += loadShaderBlock(&combineArgMod[arg]
-					[texture->combc.arg[arg].mod], addr);
+			copyShaderBlock(&combineArg[arg]
+					[texture->combc.arg[arg].src], &buf);
+			copyShaderBlock(&combineArgMod[arg]
+					[texture->combc.arg[arg].mod], &buf);
 		}
 
-		addr += loadShaderBlock(&combineFunc[texture->combc.func],
-									addr);
+		copyShaderBlock(&combineFunc[texture->combc.func],
+									&buf);
 #if 0
 		if (texture->combc.func == texture->comba.func) {
-			addr += loadShaderBlock(&combine_u, addr);
+			copyShaderBlock(&combine_u, &buf);
 			continue;
 		}
 #endif
 		if (texture->combc.func == FGFP_COMBFUNC_DOT3_RGBA) {
-			addr += loadShaderBlock(&combine_u, addr);
+			copyShaderBlock(&combine_u, &buf);
 			continue;
 		}
 
-		addr += loadShaderBlock(&combine_c, addr);
+		copyShaderBlock(&combine_c, &buf);
 
 		for (arg = 0; arg < 3; arg++) {
-			addr += loadShaderBlock(&combineArg[arg]
-					[texture->comba.arg[arg].src], addr);
-			addr += loadShaderBlock(&combineArgMod[arg]
-					[texture->comba.arg[arg].mod], addr);
+			copyShaderBlock(&combineArg[arg]
+					[texture->comba.arg[arg].src], &buf);
+			copyShaderBlock(&combineArgMod[arg]
+					[texture->comba.arg[arg].mod], &buf);
 		}
 
-		addr += loadShaderBlock(&combineFunc[texture->comba.func],
-									addr);
-		addr += loadShaderBlock(&combine_a, addr);
+		copyShaderBlock(&combineFunc[texture->comba.func],
+									&buf);
+		copyShaderBlock(&combine_a, &buf);
+	}
+
+	if (ctx->compat.fog)
+		copyShaderBlock(&pixelFog, &buf);
+
+	copyShaderBlock(&pixelFooter, &buf);
+
+	if (buf.overflow) {
+		LOGE("FIMG: Generated pixel shader does not fit");
+		return -1;
 	}
 
-	addr += loadShaderBlock(&pixelFooter, addr);
+	/* c0 and c1 of pixel shader always hold 0.0 and 1.0 */
+	flags = FGSO_KNOWN_CONSTANTS;
+	index = pixelShaderVariant(ctx);
+	if (index == FGFP_PSHADER_WHITE)
+		flags |= FGSO_INPUT0_WHITE;
+
+	variant = &ctx->compat.psVariant[index];
+	if (loadShaderVariant(variant, &ctx->compat.psVariant[!index], code,
+			buf.pos, psInstAddr(ctx, 0),
+			FIMG_SHADER_SLOTS - pixelClear.len, flags))
+		return -1;
+	ctx->compat.pshaderStart = variant->start;
+	ctx->compat.pshaderEnd = variant->end;
 
-	ctx->compat.pshaderEnd = psInstLen(ctx, addr) - 1;
-	setPixelShaderRange(ctx, 0, ctx->compat.pshaderEnd);
+	setPixelShaderRange(ctx, variant->start, variant->end);
 
-	loadShaderBlock(&pixelClear, psInstAddr(ctx, 512 - pixelClear.len));
+	loadShaderBlock(&pixelClear,
+			psInstAddr(ctx, FIMG_SHADER_SLOTS - pixelClear.len));
 
-	addr = (volatile uint32_t *)(ctx->base + FGPS_CFLOAT_START);
+	loadDefaultConsts(ctx);
 
-	loadShaderBlock(&pixelConstFloat, addr);
+	return 0;
 }
 
 void fimgCompatSetTextureEnable(fimgContext *ctx, uint32_t unit, int enable)
@@ -533,6 +1089,25 @@ void fimgCompatSetEnvColor(fimgContext *ctx, uint32_t unit,
 	ctx->compat.texture[unit].dirty = 1;
 }
 
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetTexGen
+ * SYNOPSIS:	This function selects texture coordinate generation mode
+ *		of given texture unit.
+ * PARAMETERS:	[IN] unit - texture unit
+ *		[IN] mode - generation mode (FGFP_TEXGEN_NONE to use texture
+ *		coordinate attribute)
+ *****************************************************************************/
+void fimgCompatSetTexGen(fimgContext *ctx, unsigned unit, fimgTexGenMode mode)
+{
+	if (ctx->compat.texture[unit].texGen == mode)
+		return;
+
+	ctx->compat.texture[unit].texGen = mode;
+
+	if (ctx->compat.texture[unit].enabled)
+		ctx->compat.vsDirty = 1;
+}
+
 void fimgCompatSetupTexture(fimgContext *ctx, fimgTexture *tex,
 						uint32_t unit, int swap)
 {
@@ -540,126 +1115,952 @@ void fimgCompatSetupTexture(fimgContext *ctx, fimgTexture *tex,
 	ctx->compat.texture[unit].swap = swap;
 }
 
-void fimgCreateCompatContext(fimgContext *ctx)
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetTexturePalette
+ * SYNOPSIS:	This function sets the palette used by 1, 2, 4 and 8 BPP
+ *		textures. There is only one palette in hardware, so all
+ *		texture units see the palette from the last call.
+ * PARAMETERS:	[IN] entries - palette entries in format of the texture
+ *		[IN] count - number of entries (1~256)
+ *****************************************************************************/
+void fimgCompatSetTexturePalette(fimgContext *ctx, const uint32_t *entries,
+							unsigned count)
 {
-	uint32_t unit;
-	fimgTextureCompat *texture;
+	if (count > FIMG_PALETTE_SIZE)
+		count = FIMG_PALETTE_SIZE;
 
-	texture = ctx->compat.texture;
+	if (ctx->compat.texPaletteSize == count && !memcmp(
+		ctx->compat.texPalette, entries, count * sizeof(*entries)))
+		return;
 
-	for (unit = 0; unit < FIMG_NUM_TEXTURE_UNITS; unit++, texture++) {
-		texture->func = FGFP_TEXFUNC_MODULATE;
+	memcpy(ctx->compat.texPalette, entries, count * sizeof(*entries));
+	ctx->compat.texPaletteSize = count;
+	ctx->compat.texPaletteDirty = 1;
+}
 
-		texture->combc.func = FGFP_COMBFUNC_MODULATE;
-		texture->combc.arg[0].src = FGFP_COMBARG_TEX;
-		texture->combc.arg[0].mod = FGFP_COMBARG_SRC_COLOR;
-		texture->combc.arg[1].src = FGFP_COMBARG_PREV;
-		texture->combc.arg[1].mod = FGFP_COMBARG_SRC_COLOR;
-		texture->combc.arg[2].src = FGFP_COMBARG_CONST;
-		texture->combc.arg[2].mod = FGFP_COMBARG_SRC_COLOR;
+static void loadTexturePalette(fimgContext *ctx)
+{
+	if (!ctx->compat.texPaletteDirty || !ctx->compat.texPaletteSize)
+		return;
 
-		texture->combc.func = FGFP_COMBFUNC_MODULATE;
-		texture->comba.arg[0].src = FGFP_COMBARG_TEX;
-		texture->comba.arg[0].mod = FGFP_COMBARG_SRC_ALPHA;
-		texture->comba.arg[1].src = FGFP_COMBARG_PREV;
-		texture->comba.arg[1].mod = FGFP_COMBARG_SRC_ALPHA;
-		texture->comba.arg[2].src = FGFP_COMBARG_CONST;
-		texture->comba.arg[2].mod = FGFP_COMBARG_SRC_ALPHA;
+	fimgLoadTexPalette(ctx, ctx->compat.texPalette,
+					ctx->compat.texPaletteSize);
+	ctx->compat.texPaletteDirty = 0;
+}
 
-		texture->scale[0] = 1.0;
-		texture->scale[1] = 1.0;
-		texture->scale[2] = 1.0;
-		texture->scale[3] = 1.0;
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetPrimaryWhite
+ * SYNOPSIS:	This function tells the shader generator whether the primary
+ *		color is known to be constant white, which lets it drop
+ *		operations on it from the pixel shader. Both variants of
+ *		the pixel shader are kept resident, so alternating colors
+ *		only select one of them. The hint is ignored while lighting
+ *		is enabled, as the vertex shader computes the color then.
+ * PARAMETERS:	[IN] white - non-zero if primary color is (1.0, 1.0, 1.0, 1.0)
+ *****************************************************************************/
+void fimgCompatSetPrimaryWhite(fimgContext *ctx, int white)
+{
+	ctx->compat.primaryWhite = !!white;
+}
 
-		texture->swap = 0;
-	}
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetLightingEnable
+ * SYNOPSIS:	This function controls whether vertex colors are computed
+ *		by the lighting equation or taken from the color attribute.
+ * PARAMETERS:	[IN] enable - non-zero to enable lighting
+ *****************************************************************************/
+void fimgCompatSetLightingEnable(fimgContext *ctx, int enable)
+{
+	if (ctx->compat.lighting == !!enable)
+		return;
 
+	ctx->compat.lighting = !!enable;
 	ctx->compat.vsDirty = 1;
-	ctx->compat.psDirty = 1;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetLightEnable
+ * SYNOPSIS:	This function controls whether specified light contributes
+ *		to the lighting equation.
+ * PARAMETERS:	[IN] light - light index
+ *		[IN] enable - non-zero to enable the light
+ *****************************************************************************/
+void fimgCompatSetLightEnable(fimgContext *ctx, unsigned light, int enable)
+{
+	if (ctx->compat.light[light].enabled == !!enable)
+		return;
+
+	ctx->compat.light[light].enabled = !!enable;
+	ctx->compat.vsDirty = 1;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetLightType
+ * SYNOPSIS:	This function selects the lighting function used for
+ *		specified light.
+ * PARAMETERS:	[IN] light - light index
+ *		[IN] type - light type (FGFP_LIGHT_*)
+ *****************************************************************************/
+void fimgCompatSetLightType(fimgContext *ctx, unsigned light,
+							fimgLightType type)
+{
+	if (ctx->compat.light[light].type == type)
+		return;
+
+	ctx->compat.light[light].type = type;
+	ctx->compat.vsDirty = 1;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetLightParam
+ * SYNOPSIS:	This function sets a parameter of specified light. Positions
+ *		and directions are in eye space, colors are premultiplied
+ *		by respective material colors.
+ * PARAMETERS:	[IN] light - light index
+ *		[IN] param - which parameter to set (FGFP_LIGHT_*)
+ *		[IN] vec - 4 component parameter value
+ *****************************************************************************/
+void fimgCompatSetLightParam(fimgContext *ctx, unsigned light,
+				fimgLightParam param, const float *vec)
+{
+	fimgLightCompat *l = &ctx->compat.light[light];
+
+	if (!memcmp(l->params[param], vec, sizeof(l->params[param])))
+		return;
+
+	memcpy(l->params[param], vec, sizeof(l->params[param]));
+	l->dirty = 1;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetSceneColor
+ * SYNOPSIS:	This function sets the color lights are added to, which is
+ *		material emission plus material ambient times scene ambient
+ *		with alpha of material diffuse color.
+ * PARAMETERS:	[IN] color - RGBA color
+ *****************************************************************************/
+void fimgCompatSetSceneColor(fimgContext *ctx, const float *color)
+{
+	if (!memcmp(ctx->compat.lightModel[0], color, 4*sizeof(float)))
+		return;
+
+	memcpy(ctx->compat.lightModel[0], color, 4*sizeof(float));
+	ctx->compat.lightModelDirty = 1;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetShininess
+ * SYNOPSIS:	This function sets the specular exponent of the material.
+ * PARAMETERS:	[IN] shininess - specular exponent
+ *****************************************************************************/
+void fimgCompatSetShininess(fimgContext *ctx, float shininess)
+{
+	if (ctx->compat.lightModel[1][0] == shininess)
+		return;
+
+	ctx->compat.lightModel[1][0] = shininess;
+	ctx->compat.lightModelDirty = 1;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetFogEnable
+ * SYNOPSIS:	This function controls whether fog is applied to fragments.
+ * PARAMETERS:	[IN] enable - non-zero to enable fog
+ *****************************************************************************/
+void fimgCompatSetFogEnable(fimgContext *ctx, int enable)
+{
+	if (ctx->compat.fog == !!enable)
+		return;
+
+	ctx->compat.fog = !!enable;
+	ctx->compat.vsDirty = 1;
+	ctx->compat.psDirty = 1;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetFogMode
+ * SYNOPSIS:	This function selects the function used to compute fog
+ *		factor from eye distance.
+ * PARAMETERS:	[IN] mode - fog function (FGFP_FOG_*)
+ *****************************************************************************/
+void fimgCompatSetFogMode(fimgContext *ctx, fimgFogMode mode)
+{
+	if (ctx->compat.fogMode == mode)
+		return;
+
+	ctx->compat.fogMode = mode;
+	if (ctx->compat.fog)
+		ctx->compat.vsDirty = 1;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetFogParams
+ * SYNOPSIS:	This function sets parameters of fog functions.
+ * PARAMETERS:	[IN] start, end - distances for linear fog
+ *		[IN] density - density for exponential fogs
+ *****************************************************************************/
+void fimgCompatSetFogParams(fimgContext *ctx,
+				float start, float end, float density)
+{
+	float *params = ctx->compat.fogParams;
+	float scale = (end != start) ? 1.0f / (end - start) : 0.0f;
+
+	/* Exponential fogs use exp2, so fold log2(e) into density */
+	params[0] = scale;
+	params[1] = end * scale;
+	params[2] = density * 1.442695f;
+	params[3] = -density * density * 1.442695f;
+	ctx->compat.fogDirty = 1;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetFogColor
+ * SYNOPSIS:	This function sets the color fragments are blended with.
+ * PARAMETERS:	[IN] r, g, b, a - fog color
+ *****************************************************************************/
+void fimgCompatSetFogColor(fimgContext *ctx,
+				float r, float g, float b, float a)
+{
+	ctx->compat.fogColor[0] = r;
+	ctx->compat.fogColor[1] = g;
+	ctx->compat.fogColor[2] = b;
+	ctx->compat.fogColor[3] = a;
+	ctx->compat.fogDirty = 1;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetClipPlaneEnable
+ * SYNOPSIS:	This function controls whether fragments are clipped against
+ *		given user clip plane.
+ * PARAMETERS:	[IN] plane - clip plane index
+ *		[IN] enable - non-zero to enable the clip plane
+ *****************************************************************************/
+void fimgCompatSetClipPlaneEnable(fimgContext *ctx, unsigned plane, int enable)
+{
+	if (ctx->compat.clipPlane[plane] == !!enable)
+		return;
+
+	ctx->compat.clipPlane[plane] = !!enable;
+	ctx->compat.vsDirty = 1;
+	ctx->compat.psDirty = 1;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetClipPlane
+ * SYNOPSIS:	This function sets the equation of given user clip plane.
+ * PARAMETERS:	[IN] plane - clip plane index
+ *		[IN] eq - plane equation in object coordinates of vertices
+ *		     being drawn (vertices with negative distance are clipped)
+ *****************************************************************************/
+void fimgCompatSetClipPlane(fimgContext *ctx, unsigned plane, const float *eq)
+{
+	memcpy(ctx->compat.clipPlaneEq[plane], eq, 4*sizeof(float));
+	ctx->compat.clipPlaneDirty = 1;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetPointSizeEnable
+ * SYNOPSIS:	This function controls whether point size is computed
+ *		per vertex from point size attribute. Vertex shader variants
+ *		with and without point size output are kept resident, so
+ *		alternating point and other draws only select one of them.
+ * PARAMETERS:	[IN] enable - non-zero when drawing points
+ *****************************************************************************/
+void fimgCompatSetPointSizeEnable(fimgContext *ctx, int enable)
+{
+	ctx->compat.pointSize = !!enable;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetPointAttenuationEnable
+ * SYNOPSIS:	This function controls whether point size is attenuated
+ *		with distance to the eye.
+ * PARAMETERS:	[IN] enable - non-zero to enable attenuation
+ *****************************************************************************/
+void fimgCompatSetPointAttenuationEnable(fimgContext *ctx, int enable)
+{
+	if (ctx->compat.pointAttenuation == !!enable)
+		return;
+
+	ctx->compat.pointAttenuation = !!enable;
+	/* Only the point size variant depends on it */
+	ctx->compat.vsVariant[FGFP_VSHADER_POINT_SIZE].valid = 0;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetPointAttenuation
+ * SYNOPSIS:	This function sets coefficients of point size attenuation.
+ * PARAMETERS:	[IN] coeffs - constant, linear and quadratic coefficients
+ *****************************************************************************/
+void fimgCompatSetPointAttenuation(fimgContext *ctx, const float *coeffs)
+{
+	memcpy(ctx->compat.pointParams, coeffs, 3*sizeof(float));
+	ctx->compat.pointDirty = 1;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetCoordReplace
+ * SYNOPSIS:	This function selects the texture unit which gets point
+ *		sprite coordinates instead of interpolated ones.
+ * PARAMETERS:	[IN] unit - texture unit index
+ *****************************************************************************/
+void fimgCompatSetCoordReplace(fimgContext *ctx, unsigned unit)
+{
+	fimgSetCoordReplace(ctx, FGFP_TEXCOORD_ATTRIB(unit));
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetDrawTexture
+ * SYNOPSIS:	This function switches between the generated vertex shader
+ *		and the resident one used for glDrawTexOES, which takes
+ *		vertices in normalized device coordinates and ignores
+ *		matrices, lighting, fog and clip planes.
+ * PARAMETERS:	[IN] enable - non-zero to use the resident shader
+ *****************************************************************************/
+void fimgCompatSetDrawTexture(fimgContext *ctx, int enable)
+{
+	if (ctx->compat.drawTex == !!enable)
+		return;
+
+	ctx->compat.drawTex = !!enable;
+	ctx->compat.vsSelectDirty = 1;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetMatrixPalette
+ * SYNOPSIS:	This function controls vertex skinning. With the palette
+ *		enabled, vertices are transformed to eye space by palette
+ *		matrices selected by matrix index attribute and blended
+ *		with weight attribute, so the modelview matrix should be
+ *		set to identity.
+ * PARAMETERS:	[IN] count - number of palette matrices referenced by
+ *		     vertices or 0 to disable the palette
+ *****************************************************************************/
+void fimgCompatSetMatrixPalette(fimgContext *ctx, unsigned count)
+{
+	if (count > FIMG_NUM_PALETTE_MATRICES)
+		count = FIMG_NUM_PALETTE_MATRICES;
+
+	if (ctx->compat.paletteCount == count)
+		return;
+
+	ctx->compat.paletteCount = count;
+	ctx->compat.vsDirty = 1;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetVertexUnits
+ * SYNOPSIS:	This function sets the number of matrix index and weight
+ *		pairs given per vertex.
+ * PARAMETERS:	[IN] units - number of vertex units in use
+ *****************************************************************************/
+void fimgCompatSetVertexUnits(fimgContext *ctx, unsigned units)
+{
+	float *mask = ctx->compat.vertexUnits;
+	unsigned i;
+
+	for (i = 0; i < FIMG_NUM_VERTEX_UNITS; i++) {
+		if (mask[i] == (i < units))
+			continue;
+
+		mask[i] = (i < units);
+		ctx->compat.vertexUnitsDirty = 1;
+	}
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetPaletteMatrix
+ * SYNOPSIS:	This function sets given matrix of the palette. Only ranges
+ *		of changed matrices are uploaded on next flush.
+ * PARAMETERS:	[IN] index - palette matrix index
+ *		[IN] matrix - matrix elements in column-major ordering
+ *		[IN] inverse - inverse matrix used to transform normals
+ *****************************************************************************/
+void fimgCompatSetPaletteMatrix(fimgContext *ctx, unsigned index,
+				const float *matrix, const float *inverse)
+{
+	float (*regs)[4] = ctx->compat.palette[index];
+
+	memcpy(regs[0], matrix, 16*sizeof(float));
+	memcpy(regs[4], inverse, 12*sizeof(float));
+
+	if (ctx->compat.paletteStart == ctx->compat.paletteEnd) {
+		ctx->compat.paletteStart = index;
+		ctx->compat.paletteEnd = index + 1;
+		return;
+	}
+
+	if (index < ctx->compat.paletteStart)
+		ctx->compat.paletteStart = index;
+	if (index + 1 > ctx->compat.paletteEnd)
+		ctx->compat.paletteEnd = index + 1;
+}
+
+static void markCompatDirty(fimgContext *ctx)
+{
+	uint32_t i;
+
+	for (i = 0; i < 3 + FIMG_NUM_TEXTURE_UNITS; i++)
+		ctx->compat.matrixDirty[i] = 1;
+
+	for (i = 0; i < FIMG_NUM_TEXTURE_UNITS; i++)
+		ctx->compat.texture[i].dirty = 1;
+
+	for (i = 0; i < FIMG_NUM_LIGHTS; i++)
+		ctx->compat.light[i].dirty = 1;
+	ctx->compat.lightModelDirty = 1;
+	ctx->compat.fogDirty = 1;
+	ctx->compat.clipPlaneDirty = 1;
+	ctx->compat.pointDirty = 1;
+	ctx->compat.vertexUnitsDirty = 1;
+	ctx->compat.paletteStart = 0;
+	ctx->compat.paletteEnd = FIMG_NUM_PALETTE_MATRICES;
+	ctx->compat.texPaletteDirty = 1;
+
+	ctx->compat.vsDirty = 1;
+	ctx->compat.psDirty = 1;
+	/* No valid boolean mask has bits above texture units */
+	ctx->compat.psConstBool = ~0U;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatGetProgramSlots
+ * SYNOPSIS:	This function returns the maximum length of application
+ *		program for given shader, which does not overlap
+ *		resident shaders.
+ * PARAMETERS:	[IN] stage - shader to query
+ * RETURNS:	number of instruction slots
+ *****************************************************************************/
+uint32_t fimgCompatGetProgramSlots(fimgProgramStage stage)
+{
+	if (stage == FGFP_PROGRAM_PIXEL)
+		return FIMG_SHADER_SLOTS - pixelClear.len;
+
+	return FGFP_DRAWTEX_VSHADER;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatGetProgramConsts
+ * SYNOPSIS:	This function returns the number of float constants available
+ *		to application program for given shader.
+ * PARAMETERS:	[IN] stage - shader to query
+ * RETURNS:	number of float constant registers
+ *****************************************************************************/
+uint32_t fimgCompatGetProgramConsts(fimgProgramStage stage)
+{
+	/* c255 of pixel shader is used by clear */
+	if (stage == FGFP_PROGRAM_PIXEL)
+		return FIMG_NUM_CONST_FLOAT - 1;
+
+	return FIMG_NUM_CONST_FLOAT;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetProgram
+ * SYNOPSIS:	This function replaces generated shaders with application
+ *		supplied ones. The program is copied, so it does not need
+ *		to be kept by the caller.
+ * PARAMETERS:	[IN] prog - program to use or NULL to restore generated
+ *		shaders
+ * RETURNS:	 0, if successful
+ *		-1, program does not fit in shader memory
+ *****************************************************************************/
+int fimgCompatSetProgram(fimgContext *ctx, const fimgProgram *prog)
+{
+	fimgProgramCompat *cur = &ctx->compat.program;
+	uint32_t stage, i;
+
+	if (prog == NULL) {
+		if (!ctx->compat.useProgram)
+			return 0;
+
+		ctx->compat.useProgram = 0;
+		markCompatDirty(ctx);
+		return 0;
+	}
+
+	for (stage = 0; stage < FGFP_PROGRAM_STAGES; stage++) {
+		if (!prog->len[stage] || prog->len[stage]
+				> fimgCompatGetProgramSlots(stage))
+			return -1;
+
+		if (prog->numConsts[stage] > fimgCompatGetProgramConsts(stage))
+			return -1;
+	}
+
+	for (i = 0; i < 3 + FIMG_NUM_TEXTURE_UNITS; i++)
+		if (prog->matrix[i] > FIMG_NUM_CONST_FLOAT - 4)
+			return -1;
+
+	for (stage = 0; stage < FGFP_PROGRAM_STAGES; stage++) {
+		memcpy(cur->code[stage], prog->code[stage],
+						16*prog->len[stage]);
+		cur->len[stage] = prog->len[stage];
+
+		memcpy(cur->consts[stage], prog->consts[stage],
+						16*prog->numConsts[stage]);
+		cur->numConsts[stage] = prog->numConsts[stage];
+		cur->constStart[stage] = 0;
+		cur->constEnd[stage] = cur->numConsts[stage];
+	}
+
+	for (i = 0; i < 3 + FIMG_NUM_TEXTURE_UNITS; i++) {
+		cur->matrix[i] = prog->matrix[i];
+		ctx->compat.matrixDirty[i] = 1;
+	}
+
+	cur->codeDirty = 1;
+	ctx->compat.useProgram = 1;
+
+	return 0;
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgCompatSetProgramConst
+ * SYNOPSIS:	This function updates float constants of current application
+ *		program without reloading its code.
+ * PARAMETERS:	[IN] stage - shader owning the constants
+ *		[IN] slot - first constant register to update
+ *		[IN] values - 4 floats per constant register
+ *		[IN] count - number of constant registers to update
+ *****************************************************************************/
+void fimgCompatSetProgramConst(fimgContext *ctx, fimgProgramStage stage,
+			uint32_t slot, const float *values, uint32_t count)
+{
+	fimgProgramCompat *prog = &ctx->compat.program;
+	uint32_t max = fimgCompatGetProgramConsts(stage);
+
+	if (!ctx->compat.useProgram || slot >= max || count > max - slot)
+		return;
+
+	memcpy(prog->consts[stage][slot], values, 16*count);
+
+	if (slot + count > prog->numConsts[stage])
+		prog->numConsts[stage] = slot + count;
+
+	if (prog->constStart[stage] == prog->constEnd[stage]) {
+		prog->constStart[stage] = slot;
+		prog->constEnd[stage] = slot + count;
+		return;
+	}
+
+	if (slot < prog->constStart[stage])
+		prog->constStart[stage] = slot;
+	if (slot + count > prog->constEnd[stage])
+		prog->constEnd[stage] = slot + count;
+}
+
+void fimgCreateCompatContext(fimgContext *ctx)
+{
+	uint32_t unit;
+	fimgTextureCompat *texture;
+	fimgLightCompat *light;
+
+	texture = ctx->compat.texture;
+
+	for (unit = 0; unit < 3 + FIMG_NUM_TEXTURE_UNITS; unit++)
+		ctx->compat.matrixClass[unit] = FGFP_MATRIX_CLASS_GENERAL;
+
+	for (unit = 0; unit < FIMG_NUM_TEXTURE_UNITS; unit++, texture++) {
+		texture->func = FGFP_TEXFUNC_MODULATE;
+
+		texture->combc.func = FGFP_COMBFUNC_MODULATE;
+		texture->combc.arg[0].src = FGFP_COMBARG_TEX;
+		texture->combc.arg[0].mod = FGFP_COMBARG_SRC_COLOR;
+		texture->combc.arg[1].src = FGFP_COMBARG_PREV;
+		texture->combc.arg[1].mod = FGFP_COMBARG_SRC_COLOR;
+		texture->combc.arg[2].src = FGFP_COMBARG_CONST;
+		texture->combc.arg[2].mod = FGFP_COMBARG_SRC_COLOR;
+
+		texture->combc.func = FGFP_COMBFUNC_MODULATE;
+		texture->comba.arg[0].src = FGFP_COMBARG_TEX;
+		texture->comba.arg[0].mod = FGFP_COMBARG_SRC_ALPHA;
+		texture->comba.arg[1].src = FGFP_COMBARG_PREV;
+		texture->comba.arg[1].mod = FGFP_COMBARG_SRC_ALPHA;
+		texture->comba.arg[2].src = FGFP_COMBARG_CONST;
+		texture->comba.arg[2].mod = FGFP_COMBARG_SRC_ALPHA;
+
+		texture->scale[0] = 1.0;
+		texture->scale[1] = 1.0;
+		texture->scale[2] = 1.0;
+		texture->scale[3] = 1.0;
+
+		texture->swap = 0;
+	}
+
+	light = ctx->compat.light;
+
+	for (unit = 0; unit < FIMG_NUM_LIGHTS; unit++, light++) {
+		light->type = FGFP_LIGHT_DIRECTIONAL;
+		light->params[FGFP_LIGHT_POSITION][2] = 1.0;
+		light->params[FGFP_LIGHT_HALF_VECTOR][2] = 1.0;
+		light->params[FGFP_LIGHT_SPOT_DIRECTION][2] = -1.0;
+		light->params[FGFP_LIGHT_SPOT_DIRECTION][3] = -1.0;
+		light->params[FGFP_LIGHT_ATTENUATION][0] = 1.0;
+		light->dirty = 1;
+	}
+
+	/* Scene color */
+	ctx->compat.lightModel[0][3] = 1.0;
+	/* Shininess, 0.0, epsilon to keep log() finite, 1.0 */
+	ctx->compat.lightModel[1][2] = 1.0e-20;
+	ctx->compat.lightModel[1][3] = 1.0;
+	/* Direction to viewer */
+	ctx->compat.lightModel[2][2] = 1.0;
+	ctx->compat.lightModelDirty = 1;
+
+	ctx->compat.fogMode = FGFP_FOG_EXP;
+	fimgCompatSetFogParams(ctx, 0.0f, 1.0f, 1.0f);
+
+	ctx->compat.pointParams[0] = 1.0f;
+	ctx->compat.pointDirty = 1;
+
+	for (unit = 0; unit < FIMG_NUM_VERTEX_UNITS; unit++)
+		ctx->compat.vertexUnits[unit] = 1.0f;
+	ctx->compat.vertexUnitsDirty = 1;
+
+	/* Identity matrices, bounds for matching of matrix index */
+	for (unit = 0; unit < FIMG_NUM_PALETTE_MATRICES; unit++) {
+		float (*regs)[4] = ctx->compat.palette[unit];
+
+		regs[0][0] = regs[1][1] = regs[2][2] = regs[3][3] = 1.0f;
+		regs[4][0] = regs[5][1] = regs[6][2] = 1.0f;
+		regs[7][0] = unit - 0.5f;
+		regs[7][1] = unit + 0.5f;
+	}
+	ctx->compat.paletteEnd = FIMG_NUM_PALETTE_MATRICES;
+
+	ctx->compat.vsDirty = 1;
+	ctx->compat.psDirty = 1;
+	ctx->compat.psConstBool = ~0U;
 
 	ctx->clear.depth = 1.0;
 }
 
 #define FGFP_TEXENV(unit)	(4 + 2*(unit))
 #define FGFP_COMBSCALE(unit)	(5 + 2*(unit))
+#define FGFP_FOG_COLOR		32
 
-static void setPSConstBool(fimgContext *ctx, int val, uint32_t slot)
+/* Boolean constant b<unit> selects swapped components of texture unit */
+static uint32_t pixelShaderConstBool(fimgContext *ctx)
 {
-	uint32_t reg;
+	uint32_t i, val = 0;
 
-	reg = fimgRead(ctx, FGPS_CBOOL_START);
-	reg &= ~(!val << slot);
-	reg |= !!val << slot;
-	fimgWrite(ctx, reg, FGPS_CBOOL_START);
+	for (i = 0; i < FIMG_NUM_TEXTURE_UNITS; i++) {
+		if (ctx->compat.texture[i].texture == NULL)
+			continue;
+
+		if (!ctx->compat.texture[i].enabled)
+			continue;
+
+		if (ctx->compat.texture[i].swap)
+			val |= 1 << i;
+	}
+
+	return val;
 }
 
-static void loadPSConstFloat(fimgContext *ctx, const float *pfData,
-								uint32_t slot)
+/* Checks whether any pixel shader register differs from flushed state */
+static int pixelShaderChanged(fimgContext *ctx)
 {
-	const uint32_t *data = (const uint32_t *)pfData;
-	volatile uint32_t *reg = (volatile uint32_t *)(ctx->base
-						+ FGPS_CFLOAT_START + 16*slot);
-#if 0
-	asm ( 	"ldmia %0!, {r0-r3}"
-		"stmia %1!, {r0-r3}"
-		: "=r"(data), "=r"(reg)
-		: "0"(data), "1"(reg)
-		: "r0", "r1", "r2", "r3");
-#else
-	*(reg++) = *(data++);
-	*(reg++) = *(data++);
-	*(reg++) = *(data++);
-	*(reg++) = *(data++);
-#endif
+	fimgShaderVariant *variant;
+	uint32_t i;
+
+	if (ctx->compat.psDirty)
+		return 1;
+
+	variant = &ctx->compat.psVariant[pixelShaderVariant(ctx)];
+	if (!variant->valid || variant->start != ctx->compat.pshaderStart)
+		return 1;
+
+	if (ctx->compat.psConstBool != pixelShaderConstBool(ctx))
+		return 1;
+
+	if (ctx->compat.fog && ctx->compat.fogDirty)
+		return 1;
+
+	for (i = 0; i < FIMG_NUM_TEXTURE_UNITS; i++)
+		if (ctx->compat.texture[i].texture != NULL
+		    && ctx->compat.texture[i].enabled
+		    && ctx->compat.texture[i].dirty)
+			return 1;
+
+	return 0;
 }
 
-static void loadVSMatrix(fimgContext *ctx, const float *pfData, uint32_t slot)
+static void loadTransformMatrix(fimgContext *ctx, uint32_t matrix)
+{
+	const float *m = ctx->compat.matrix[matrix];
+	float packed[16];
+
+	switch (ctx->compat.matrixClass[matrix]) {
+	case FGFP_MATRIX_CLASS_IDENTITY:
+		/* Not referenced by the shader */
+		if (matrix != FGFP_MATRIX_LIGHTING)
+			return;
+		break;
+	case FGFP_MATRIX_CLASS_SCALE_TRANSLATE:
+		/* c0 = (m[0][0], m[1][1], m[2][2], 0.0) */
+		memcpy(packed, m, sizeof(packed));
+		packed[1] = m[5];
+		packed[2] = m[10];
+		packed[3] = 0.0f;
+		m = packed;
+		break;
+	case FGFP_MATRIX_CLASS_AFFINE_2D:
+		/* c0 = (m[0][0], m[0][1], m[2][2], 0.0) */
+		memcpy(packed, m, sizeof(packed));
+		packed[2] = m[10];
+		packed[3] = 0.0f;
+		m = packed;
+		break;
+	default:
+		break;
+	}
+
+	loadVSMatrix(ctx, m, 4*matrix);
+}
+
+static void loadLightingConsts(fimgContext *ctx)
+{
+	fimgLightCompat *light = ctx->compat.light;
+	uint32_t i, j;
+
+	if (ctx->compat.lightModelDirty) {
+		for (j = 0; j < 3; j++)
+			loadVSConstFloat(ctx, ctx->compat.lightModel[j],
+							FGFP_LIGHTMODEL + j);
+		ctx->compat.lightModelDirty = 0;
+	}
+
+	for (i = 0; i < FIMG_NUM_LIGHTS; i++, light++) {
+		if (!light->enabled || !light->dirty)
+			continue;
+
+		for (j = 0; j < FGFP_LIGHT_PARAMS; j++)
+			loadVSConstFloat(ctx, light->params[j],
+							FGFP_LIGHT(i) + j);
+		light->dirty = 0;
+	}
+}
+
+static void loadPaletteConsts(fimgContext *ctx)
+{
+	uint32_t i, j;
+
+	if (ctx->compat.vertexUnitsDirty) {
+		loadVSConstFloat(ctx, ctx->compat.vertexUnits,
+							FGFP_PALETTE_UNITS);
+		ctx->compat.vertexUnitsDirty = 0;
+	}
+
+	for (i = ctx->compat.paletteStart; i < ctx->compat.paletteEnd; i++)
+		for (j = 0; j < 8; j++)
+			loadVSConstFloat(ctx, ctx->compat.palette[i][j],
+							FGFP_PALETTE(i) + j);
+	ctx->compat.paletteStart = 0;
+	ctx->compat.paletteEnd = 0;
+}
+
+static void flushProgram(fimgContext *ctx)
 {
+	fimgProgramCompat *prog = &ctx->compat.program;
+	struct shaderBlock blk;
 	uint32_t i;
-	const uint32_t *data = (const uint32_t *)pfData;
-	volatile uint32_t *reg = (volatile uint32_t *)(ctx->base
-						+ FGVS_CFLOAT_START + 16*slot);
-	for (i = 0; i < 4; i++) {
-#if 0
-		asm ( 	"ldmia %0!, {r0-r3}"
-			"stmia %1!, {r0-r3}"
-			: "=r"(data), "=r"(reg)
-			: "0"(data), "1"(reg)
-			: "r0", "r1", "r2", "r3");
-#else
-		*(reg++) = *(data++);
-		*(reg++) = *(data++);
-		*(reg++) = *(data++);
-		*(reg++) = *(data++);
-#endif
+	int slot;
+
+	if (prog->codeDirty) {
+		blk.data = prog->code[FGFP_PROGRAM_VERTEX];
+		blk.len = prog->len[FGFP_PROGRAM_VERTEX];
+		loadShaderBlock(&blk, vsInstAddr(ctx, 0));
+		ctx->compat.vshaderStart = 0;
+		ctx->compat.vshaderEnd = blk.len - 1;
+
+		loadShaderBlock(&vertexClear,
+				vsInstAddr(ctx, FGFP_CLEAR_VSHADER));
+		loadShaderBlock(&vertexDrawTex,
+				vsInstAddr(ctx, FGFP_DRAWTEX_VSHADER));
+
+		setVertexShaderOutputs(ctx, 0);
+		ctx->compat.vsSelectDirty = 1;
+	}
+
+	if (ctx->compat.vsSelectDirty) {
+		selectVertexShader(ctx);
+		ctx->compat.vsSelectDirty = 0;
+	}
+	setVertexShaderAttribCount(ctx, ctx->numAttribs);
+
+	for (i = prog->constStart[FGFP_PROGRAM_VERTEX];
+				i < prog->constEnd[FGFP_PROGRAM_VERTEX]; i++)
+		loadVSConstFloat(ctx, prog->consts[FGFP_PROGRAM_VERTEX][i], i);
+	prog->constStart[FGFP_PROGRAM_VERTEX] = 0;
+	prog->constEnd[FGFP_PROGRAM_VERTEX] = 0;
+
+	/* Matrices are loaded unpacked, as columns */
+	for (i = 0; i < 3 + FIMG_NUM_TEXTURE_UNITS; i++) {
+		slot = prog->matrix[i];
+		if (slot < 0 || !ctx->compat.matrixDirty[i]
+		    || ctx->compat.matrix[i] == NULL)
+			continue;
+
+		loadVSMatrix(ctx, ctx->compat.matrix[i], slot);
+		ctx->compat.matrixDirty[i] = 0;
 	}
+
+	/* Application programs do not output point size */
+	ctx->primitive.vctx.pointSize = 0;
+
+	for (i = 0; i < FIMG_NUM_TEXTURE_UNITS; i++) {
+		if (ctx->compat.texture[i].texture == NULL)
+			continue;
+
+		if (!ctx->compat.texture[i].enabled)
+			continue;
+
+		fimgSetupTexture(ctx, ctx->compat.texture[i].texture, i);
+	}
+
+	loadTexturePalette(ctx);
+
+	if (!prog->codeDirty && prog->constStart[FGFP_PROGRAM_PIXEL]
+					== prog->constEnd[FGFP_PROGRAM_PIXEL])
+		return;
+
+	setPixelShaderState(ctx, 0);
+
+	if (prog->codeDirty) {
+		blk.data = prog->code[FGFP_PROGRAM_PIXEL];
+		blk.len = prog->len[FGFP_PROGRAM_PIXEL];
+		loadShaderBlock(&blk, psInstAddr(ctx, 0));
+		ctx->compat.pshaderStart = 0;
+		ctx->compat.pshaderEnd = blk.len - 1;
+
+		setPixelShaderRange(ctx, 0, ctx->compat.pshaderEnd);
+
+		loadShaderBlock(&pixelClear,
+			psInstAddr(ctx, FIMG_SHADER_SLOTS - pixelClear.len));
+
+		setPixelShaderAttribCount(ctx, 8);
+		prog->codeDirty = 0;
+	}
+
+	for (i = prog->constStart[FGFP_PROGRAM_PIXEL];
+				i < prog->constEnd[FGFP_PROGRAM_PIXEL]; i++)
+		loadPSConstFloat(ctx, prog->consts[FGFP_PROGRAM_PIXEL][i], i);
+	prog->constStart[FGFP_PROGRAM_PIXEL] = 0;
+	prog->constEnd[FGFP_PROGRAM_PIXEL] = 0;
+
+	setPixelShaderState(ctx, 1);
 }
 
-void fimgCompatFlush(fimgContext *ctx)
+int fimgCompatFlush(fimgContext *ctx)
 {
+	fimgShaderVariant *variant;
 	uint32_t i;
 
+	if (ctx->compat.useProgram) {
+		flushProgram(ctx);
+		return 0;
+	}
+
 	if (ctx->compat.vsDirty) {
-		fimgCompatLoadVertexShader(ctx);
+		memset(ctx->compat.vsVariant, 0, sizeof(ctx->compat.vsVariant));
 		ctx->compat.vsDirty = 0;
 	}
+
+	variant = &ctx->compat.vsVariant[vertexShaderVariant(ctx)];
+	if (!variant->valid) {
+		/* Previous program stays, but does not match the state */
+		if (fimgCompatLoadVertexShader(ctx))
+			return -1;
+		ctx->compat.vsSelectDirty = 1;
+	} else if (variant->start != ctx->compat.vshaderStart) {
+		ctx->compat.vshaderStart = variant->start;
+		ctx->compat.vshaderEnd = variant->end;
+		setVertexShaderOutputs(ctx, ctx->compat.pointSize);
+		ctx->compat.vsSelectDirty = 1;
+	}
+
+	if (ctx->compat.vsSelectDirty) {
+		selectVertexShader(ctx);
+		ctx->compat.vsSelectDirty = 0;
+	}
 	setVertexShaderAttribCount(ctx, ctx->numAttribs);
 
-	for (i = 0; i < 2 + FIMG_NUM_TEXTURE_UNITS; i++) {
+	for (i = 0; i < 3 + FIMG_NUM_TEXTURE_UNITS; i++) {
 		if (!ctx->compat.matrixDirty[i] || ctx->compat.matrix[i] == NULL)
 			continue;
 
-		loadVSMatrix(ctx, ctx->compat.matrix[i], 4*i);
+		loadTransformMatrix(ctx, i);
 		ctx->compat.matrixDirty[i] = 0;
 	}
 
+	if (ctx->compat.lighting)
+		loadLightingConsts(ctx);
+
+	if (ctx->compat.paletteCount)
+		loadPaletteConsts(ctx);
+
+	if (ctx->compat.fog && ctx->compat.fogDirty)
+		loadVSConstFloat(ctx, ctx->compat.fogParams, FGFP_FOG_PARAMS);
+
+	if (ctx->compat.clipPlaneDirty) {
+		for (i = 0; i < FIMG_NUM_CLIP_PLANES; i++)
+			loadVSConstFloat(ctx, ctx->compat.clipPlaneEq[i],
+							FGFP_CLIP_PLANE(i));
+		ctx->compat.clipPlaneDirty = 0;
+	}
+
+	if (ctx->compat.pointAttenuation && ctx->compat.pointDirty) {
+		loadVSConstFloat(ctx, ctx->compat.pointParams,
+							FGFP_POINT_PARAMS);
+		ctx->compat.pointDirty = 0;
+	}
+
+	/* Picked up by vertex context setup of the draw */
+	ctx->primitive.vctx.pointSize = ctx->compat.pointSize;
+
+	for (i = 0; i < FIMG_NUM_TEXTURE_UNITS; i++) {
+		if (ctx->compat.texture[i].texture == NULL)
+			continue;
+
+		if (!ctx->compat.texture[i].enabled)
+			continue;
+
+		fimgSetupTexture(ctx, ctx->compat.texture[i].texture, i);
+	}
+
+	loadTexturePalette(ctx);
+
+	/* Pixel shader executor is only stopped if there is anything to write */
+	if (!pixelShaderChanged(ctx))
+		return 0;
+
 	setPixelShaderState(ctx, 0);
 
 	if (ctx->compat.psDirty) {
-		fimgCompatLoadPixelShader(ctx);
+		memset(ctx->compat.psVariant, 0, sizeof(ctx->compat.psVariant));
 		ctx->compat.psDirty = 0;
 	}
-	setPixelShaderAttribCount(ctx, 8);
+
+	variant = &ctx->compat.psVariant[pixelShaderVariant(ctx)];
+	if (!variant->valid) {
+		if (fimgCompatLoadPixelShader(ctx)) {
+			setPixelShaderState(ctx, 1);
+			return -1;
+		}
+		setPixelShaderAttribCount(ctx, 8);
+	} else if (variant->start != ctx->compat.pshaderStart) {
+		ctx->compat.pshaderStart = variant->start;
+		ctx->compat.pshaderEnd = variant->end;
+		setPixelShaderRange(ctx, variant->start, variant->end);
+	}
+
+	if (ctx->compat.psConstBool != pixelShaderConstBool(ctx)) {
+		ctx->compat.psConstBool = pixelShaderConstBool(ctx);
+		fimgWrite(ctx, ctx->compat.psConstBool, FGPS_CBOOL_START);
+	}
 
 	for (i = 0; i < FIMG_NUM_TEXTURE_UNITS; i++) {
 		if (ctx->compat.texture[i].texture == NULL)
@@ -668,9 +2069,6 @@ void fimgCompatFlush(fimgContext *ctx)
 		if (!ctx->compat.texture[i].enabled)
 			continue;
 
-		fimgSetupTexture(ctx, ctx->compat.texture[i].texture, i);
-		setPSConstBool(ctx, ctx->compat.texture[i].swap, i);
-
 		if (!ctx->compat.texture[i].dirty)
 			continue;
 
@@ -682,21 +2080,34 @@ void fimgCompatFlush(fimgContext *ctx)
 		ctx->compat.texture[i].dirty = 0;
 	}
 
+	if (ctx->compat.fog && ctx->compat.fogDirty) {
+		loadPSConstFloat(ctx, ctx->compat.fogColor, FGFP_FOG_COLOR);
+		ctx->compat.fogDirty = 0;
+	}
+
 	setPixelShaderState(ctx, 1);
+
+	return 0;
 }
 
 void fimgRestoreCompatState(fimgContext *ctx)
 {
-	uint32_t i;
+	fimgProgramCompat *prog = &ctx->compat.program;
+	uint32_t stage;
 
-	for (i = 0; i < 2 + FIMG_NUM_TEXTURE_UNITS; i++)
-		ctx->compat.matrixDirty[i] = 1;
+	/* Constant registers might have been changed by other contexts */
+	memset(ctx->compat.vsConstValid, 0, sizeof(ctx->compat.vsConstValid));
+	memset(ctx->compat.psConstValid, 0, sizeof(ctx->compat.psConstValid));
 
-	for (i = 0; i < FIMG_NUM_TEXTURE_UNITS; i++)
-		ctx->compat.texture[i].dirty = 1;
+	markCompatDirty(ctx);
 
-	ctx->compat.vsDirty = 1;
-	ctx->compat.psDirty = 1;
+	if (ctx->compat.useProgram) {
+		prog->codeDirty = 1;
+		for (stage = 0; stage < FGFP_PROGRAM_STAGES; stage++) {
+			prog->constStart[stage] = 0;
+			prog->constEnd[stage] = prog->numConsts[stage];
+		}
+	}
 
 	fimgCompatFlush(ctx);
 }
@@ -730,12 +2141,14 @@ void fimgClear(fimgContext *ctx, uint32_t mode)
 
 	// load clear vertex shader
 	setVertexShaderAttribCount(ctx, 1);
-	setVertexShaderRange(ctx, 512 - vertexClear.len, 511);
+	setVertexShaderRange(ctx, FGFP_CLEAR_VSHADER,
+						FIMG_SHADER_SLOTS - 1);
 
 	// load clear pixel shader
 	setPixelShaderState(ctx, 0);
 	setPixelShaderAttribCount(ctx, 1);
-	setPixelShaderRange(ctx, 512 - pixelClear.len, 511);
+	setPixelShaderRange(ctx, FIMG_SHADER_SLOTS - pixelClear.len,
+						FIMG_SHADER_SLOTS - 1);
 	loadPSConstFloat(ctx, ctx->clear.color, 255);
 	setPixelShaderState(ctx, 1);
 
@@ -772,6 +2185,7 @@ void fimgClear(fimgContext *ctx, uint32_t mode)
 
 	// setup context
 	fimgSetAttribCount(ctx, 1);
+	ctx->primitive.vctx.pointSize = 0;
 	fimgSetVertexContext(ctx, FGPE_POINTS);
 
 	// setup attribute
@@ -816,11 +2230,13 @@ void fimgClear(fimgContext *ctx, uint32_t mode)
 	fimgWrite(ctx, ctx->fragment.mask.val, FGPF_CBMSK);
 
 	// restore vertex shader
-	setVertexShaderRange(ctx, 0, ctx->compat.vshaderEnd);
+	selectVertexShader(ctx);
 
 	// restore pixel shader
 	setPixelShaderState(ctx, 0);
-	setPixelShaderRange(ctx, 0, ctx->compat.pshaderEnd);
+	setPixelShaderAttribCount(ctx, 8);
+	setPixelShaderRange(ctx, ctx->compat.pshaderStart,
+						ctx->compat.pshaderEnd);
 	setPixelShaderState(ctx, 1);
 
 	// release hardware
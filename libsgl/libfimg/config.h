@@ -37,6 +37,9 @@
 /* Use fixed pipeline emulation */
 #define FIMG_FIXED_PIPELINE
 
+/* Optimize shader code generated for fixed pipeline emulation */
+#define FIMG_SHADER_OPTIMIZER
+
 /* Flip the Y axis */
 #define FIMG_COORD_FLIP_Y
 
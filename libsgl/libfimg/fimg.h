@@ -78,7 +78,7 @@ uint32_t fimgGetInterruptState(fimgContext *ctx);
  * Host interface
  */
 
-#define FIMG_ATTRIB_NUM			8
+#define FIMG_ATTRIB_NUM			10
 
 /* Type definitions */
 #define FGHI_NUMCOMP(i)		((i) - 1)
@@ -312,6 +312,8 @@ void fimgSetTex2DSize(fimgTexture *texture,
 	unsigned int uSize, unsigned int vSize);
 void fimgSetTex3DSize(fimgTexture *texture, unsigned int vSize,
 				unsigned int uSize, unsigned int pSize);
+void fimgSetTexType(fimgTexture *texture, unsigned type);
+void fimgSetTexPaletteFormat(fimgTexture *texture, unsigned format);
 void fimgSetTexUAddrMode(fimgTexture *texture, unsigned mode);
 void fimgSetTexVAddrMode(fimgTexture *texture, unsigned mode);
 void fimgSetTexPAddrMode(fimgTexture *texture, unsigned mode);
@@ -326,15 +328,34 @@ void fimgSetTexCoordSys(fimgTexture *texture, unsigned mode);
 
 #ifdef FIMG_FIXED_PIPELINE
 
-#define FIMG_NUM_TEXTURE_UNITS	2
+/*
+ * Hardware has 8 texture units and 8 pixel shader inputs (6 used with
+ * 4 units), but vertex attributes are the limit: position, normal,
+ * color, point size, matrix index and weight leave 4 of FIMG_ATTRIB_NUM
+ * for texture coordinates.
+ */
+#define FIMG_NUM_TEXTURE_UNITS	4
+#define FIMG_NUM_LIGHTS		8
+#define FIMG_NUM_CLIP_PLANES	3
+#define FIMG_NUM_PALETTE_MATRICES	16
+#define FIMG_NUM_VERTEX_UNITS	4
+#define FIMG_PALETTE_SIZE	256
 
 typedef enum {
 	FGFP_MATRIX_TRANSFORM = 0,
 	FGFP_MATRIX_LIGHTING,
+	FGFP_MATRIX_MODELVIEW,
 	FGFP_MATRIX_TEXTURE
 } fimgMatrix;
 #define FGFP_MATRIX_TEXTURE(i)	(FGFP_MATRIX_TEXTURE + (i))
 
+typedef enum {
+	FGFP_MATRIX_CLASS_IDENTITY = 0,
+	FGFP_MATRIX_CLASS_SCALE_TRANSLATE,
+	FGFP_MATRIX_CLASS_AFFINE_2D,
+	FGFP_MATRIX_CLASS_GENERAL
+} fimgMatrixClass;
+
 typedef enum {
 	FGFP_TEXFUNC_REPLACE = 0,
 	FGFP_TEXFUNC_MODULATE,
@@ -344,6 +365,12 @@ typedef enum {
 	FGFP_TEXFUNC_COMBINE
 } fimgTexFunc;
 
+typedef enum {
+	FGFP_TEXGEN_NONE = 0,
+	FGFP_TEXGEN_REFLECTION_MAP,
+	FGFP_TEXGEN_NORMAL_MAP
+} fimgTexGenMode;
+
 typedef enum {
 	FGFP_COMBFUNC_REPLACE = 0,
 	FGFP_COMBFUNC_MODULATE,
@@ -369,10 +396,58 @@ typedef enum {
 	FGFP_COMBARG_ONE_MINUS_SRC_ALPHA
 } fimgCombArgMod;
 
+typedef enum {
+	FGFP_LIGHT_DIRECTIONAL = 0,
+	FGFP_LIGHT_POINT,
+	FGFP_LIGHT_SPOT
+} fimgLightType;
+
+typedef enum {
+	FGFP_LIGHT_POSITION = 0,
+	FGFP_LIGHT_AMBIENT,
+	FGFP_LIGHT_DIFFUSE,
+	FGFP_LIGHT_SPECULAR,
+	FGFP_LIGHT_HALF_VECTOR,
+	FGFP_LIGHT_SPOT_DIRECTION,
+	FGFP_LIGHT_ATTENUATION,
+	FGFP_LIGHT_PARAMS
+} fimgLightParam;
+
+typedef enum {
+	FGFP_FOG_LINEAR = 0,
+	FGFP_FOG_EXP,
+	FGFP_FOG_EXP2
+} fimgFogMode;
+
+typedef enum {
+	FGFP_PROGRAM_VERTEX = 0,
+	FGFP_PROGRAM_PIXEL,
+	FGFP_PROGRAM_STAGES
+} fimgProgramStage;
+
+/* Number of float constant registers of each shader */
+#define FIMG_NUM_CONST_FLOAT	256
+
+/*
+ * Application supplied shader pair used in place of the generated one.
+ * Code is in the hardware format (4 words per instruction), constants
+ * start at c0. Each entry of matrix[] is the vertex shader constant
+ * register receiving columns of given FGFP_MATRIX_* matrix or -1.
+ */
+typedef struct {
+	const uint32_t *code[FGFP_PROGRAM_STAGES];
+	uint32_t len[FGFP_PROGRAM_STAGES];
+	const float *consts[FGFP_PROGRAM_STAGES];
+	uint32_t numConsts[FGFP_PROGRAM_STAGES];
+	int matrix[3 + FIMG_NUM_TEXTURE_UNITS];
+} fimgProgram;
+
 void fimgLoadMatrix(fimgContext *ctx, unsigned int matrix, const float *pData);
+void fimgSetMatrixClass(fimgContext *ctx, unsigned int matrix,
+						fimgMatrixClass cls);
 void fimgEnableTexture(fimgContext *ctx, unsigned int unit);
 void fimgDisableTexture(fimgContext *ctx, unsigned int unit);
-void fimgCompatLoadPixelShader(fimgContext *ctx);
+int fimgCompatLoadPixelShader(fimgContext *ctx);
 void fimgCompatSetTextureEnable(fimgContext *ctx, unsigned unit, int enable);
 void fimgCompatSetTextureFunc(fimgContext *ctx, unsigned unit, fimgTexFunc func);
 void fimgCompatSetColorCombiner(fimgContext *ctx, unsigned unit,
@@ -391,8 +466,45 @@ void fimgCompatSetColorScale(fimgContext *ctx, unsigned unit, float scale);
 void fimgCompatSetAlphaScale(fimgContext *ctx, unsigned unit, float scale);
 void fimgCompatSetEnvColor(fimgContext *ctx, unsigned unit,
 					float r, float g, float b, float a);
+void fimgCompatSetTexGen(fimgContext *ctx, unsigned unit,
+						fimgTexGenMode mode);
 void fimgCompatSetupTexture(fimgContext *ctx, fimgTexture *tex,
 						uint32_t unit, int swap);
+void fimgCompatSetTexturePalette(fimgContext *ctx, const uint32_t *entries,
+							unsigned count);
+void fimgCompatSetPrimaryWhite(fimgContext *ctx, int white);
+void fimgCompatSetLightingEnable(fimgContext *ctx, int enable);
+void fimgCompatSetLightEnable(fimgContext *ctx, unsigned light, int enable);
+void fimgCompatSetLightType(fimgContext *ctx, unsigned light,
+							fimgLightType type);
+void fimgCompatSetLightParam(fimgContext *ctx, unsigned light,
+				fimgLightParam param, const float *vec);
+void fimgCompatSetSceneColor(fimgContext *ctx, const float *color);
+void fimgCompatSetShininess(fimgContext *ctx, float shininess);
+void fimgCompatSetFogEnable(fimgContext *ctx, int enable);
+void fimgCompatSetFogMode(fimgContext *ctx, fimgFogMode mode);
+void fimgCompatSetFogParams(fimgContext *ctx,
+				float start, float end, float density);
+void fimgCompatSetFogColor(fimgContext *ctx,
+				float r, float g, float b, float a);
+void fimgCompatSetClipPlaneEnable(fimgContext *ctx, unsigned plane,
+								int enable);
+void fimgCompatSetClipPlane(fimgContext *ctx, unsigned plane,
+							const float *eq);
+void fimgCompatSetPointSizeEnable(fimgContext *ctx, int enable);
+void fimgCompatSetPointAttenuationEnable(fimgContext *ctx, int enable);
+void fimgCompatSetPointAttenuation(fimgContext *ctx, const float *coeffs);
+void fimgCompatSetCoordReplace(fimgContext *ctx, unsigned unit);
+void fimgCompatSetDrawTexture(fimgContext *ctx, int enable);
+void fimgCompatSetMatrixPalette(fimgContext *ctx, unsigned count);
+void fimgCompatSetVertexUnits(fimgContext *ctx, unsigned units);
+void fimgCompatSetPaletteMatrix(fimgContext *ctx, unsigned index,
+				const float *matrix, const float *inverse);
+uint32_t fimgCompatGetProgramSlots(fimgProgramStage stage);
+uint32_t fimgCompatGetProgramConsts(fimgProgramStage stage);
+int fimgCompatSetProgram(fimgContext *ctx, const fimgProgram *prog);
+void fimgCompatSetProgramConst(fimgContext *ctx, fimgProgramStage stage,
+			uint32_t slot, const float *values, uint32_t count);
 
 #endif
 
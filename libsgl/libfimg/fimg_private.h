@@ -456,6 +456,7 @@ typedef struct {
 	int enabled;
 	int dirty;
 	fimgTexFunc func;
+	fimgTexGenMode texGen;
 	fimgCombiner combc;
 	fimgCombiner comba;
 	float env[4];
@@ -464,20 +465,118 @@ typedef struct {
 	int swap;
 } fimgTextureCompat;
 
+typedef struct {
+	int enabled;
+	int dirty;
+	fimgLightType type;
+	float params[FGFP_LIGHT_PARAMS][4];
+} fimgLightCompat;
+
+/* Size of shader instruction memory (in instructions) */
+#define FIMG_SHADER_SLOTS	512
+
+typedef struct {
+	uint32_t code[FGFP_PROGRAM_STAGES][4*FIMG_SHADER_SLOTS];
+	uint32_t len[FGFP_PROGRAM_STAGES];
+	float consts[FGFP_PROGRAM_STAGES][FIMG_NUM_CONST_FLOAT][4];
+	uint32_t numConsts[FGFP_PROGRAM_STAGES];
+	int matrix[3 + FIMG_NUM_TEXTURE_UNITS];
+	int codeDirty;
+	/* Range of constants to upload */
+	uint32_t constStart[FGFP_PROGRAM_STAGES];
+	uint32_t constEnd[FGFP_PROGRAM_STAGES];
+} fimgProgramCompat;
+
+/* Generated shader kept resident in instruction memory */
+typedef struct {
+	int valid;
+	uint32_t start;
+	uint32_t end;
+} fimgShaderVariant;
+
+/* Shader variants, switched without generating the shader again */
+enum {
+	FGFP_VSHADER_DEFAULT = 0,
+	FGFP_VSHADER_POINT_SIZE,	/* point size output for points */
+	FGFP_VSHADER_VARIANTS
+};
+
+enum {
+	FGFP_PSHADER_DEFAULT = 0,
+	FGFP_PSHADER_WHITE,		/* primary color is known to be white */
+	FGFP_PSHADER_VARIANTS
+};
+
 typedef struct {
 	int vsDirty;
+	int vsSelectDirty;
+	uint32_t vshaderStart;
 	uint32_t vshaderEnd;
+	fimgShaderVariant vsVariant[FGFP_VSHADER_VARIANTS];
 	int psDirty;
+	uint32_t pshaderStart;
 	uint32_t pshaderEnd;
+	fimgShaderVariant psVariant[FGFP_PSHADER_VARIANTS];
+	/* Last flushed value of boolean constants */
+	uint32_t psConstBool;
+	int primaryWhite;
 	fimgTextureCompat texture[FIMG_NUM_TEXTURE_UNITS];
-	int matrixDirty[2 + FIMG_NUM_TEXTURE_UNITS];
-	const float *matrix[2 + FIMG_NUM_TEXTURE_UNITS];
+	int matrixDirty[3 + FIMG_NUM_TEXTURE_UNITS];
+	const float *matrix[3 + FIMG_NUM_TEXTURE_UNITS];
+	fimgMatrixClass matrixClass[3 + FIMG_NUM_TEXTURE_UNITS];
+	int lighting;
+	int lightModelDirty;
+	float lightModel[3][4];
+	fimgLightCompat light[FIMG_NUM_LIGHTS];
+	int fog;
+	int fogDirty;
+	fimgFogMode fogMode;
+	float fogParams[4];
+	float fogColor[4];
+	int clipPlane[FIMG_NUM_CLIP_PLANES];
+	int clipPlaneDirty;
+	float clipPlaneEq[FIMG_NUM_CLIP_PLANES][4];
+	int pointSize;
+	int pointAttenuation;
+	int pointDirty;
+	float pointParams[4];
+	int drawTex;
+	uint32_t paletteCount;
+	float vertexUnits[4];
+	int vertexUnitsDirty;
+	float palette[FIMG_NUM_PALETTE_MATRICES][8][4];
+	/* Range of palette matrices to upload */
+	uint32_t paletteStart;
+	uint32_t paletteEnd;
+	int useProgram;
+	fimgProgramCompat program;
+	/* Shadow of constant registers, to skip redundant uploads */
+	uint32_t vsConst[FIMG_NUM_CONST_FLOAT][4];
+	uint32_t psConst[FIMG_NUM_CONST_FLOAT][4];
+	uint32_t vsConstValid[FIMG_NUM_CONST_FLOAT / 32];
+	uint32_t psConstValid[FIMG_NUM_CONST_FLOAT / 32];
+	/* Texture palette, shared by all texture units */
+	uint32_t texPalette[FIMG_PALETTE_SIZE];
+	uint32_t texPaletteSize;
+	int texPaletteDirty;
 	/* More to come */
 } fimgCompatContext;
 
 void fimgCreateCompatContext(fimgContext *ctx);
+void fimgLoadTexPalette(fimgContext *ctx, const uint32_t *entries,
+							unsigned count);
 void fimgRestoreCompatState(fimgContext *ctx);
-void fimgCompatFlush(fimgContext *ctx);
+int fimgCompatFlush(fimgContext *ctx);
+
+#ifdef FIMG_SHADER_OPTIMIZER
+/* Values of registers known to the optimizer */
+enum {
+	FGSO_KNOWN_CONSTANTS	= (1 << 0), /* c0 = 0.0, c1 = 1.0 */
+	FGSO_INPUT0_WHITE	= (1 << 1)  /* v0 = 1.0 (needs constants) */
+};
+
+uint32_t fimgOptimizeShader(uint32_t *code, uint32_t len, uint32_t flags);
+#endif
 
 #endif
 
@@ -620,11 +719,14 @@ static inline void fimgGetHardware(fimgContext *ctx)
 	}
 }
 
-static inline void fimgFlushContext(fimgContext *ctx)
+/* Returns non-zero if the context can not be used for drawing */
+static inline int fimgFlushContext(fimgContext *ctx)
 {
 	fimgQueueFlush(ctx);
 #ifdef FIMG_FIXED_PIPELINE
-	fimgCompatFlush(ctx);
+	return fimgCompatFlush(ctx);
+#else
+	return 0;
 #endif
 }
 
@@ -183,7 +183,11 @@ void fimgDrawArrays(fimgContext *ctx, unsigned int mode, fimgArray *arrays,
 	// Get hardware lock
 	fimgGetHardware(ctx);
 	fimgFlush(ctx);
-	fimgFlushContext(ctx);
+	if (fimgFlushContext(ctx)) {
+		// Shaders for current state do not fit, skip the draw
+		fimgPutHardware(ctx);
+		return;
+	}
 	fimgSetVertexContext(ctx, mode);
 
 	// write attribute configuration
@@ -230,7 +234,11 @@ void fimgDrawElementsUByteIdx(fimgContext *ctx, unsigned int mode, fimgArray *ar
 	// Get hardware lock
 	fimgGetHardware(ctx);
 	fimgFlush(ctx);
-	fimgFlushContext(ctx);
+	if (fimgFlushContext(ctx)) {
+		// Shaders for current state do not fit, skip the draw
+		fimgPutHardware(ctx);
+		return;
+	}
 	fimgSetVertexContext(ctx, mode);
 
 	// write attribute configuration
@@ -277,7 +285,11 @@ void fimgDrawElementsUShortIdx(fimgContext *ctx, unsigned int mode, fimgArray *a
 	// Get hardware lock
 	fimgGetHardware(ctx);
 	fimgFlush(ctx);
-	fimgFlushContext(ctx);
+	if (fimgFlushContext(ctx)) {
+		// Shaders for current state do not fit, skip the draw
+		fimgPutHardware(ctx);
+		return;
+	}
 	fimgSetVertexContext(ctx, mode);
 
 	// write attribute configuration
@@ -685,7 +697,11 @@ void fimgDrawArraysBuffered(fimgContext *ctx, unsigned int mode, fimgArray *arra
 	// Get hardware lock
 	fimgGetHardware(ctx);
 	fimgFlush(ctx);
-	fimgFlushContext(ctx);
+	if (fimgFlushContext(ctx)) {
+		// Shaders for current state do not fit, skip the draw
+		fimgPutHardware(ctx);
+		return;
+	}
 
 	fimgSetVertexContext(ctx, mode);
 	fimgSetupAttributes(ctx, arrays);
@@ -1036,7 +1052,11 @@ void fimgDrawElementsBufferedUByteIdx(fimgContext *ctx, unsigned int mode, fimgA
 	// Flush the context
 	fimgGetHardware(ctx);
 	fimgFlush(ctx);
-	fimgFlushContext(ctx);
+	if (fimgFlushContext(ctx)) {
+		// Shaders for current state do not fit, skip the draw
+		fimgPutHardware(ctx);
+		return;
+	}
 
 	fimgSetVertexContext(ctx, mode);
 	fimgSetupAttributes(ctx, arrays);
@@ -1381,7 +1401,11 @@ void fimgDrawElementsBufferedUShortIdx(fimgContext *ctx, unsigned int mode, fimg
 	// Flush the context
 	fimgGetHardware(ctx);
 	fimgFlush(ctx);
-	fimgFlushContext(ctx);
+	if (fimgFlushContext(ctx)) {
+		// Shaders for current state do not fit, skip the draw
+		fimgPutHardware(ctx);
+		return;
+	}
 
 	fimgSetVertexContext(ctx, mode);
 	fimgSetupAttributes(ctx, arrays);
@@ -0,0 +1,705 @@
+/*
+ * fimg/optimizer.c
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE SHADER PEEPHOLE OPTIMIZER
+ *
+ * Copyrights:	2010 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "fimg_private.h"
+
+#ifdef FIMG_SHADER_OPTIMIZER
+
+/*
+ * Instruction encoding
+ *
+ * Every instruction is made of four words:
+ *	word 0:	[31:24] src1 number, [23:16] src2 swizzle,
+ *		[15:8] src2 type, [7:0] src2 number
+ *	word 1:	[31:24] src0 type, [23:16] src0 number,
+ *		[15:8] src1 swizzle, [7:0] src1 type
+ *	word 2:	[29] next mad depends on result, [28:23] opcode,
+ *		[22:19] write mask, [17] saturate, [15:8] destination
+ *		(branch offset for bf), [7:0] src0 swizzle
+ *	word 3:	reserved
+ */
+
+#define OPC_MOV			0x01
+#define OPC_ADD			0x04
+#define OPC_MUL			0x06
+#define OPC_DP3			0x08
+#define OPC_MAD			0x1d
+#define OPC_TEXLD		0x20
+#define OPC_BF			0x31
+#define OPC_RET			0x3c
+
+#define INST_OPCODE(i)		(((i)[2] >> 23) & 0x3f)
+#define INST_MASK(i)		(((i)[2] >> 19) & 0xf)
+#define INST_SAT(i)		(((i)[2] >> 17) & 1)
+#define INST_DEST(i)		(((i)[2] >> 8) & 0xff)
+#define INST_MAD_DEP		(1 << 29)
+
+#define DEST_TYPE_MASK		0xe0
+#define DEST_TYPE_TEMP		0x20
+#define DEST_NUM(d)		((d) & 0x1f)
+
+#define SRC_NEGATE		0x40
+#define SRC_TYPE(t)		((t) & ~SRC_NEGATE)
+#define SRC_TYPE_INPUT		0x00
+#define SRC_TYPE_TEMP		0x01
+#define SRC_TYPE_CONST		0x02
+
+#define SWIZZLE_IDENTITY	0xe4
+#define SWIZZLE_COMP(s, c)	(((s) >> (2*(c))) & 3)
+
+#define NUM_TEMPS		32
+#define MAX_BRANCHES		16
+
+typedef struct {
+	uint8_t type;
+	uint8_t num;
+	uint8_t swz;
+} fimgOperand;
+
+typedef struct {
+	int valid;
+	fimgOperand src;
+} fimgCopy;
+
+typedef struct {
+	uint32_t target;
+	int valid;
+	fimgCopy copy[NUM_TEMPS];
+} fimgBranchState;
+
+static void getSrc(const uint32_t *inst, int n, fimgOperand *op)
+{
+	switch (n) {
+	case 0:
+		op->type = inst[1] >> 24;
+		op->num = inst[1] >> 16;
+		op->swz = inst[2];
+		break;
+	case 1:
+		op->type = inst[1];
+		op->num = inst[0] >> 24;
+		op->swz = inst[1] >> 8;
+		break;
+	default:
+		op->type = inst[0] >> 8;
+		op->num = inst[0];
+		op->swz = inst[0] >> 16;
+	}
+}
+
+static void setSrc(uint32_t *inst, int n, const fimgOperand *op)
+{
+	switch (n) {
+	case 0:
+		inst[1] = (inst[1] & 0x0000ffff) | (op->type << 24)
+							| (op->num << 16);
+		inst[2] = (inst[2] & 0xffffff00) | op->swz;
+		break;
+	case 1:
+		inst[1] = (inst[1] & 0xffff0000) | (op->swz << 8) | op->type;
+		inst[0] = (inst[0] & 0x00ffffff) | (op->num << 24);
+		break;
+	default:
+		inst[0] = (inst[0] & 0xff000000) | (op->swz << 16)
+						| (op->type << 8) | op->num;
+	}
+}
+
+static void clearSrc(uint32_t *inst, int n)
+{
+	fimgOperand zero = { 0, 0, 0 };
+
+	setSrc(inst, n, &zero);
+}
+
+static inline void setOpcode(uint32_t *inst, uint32_t opcode)
+{
+	inst[2] = (inst[2] & ~(0x3f << 23)) | (opcode << 23);
+}
+
+static inline void setMask(uint32_t *inst, uint32_t mask)
+{
+	inst[2] = (inst[2] & ~(0xf << 19)) | (mask << 19);
+}
+
+/* Returns the number of sources of ALU instructions we can reason about */
+static int numSources(uint32_t opcode)
+{
+	switch (opcode) {
+	case OPC_MOV:
+		return 1;
+	case OPC_ADD:
+	case OPC_MUL:
+	case OPC_DP3:
+		return 2;
+	case OPC_MAD:
+		return 3;
+	default:
+		return -1;
+	}
+}
+
+static inline int isTemp(const fimgOperand *op)
+{
+	return SRC_TYPE(op->type) == SRC_TYPE_TEMP;
+}
+
+static inline int destTemp(const uint32_t *inst)
+{
+	uint32_t dest = INST_DEST(inst);
+
+	if ((dest & DEST_TYPE_MASK) != DEST_TYPE_TEMP)
+		return -1;
+
+	return DEST_NUM(dest);
+}
+
+/* Components of the source register read by given instruction */
+static uint32_t readComponents(const uint32_t *inst, const fimgOperand *op)
+{
+	uint32_t c, mask, comps = 0;
+
+	if (INST_OPCODE(inst) == OPC_DP3)
+		mask = 0x7;
+	else
+		mask = INST_MASK(inst);
+
+	for (c = 0; c < 4; c++)
+		if (mask & (1 << c))
+			comps |= 1 << SWIZZLE_COMP(op->swz, c);
+
+	return comps;
+}
+
+/* Swizzle of a value read with swizzle outer from register read with inner */
+static inline uint8_t composeSwizzle(uint8_t inner, uint8_t outer)
+{
+	uint32_t c, swz = 0;
+
+	for (c = 0; c < 4; c++)
+		swz |= SWIZZLE_COMP(inner, SWIZZLE_COMP(outer, c)) << (2*c);
+
+	return swz;
+}
+
+/*
+ * The generated blocks never read two different registers of the same
+ * non-temporary file in one instruction, so don't create such either.
+ */
+static int checkReadPorts(const uint32_t *inst)
+{
+	fimgOperand op[3];
+	int i, j, n = numSources(INST_OPCODE(inst));
+
+	for (i = 0; i < n; i++)
+		getSrc(inst, i, &op[i]);
+
+	for (i = 0; i < n; i++) {
+		if (isTemp(&op[i]))
+			continue;
+
+		for (j = i + 1; j < n; j++)
+			if (SRC_TYPE(op[i].type) == SRC_TYPE(op[j].type)
+			    && op[i].num != op[j].num)
+				return 0;
+	}
+
+	return 1;
+}
+
+/* Value of a source operand if it is one of known constants (c0, c1) */
+static int constValue(const fimgOperand *op, uint32_t flags, int *val)
+{
+	if (!(flags & FGSO_KNOWN_CONSTANTS))
+		return 0;
+
+	if (SRC_TYPE(op->type) != SRC_TYPE_CONST || op->num > 1)
+		return 0;
+
+	*val = op->num;
+	if (op->type & SRC_NEGATE)
+		*val = -*val;
+
+	return 1;
+}
+
+static inline int isConst(const fimgOperand *op, uint32_t flags, int val)
+{
+	int v;
+
+	return constValue(op, flags, &v) && v == val;
+}
+
+/*
+ * Rewrites arithmetic on known constants into cheaper operations.
+ * Returns 1 if the instruction became a no-op and can be removed.
+ */
+static int simplifyInstruction(uint32_t *inst, uint32_t flags)
+{
+	fimgOperand a, b, c, zero;
+	uint32_t comp;
+	int again = 1;
+
+	while (again) {
+		again = 0;
+
+		getSrc(inst, 0, &a);
+		getSrc(inst, 1, &b);
+		getSrc(inst, 2, &c);
+
+		switch (INST_OPCODE(inst)) {
+		case OPC_MOV:
+			/* mov rX, rX with identity swizzle on written comps */
+			if (!isTemp(&a) || (a.type & SRC_NEGATE)
+			    || INST_SAT(inst) || destTemp(inst) != a.num)
+				break;
+
+			for (comp = 0; comp < 4; comp++)
+				if ((INST_MASK(inst) & (1 << comp))
+				    && SWIZZLE_COMP(a.swz, comp) != comp)
+					break;
+
+			if (comp == 4)
+				return 1;
+			break;
+		case OPC_ADD:
+			if (isConst(&a, flags, 0)) {
+				setSrc(inst, 0, &b);
+			} else if (!isConst(&b, flags, 0)) {
+				break;
+			}
+			clearSrc(inst, 1);
+			setOpcode(inst, OPC_MOV);
+			again = 1;
+			break;
+		case OPC_MUL:
+			if (isConst(&a, flags, 0) || isConst(&b, flags, 0)) {
+				zero.type = SRC_TYPE_CONST;
+				zero.num = 0;
+				zero.swz = SWIZZLE_IDENTITY;
+				setSrc(inst, 0, &zero);
+			} else if (isConst(&a, flags, 1)) {
+				setSrc(inst, 0, &b);
+			} else if (isConst(&a, flags, -1)) {
+				b.type ^= SRC_NEGATE;
+				setSrc(inst, 0, &b);
+			} else if (isConst(&b, flags, -1)) {
+				a.type ^= SRC_NEGATE;
+				setSrc(inst, 0, &a);
+			} else if (!isConst(&b, flags, 1)) {
+				break;
+			}
+			clearSrc(inst, 1);
+			setOpcode(inst, OPC_MOV);
+			again = 1;
+			break;
+		case OPC_MAD:
+			if (isConst(&a, flags, 0) || isConst(&b, flags, 0)) {
+				setSrc(inst, 0, &c);
+				clearSrc(inst, 1);
+				setOpcode(inst, OPC_MOV);
+			} else if (isConst(&c, flags, 0)) {
+				setOpcode(inst, OPC_MUL);
+			} else if (isConst(&a, flags, 1)) {
+				setSrc(inst, 0, &b);
+				setSrc(inst, 1, &c);
+				setOpcode(inst, OPC_ADD);
+			} else if (isConst(&b, flags, 1)) {
+				setSrc(inst, 1, &c);
+				setOpcode(inst, OPC_ADD);
+			} else {
+				break;
+			}
+			clearSrc(inst, 2);
+			again = 1;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+static void invalidateCopies(fimgCopy *copy, int reg)
+{
+	int i;
+
+	copy[reg].valid = 0;
+
+	for (i = 0; i < NUM_TEMPS; i++)
+		if (copy[i].valid && isTemp(&copy[i].src)
+		    && copy[i].src.num == reg)
+			copy[i].valid = 0;
+}
+
+static void mergeCopies(fimgCopy *dst, const fimgCopy *src)
+{
+	int i;
+
+	for (i = 0; i < NUM_TEMPS; i++)
+		if (dst[i].valid && (!src[i].valid
+		    || memcmp(&dst[i].src, &src[i].src, sizeof(fimgOperand))))
+			dst[i].valid = 0;
+}
+
+static fimgBranchState *findBranch(fimgBranchState *br, int num,
+							uint32_t target)
+{
+	int i;
+
+	for (i = 0; i < num; i++)
+		if (br[i].target == target)
+			return &br[i];
+
+	return NULL;
+}
+
+/*
+ * Forward pass: propagates copies into their consumers and simplifies
+ * operations on known constants.
+ */
+static void propagateCopies(uint32_t *code, uint32_t len, uint8_t *removed,
+			fimgBranchState *br, int numBranches, uint32_t flags)
+{
+	fimgCopy copy[NUM_TEMPS];
+	fimgBranchState *state;
+	fimgOperand op;
+	uint32_t i, opcode, tmp[4];
+	int n, s, dest, fallthrough = 1;
+
+	memset(copy, 0, sizeof(copy));
+
+	for (i = 0; i < len; i++) {
+		uint32_t *inst = &code[4*i];
+
+		state = findBranch(br, numBranches, i);
+		if (state) {
+			if (!state->valid)
+				memset(copy, 0, sizeof(copy));
+			else if (fallthrough)
+				mergeCopies(copy, state->copy);
+			else
+				memcpy(copy, state->copy, sizeof(copy));
+		}
+
+		fallthrough = 1;
+
+		if (removed[i])
+			continue;
+
+		opcode = INST_OPCODE(inst);
+
+		if (opcode == OPC_BF) {
+			state = findBranch(br, numBranches,
+						i + 1 + INST_DEST(inst));
+			if (state->valid) {
+				mergeCopies(state->copy, copy);
+			} else {
+				memcpy(state->copy, copy, sizeof(copy));
+				state->valid = 1;
+			}
+			continue;
+		}
+
+		if (opcode == OPC_RET) {
+			fallthrough = 0;
+			continue;
+		}
+
+		if (opcode == OPC_TEXLD) {
+			dest = destTemp(inst);
+			if (dest >= 0)
+				invalidateCopies(copy, dest);
+			continue;
+		}
+
+		n = numSources(opcode);
+		if (n < 0) {
+			/* Don't know what it does, so forget everything */
+			memset(copy, 0, sizeof(copy));
+			continue;
+		}
+
+		for (s = 0; s < n; s++) {
+			getSrc(inst, s, &op);
+
+			if ((flags & FGSO_INPUT0_WHITE)
+			    && SRC_TYPE(op.type) == SRC_TYPE_INPUT
+			    && op.num == 0) {
+				op.type = (op.type & SRC_NEGATE) | SRC_TYPE_CONST;
+				op.num = 1;
+			} else if (isTemp(&op) && copy[op.num].valid) {
+				const fimgOperand *src = &copy[op.num].src;
+
+				op.swz = composeSwizzle(src->swz, op.swz);
+				op.type = src->type ^ (op.type & SRC_NEGATE);
+				op.num = src->num;
+			} else {
+				continue;
+			}
+
+			memcpy(tmp, inst, sizeof(tmp));
+			setSrc(inst, s, &op);
+			if (!checkReadPorts(inst))
+				memcpy(inst, tmp, sizeof(tmp));
+		}
+
+		if (simplifyInstruction(inst, flags)) {
+			removed[i] = 1;
+			continue;
+		}
+
+		dest = destTemp(inst);
+		if (dest < 0)
+			continue;
+
+		invalidateCopies(copy, dest);
+
+		if (INST_OPCODE(inst) != OPC_MOV || INST_SAT(inst)
+		    || INST_MASK(inst) != 0xf)
+			continue;
+
+		getSrc(inst, 0, &op);
+		if (isTemp(&op) && op.num == dest)
+			continue;
+
+		copy[dest].src = op;
+		copy[dest].valid = 1;
+	}
+}
+
+/*
+ * Backward pass: drops writes to temporaries that are never read and
+ * narrows write masks to the components which are.
+ */
+static void removeDeadCode(uint32_t *code, uint32_t len, uint8_t *removed,
+			const uint32_t *targets, int numTargets)
+{
+	uint8_t live[NUM_TEMPS];
+	uint8_t liveAt[MAX_BRANCHES][NUM_TEMPS];
+	fimgOperand op;
+	uint32_t opcode, mask;
+	int i, t, n, s, dest;
+
+	memset(live, 0, sizeof(live));
+	memset(liveAt, 0, sizeof(liveAt));
+
+	for (i = len - 1; i >= 0; i--) {
+		uint32_t *inst = &code[4*i];
+
+		if (removed[i])
+			goto save;
+
+		opcode = INST_OPCODE(inst);
+
+		if (opcode == OPC_RET) {
+			memset(live, 0, sizeof(live));
+			goto save;
+		}
+
+		if (opcode == OPC_BF) {
+			for (t = 0; t < numTargets; t++)
+				if (targets[t] == i + 1 + INST_DEST(inst))
+					break;
+
+			for (s = 0; s < NUM_TEMPS; s++)
+				live[s] |= liveAt[t][s];
+			goto save;
+		}
+
+		n = numSources(opcode);
+		if (n < 0 && opcode != OPC_TEXLD) {
+			memset(live, 0xf, sizeof(live));
+			goto save;
+		}
+
+		dest = destTemp(inst);
+		if (dest >= 0) {
+			mask = INST_MASK(inst) & live[dest];
+			if (!mask) {
+				removed[i] = 1;
+				goto save;
+			}
+
+			if (opcode != OPC_TEXLD && mask != INST_MASK(inst))
+				setMask(inst, mask);
+
+			live[dest] &= ~mask;
+		}
+
+		if (opcode == OPC_TEXLD) {
+			getSrc(inst, 0, &op);
+			if (isTemp(&op))
+				live[op.num] = 0xf;
+			goto save;
+		}
+
+		for (s = 0; s < n; s++) {
+			getSrc(inst, s, &op);
+			if (isTemp(&op))
+				live[op.num] |= readComponents(inst, &op);
+		}
+
+save:
+		for (t = 0; t < numTargets; t++)
+			if (targets[t] == i)
+				memcpy(liveAt[t], live, sizeof(live));
+	}
+}
+
+/* Number of instructions left in range [start, end) */
+static inline uint32_t countLive(const uint8_t *removed,
+						uint32_t start, uint32_t end)
+{
+	uint32_t count = 0;
+
+	for (; start < end; start++)
+		count += !removed[start];
+
+	return count;
+}
+
+static uint32_t compact(uint32_t *code, uint32_t len, uint8_t *removed)
+{
+	uint32_t i, out, target;
+	int changed;
+
+	/* Drop branches that no longer skip anything */
+	do {
+		changed = 0;
+		for (i = 0; i < len; i++) {
+			if (removed[i] || INST_OPCODE(&code[4*i]) != OPC_BF)
+				continue;
+
+			target = i + 1 + INST_DEST(&code[4*i]);
+			if (countLive(removed, i + 1, target))
+				continue;
+
+			removed[i] = 1;
+			changed = 1;
+		}
+	} while (changed);
+
+	for (i = 0; i < len; i++) {
+		if (removed[i] || INST_OPCODE(&code[4*i]) != OPC_BF)
+			continue;
+
+		target = i + 1 + INST_DEST(&code[4*i]);
+		code[4*i + 2] &= ~(0xff << 8);
+		code[4*i + 2] |= countLive(removed, i + 1, target) << 8;
+	}
+
+	for (i = 0, out = 0; i < len; i++) {
+		if (removed[i])
+			continue;
+
+		if (out != i)
+			memcpy(&code[4*out], &code[4*i], 16);
+		++out;
+	}
+
+	return out;
+}
+
+/* The assembler flags instructions whose result feeds the following mad */
+static void updateMadDependencies(uint32_t *code, uint32_t len)
+{
+	fimgOperand op;
+	uint32_t i, opcode;
+	int s, dest;
+
+	for (i = 0; i < len; i++) {
+		uint32_t *inst = &code[4*i];
+
+		opcode = INST_OPCODE(inst);
+		if (opcode == OPC_BF || opcode == OPC_RET)
+			continue;
+
+		inst[2] &= ~INST_MAD_DEP;
+
+		dest = destTemp(inst);
+		if (dest < 0 || i + 1 == len)
+			continue;
+
+		if (INST_OPCODE(inst + 4) != OPC_MAD)
+			continue;
+
+		for (s = 0; s < 3; s++) {
+			getSrc(inst + 4, s, &op);
+			if (isTemp(&op) && op.num == dest) {
+				inst[2] |= INST_MAD_DEP;
+				break;
+			}
+		}
+	}
+}
+
+/*****************************************************************************
+ * FUNCTIONS:	fimgOptimizeShader
+ * SYNOPSIS:	This function runs a peephole optimization pass over shader
+ *		code stitched together from fixed pipeline blocks.
+ * PARAMETERS:	[IN/OUT] code - instruction words (4 per instruction)
+ *		[IN] len - number of instructions
+ *		[IN] flags - FGSO_* flags describing known register values
+ * RETURNS:	Number of instructions after optimization
+ *****************************************************************************/
+uint32_t fimgOptimizeShader(uint32_t *code, uint32_t len, uint32_t flags)
+{
+	uint8_t removed[FIMG_SHADER_SLOTS];
+	fimgBranchState br[MAX_BRANCHES];
+	uint32_t targets[MAX_BRANCHES];
+	uint32_t i, target;
+	int num = 0;
+
+	if (len > FIMG_SHADER_SLOTS)
+		return len;
+
+	/* Find branch targets, bail out on anything unexpected */
+	for (i = 0; i < len; i++) {
+		if (INST_OPCODE(&code[4*i]) != OPC_BF)
+			continue;
+
+		target = i + 1 + INST_DEST(&code[4*i]);
+		if (target > len)
+			return len;
+
+		if (findBranch(br, num, target))
+			continue;
+
+		if (num == MAX_BRANCHES)
+			return len;
+
+		br[num].target = target;
+		br[num].valid = 0;
+		targets[num++] = target;
+	}
+
+	memset(removed, 0, len);
+
+	propagateCopies(code, len, removed, br, num, flags);
+	removeDeadCode(code, len, removed, targets, num);
+	len = compact(code, len, removed);
+	updateMadDependencies(code, len);
+
+	return len;
+}
+
+#endif /* FIMG_SHADER_OPTIMIZER */
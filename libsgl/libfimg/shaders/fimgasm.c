@@ -0,0 +1,806 @@
+/*
+ * fimg/shaders/fimgasm.c
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE SHADER BLOCK ASSEMBLER (HOST TOOL)
+ *
+ * Copyrights:	2010 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Assembles shader block sources (vert.asm, frag.asm) into C headers
+ * with one instruction array per "% <type> <name>" block, in the same
+ * format as previously produced by genshader and orion.exe.
+ *
+ * Usage:
+ *	fimgasm [-o <output.h>] <input.asm>
+ *	fimgasm -c <reference.h> <input.asm>
+ *
+ * The -c mode assembles the input and compares the result against
+ * a checked-in header, returning non-zero if they differ.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdarg.h>
+
+#define MAX_LINES	4096
+#define MAX_INSTS	512
+#define MAX_LABELS	64
+#define MAX_NAME	64
+
+/*
+ * Instruction set
+ */
+
+#define OP_NODEST	(1 << 0)
+#define OP_BRANCH	(1 << 1)
+
+struct opcode {
+	const char *name;
+	uint32_t code;
+	uint32_t flags;
+};
+
+static const struct opcode opcodes[] = {
+	{ "nop",	0x00,	OP_NODEST },
+	{ "mov",	0x01,	0 },
+	{ "mova",	0x02,	0 },
+	{ "movc",	0x03,	0 },
+	{ "add",	0x04,	0 },
+	{ "mul",	0x06,	0 },
+	{ "mul_lit",	0x07,	0 },
+	{ "dp3",	0x08,	0 },
+	{ "dp4",	0x09,	0 },
+	{ "dph",	0x0a,	0 },
+	{ "dst",	0x0b,	0 },
+	{ "exp",	0x0c,	0 },
+	{ "exp_lit",	0x0d,	0 },
+	{ "log",	0x0e,	0 },
+	{ "log_lit",	0x0f,	0 },
+	{ "rcp",	0x10,	0 },
+	{ "rsq",	0x11,	0 },
+	{ "dp2add",	0x12,	0 },
+	{ "max",	0x14,	0 },
+	{ "min",	0x15,	0 },
+	{ "sge",	0x16,	0 },
+	{ "slt",	0x17,	0 },
+	{ "setp_eq",	0x18,	0 },
+	{ "setp_ge",	0x19,	0 },
+	{ "setp_gt",	0x1a,	0 },
+	{ "setp_ne",	0x1b,	0 },
+	{ "cmp",	0x1c,	0 },
+	{ "mad",	0x1d,	0 },
+	{ "frc",	0x1e,	0 },
+	{ "flr",	0x1f,	0 },
+	{ "texld",	0x20,	0 },
+	{ "cubedir",	0x21,	0 },
+	{ "maxcomp",	0x22,	0 },
+	{ "texldc",	0x23,	0 },
+	{ "texkill",	0x27,	OP_NODEST },
+	{ "movips",	0x28,	0 },
+	{ "addi",	0x29,	0 },
+	{ "b",		0x30,	OP_NODEST | OP_BRANCH },
+	{ "bf",		0x31,	OP_NODEST | OP_BRANCH },
+	{ "bp",		0x34,	OP_NODEST },
+	{ "bfp",	0x35,	OP_NODEST },
+	{ "bzp",	0x36,	OP_NODEST },
+	{ "call",	0x38,	OP_NODEST },
+	{ "callnz",	0x39,	OP_NODEST },
+	{ "ret",	0x3c,	OP_NODEST },
+};
+
+#define OPCODE_MAD	0x1d
+
+#define SRC_TYPE_V	0x00
+#define SRC_TYPE_R	0x01
+#define SRC_TYPE_C	0x02
+#define SRC_TYPE_B	0x05
+#define SRC_TYPE_S	0x07
+#define SRC_TYPE_MASK	0x3f
+#define SRC_NEGATE	0x40
+
+#define DST_OCOLOR	0x10
+#define DST_TEMP	0x20
+#define DST_CLASS_MASK	0xe0
+#define DST_NUM_MASK	0x1f
+
+#define SWIZZLE_XYZW	0xe4
+
+#define INST_SAT	(1 << 17)
+#define INST_MAD_DEP	(1 << 29)
+
+struct operand {
+	uint32_t type;
+	uint32_t num;
+	uint32_t swizzle;
+};
+
+struct inst {
+	uint32_t word[4];
+	int isDef;
+	uint32_t opcode;
+	int hasDest;
+	uint32_t dest;
+	struct operand src[3];
+	int numSrc;
+};
+
+struct label {
+	char name[MAX_NAME];
+	int addr;
+};
+
+struct source {
+	const char *file;
+	char *line[MAX_LINES];
+	int numLines;
+};
+
+struct output {
+	char *buf;
+	size_t len;
+	size_t size;
+};
+
+static struct inst insts[MAX_INSTS];
+static int numInsts;
+static struct label labels[MAX_LABELS];
+static int numLabels;
+
+static const char *curFile;
+static int curLine;
+
+/*
+ * Helpers
+ */
+
+static void error(const char *fmt, ...)
+{
+	va_list ap;
+
+	fprintf(stderr, "%s:%d: error: ", curFile, curLine);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fputc('\n', stderr);
+	exit(EXIT_FAILURE);
+}
+
+static char *trim(char *s)
+{
+	char *end;
+
+	while (isspace((unsigned char)*s))
+		++s;
+
+	end = s + strlen(s);
+	while (end > s && isspace((unsigned char)end[-1]))
+		*--end = '\0';
+
+	return s;
+}
+
+static void outPrintf(struct output *out, const char *fmt, ...)
+{
+	va_list ap;
+	int len;
+
+	for (;;) {
+		va_start(ap, fmt);
+		len = vsnprintf(out->buf + out->len, out->size - out->len, fmt, ap);
+		va_end(ap);
+
+		if (len < 0) {
+			fprintf(stderr, "fimgasm: output formatting failed\n");
+			exit(EXIT_FAILURE);
+		}
+
+		if (out->len + len < out->size)
+			break;
+
+		out->size = 2 * (out->size + len + 1);
+		out->buf = realloc(out->buf, out->size);
+		if (!out->buf) {
+			fprintf(stderr, "fimgasm: out of memory\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	out->len += len;
+}
+
+/*
+ * Operand parsing
+ */
+
+static int componentIndex(char c)
+{
+	switch (c) {
+	case 'x': case 'r': return 0;
+	case 'y': case 'g': return 1;
+	case 'z': case 'b': return 2;
+	case 'w': case 'a': return 3;
+	}
+
+	return -1;
+}
+
+static uint32_t parseSwizzle(const char *s)
+{
+	uint32_t swizzle = 0;
+	int len = strlen(s);
+	int i, comp = 0;
+
+	if (len < 1 || len > 4)
+		error("invalid swizzle '%s'", s);
+
+	/* Missing components replicate the last one */
+	for (i = 0; i < 4; ++i) {
+		if (i < len) {
+			comp = componentIndex(s[i]);
+			if (comp < 0)
+				error("invalid swizzle '%s'", s);
+		}
+		swizzle |= comp << (2 * i);
+	}
+
+	return swizzle;
+}
+
+static uint32_t parseNumber(const char *s, const char **end)
+{
+	char *e;
+	unsigned long val;
+
+	if (!isdigit((unsigned char)*s))
+		error("register number expected at '%s'", s);
+
+	val = strtoul(s, &e, 10);
+	if (val > 0xff)
+		error("register number out of range at '%s'", s);
+
+	*end = e;
+	return val;
+}
+
+static void parseSource(const char *s, struct operand *op)
+{
+	const char *p = s;
+
+	op->type = 0;
+	if (*p == '-') {
+		op->type |= SRC_NEGATE;
+		++p;
+	}
+
+	switch (*p++) {
+	case 'v': op->type |= SRC_TYPE_V; break;
+	case 'r': op->type |= SRC_TYPE_R; break;
+	case 'c': op->type |= SRC_TYPE_C; break;
+	case 'b': op->type |= SRC_TYPE_B; break;
+	case 's': op->type |= SRC_TYPE_S; break;
+	default:
+		error("invalid source operand '%s'", s);
+	}
+
+	op->num = parseNumber(p, &p);
+	op->swizzle = SWIZZLE_XYZW;
+
+	if (*p == '.')
+		op->swizzle = parseSwizzle(p + 1);
+	else if (*p != '\0')
+		error("invalid source operand '%s'", s);
+}
+
+static void parseDest(const char *s, uint32_t *dest, uint32_t *mask)
+{
+	const char *p = s;
+	int comp;
+
+	if (!strncmp(p, "oColor", 6)) {
+		*dest = DST_OCOLOR;
+		p += 6;
+	} else if (*p == 'o') {
+		*dest = parseNumber(p + 1, &p);
+		if (*dest >= DST_OCOLOR)
+			error("output register out of range in '%s'", s);
+	} else if (*p == 'r') {
+		*dest = parseNumber(p + 1, &p);
+		if (*dest > DST_NUM_MASK)
+			error("temporary register out of range in '%s'", s);
+		*dest |= DST_TEMP;
+	} else {
+		error("invalid destination operand '%s'", s);
+	}
+
+	*mask = 0xf;
+	if (*p == '\0')
+		return;
+
+	if (*p++ != '.' || *p == '\0')
+		error("invalid destination operand '%s'", s);
+
+	*mask = 0;
+	for (; *p; ++p) {
+		comp = componentIndex(*p);
+		if (comp < 0 || *p == 'r' || *p == 'g'
+		    || *p == 'b' || *p == 'a')
+			error("invalid write mask in '%s'", s);
+		*mask |= 1 << comp;
+	}
+}
+
+static int splitArgs(char *s, char **args, int max)
+{
+	int num = 0;
+	char *tok;
+
+	if (*s == '\0')
+		return 0;
+
+	for (tok = strtok(s, ","); tok; tok = strtok(NULL, ",")) {
+		if (num == max)
+			error("too many operands");
+		args[num++] = trim(tok);
+	}
+
+	return num;
+}
+
+/*
+ * Statements
+ */
+
+static struct inst *newInst(void)
+{
+	struct inst *inst;
+
+	if (numInsts == MAX_INSTS)
+		error("too many instructions in block");
+
+	inst = &insts[numInsts++];
+	memset(inst, 0, sizeof(*inst));
+
+	return inst;
+}
+
+static int findLabel(const char *name)
+{
+	int i;
+
+	for (i = 0; i < numLabels; ++i)
+		if (!strcmp(labels[i].name, name))
+			return labels[i].addr;
+
+	error("undefined label '%s'", name);
+	return -1;
+}
+
+static void parseDef(char *s)
+{
+	struct inst *inst = newInst();
+	char *args[5];
+	char *end;
+	union {
+		float f;
+		uint32_t u;
+	} val;
+	int i;
+
+	if (splitArgs(s, args, 5) != 5 || args[0][0] != 'c')
+		error("def expects a constant register and 4 values");
+
+	inst->isDef = 1;
+	for (i = 0; i < 4; ++i) {
+		val.f = strtof(args[i + 1], &end);
+		if (end == args[i + 1] || *trim(end) != '\0')
+			error("invalid floating point value '%s'", args[i + 1]);
+		inst->word[i] = val.u;
+	}
+}
+
+static const struct opcode *findOpcode(const char *name, int *sat)
+{
+	char base[MAX_NAME];
+	size_t len = strlen(name);
+	unsigned i;
+
+	*sat = 0;
+	for (i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); ++i)
+		if (!strcmp(opcodes[i].name, name))
+			return &opcodes[i];
+
+	if (len <= 4 || len >= MAX_NAME || strcmp(name + len - 4, "_sat"))
+		return NULL;
+
+	memcpy(base, name, len - 4);
+	base[len - 4] = '\0';
+	*sat = 1;
+
+	for (i = 0; i < sizeof(opcodes) / sizeof(opcodes[0]); ++i)
+		if (!strcmp(opcodes[i].name, base))
+			return &opcodes[i];
+
+	return NULL;
+}
+
+static void parseInst(char *s)
+{
+	struct inst *inst = newInst();
+	const struct opcode *op;
+	struct operand *src = inst->src;
+	char *args[4];
+	char *name = s;
+	uint32_t dest = 0, mask = 0;
+	int numArgs, first = 0;
+	int sat, i;
+
+	while (*s && !isspace((unsigned char)*s))
+		++s;
+	if (*s)
+		*s++ = '\0';
+
+	op = findOpcode(name, &sat);
+	if (!op)
+		error("unknown instruction '%s'", name);
+
+	numArgs = splitArgs(trim(s), args, 4);
+
+	if (op->flags & OP_BRANCH) {
+		if (numArgs < 1)
+			error("branch target expected");
+		/* Branch offset is relative to the next instruction */
+		dest = findLabel(args[0]) - numInsts;
+		first = 1;
+	} else if (!(op->flags & OP_NODEST)) {
+		if (numArgs < 1)
+			error("destination operand expected");
+		parseDest(args[0], &dest, &mask);
+		inst->hasDest = 1;
+		first = 1;
+	}
+
+	inst->numSrc = numArgs - first;
+	if (inst->numSrc > 3)
+		error("too many source operands");
+
+	for (i = 0; i < inst->numSrc; ++i)
+		parseSource(args[first + i], &src[i]);
+
+	inst->opcode = op->code;
+	inst->dest = dest;
+
+	inst->word[0] = (src[1].num << 24) | (src[2].swizzle << 16)
+			| (src[2].type << 8) | src[2].num;
+	inst->word[1] = (src[0].type << 24) | (src[0].num << 16)
+			| (src[1].swizzle << 8) | src[1].type;
+	inst->word[2] = (op->code << 23) | (mask << 19)
+			| ((dest & 0xff) << 8) | src[0].swizzle;
+	if (sat)
+		inst->word[2] |= INST_SAT;
+}
+
+/*
+ * Instructions writing a temporary register read by the immediately
+ * following mad must be flagged for the hardware to resolve
+ * the dependency.
+ */
+static void markMadDependencies(void)
+{
+	struct inst *inst, *next;
+	int i, j;
+
+	for (i = 0; i < numInsts - 1; ++i) {
+		inst = &insts[i];
+		next = &insts[i + 1];
+
+		if (inst->isDef || !inst->hasDest
+		    || (inst->dest & DST_CLASS_MASK) != DST_TEMP)
+			continue;
+
+		if (next->isDef || next->opcode != OPCODE_MAD)
+			continue;
+
+		for (j = 0; j < next->numSrc; ++j) {
+			if ((next->src[j].type & SRC_TYPE_MASK) == SRC_TYPE_R
+			    && next->src[j].num == (inst->dest & DST_NUM_MASK)) {
+				inst->word[2] |= INST_MAD_DEP;
+				break;
+			}
+		}
+	}
+}
+
+static int isDirective(const char *s)
+{
+	return !strncmp(s, "vs_", 3) || !strncmp(s, "ps_", 3)
+		|| !strncmp(s, "fimg_version", 12);
+}
+
+/*
+ * Runs one pass over given line range. The first pass only collects
+ * labels, the second one encodes instructions.
+ */
+static void assembleLines(struct source *src, int start, int end, int encode)
+{
+	char buf[MAX_NAME * 8];
+	char *s, *comment;
+	int i;
+
+	for (i = start; i < end; ++i) {
+		curLine = i + 1;
+
+		if (strlen(src->line[i]) >= sizeof(buf))
+			error("line too long");
+		strcpy(buf, src->line[i]);
+
+		comment = strchr(buf, '#');
+		if (comment)
+			*comment = '\0';
+
+		s = trim(buf);
+		if (*s == '\0' || isDirective(s))
+			continue;
+
+		if (!strncmp(s, "label", 5) && isspace((unsigned char)s[5])) {
+			if (encode)
+				continue;
+			if (numLabels == MAX_LABELS)
+				error("too many labels");
+			s = trim(s + 5);
+			if (strlen(s) >= MAX_NAME)
+				error("label name too long");
+			strcpy(labels[numLabels].name, s);
+			labels[numLabels++].addr = numInsts;
+			continue;
+		}
+
+		if (!encode) {
+			/* Only the instruction count matters here */
+			newInst();
+			continue;
+		}
+
+		if (!strncmp(s, "def", 3) && isspace((unsigned char)s[3]))
+			parseDef(trim(s + 3));
+		else
+			parseInst(s);
+	}
+}
+
+static void assembleBlock(struct source *src, int common, int start, int end)
+{
+	numLabels = 0;
+	numInsts = 0;
+
+	/* Common lines before the first block are prepended to each block */
+	assembleLines(src, 0, common, 0);
+	assembleLines(src, start, end, 0);
+
+	numInsts = 0;
+	assembleLines(src, 0, common, 1);
+	assembleLines(src, start, end, 1);
+
+	markMadDependencies();
+}
+
+/*
+ * Header generation
+ */
+
+static void assemble(struct source *src, const char *prefix,
+							struct output *out)
+{
+	char guard[MAX_NAME];
+	char type[MAX_NAME], name[MAX_NAME];
+	int common = -1, start, end;
+	int i;
+
+	for (i = 0; prefix[i] && i < MAX_NAME - 1; ++i)
+		guard[i] = toupper((unsigned char)prefix[i]);
+	guard[i] = '\0';
+
+	outPrintf(out, "#ifndef _%s_H_\n#define _%s_H_\n\n", guard, guard);
+
+	for (start = 0; start < src->numLines; start = end) {
+		if (src->line[start][0] != '%') {
+			end = start + 1;
+			continue;
+		}
+
+		curLine = start + 1;
+		if (common < 0)
+			common = start;
+
+		if (sscanf(src->line[start] + 1, "%63s %63s", type, name) != 2)
+			error("syntax error in block header");
+
+		if (strcmp(type, "f") && strcmp(type, "v"))
+			error("invalid shader type '%s', "
+				"valid shader types are 'f' and 'v'", type);
+
+		for (end = start + 1; end < src->numLines; ++end)
+			if (src->line[end][0] == '%')
+				break;
+
+		assembleBlock(src, common, start + 1, end);
+
+		outPrintf(out, "static const unsigned int %s_%s[] = {\n",
+								prefix, name);
+		for (i = 0; i < numInsts; ++i)
+			outPrintf(out, "\t0x%08x, 0x%08x, 0x%08x, 0x%08x,\n",
+					insts[i].word[0], insts[i].word[1],
+					insts[i].word[2], insts[i].word[3]);
+		outPrintf(out, "};\n\n");
+	}
+
+	outPrintf(out, "#endif\n");
+}
+
+static char *readFile(const char *path, size_t *len)
+{
+	FILE *file;
+	char *buf;
+	long size;
+
+	file = fopen(path, "rb");
+	if (!file) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	buf = malloc(size + 1);
+	if (!buf || fread(buf, 1, size, file) != (size_t)size) {
+		fprintf(stderr, "fimgasm: failed to read %s\n", path);
+		exit(EXIT_FAILURE);
+	}
+	buf[size] = '\0';
+	fclose(file);
+
+	if (len)
+		*len = size;
+
+	return buf;
+}
+
+static void loadSource(struct source *src, const char *path)
+{
+	char *buf = readFile(path, NULL);
+	char *p, *nl;
+
+	src->file = path;
+	src->numLines = 0;
+
+	curFile = path;
+	for (p = buf; *p; p = nl + 1) {
+		if (src->numLines == MAX_LINES) {
+			curLine = src->numLines;
+			error("too many lines");
+		}
+
+		src->line[src->numLines++] = p;
+
+		nl = strchr(p, '\n');
+		if (!nl)
+			break;
+		*nl = '\0';
+		if (nl > p && nl[-1] == '\r')
+			nl[-1] = '\0';
+	}
+}
+
+/*
+ * Compares generated output with reference header, reporting the first
+ * differing line.
+ */
+static int verify(const struct output *out, const char *path)
+{
+	size_t refLen, i;
+	char *ref = readFile(path, &refLen);
+	int line = 1;
+
+	for (i = 0; i < out->len && i < refLen; ++i) {
+		if (out->buf[i] != ref[i])
+			break;
+		if (ref[i] == '\n')
+			++line;
+	}
+
+	free(ref);
+
+	if (i == out->len && i == refLen) {
+		printf("%s: up to date\n", path);
+		return EXIT_SUCCESS;
+	}
+
+	fprintf(stderr, "%s:%d: differs from assembled %s\n",
+							path, line, curFile);
+	return EXIT_FAILURE;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-o <output.h>] <input.asm>\n"
+			"       %s -c <reference.h> <input.asm>\n",
+			name, name);
+	exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+	static struct source src;
+	struct output out = { NULL, 0, 0 };
+	const char *output = NULL, *reference = NULL, *input = NULL;
+	const char *base, *ext;
+	char prefix[MAX_NAME];
+	FILE *file;
+	int i;
+
+	for (i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			output = argv[++i];
+		else if (!strcmp(argv[i], "-c") && i + 1 < argc)
+			reference = argv[++i];
+		else if (argv[i][0] != '-' && !input)
+			input = argv[i];
+		else
+			usage(argv[0]);
+	}
+
+	if (!input || (output && reference))
+		usage(argv[0]);
+
+	/* Array names are prefixed with the base name of the source file */
+	base = strrchr(input, '/');
+	base = base ? base + 1 : input;
+	ext = strchr(base, '.');
+	if (!ext)
+		ext = base + strlen(base);
+	if (ext == base || ext - base >= MAX_NAME) {
+		fprintf(stderr, "fimgasm: invalid input file name %s\n", input);
+		return EXIT_FAILURE;
+	}
+	memcpy(prefix, base, ext - base);
+	prefix[ext - base] = '\0';
+
+	loadSource(&src, input);
+	assemble(&src, prefix, &out);
+
+	if (reference)
+		return verify(&out, reference);
+
+	if (!output) {
+		fwrite(out.buf, 1, out.len, stdout);
+		return EXIT_SUCCESS;
+	}
+
+	file = fopen(output, "w");
+	if (!file) {
+		perror(output);
+		return EXIT_FAILURE;
+	}
+	fwrite(out.buf, 1, out.len, file);
+	fclose(file);
+
+	return EXIT_SUCCESS;
+}
@@ -45,6 +45,19 @@ def c3, 4.0, 4.0, 4.0, 4.0
 # Combiner scale 1
 # def c7, 1.0, 1.0, 1.0, 1.0
 
+# Texture environment color 2
+# def c8, 0.0, 0.0, 0.0, 0.0
+# Combiner scale 2
+# def c9, 1.0, 1.0, 1.0, 1.0
+
+# Texture environment color 3
+# def c10, 0.0, 0.0, 0.0, 0.0
+# Combiner scale 3
+# def c11, 1.0, 1.0, 1.0, 1.0
+
+# Fog color
+# def c32, 0.0, 0.0, 0.0, 0.0
+
 % f header
 
 # Shader header
@@ -84,6 +97,34 @@ label noswap1
 	mov r2, c6
 	mov r3, c7
 
+% f texture2
+
+# Sampling function
+#
+# Output:	r1 - texture value
+
+# Texture 2
+	texld r1, v3, s2
+	bf noswap2, b2
+	mov r1.xyzw, r1.wzyx
+label noswap2
+	mov r2, c8
+	mov r3, c9
+
+% f texture3
+
+# Sampling function
+#
+# Output:	r1 - texture value
+
+# Texture 3
+	texld r1, v4, s3
+	bf noswap3, b3
+	mov r1.xyzw, r1.wzyx
+label noswap3
+	mov r2, c10
+	mov r3, c11
+
 ################################################################################
 
 % f replace
@@ -145,7 +186,7 @@ label noswap1
 	mov r4.w, r1
 	add r4.xyz, c1, -r1
 	mul r0, r0, r4
-	mad r0.xyz, c4, r1, r0
+	mad r0.xyz, r2, r1, r0
 
 % f add
 
@@ -641,6 +682,41 @@ label noswap1
 
 ################################################################################
 
+% f clip0
+
+# Clip plane 0
+	# Drop fragments behind the plane
+	texkill v5.y
+
+% f clip1
+
+# Clip plane 1
+	# Drop fragments behind the plane
+	texkill v5.z
+
+% f clip2
+
+# Clip plane 2
+	# Drop fragments behind the plane
+	texkill v5.w
+
+################################################################################
+
+% f fog
+
+# Fog
+#
+# Inputs:	r0 - current fragment value
+#		v5.x - fog factor
+#
+# Output:	r0 - new fragment value
+
+	# Blend fragment color with fog color
+	add r1.xyz, r0, -c32
+	mad r0.xyz, r1, v5.x, c32
+
+################################################################################
+
 % f footer
 
 # Shader footer
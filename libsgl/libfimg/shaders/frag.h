@@ -28,6 +28,22 @@ static const unsigned int frag_texture1[] = {
 	0x00000000, 0x02070000, 0x00f823e4, 0x00000000,
 };
 
+static const unsigned int frag_texture2[] = {
+	0x02000000, 0x0003e407, 0x107821e4, 0x00000000,
+	0x00000000, 0x05020000, 0x188001e4, 0x00000000,
+	0x00000000, 0x01010000, 0x00f8211b, 0x00000000,
+	0x00000000, 0x02080000, 0x00f822e4, 0x00000000,
+	0x00000000, 0x02090000, 0x00f823e4, 0x00000000,
+};
+
+static const unsigned int frag_texture3[] = {
+	0x03000000, 0x0004e407, 0x107821e4, 0x00000000,
+	0x00000000, 0x05030000, 0x188001e4, 0x00000000,
+	0x00000000, 0x01010000, 0x00f8211b, 0x00000000,
+	0x00000000, 0x020a0000, 0x00f822e4, 0x00000000,
+	0x00000000, 0x020b0000, 0x00f823e4, 0x00000000,
+};
+
 static const unsigned int frag_replace[] = {
 	0x00000000, 0x01010000, 0x00f820e4, 0x00000000,
 };
@@ -46,7 +62,7 @@ static const unsigned int frag_blend[] = {
 	0x00000000, 0x01010000, 0x00c024e4, 0x00000000,
 	0x01000000, 0x0201e441, 0x023824e4, 0x00000000,
 	0x04000000, 0x0100e401, 0x237820e4, 0x00000000,
-	0x01e40100, 0x0204e401, 0x0eb820e4, 0x00000000,
+	0x01e40100, 0x0102e401, 0x0eb820e4, 0x00000000,
 };
 
 static const unsigned int frag_add[] = {
@@ -195,6 +211,23 @@ static const unsigned int frag_combine_dot3[] = {
 	0x03000000, 0x0104e402, 0x037824e4, 0x00000000,
 };
 
+static const unsigned int frag_clip0[] = {
+	0x00000000, 0x00050000, 0x13800055, 0x00000000,
+};
+
+static const unsigned int frag_clip1[] = {
+	0x00000000, 0x00050000, 0x138000aa, 0x00000000,
+};
+
+static const unsigned int frag_clip2[] = {
+	0x00000000, 0x00050000, 0x138000ff, 0x00000000,
+};
+
+static const unsigned int frag_fog[] = {
+	0x20000000, 0x0100e442, 0x223821e4, 0x00000000,
+	0x05e40220, 0x01010000, 0x0eb820e4, 0x00000000,
+};
+
 static const unsigned int frag_footer[] = {
 	0x00000000, 0x01000000, 0x00f810e4, 0x00000000,
 	0x00000000, 0x00000000, 0x1e000000, 0x00000000,
@@ -38,32 +38,502 @@ fimg_version	0x01050000
 # def c6, 0.0, 0.0, 1.0, 0.0
 # def c7, 0.0, 0.0, 0.0, 1.0
 
-# Texture 0 matrix
+# Modelview matrix
 # def c8,  1.0, 0.0, 0.0, 0.0
 # def c9,  0.0, 1.0, 0.0, 0.0
 # def c10, 0.0, 0.0, 1.0, 0.0
 # def c11, 0.0, 0.0, 0.0, 1.0
 
-# Texture 1 matrix
+# Texture 0 matrix
 # def c12, 1.0, 0.0, 0.0, 0.0
 # def c13, 0.0, 1.0, 0.0, 0.0
 # def c14, 0.0, 0.0, 1.0, 0.0
 # def c15, 0.0, 0.0, 0.0, 1.0
 
+# Texture 1 matrix
+# def c16, 1.0, 0.0, 0.0, 0.0
+# def c17, 0.0, 1.0, 0.0, 0.0
+# def c18, 0.0, 0.0, 1.0, 0.0
+# def c19, 0.0, 0.0, 0.0, 1.0
+
+# Texture 2 matrix
+# def c20, 1.0, 0.0, 0.0, 0.0
+# def c21, 0.0, 1.0, 0.0, 0.0
+# def c22, 0.0, 0.0, 1.0, 0.0
+# def c23, 0.0, 0.0, 0.0, 1.0
+
+# Texture 3 matrix
+# def c24, 1.0, 0.0, 0.0, 0.0
+# def c25, 0.0, 1.0, 0.0, 0.0
+# def c26, 0.0, 0.0, 1.0, 0.0
+# def c27, 0.0, 0.0, 0.0, 1.0
+
+# Mask of vertex units used by matrix palette (1.0 for units in use)
+# def c28, 1.0, 1.0, 1.0, 1.0
+
+# Scene color (emission + material ambient * scene ambient, material alpha)
+# def c32, 0.0, 0.0, 0.0, 1.0
+# Material parameters (shininess, 0.0, epsilon, 1.0)
+# def c33, 0.0, 0.0, 1.0e-20, 1.0
+# Direction to viewer
+# def c34, 0.0, 0.0, 1.0, 0.0
+
+# Fog parameters (1/(end-start), end/(end-start), density*log2(e),
+#                 -density^2*log2(e))
+# def c35, 1.0, 1.0, 1.4427, -1.4427
+
+# Clip planes in object space
+# def c36, 0.0, 0.0, 0.0, 0.0
+# def c37, 0.0, 0.0, 0.0, 0.0
+# def c38, 0.0, 0.0, 0.0, 0.0
+
+# Point size attenuation coefficients (constant, linear, quadratic, 0.0)
+# def c39, 1.0, 0.0, 0.0, 0.0
+
+# Light 0 (next lights follow every 8 registers)
+# Direction to light (directional) or position (point, spot)
+# def c40, 0.0, 0.0, 1.0, 0.0
+# Ambient product
+# def c41, 0.0, 0.0, 0.0, 0.0
+# Diffuse product
+# def c42, 0.0, 0.0, 0.0, 0.0
+# Specular product
+# def c43, 0.0, 0.0, 0.0, 0.0
+# Half vector (directional)
+# def c44, 0.0, 0.0, 1.0, 0.0
+# Spot direction, cosine of spot cutoff
+# def c45, 0.0, 0.0, -1.0, -1.0
+# Attenuation factors, spot exponent
+# def c46, 1.0, 0.0, 0.0, 0.0
+
+# Palette matrix 0 (next matrices follow every 8 registers)
+# Matrix
+# def c104, 1.0, 0.0, 0.0, 0.0
+# def c105, 0.0, 1.0, 0.0, 0.0
+# def c106, 0.0, 0.0, 1.0, 0.0
+# def c107, 0.0, 0.0, 0.0, 1.0
+# Inverse matrix
+# def c108, 1.0, 0.0, 0.0, 0.0
+# def c109, 0.0, 1.0, 0.0, 0.0
+# def c110, 0.0, 0.0, 1.0, 0.0
+# Matrix index - 0.5, matrix index + 0.5, 0.0, 0.0
+# def c111, -0.5, 0.5, 0.0, 0.0
+
 % v header
 
 # Shader header
 label start
+
+# Code is being inserted here dynamically
+
+################################################################################
+
+% v palette
+
+# Matrix palette header
+#
+# Output:	r7 - weights of used vertex units
+#		r14 - blended position in eye space
+#		r15 - blended normal in eye space
+
+	# Drop weights of vertex units missing in weight array
+	mul r7, v9, c28
+	# Clear accumulators
+	mov r14, c111.zzzz
+	mov r15, c111.zzzz
+
+% v palette_position
+
+# Matrix palette blending function (constants of matrix 0 are moved
+# to given matrix by the driver)
+#
+# Inputs:	v8 - matrix indices
+#		r7 - weights of used vertex units
+#		r14 - blended position in eye space
+#
+# Output:	r6.x - weight of the matrix
+#		r14 - blended position in eye space
+
+	# Sum weights of units referencing this matrix
+	sge r8, v8, c111.xxxx
+	sge r9, v8, c111.yyyy
+	add r8, r8, -r9
+	dp4 r6.x, r8, r7
+	# Transform position and add it with the weight
+	mul r8.xyzw, c104.xyzw, v0.xxxx
+	mad r8.xyzw, c105.xyzw, v0.yyyy, r8.xyzw
+	mad r8.xyzw, c106.xyzw, v0.zzzz, r8.xyzw
+	mad r8.xyzw, c107.xyzw, v0.wwww, r8.xyzw
+	mad r14.xyzw, r8.xyzw, r6.xxxx, r14.xyzw
+
+% v palette_normal
+
+# Matrix palette blending function for normals, follows the one above
+#
+# Inputs:	r6.x - weight of the matrix
+#		r15 - blended normal in eye space
+#
+# Output:	r15 - blended normal in eye space
+
+	# Transform normal (inverse transposed matrix) and add it with the weight
+	dp3 r9.x, c108, v1
+	dp3 r9.y, c109, v1
+	dp3 r9.z, c110, v1
+	mad r15.xyz, r9.xyz, r6.xxxx, r15.xyz
+
+################################################################################
+
+% v color
+
+# Vertex color
+	# Pass vertex color
+	mov o1, v2
+
+################################################################################
+
+% v position
+
+# General transformation
 	# Transform position by transformation matrix
 	mul r0.xyzw, c0.xyzw, v0.xxxx
 	mad r0.xyzw, c1.xyzw, v0.yyyy, r0.xyzw
 	mad r0.xyzw, c2.xyzw, v0.zzzz, r0.xyzw
 	mad o0.xyzw, c3.xyzw, v0.wwww, r0.xyzw
 
-	# Pass vertex color
-	mov o1, v2
+% v position_identity
 
-# Code is being inserted here dynamically
+# Identity transformation
+	# Pass position
+	mov o0, v0
+
+% v position_st
+
+# Scale and translation
+#
+# Constants:	c0 - (m[0][0], m[1][1], m[2][2], 0.0)
+#		c3 - translation column
+
+	mul r0.xyzw, c0.xyzw, v0.xyzw
+	mad o0.xyzw, c3.xyzw, v0.wwww, r0.xyzw
+
+% v position_a2d
+
+# 2D affine transformation (z is only scaled and translated)
+#
+# Constants:	c0 - (m[0][0], m[0][1], m[2][2], 0.0)
+#		c1 - second column
+#		c3 - translation column
+
+	mul r0.xyzw, c0.xyzw, v0.xxzz
+	mad r0.xyzw, c1.xyzw, v0.yyyy, r0.xyzw
+	mad o0.xyzw, c3.xyzw, v0.wwww, r0.xyzw
+
+################################################################################
+
+% v lighting
+
+# Lighting header
+#
+# Output:	r3 - normal in eye space
+#		r5 - lit color accumulator
+
+	# Transform normal to eye space (inverse transposed modelview)
+	dp3 r3.x, c4, v1
+	dp3 r3.y, c5, v1
+	dp3 r3.z, c6, v1
+	# Normalize it
+	dp3 r3.w, r3, r3
+	rsq r3.w, r3.w
+	mul r3.xyz, r3, r3.w
+	# Start with scene color
+	mov r5, c32
+
+% v lighting_eyepos
+
+# Vertex position in eye space, needed by local lights
+#
+# Output:	r4 - position in eye space
+
+	mul r4.xyzw, c8.xyzw,  v0.xxxx
+	mad r4.xyzw, c9.xyzw,  v0.yyyy, r4.xyzw
+	mad r4.xyzw, c10.xyzw, v0.zzzz, r4.xyzw
+	mad r4.xyzw, c11.xyzw, v0.wwww, r4.xyzw
+
+% v light_directional
+
+# Lighting function
+#
+# Inputs:	r3 - normal in eye space
+#		r4 - position in eye space
+#		r5 - lit color accumulator
+#
+# Output:	r5 - lit color accumulator
+#
+# Written for light 0, constants are relocated for other lights.
+
+# Directional light
+	# Diffuse factor
+	dp3 r6.x, r3, c40
+	max r6.x, r6.x, c33.y
+	# Specular factor, only if lit from the front
+	dp3 r6.y, r3, c44
+	max r6.y, r6.y, c33.z
+	log r6.y, r6.y
+	mul r6.y, r6.y, c33.x
+	exp r6.y, r6.y
+	slt r6.z, c33.y, r6.x
+	mul r6.y, r6.y, r6.z
+	# Accumulate
+	add r5, r5, c41
+	mad r5, c42, r6.x, r5
+	mad r5, c43, r6.y, r5
+
+% v light_point
+
+# Lighting function
+#
+# Inputs:	r3 - normal in eye space
+#		r4 - position in eye space
+#		r5 - lit color accumulator
+#
+# Output:	r5 - lit color accumulator
+#
+# Written for light 0, constants are relocated for other lights.
+
+# Point light
+	# Direction and distance to light
+	add r6, c40, -r4
+	dp3 r7.z, r6, r6
+	rsq r7.w, r7.z
+	mul r6.xyz, r6, r7.w
+	mul r7.y, r7.z, r7.w
+	# Attenuation
+	mov r7.x, c33.w
+	dp3 r7.x, r7, c46
+	rcp r7.x, r7.x
+	# Half vector
+	add r8.xyz, r6, c34
+	dp3 r8.w, r8, r8
+	rsq r8.w, r8.w
+	mul r8.xyz, r8, r8.w
+	# Diffuse factor
+	dp3 r9.x, r3, r6
+	max r9.x, r9.x, c33.y
+	# Specular factor, only if lit from the front
+	dp3 r9.y, r3, r8
+	max r9.y, r9.y, c33.z
+	log r9.y, r9.y
+	mul r9.y, r9.y, c33.x
+	exp r9.y, r9.y
+	slt r9.z, c33.y, r9.x
+	mul r9.y, r9.y, r9.z
+	# Accumulate
+	mul r9.xy, r9, r7.x
+	mad r5, c41, r7.x, r5
+	mad r5, c42, r9.x, r5
+	mad r5, c43, r9.y, r5
+
+% v light_spot
+
+# Lighting function
+#
+# Inputs:	r3 - normal in eye space
+#		r4 - position in eye space
+#		r5 - lit color accumulator
+#
+# Output:	r5 - lit color accumulator
+#
+# Written for light 0, constants are relocated for other lights.
+
+# Spot light
+	# Direction and distance to light
+	add r6, c40, -r4
+	dp3 r7.z, r6, r6
+	rsq r7.w, r7.z
+	mul r6.xyz, r6, r7.w
+	mul r7.y, r7.z, r7.w
+	# Attenuation
+	mov r7.x, c33.w
+	dp3 r7.x, r7, c46
+	rcp r7.x, r7.x
+	# Spot factor, zero outside of the cone
+	dp3 r7.y, -r6, c45
+	sge r7.z, r7.y, c45.w
+	max r7.y, r7.y, c33.z
+	log r7.y, r7.y
+	mul r7.y, r7.y, c46.w
+	exp r7.y, r7.y
+	mul r7.y, r7.y, r7.z
+	mul r7.x, r7.x, r7.y
+	# Half vector
+	add r8.xyz, r6, c34
+	dp3 r8.w, r8, r8
+	rsq r8.w, r8.w
+	mul r8.xyz, r8, r8.w
+	# Diffuse factor
+	dp3 r9.x, r3, r6
+	max r9.x, r9.x, c33.y
+	# Specular factor, only if lit from the front
+	dp3 r9.y, r3, r8
+	max r9.y, r9.y, c33.z
+	log r9.y, r9.y
+	mul r9.y, r9.y, c33.x
+	exp r9.y, r9.y
+	slt r9.z, c33.y, r9.x
+	mul r9.y, r9.y, r9.z
+	# Accumulate
+	mul r9.xy, r9, r7.x
+	mad r5, c41, r7.x, r5
+	mad r5, c42, r9.x, r5
+	mad r5, c43, r9.y, r5
+
+% v lighting_end
+
+# Lighting footer
+	# Output lit color
+	mov_sat o1, r5
+
+################################################################################
+
+% v fog
+
+# Fog header
+#
+# Output:	r10.x - eye space z coordinate
+
+	mul r10.x, c8.z,  v0.x
+	mad r10.x, c9.z,  v0.y, r10.x
+	mad r10.x, c10.z, v0.z, r10.x
+	mad r10.x, c11.z, v0.w, r10.x
+
+% v fog_linear
+
+# Fog function
+#
+# Inputs:	r10.x - eye space z coordinate
+#
+# Output:	o6.x - fog factor
+#
+# Distance to eye is approximated with -z.
+
+# Linear fog
+	mad_sat o6.x, r10.x, c35.x, c35.y
+
+% v fog_exp
+
+# Fog function
+#
+# Inputs:	r10.x - eye space z coordinate
+#
+# Output:	o6.x - fog factor
+#
+# Distance to eye is approximated with -z.
+
+# Exponential fog
+	mul r10.x, r10.x, c35.z
+	exp_sat o6.x, r10.x
+
+% v fog_exp2
+
+# Fog function
+#
+# Inputs:	r10.x - eye space z coordinate
+#
+# Output:	o6.x - fog factor
+#
+# Distance to eye is approximated with -z.
+
+# Squared exponential fog
+	mul r10.x, r10.x, r10.x
+	mul r10.x, r10.x, c35.w
+	exp_sat o6.x, r10.x
+
+################################################################################
+
+% v point_size
+
+# Point size
+#
+# Output:	o9.x - point size (remapped to follow position)
+
+	# Taken from point size attribute (current point size without array)
+	mov o9.x, v3.x
+
+% v point_size_attenuated
+
+# Point size with distance attenuation
+#
+# Output:	o9.x - point size (remapped to follow position)
+
+	# Eye space position
+	mul r11, c8,  v0.x
+	mad r11, c9,  v0.y, r11
+	mad r11, c10, v0.z, r11
+	mad r11, c11, v0.w, r11
+	# Squared distance to eye and its reciprocal square root
+	dp3 r11.z, r11, r11
+	rsq r11.w, r11.z
+	# (1, d, d^2)
+	dst r11.xyz, r11.zzzz, r11.wwww
+	# size * sqrt(1 / (a + b * d + c * d^2))
+	dp3 r11.x, r11, c39
+	rsq r11.x, r11.x
+	mul o9.x, v3.x, r11.x
+
+################################################################################
+
+% v clip0
+
+# Clip plane 0
+	# Signed distance to the plane
+	dp4 o6.y, c36, v0
+
+% v clip1
+
+# Clip plane 1
+	# Signed distance to the plane
+	dp4 o6.z, c37, v0
+
+% v clip2
+
+# Clip plane 2
+	# Signed distance to the plane
+	dp4 o6.w, c38, v0
+
+################################################################################
+
+% v texgen
+
+# Texture coordinate generation (GL_OES_texture_cube_map)
+#
+# Output:	r16 - normal in eye space (normal map coordinates)
+#		r17 - reflection vector in eye space (reflection map coordinates)
+#
+# Texture coordinate attributes of units using generated coordinates
+# are replaced by the driver with one of these registers.
+
+	# Transform normal to eye space and normalize it
+	dp3 r16.x, c4, v1
+	dp3 r16.y, c5, v1
+	dp3 r16.z, c6, v1
+	dp3 r16.w, r16, r16
+	rsq r16.w, r16.w
+	mul r16.xyz, r16, r16.w
+	# Direction from eye to vertex
+	mul r17.xyzw, c8.xyzw,  v0.xxxx
+	mad r17.xyzw, c9.xyzw,  v0.yyyy, r17.xyzw
+	mad r17.xyzw, c10.xyzw, v0.zzzz, r17.xyzw
+	mad r17.xyzw, c11.xyzw, v0.wwww, r17.xyzw
+	dp3 r17.w, r17, r17
+	rsq r17.w, r17.w
+	mul r17.xyz, r17, r17.w
+	# Reflect it about the normal: u - 2 * (n . u) * n
+	dp3 r17.w, r16, r17
+	add r17.w, r17.w, r17.w
+	mad r17.xyz, -r16.xyz, r17.wwww, r17.xyz
+	# Set q coordinates to 1.0
+	sge r16.w, r16.w, r16.w
+	mov r17.w, r16.w
 
 ################################################################################
 
@@ -71,19 +541,61 @@ label start
 
 # Texture 0
 	# Transform texture0 coordinates
-	mul r1.xyzw, c8.xyzw,  v4.xxxx
-	mad r1.xyzw, c9.xyzw,  v4.yyyy, r1.xyzw
-	mad r1.xyzw, c10.xyzw, v4.zzzz, r1.xyzw
-	mad o2.xyzw, c11.xyzw, v4.wwww, r1.xyzw
+	mul r1.xyzw, c12.xyzw, v4.xxxx
+	mad r1.xyzw, c13.xyzw, v4.yyyy, r1.xyzw
+	mad r1.xyzw, c14.xyzw, v4.zzzz, r1.xyzw
+	mad o2.xyzw, c15.xyzw, v4.wwww, r1.xyzw
 
 % v texture1
 
 # Texture 1
 	# Transform texture1 coordinates
-	mul r2.xyzw, c12.xyzw, v5.xxxx
-	mad r2.xyzw, c13.xyzw, v5.yyyy, r2.xyzw
-	mad r2.xyzw, c14.xyzw, v5.zzzz, r2.xyzw
-	mad o3.xyzw, c15.xyzw, v5.wwww, r2.xyzw
+	mul r2.xyzw, c16.xyzw, v5.xxxx
+	mad r2.xyzw, c17.xyzw, v5.yyyy, r2.xyzw
+	mad r2.xyzw, c18.xyzw, v5.zzzz, r2.xyzw
+	mad o3.xyzw, c19.xyzw, v5.wwww, r2.xyzw
+
+% v texture2
+
+# Texture 2
+	# Transform texture2 coordinates
+	mul r12.xyzw, c20.xyzw, v6.xxxx
+	mad r12.xyzw, c21.xyzw, v6.yyyy, r12.xyzw
+	mad r12.xyzw, c22.xyzw, v6.zzzz, r12.xyzw
+	mad o4.xyzw, c23.xyzw, v6.wwww, r12.xyzw
+
+% v texture3
+
+# Texture 3
+	# Transform texture3 coordinates
+	mul r13.xyzw, c24.xyzw, v7.xxxx
+	mad r13.xyzw, c25.xyzw, v7.yyyy, r13.xyzw
+	mad r13.xyzw, c26.xyzw, v7.zzzz, r13.xyzw
+	mad o5.xyzw, c27.xyzw, v7.wwww, r13.xyzw
+
+% v texture0_identity
+
+# Texture 0 (identity matrix)
+	# Pass texture0 coordinates
+	mov o2, v4
+
+% v texture1_identity
+
+# Texture 1 (identity matrix)
+	# Pass texture1 coordinates
+	mov o3, v5
+
+% v texture2_identity
+
+# Texture 2 (identity matrix)
+	# Pass texture2 coordinates
+	mov o4, v6
+
+% v texture3_identity
+
+# Texture 3 (identity matrix)
+	# Pass texture3 coordinates
+	mov o5, v7
 
 ################################################################################
 
@@ -95,6 +607,24 @@ label start
 
 ################################################################################
 
+% v draw_texture
+
+# Resident shader for glDrawTexOES
+#
+# Vertices come in normalized device coordinates and texture coordinates
+# are passed unchanged.
+	mov o0, v0
+	mov o1, v2
+	mov o2, v4
+	mov o3, v5
+	mov o4, v6
+	mov o5, v7
+	# No fog (factor 1.0) and positive distances to all clip planes
+	sge o6, v0, v0
+	ret
+
+################################################################################
+
 % v clear
 
 # Shader for glClear
@@ -5,31 +5,290 @@ static const unsigned int vert_cfloat[] = {
 };
 
 static const unsigned int vert_header[] = {
+};
+
+static const unsigned int vert_palette[] = {
+	0x1c000000, 0x0009e402, 0x037827e4, 0x00000000,
+	0x00000000, 0x026f0000, 0x00f82eaa, 0x00000000,
+	0x00000000, 0x026f0000, 0x00f82faa, 0x00000000,
+};
+
+static const unsigned int vert_palette_position[] = {
+	0x6f000000, 0x00080002, 0x0b7828e4, 0x00000000,
+	0x6f000000, 0x00085502, 0x0b7829e4, 0x00000000,
+	0x09000000, 0x0108e441, 0x027828e4, 0x00000000,
+	0x07000000, 0x0108e401, 0x048826e4, 0x00000000,
+	0x00000000, 0x02680000, 0x237828e4, 0x00000000,
+	0x00e40108, 0x02695500, 0x2ef828e4, 0x00000000,
+	0x00e40108, 0x026aaa00, 0x2ef828e4, 0x00000000,
+	0x00e40108, 0x026bff00, 0x2ef828e4, 0x00000000,
+	0x06e4010e, 0x01080001, 0x0ef82ee4, 0x00000000,
+};
+
+static const unsigned int vert_palette_normal[] = {
+	0x01000000, 0x026ce400, 0x040829e4, 0x00000000,
+	0x01000000, 0x026de400, 0x041029e4, 0x00000000,
+	0x01000000, 0x026ee400, 0x242029e4, 0x00000000,
+	0x06a4010f, 0x01090001, 0x0eb82fa4, 0x00000000,
+};
+
+static const unsigned int vert_color[] = {
+	0x00000000, 0x00020000, 0x00f801e4, 0x00000000,
+};
+
+static const unsigned int vert_position[] = {
 	0x00000000, 0x02000000, 0x237820e4, 0x00000000,
 	0x00e40100, 0x02015500, 0x2ef820e4, 0x00000000,
 	0x00e40100, 0x0202aa00, 0x2ef820e4, 0x00000000,
 	0x00e40100, 0x0203ff00, 0x0ef800e4, 0x00000000,
-	0x00000000, 0x00020000, 0x00f801e4, 0x00000000,
+};
+
+static const unsigned int vert_position_identity[] = {
+	0x00000000, 0x00000000, 0x00f800e4, 0x00000000,
+};
+
+static const unsigned int vert_position_st[] = {
+	0x00000000, 0x0200e400, 0x237820e4, 0x00000000,
+	0x00e40100, 0x0203ff00, 0x0ef800e4, 0x00000000,
+};
+
+static const unsigned int vert_position_a2d[] = {
+	0x00000000, 0x0200a000, 0x237820e4, 0x00000000,
+	0x00e40100, 0x02015500, 0x2ef820e4, 0x00000000,
+	0x00e40100, 0x0203ff00, 0x0ef800e4, 0x00000000,
+};
+
+static const unsigned int vert_lighting[] = {
+	0x01000000, 0x0204e400, 0x040823e4, 0x00000000,
+	0x01000000, 0x0205e400, 0x041023e4, 0x00000000,
+	0x01000000, 0x0206e400, 0x042023e4, 0x00000000,
+	0x03000000, 0x0103e401, 0x044023e4, 0x00000000,
+	0x00000000, 0x01030000, 0x08c023ff, 0x00000000,
+	0x03000000, 0x0103ff01, 0x033823e4, 0x00000000,
+	0x00000000, 0x02200000, 0x00f825e4, 0x00000000,
+};
+
+static const unsigned int vert_lighting_eyepos[] = {
+	0x00000000, 0x02080000, 0x237824e4, 0x00000000,
+	0x00e40104, 0x02095500, 0x2ef824e4, 0x00000000,
+	0x00e40104, 0x020aaa00, 0x2ef824e4, 0x00000000,
+	0x00e40104, 0x020bff00, 0x0ef824e4, 0x00000000,
+};
+
+static const unsigned int vert_light_directional[] = {
+	0x28000000, 0x0103e402, 0x040826e4, 0x00000000,
+	0x21000000, 0x01065502, 0x0a082600, 0x00000000,
+	0x2c000000, 0x0103e402, 0x041026e4, 0x00000000,
+	0x21000000, 0x0106aa02, 0x0a102655, 0x00000000,
+	0x00000000, 0x01060000, 0x07102655, 0x00000000,
+	0x21000000, 0x01060002, 0x03102655, 0x00000000,
+	0x00000000, 0x01060000, 0x06102655, 0x00000000,
+	0x06000000, 0x02210001, 0x0ba02655, 0x00000000,
+	0x06000000, 0x0106aa01, 0x03102655, 0x00000000,
+	0x29000000, 0x0105e402, 0x227825e4, 0x00000000,
+	0x06e40105, 0x022a0001, 0x2ef825e4, 0x00000000,
+	0x06e40105, 0x022b5501, 0x0ef825e4, 0x00000000,
+};
+
+static const unsigned int vert_light_point[] = {
+	0x04000000, 0x0228e441, 0x027826e4, 0x00000000,
+	0x06000000, 0x0106e401, 0x042027e4, 0x00000000,
+	0x00000000, 0x01070000, 0x08c027aa, 0x00000000,
+	0x07000000, 0x0106ff01, 0x033826e4, 0x00000000,
+	0x07000000, 0x0107ff01, 0x031027aa, 0x00000000,
+	0x00000000, 0x02210000, 0x008827ff, 0x00000000,
+	0x2e000000, 0x0107e402, 0x040827e4, 0x00000000,
+	0x00000000, 0x01070000, 0x08082700, 0x00000000,
+	0x22000000, 0x0106e402, 0x023828e4, 0x00000000,
+	0x08000000, 0x0108e401, 0x044028e4, 0x00000000,
+	0x00000000, 0x01080000, 0x08c028ff, 0x00000000,
+	0x08000000, 0x0108ff01, 0x033828e4, 0x00000000,
+	0x06000000, 0x0103e401, 0x040829e4, 0x00000000,
+	0x21000000, 0x01095502, 0x0a082900, 0x00000000,
+	0x08000000, 0x0103e401, 0x041029e4, 0x00000000,
+	0x21000000, 0x0109aa02, 0x0a102955, 0x00000000,
+	0x00000000, 0x01090000, 0x07102955, 0x00000000,
+	0x21000000, 0x01090002, 0x03102955, 0x00000000,
+	0x00000000, 0x01090000, 0x06102955, 0x00000000,
+	0x09000000, 0x02210001, 0x0ba02955, 0x00000000,
+	0x09000000, 0x0109aa01, 0x03102955, 0x00000000,
+	0x07000000, 0x01090001, 0x031829e4, 0x00000000,
+	0x07e40105, 0x02290001, 0x2ef825e4, 0x00000000,
+	0x09e40105, 0x022a0001, 0x2ef825e4, 0x00000000,
+	0x09e40105, 0x022b5501, 0x0ef825e4, 0x00000000,
+};
+
+static const unsigned int vert_light_spot[] = {
+	0x04000000, 0x0228e441, 0x027826e4, 0x00000000,
+	0x06000000, 0x0106e401, 0x042027e4, 0x00000000,
+	0x00000000, 0x01070000, 0x08c027aa, 0x00000000,
+	0x07000000, 0x0106ff01, 0x033826e4, 0x00000000,
+	0x07000000, 0x0107ff01, 0x031027aa, 0x00000000,
+	0x00000000, 0x02210000, 0x008827ff, 0x00000000,
+	0x2e000000, 0x0107e402, 0x040827e4, 0x00000000,
+	0x00000000, 0x01070000, 0x08082700, 0x00000000,
+	0x2d000000, 0x4106e402, 0x041027e4, 0x00000000,
+	0x2d000000, 0x0107ff02, 0x0b202755, 0x00000000,
+	0x21000000, 0x0107aa02, 0x0a102755, 0x00000000,
+	0x00000000, 0x01070000, 0x07102755, 0x00000000,
+	0x2e000000, 0x0107ff02, 0x03102755, 0x00000000,
+	0x00000000, 0x01070000, 0x06102755, 0x00000000,
+	0x07000000, 0x0107aa01, 0x03102755, 0x00000000,
+	0x07000000, 0x01075501, 0x03082700, 0x00000000,
+	0x22000000, 0x0106e402, 0x023828e4, 0x00000000,
+	0x08000000, 0x0108e401, 0x044028e4, 0x00000000,
+	0x00000000, 0x01080000, 0x08c028ff, 0x00000000,
+	0x08000000, 0x0108ff01, 0x033828e4, 0x00000000,
+	0x06000000, 0x0103e401, 0x040829e4, 0x00000000,
+	0x21000000, 0x01095502, 0x0a082900, 0x00000000,
+	0x08000000, 0x0103e401, 0x041029e4, 0x00000000,
+	0x21000000, 0x0109aa02, 0x0a102955, 0x00000000,
+	0x00000000, 0x01090000, 0x07102955, 0x00000000,
+	0x21000000, 0x01090002, 0x03102955, 0x00000000,
+	0x00000000, 0x01090000, 0x06102955, 0x00000000,
+	0x09000000, 0x02210001, 0x0ba02955, 0x00000000,
+	0x09000000, 0x0109aa01, 0x03102955, 0x00000000,
+	0x07000000, 0x01090001, 0x031829e4, 0x00000000,
+	0x07e40105, 0x02290001, 0x2ef825e4, 0x00000000,
+	0x09e40105, 0x022a0001, 0x2ef825e4, 0x00000000,
+	0x09e40105, 0x022b5501, 0x0ef825e4, 0x00000000,
+};
+
+static const unsigned int vert_lighting_end[] = {
+	0x00000000, 0x01050000, 0x00fa01e4, 0x00000000,
+};
+
+static const unsigned int vert_fog[] = {
+	0x00000000, 0x02080000, 0x23082aaa, 0x00000000,
+	0x0000010a, 0x02095500, 0x2e882aaa, 0x00000000,
+	0x0000010a, 0x020aaa00, 0x2e882aaa, 0x00000000,
+	0x0000010a, 0x020bff00, 0x0e882aaa, 0x00000000,
+};
+
+static const unsigned int vert_fog_linear[] = {
+	0x23550223, 0x010a0002, 0x0e8a0600, 0x00000000,
+};
+
+static const unsigned int vert_fog_exp[] = {
+	0x23000000, 0x010aaa02, 0x03082a00, 0x00000000,
+	0x00000000, 0x010a0000, 0x060a0600, 0x00000000,
+};
+
+static const unsigned int vert_fog_exp2[] = {
+	0x0a000000, 0x010a0001, 0x03082a00, 0x00000000,
+	0x23000000, 0x010aff02, 0x03082a00, 0x00000000,
+	0x00000000, 0x010a0000, 0x060a0600, 0x00000000,
+};
+
+static const unsigned int vert_point_size[] = {
+	0x00000000, 0x00030000, 0x00880900, 0x00000000,
+};
+
+static const unsigned int vert_point_size_attenuated[] = {
+	0x00000000, 0x02080000, 0x23782be4, 0x00000000,
+	0x00e4010b, 0x02095500, 0x2ef82be4, 0x00000000,
+	0x00e4010b, 0x020aaa00, 0x2ef82be4, 0x00000000,
+	0x00e4010b, 0x020bff00, 0x0ef82be4, 0x00000000,
+	0x0b000000, 0x010be401, 0x04202be4, 0x00000000,
+	0x00000000, 0x010b0000, 0x08c02baa, 0x00000000,
+	0x0b000000, 0x010bff01, 0x05b82baa, 0x00000000,
+	0x27000000, 0x010be402, 0x04082be4, 0x00000000,
+	0x00000000, 0x010b0000, 0x08882b00, 0x00000000,
+	0x0b000000, 0x00030001, 0x03080900, 0x00000000,
+};
+
+static const unsigned int vert_clip0[] = {
+	0x00000000, 0x0224e400, 0x049006e4, 0x00000000,
+};
+
+static const unsigned int vert_clip1[] = {
+	0x00000000, 0x0225e400, 0x04a006e4, 0x00000000,
+};
+
+static const unsigned int vert_clip2[] = {
+	0x00000000, 0x0226e400, 0x04c006e4, 0x00000000,
+};
+
+static const unsigned int vert_texgen[] = {
+	0x01000000, 0x0204e400, 0x040830e4, 0x00000000,
+	0x01000000, 0x0205e400, 0x041030e4, 0x00000000,
+	0x01000000, 0x0206e400, 0x042030e4, 0x00000000,
+	0x10000000, 0x0110e401, 0x044030e4, 0x00000000,
+	0x00000000, 0x01100000, 0x08c030ff, 0x00000000,
+	0x10000000, 0x0110ff01, 0x033830e4, 0x00000000,
+	0x00000000, 0x02080000, 0x237831e4, 0x00000000,
+	0x00e40111, 0x02095500, 0x2ef831e4, 0x00000000,
+	0x00e40111, 0x020aaa00, 0x2ef831e4, 0x00000000,
+	0x00e40111, 0x020bff00, 0x0ef831e4, 0x00000000,
+	0x11000000, 0x0111e401, 0x044031e4, 0x00000000,
+	0x00000000, 0x01110000, 0x08c031ff, 0x00000000,
+	0x11000000, 0x0111ff01, 0x033831e4, 0x00000000,
+	0x11000000, 0x0110e401, 0x044031e4, 0x00000000,
+	0x11000000, 0x0111ff01, 0x224031ff, 0x00000000,
+	0x11a40111, 0x4110ff01, 0x0eb831a4, 0x00000000,
+	0x10000000, 0x0110ff01, 0x0b4030ff, 0x00000000,
+	0x00000000, 0x01100000, 0x00c031ff, 0x00000000,
 };
 
 static const unsigned int vert_texture0[] = {
-	0x04000000, 0x02080000, 0x237821e4, 0x00000000,
-	0x04e40101, 0x02095500, 0x2ef821e4, 0x00000000,
-	0x04e40101, 0x020aaa00, 0x2ef821e4, 0x00000000,
-	0x04e40101, 0x020bff00, 0x0ef802e4, 0x00000000,
+	0x04000000, 0x020c0000, 0x237821e4, 0x00000000,
+	0x04e40101, 0x020d5500, 0x2ef821e4, 0x00000000,
+	0x04e40101, 0x020eaa00, 0x2ef821e4, 0x00000000,
+	0x04e40101, 0x020fff00, 0x0ef802e4, 0x00000000,
 };
 
 static const unsigned int vert_texture1[] = {
-	0x05000000, 0x020c0000, 0x237822e4, 0x00000000,
-	0x05e40102, 0x020d5500, 0x2ef822e4, 0x00000000,
-	0x05e40102, 0x020eaa00, 0x2ef822e4, 0x00000000,
-	0x05e40102, 0x020fff00, 0x0ef803e4, 0x00000000,
+	0x05000000, 0x02100000, 0x237822e4, 0x00000000,
+	0x05e40102, 0x02115500, 0x2ef822e4, 0x00000000,
+	0x05e40102, 0x0212aa00, 0x2ef822e4, 0x00000000,
+	0x05e40102, 0x0213ff00, 0x0ef803e4, 0x00000000,
+};
+
+static const unsigned int vert_texture2[] = {
+	0x06000000, 0x02140000, 0x23782ce4, 0x00000000,
+	0x06e4010c, 0x02155500, 0x2ef82ce4, 0x00000000,
+	0x06e4010c, 0x0216aa00, 0x2ef82ce4, 0x00000000,
+	0x06e4010c, 0x0217ff00, 0x0ef804e4, 0x00000000,
+};
+
+static const unsigned int vert_texture3[] = {
+	0x07000000, 0x02180000, 0x23782de4, 0x00000000,
+	0x07e4010d, 0x02195500, 0x2ef82de4, 0x00000000,
+	0x07e4010d, 0x021aaa00, 0x2ef82de4, 0x00000000,
+	0x07e4010d, 0x021bff00, 0x0ef805e4, 0x00000000,
+};
+
+static const unsigned int vert_texture0_identity[] = {
+	0x00000000, 0x00040000, 0x00f802e4, 0x00000000,
+};
+
+static const unsigned int vert_texture1_identity[] = {
+	0x00000000, 0x00050000, 0x00f803e4, 0x00000000,
+};
+
+static const unsigned int vert_texture2_identity[] = {
+	0x00000000, 0x00060000, 0x00f804e4, 0x00000000,
+};
+
+static const unsigned int vert_texture3_identity[] = {
+	0x00000000, 0x00070000, 0x00f805e4, 0x00000000,
 };
 
 static const unsigned int vert_footer[] = {
 	0x00000000, 0x00000000, 0x1e000000, 0x00000000,
 };
 
+static const unsigned int vert_draw_texture[] = {
+	0x00000000, 0x00000000, 0x00f800e4, 0x00000000,
+	0x00000000, 0x00020000, 0x00f801e4, 0x00000000,
+	0x00000000, 0x00040000, 0x00f802e4, 0x00000000,
+	0x00000000, 0x00050000, 0x00f803e4, 0x00000000,
+	0x00000000, 0x00060000, 0x00f804e4, 0x00000000,
+	0x00000000, 0x00070000, 0x00f805e4, 0x00000000,
+	0x00000000, 0x0000e400, 0x0b7806e4, 0x00000000,
+	0x00000000, 0x00000000, 0x1e000000, 0x00000000,
+};
+
 static const unsigned int vert_clear[] = {
 	0x00000000, 0x00000000, 0x00f800e4, 0x00000000,
 	0x00000000, 0x00000000, 0x1e000000, 0x00000000,
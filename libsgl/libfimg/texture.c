@@ -200,6 +200,46 @@ void fimgSetTex3DSize(fimgTexture *texture, unsigned int vSize,
 	texture->pSize = pSize;
 }
 
+/*****************************************************************************
+* FUNCTIONS:	fimgSetTexType
+* SYNOPSIS:	This function sets texture type. Faces of cube textures are
+*		stored one after another from base address, in order +X, -X,
+*		+Y, -Y, +Z, -Z, each followed by its complete mipmap chain.
+* PARAMETERS:	[IN]	unsigned type: texture type (FGTU_TSTA_TYPE_*)
+*****************************************************************************/
+void fimgSetTexType(fimgTexture *texture, unsigned type)
+{
+	texture->control.type = type;
+}
+
+/*****************************************************************************
+* FUNCTIONS:	fimgSetTexPaletteFormat
+* SYNOPSIS:	This function sets format of palette entries used by
+*		1, 2, 4 and 8 BPP textures.
+* PARAMETERS:	[IN]	unsigned format: palette format
+*			(FGTU_TSTA_PAL_TEX_FORMAT_*)
+*****************************************************************************/
+void fimgSetTexPaletteFormat(fimgTexture *texture, unsigned format)
+{
+	texture->control.paletteFmt = format;
+}
+
+/*****************************************************************************
+* FUNCTIONS:	fimgLoadTexPalette
+* SYNOPSIS:	This function loads entries of the texture palette, starting
+*		from the first one. The palette is shared by all texture units.
+* PARAMETERS:	[IN]	const uint32_t *entries: palette entries
+*		[IN]	unsigned count: number of entries (1~256)
+*****************************************************************************/
+void fimgLoadTexPalette(fimgContext *ctx, const uint32_t *entries,
+							unsigned count)
+{
+	fimgWrite(ctx, 0, FGTU_PALETTE_ADDR);
+
+	while (count--)
+		fimgWrite(ctx, *(entries++), FGTU_PALETTE_IN);
+}
+
 void fimgSetTexUAddrMode(fimgTexture *texture, unsigned mode)
 {
 	texture->control.uAddrMode = mode;
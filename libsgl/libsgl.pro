@@ -18,6 +18,9 @@ SOURCES += \
     glesGet.cpp \
     glesBase.cpp \
     fglmatrix.cpp \
+    fgltranscode.cpp \
+    fglpmem.cpp \
+    fglmipmap.cpp \
     eglMem.cpp \
     eglBase.cpp \
     libfimg/texture.c \
@@ -30,6 +33,7 @@ SOURCES += \
     libfimg/fragment.c \
     libfimg/dump.c \
     libfimg/compat.c \
+    libfimg/optimizer.c \
     glesFrame.cpp
 
 HEADERS += \
@@ -43,7 +47,12 @@ HEADERS += \
     fglobjectmanager.h \
     fglobject.h \
     fglmatrix.h \
+    fgltranscode.h \
+    fglpmem.h \
+    fglmipmap.h \
     fglbufferobject.h \
+    fglprogramobject.h \
+    fglext.h \
     eglMem.h \
     common.h \
     libfimg/s3c_g3d.h \
@@ -77,4 +86,5 @@ unix:!symbian {
 
 OTHER_FILES += \
     libfimg/shaders/vert.asm \
-    libfimg/shaders/frag.asm
+    libfimg/shaders/frag.asm \
+    libfimg/shaders/fimgasm.c
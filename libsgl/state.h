@@ -36,6 +36,7 @@
 #include "fglmatrix.h"
 #include "fgltextureobject.h"
 #include "fglbufferobject.h"
+#include "fglprogramobject.h"
 #include "fglobject.h"
 
 enum {
@@ -66,6 +67,9 @@ enum {
 	FGL_ARRAY_TEXTURE
 };
 #define FGL_ARRAY_TEXTURE(i)	(FGL_ARRAY_TEXTURE + (i))
+#define FGL_ARRAY_MATRIX_INDEX	FGL_ARRAY_TEXTURE(FGL_MAX_TEXTURE_UNITS)
+#define FGL_ARRAY_WEIGHT	(FGL_ARRAY_MATRIX_INDEX + 1)
+#define FGL_ARRAY_NUM		(FGL_ARRAY_WEIGHT + 1)
 
 #include <cutils/log.h>
 
@@ -100,31 +104,176 @@ enum {
 	FGL_MATRIX_TEXTURE
 };
 #define FGL_MATRIX_TEXTURE(__mtx)	(FGL_MATRIX_TEXTURE + (__mtx))
+#define FGL_MATRIX_PALETTE(__mtx)	\
+		(FGL_MATRIX_TEXTURE(FGL_MAX_TEXTURE_UNITS) + 2*(__mtx))
+#define FGL_MATRIX_PALETTE_INVERSE(__mtx)	(FGL_MATRIX_PALETTE(__mtx) + 1)
+#define FGL_MATRIX_NUM		FGL_MATRIX_PALETTE(FGL_MAX_PALETTE_MATRICES)
 
 struct FGLMatrixState {
-	FGLstack<FGLmatrix> stack[3 + FGL_MAX_TEXTURE_UNITS];
-	GLboolean dirty[3 + FGL_MAX_TEXTURE_UNITS];
+	FGLstack<FGLmatrix> stack[FGL_MATRIX_NUM];
+	GLboolean dirty[FGL_MATRIX_NUM];
 	FGLmatrix transformMatrix;
+	FGLmatrix identityMatrix;
 	GLint activeMatrix;
+	GLint activePalette;
+	/* Number of palette matrices referenced so far */
+	GLint paletteCount;
+	GLboolean paletteEnabled;
 
 	static unsigned int stackSizes[3 + FGL_MAX_TEXTURE_UNITS];
 
-	FGLMatrixState() : activeMatrix(0)
+	FGLMatrixState() :
+		activeMatrix(0), activePalette(0), paletteCount(1),
+		paletteEnabled(GL_FALSE)
 	{
-		for(int i = 0; i < 3 + FGL_MAX_TEXTURE_UNITS; i++) {
-			stack[i].create(stackSizes[i]);
+		for(int i = 0; i < FGL_MATRIX_NUM; i++) {
+			/* Palette matrices have no stacks */
+			if (i < FGL_MATRIX_PALETTE(0))
+				stack[i].create(stackSizes[i]);
+			else
+				stack[i].create(1);
 			stack[i].top().identity();
 			dirty[i] = GL_TRUE;
 		}
+		identityMatrix.identity();
 	}
 
 	~FGLMatrixState()
 	{
-		for(int i = 0; i < 3 + FGL_MAX_TEXTURE_UNITS; i++)
+		for(int i = 0; i < FGL_MATRIX_NUM; i++)
 			stack[i].destroy();
 	}
 };
 
+struct FGLLightState {
+	FGLvec4f ambient;
+	FGLvec4f diffuse;
+	FGLvec4f specular;
+	FGLvec4f position;
+	FGLvec3f direction;
+	GLfloat exponent;
+	GLfloat cutoff;
+	GLfloat attenuation[3];
+	GLboolean enabled;
+
+	FGLLightState() :
+		exponent(0), cutoff(180), enabled(GL_FALSE)
+	{
+		static const FGLvec4f black = { 0.0f, 0.0f, 0.0f, 1.0f };
+		static const FGLvec4f z = { 0.0f, 0.0f, 1.0f, 0.0f };
+
+		memcpy(ambient, black, sizeof(FGLvec4f));
+		memcpy(diffuse, black, sizeof(FGLvec4f));
+		memcpy(specular, black, sizeof(FGLvec4f));
+		memcpy(position, z, sizeof(FGLvec4f));
+		direction[0] = 0.0f;
+		direction[1] = 0.0f;
+		direction[2] = -1.0f;
+		attenuation[0] = 1.0f;
+		attenuation[1] = 0.0f;
+		attenuation[2] = 0.0f;
+	}
+};
+
+struct FGLMaterialState {
+	FGLvec4f ambient;
+	FGLvec4f diffuse;
+	FGLvec4f specular;
+	FGLvec4f emission;
+	GLfloat shininess;
+
+	FGLMaterialState() :
+		shininess(0)
+	{
+		for (int i = 0; i < 3; ++i) {
+			ambient[i] = 0.2f;
+			diffuse[i] = 0.8f;
+			specular[i] = 0.0f;
+			emission[i] = 0.0f;
+		}
+		ambient[3] = diffuse[3] = specular[3] = emission[3] = 1.0f;
+	}
+};
+
+struct FGLLightingState {
+	FGLLightState light[FGL_MAX_LIGHTS];
+	FGLMaterialState material;
+	FGLvec4f ambient;
+	GLboolean twoSide;
+	GLboolean enabled;
+	GLboolean dirty;
+
+	FGLLightingState() :
+		twoSide(GL_FALSE), enabled(GL_FALSE), dirty(GL_TRUE)
+	{
+		ambient[0] = ambient[1] = ambient[2] = 0.2f;
+		ambient[3] = 1.0f;
+
+		for (int i = 0; i < 4; ++i)
+			light[0].diffuse[i] = light[0].specular[i] = 1.0f;
+	}
+};
+
+struct FGLFogState {
+	GLenum mode;
+	GLfloat density;
+	GLfloat start;
+	GLfloat end;
+	FGLvec4f color;
+	GLboolean enabled;
+
+	FGLFogState() :
+		mode(GL_EXP), density(1), start(0), end(1), enabled(GL_FALSE)
+	{
+		color[0] = color[1] = color[2] = color[3] = 0.0f;
+	}
+};
+
+struct FGLClipPlaneState {
+	FGLvec4f eye[FGL_MAX_CLIP_PLANES];
+	FGLvec4f object[FGL_MAX_CLIP_PLANES];
+	GLboolean enabled[FGL_MAX_CLIP_PLANES];
+	GLboolean dirty;
+
+	FGLClipPlaneState() :
+		dirty(GL_TRUE)
+	{
+		memset(eye, 0, sizeof(eye));
+		memset(object, 0, sizeof(object));
+		for (int i = 0; i < FGL_MAX_CLIP_PLANES; ++i)
+			enabled[i] = GL_FALSE;
+	}
+};
+
+struct FGLPointState {
+	GLfloat sizeMin;
+	GLfloat sizeMax;
+	GLfloat fadeThreshold;
+	FGLvec4f attenuation;
+	GLboolean sprite;
+	GLboolean coordReplace[FGL_MAX_TEXTURE_UNITS];
+	GLboolean dirty;
+
+	FGLPointState() :
+		sizeMin(1), sizeMax(FGL_MAX_POINT_SIZE), fadeThreshold(1),
+		sprite(GL_FALSE), dirty(GL_TRUE)
+	{
+		attenuation[0] = 1.0f;
+		attenuation[1] = attenuation[2] = attenuation[3] = 0.0f;
+		for (int i = 0; i < FGL_MAX_TEXTURE_UNITS; ++i)
+			coordReplace[i] = GL_FALSE;
+	}
+};
+
+struct FGLDrawTexState {
+	GLint count;
+	GLfloat vertices[FGL_DRAW_TEX_BATCH][6*3];
+	GLfloat texcoords[FGL_MAX_TEXTURE_UNITS][FGL_DRAW_TEX_BATCH][6*2];
+
+	FGLDrawTexState() :
+		count(0) {};
+};
+
 #define FGL_IS_CURRENT		0x00010000
 #define FGL_NEVER_CURRENT	0x00020000
 #define FGL_NEEDS_RESTORE	0x00100000
@@ -159,9 +308,19 @@ struct FGLTextureState {
 	FGLTexture defTexture;
 	FGLTextureObjectBinding binding;
 	bool enabled;
+	FGLTexture defCubeTexture;
+	FGLTextureObjectBinding cubeBinding;
+	bool cubeEnabled;
+	bool texGen;
+	GLenum texGenMode;
 
 	FGLTextureState() :
-		defTexture(), binding(), enabled(false) {};
+		defTexture(), binding(), enabled(false),
+		defCubeTexture(), cubeBinding(), cubeEnabled(false),
+		texGen(false), texGenMode(GL_REFLECTION_MAP_OES)
+	{
+		defCubeTexture.target = GL_TEXTURE_CUBE_MAP_OES;
+	};
 
 	inline FGLTexture *getTexture(void)
 	{
@@ -170,6 +329,24 @@ struct FGLTextureState {
 		else
 			return &defTexture;
 	}
+
+	inline FGLTexture *getCubeTexture(void)
+	{
+		if(cubeBinding.isBound())
+			return cubeBinding.get();
+		else
+			return &defCubeTexture;
+	}
+
+	/* Texture used for rendering (cube map takes precedence) */
+	inline FGLTexture *getEnabledTexture(void)
+	{
+		if (cubeEnabled)
+			return getCubeTexture();
+		if (enabled)
+			return getTexture();
+		return 0;
+	}
 };
 
 struct FGLSurfaceData
@@ -261,37 +438,54 @@ struct FGLContext {
 	/* HW state */
 	fimgContext *fimg;
 	/* GL state */
-	FGLvec4f vertex[4 + FGL_MAX_TEXTURE_UNITS];
-	FGLArrayState array[4 + FGL_MAX_TEXTURE_UNITS];
+	FGLvec4f vertex[FGL_ARRAY_NUM];
+	FGLArrayState array[FGL_ARRAY_NUM];
 	GLint activeTexture;
 	GLint clientActiveTexture;
 	FGLMatrixState matrix;
+	FGLLightingState lighting;
+	FGLFogState fog;
+	FGLClipPlaneState clipPlane;
+	FGLPointState point;
+	FGLDrawTexState drawTex;
 	FGLTextureState texture[FGL_MAX_TEXTURE_UNITS];
 	FGLuint unpackAlignment;
 	FGLuint packAlignment;
 	FGLBufferObjectBinding arrayBuffer;
 	FGLBufferObjectBinding elementArrayBuffer;
+	FGLProgramObjectBinding program;
+	/* Serial of program loaded into libfimg, 0 for fixed pipeline */
+	unsigned programSerial;
 	FGLRenderBufferObjectBinding renderbuffer;
 	FGLFramebufferState framebuffer;
 	FGLViewportState viewport;
 	FGLPerFragmentState perFragment;
 	FGLClearState clear;
 	FGLTexture *busyTexture[FGL_MAX_TEXTURE_UNITS];
+	/* Texture storage replaced while still used by the hardware */
+	FGLSurface *retiredSurface[FGL_MAX_RETIRED_SURFACES];
+	unsigned numRetiredSurfaces;
+	/* Textures with local storage allocated by this context, LRU first */
+	FGLTexture *residentFirst;
+	FGLTexture *residentLast;
+	unsigned textureFrame;
 	FGLEnableState enable;
 	/* EGL state */
 	FGLEGLState egl;
 	FGLSurfaceState surface;
 
 	/* Static initializers */
-	static FGLvec4f defaultVertex[4 + FGL_MAX_TEXTURE_UNITS];
+	static FGLvec4f defaultVertex[FGL_ARRAY_NUM];
 
 	FGLContext(fimgContext *fctx) :
 		fimg(fctx), activeTexture(0), clientActiveTexture(0), matrix(),
-		unpackAlignment(4), packAlignment(4), egl(), surface()
+		lighting(), fog(), clipPlane(), point(), drawTex(), unpackAlignment(4), packAlignment(4), programSerial(0),
+		numRetiredSurfaces(0), residentFirst(0), residentLast(0),
+		textureFrame(1), egl(), surface()
 	{
 		enable.bits = 0;
 
-		memcpy(vertex, defaultVertex, (4 + FGL_MAX_TEXTURE_UNITS) * sizeof(FGLvec4f));
+		memcpy(vertex, defaultVertex, FGL_ARRAY_NUM * sizeof(FGLvec4f));
 		for (int i = 0; i < FGL_MAX_TEXTURE_UNITS; ++i)
 			busyTexture[i] = 0;
 	}
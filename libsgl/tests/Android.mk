@@ -0,0 +1,47 @@
+LOCAL_PATH := $(call my-dir)
+
+#
+# Host tests of platform independent parts of libsgl
+#
+# Build with:
+#	make fglpmem_test fglmipmap_test fglmipmap_workers_test
+# and run the resulting host executables.
+#
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS += -Wall -Wno-unused-parameter -O2
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_LDLIBS := -lpthread
+
+LOCAL_SRC_FILES := fglpmem_test.cpp ../fglpmem.cpp
+
+LOCAL_MODULE := fglpmem_test
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS += -Wall -Wno-unused-parameter -O2
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_LDLIBS := -lpthread
+
+LOCAL_SRC_FILES := fglmipmap_test.cpp ../fglmipmap.cpp
+
+LOCAL_MODULE := fglmipmap_test
+include $(BUILD_HOST_EXECUTABLE)
+
+# Same test with every image split between worker threads
+include $(CLEAR_VARS)
+
+LOCAL_MODULE_TAGS := optional
+LOCAL_CFLAGS += -Wall -Wno-unused-parameter -O2
+LOCAL_CFLAGS += -DFGL_MIPMAP_FORCE_WORKERS -DFGL_MIPMAP_SPLIT_SIZE=1
+LOCAL_C_INCLUDES += $(LOCAL_PATH)/..
+LOCAL_LDLIBS := -lpthread
+
+LOCAL_SRC_FILES := fglmipmap_test.cpp ../fglmipmap.cpp
+
+LOCAL_MODULE := fglmipmap_workers_test
+include $(BUILD_HOST_EXECUTABLE)
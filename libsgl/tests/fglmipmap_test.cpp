@@ -0,0 +1,285 @@
+/**
+ * libsgl/tests/fglmipmap_test.cpp
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2010 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host test of fglDownsampleImage. Output must match the per-pixel box
+ * filter bit for bit, both on the calling thread and when split between
+ * workers (build with FGL_MIPMAP_FORCE_WORKERS).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "libfimg/fimg.h"
+#include "fglmipmap.h"
+
+static int failures;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", \
+					__FILE__, __LINE__, #cond); \
+			++failures; \
+		} \
+	} while (0)
+
+/*
+ * Reference filter
+ */
+
+static unsigned pixelSize(unsigned format)
+{
+	switch (format) {
+	case FGTU_TSTA_TEXTURE_FORMAT_8888:
+		return 4;
+	case FGTU_TSTA_TEXTURE_FORMAT_8:
+		return 1;
+	default:
+		return 2;
+	}
+}
+
+/* Averages four 16-bit pixels */
+static uint16_t average16(unsigned format, uint32_t p00, uint32_t p10,
+						uint32_t p01, uint32_t p11)
+{
+	uint32_t r, g, b, a;
+
+	switch (format) {
+	case FGTU_TSTA_TEXTURE_FORMAT_565:
+		r = ((p00 >> 11) + (p10 >> 11) + (p01 >> 11) + (p11 >> 11)) >> 2;
+		g = (((p00 >> 5) & 0x3f) + ((p10 >> 5) & 0x3f)
+			+ ((p01 >> 5) & 0x3f) + ((p11 >> 5) & 0x3f)) >> 2;
+		b = ((p00 & 0x1f) + (p10 & 0x1f)
+			+ (p01 & 0x1f) + (p11 & 0x1f)) >> 2;
+		return (r << 11) | (g << 5) | b;
+	case FGTU_TSTA_TEXTURE_FORMAT_1555:
+		/* Rounded to nearest, with blue kept at 6 bits until the end */
+		r = ((p00 >> 11) + (p10 >> 11) + (p01 >> 11) + (p11 >> 11)
+								+ 2) >> 2;
+		g = (((p00 >> 6) & 0x1f) + ((p10 >> 6) & 0x1f)
+			+ ((p01 >> 6) & 0x1f) + ((p11 >> 6) & 0x1f) + 2) >> 2;
+		b = ((p00 & 0x3e) + (p10 & 0x3e)
+			+ (p01 & 0x3e) + (p11 & 0x3e) + 4) >> 3;
+		a = ((p00 & 1) + (p10 & 1) + (p01 & 1) + (p11 & 1) + 2) >> 2;
+		return (r << 11) | (g << 6) | (b << 1) | a;
+	default: /* 4444, 88 */
+		uint32_t res = 0;
+		unsigned bits = (format == FGTU_TSTA_TEXTURE_FORMAT_4444) ? 4 : 8;
+		uint32_t mask = (1 << bits) - 1;
+		for (unsigned s = 0; s < 16; s += bits) {
+			uint32_t c = (((p00 >> s) & mask) + ((p10 >> s) & mask)
+				+ ((p01 >> s) & mask) + ((p11 >> s) & mask)) >> 2;
+			res |= c << s;
+		}
+		return res;
+	}
+}
+
+static void referenceDownsample(unsigned format, const uint8_t *src,
+			unsigned width, unsigned height, uint8_t *dst)
+{
+	unsigned bpp = pixelSize(format);
+	unsigned w = (width >> 1) ? : 1;
+	unsigned h = (height >> 1) ? : 1;
+
+	for (unsigned y = 0; y < h; ++y) {
+		unsigned y0 = 2*y;
+		unsigned y1 = (height > 1) ? 2*y + 1 : y0;
+
+		for (unsigned x = 0; x < w; ++x) {
+			unsigned x0 = 2*x;
+			unsigned x1 = (width > 1) ? 2*x + 1 : x0;
+			const uint8_t *p00 = src + (y0*width + x0)*bpp;
+			const uint8_t *p10 = src + (y0*width + x1)*bpp;
+			const uint8_t *p01 = src + (y1*width + x0)*bpp;
+			const uint8_t *p11 = src + (y1*width + x1)*bpp;
+			uint8_t *d = dst + (y*w + x)*bpp;
+
+			if (bpp == 2) {
+				uint16_t v = average16(format,
+					*(const uint16_t *)p00,
+					*(const uint16_t *)p10,
+					*(const uint16_t *)p01,
+					*(const uint16_t *)p11);
+				memcpy(d, &v, 2);
+				continue;
+			}
+
+			for (unsigned c = 0; c < bpp; ++c)
+				d[c] = (p00[c] + p10[c] + p01[c] + p11[c]) >> 2;
+		}
+	}
+}
+
+/*
+ * Tests
+ */
+
+static const unsigned formats[] = {
+	FGTU_TSTA_TEXTURE_FORMAT_565,
+	FGTU_TSTA_TEXTURE_FORMAT_1555,
+	FGTU_TSTA_TEXTURE_FORMAT_4444,
+	FGTU_TSTA_TEXTURE_FORMAT_8888,
+	FGTU_TSTA_TEXTURE_FORMAT_88,
+	FGTU_TSTA_TEXTURE_FORMAT_8,
+};
+
+static const unsigned sizes[][2] = {
+	{ 1, 1 }, { 2, 1 }, { 1, 2 }, { 1, 8 }, { 8, 1 }, { 2, 2 },
+	{ 3, 5 }, { 6, 2 }, { 2, 512 }, { 16, 16 }, { 130, 70 },
+	{ 256, 128 }, { 1024, 256 }, { 512, 512 },
+};
+
+#define GUARD		0xa5
+#define GUARD_SIZE	16
+
+/* Random images of all sizes, at aligned and unaligned addresses */
+static void testReference(void)
+{
+	srand(1);
+
+	for (unsigned f = 0; f < sizeof(formats)/sizeof(*formats); ++f) {
+		unsigned format = formats[f];
+		unsigned bpp = pixelSize(format);
+
+		for (unsigned s = 0; s < sizeof(sizes)/sizeof(*sizes); ++s) {
+			unsigned width = sizes[s][0];
+			unsigned height = sizes[s][1];
+			size_t srcSize = width*height*bpp;
+			size_t dstSize = ((width >> 1) ? : 1)
+					* ((height >> 1) ? : 1) * bpp;
+
+			// Pixels are always aligned to their size
+			for (unsigned off = 0; off < 4; off += bpp) {
+				uint8_t *src = (uint8_t *)malloc(srcSize + 4);
+				uint8_t *ref = (uint8_t *)malloc(dstSize);
+				uint8_t *dst = (uint8_t *)malloc(dstSize
+							+ 4 + GUARD_SIZE);
+
+				for (size_t i = 0; i < srcSize + 4; ++i)
+					src[i] = rand();
+				memset(dst, GUARD, dstSize + 4 + GUARD_SIZE);
+
+				referenceDownsample(format, src + off,
+							width, height, ref);
+				CHECK(fglDownsampleImage(format, src + off,
+						width, height, dst + off));
+
+				if (memcmp(ref, dst + off, dstSize)) {
+					fprintf(stderr, "format %u, %ux%u, "
+						"offset %u differs\n", format,
+						width, height, off);
+					++failures;
+				}
+
+				for (unsigned i = 0; i < GUARD_SIZE; ++i)
+					CHECK(dst[off + dstSize + i] == GUARD);
+
+				free(src);
+				free(ref);
+				free(dst);
+			}
+		}
+	}
+}
+
+/* Green of 1555 is made of green bits only, rounded to nearest */
+static void test5551(void)
+{
+	static const uint16_t src[][4] = {
+		/* Full red used to leak into green */
+		{ 0xf800, 0xf800, 0xf800, 0xf800 },
+		{ 0x07c0, 0x07c0, 0x07c0, 0x07c0 },
+		{ 0x003e, 0x003e, 0x003e, 0x003e },
+		/* Halves round up */
+		{ 0x0842, 0x0000, 0x0000, 0x0842 },
+		{ 0x0001, 0x0001, 0x0000, 0x0000 },
+		/* Quarters round down */
+		{ 0x0843, 0x0000, 0x0000, 0x0000 },
+	};
+	static const uint16_t expected[] = {
+		0xf800, 0x07c0, 0x003e, 0x0842, 0x0001, 0x0000,
+	};
+
+	for (unsigned i = 0; i < sizeof(expected)/sizeof(*expected); ++i) {
+		uint16_t dst = 0xffff;
+
+		CHECK(fglDownsampleImage(FGTU_TSTA_TEXTURE_FORMAT_1555,
+							src[i], 2, 2, &dst));
+		CHECK(dst == expected[i]);
+	}
+}
+
+/* Destination line y is made of source lines 2y and 2y + 1 */
+static void testSourceStride(void)
+{
+	uint8_t src8[4*4];
+	uint8_t dst8[2*2];
+	static const uint8_t expected8[] = { 10, 18, 42, 50 };
+
+	for (unsigned i = 0; i < 4*4; ++i)
+		src8[i] = 16*(i / 4) + 4*(i % 4);
+
+	CHECK(fglDownsampleImage(FGTU_TSTA_TEXTURE_FORMAT_8,
+						src8, 4, 4, dst8));
+	CHECK(!memcmp(dst8, expected8, sizeof(dst8)));
+
+	uint32_t src32[2*4];
+	uint32_t dst32[1*2];
+
+	for (unsigned i = 0; i < 2*4; ++i)
+		src32[i] = 0x01010101 * (16*(i / 2) + 4*(i % 2));
+
+	CHECK(fglDownsampleImage(FGTU_TSTA_TEXTURE_FORMAT_8888,
+						src32, 2, 4, dst32));
+	CHECK(dst32[0] == 0x01010101 * 10);
+	CHECK(dst32[1] == 0x01010101 * 42);
+}
+
+/* Compressed and paletted formats are not filtered */
+static void testUnsupported(void)
+{
+	uint8_t src[4*4] = { 0 };
+	uint8_t dst[4] = { 0 };
+
+	CHECK(!fglDownsampleImage(FGTU_TSTA_TEXTURE_FORMAT_S3TC,
+						src, 4, 4, dst));
+}
+
+int main(void)
+{
+	testReference();
+	test5551();
+	testSourceStride();
+	testUnsupported();
+
+	if (failures) {
+		fprintf(stderr, "fglmipmap_test: %d check(s) failed\n",
+								failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("fglmipmap_test: passed\n");
+	return EXIT_SUCCESS;
+}
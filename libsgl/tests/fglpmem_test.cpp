@@ -0,0 +1,305 @@
+/**
+ * libsgl/tests/fglpmem_test.cpp
+ *
+ * SAMSUNG S3C6410 FIMG-3DSE (PROPER) OPENGL ES IMPLEMENTATION
+ *
+ * Copyrights:	2010 by Tomasz Figa < tomasz.figa at gmail.com >
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Host test of FGLPmemAllocator, with chunks of anonymous memory standing
+ * in for /dev/pmem_gpu1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "fglpmem.h"
+
+static int failures;
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", \
+					__FILE__, __LINE__, #cond); \
+			++failures; \
+		} \
+	} while (0)
+
+/*
+ * Anonymous memory backend
+ */
+
+#define MAX_CHUNKS	16
+
+struct FGLAnonPmem : public FGLPmemBackend {
+	unsigned long	size[MAX_CHUNKS];
+	int		mapped;
+	int		maps;
+	int		lastHandle;
+	unsigned long	lastOffset;
+	unsigned long	lastSize;
+
+	FGLAnonPmem() : mapped(0), maps(0), lastHandle(-1),
+		lastOffset(0), lastSize(0)
+	{
+		memset(size, 0, sizeof(size));
+	}
+
+	virtual bool map(unsigned long len, int *handle,
+					void **vaddr, unsigned long *paddr)
+	{
+		int i;
+
+		for (i = 0; i < MAX_CHUNKS; ++i)
+			if (!size[i])
+				break;
+		if (i == MAX_CHUNKS)
+			return false;
+
+		void *addr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (addr == MAP_FAILED)
+			return false;
+
+		size[i] = len;
+		++mapped;
+		++maps;
+
+		*handle = i;
+		*vaddr = addr;
+		*paddr = (unsigned long)addr;
+		return true;
+	}
+
+	virtual void unmap(int handle, void *vaddr, unsigned long len)
+	{
+		CHECK(size[handle] == len);
+		munmap(vaddr, len);
+		size[handle] = 0;
+		--mapped;
+	}
+
+	virtual void flush(int handle, unsigned long offset,
+						unsigned long len)
+	{
+		CHECK(offset + len <= size[handle]);
+		lastHandle = handle;
+		lastOffset = offset;
+		lastSize = len;
+	}
+};
+
+#define CHUNK_SIZE	(64*1024)
+
+static bool aligned(const FGLPmemBlock *block)
+{
+	return !(block->offset % FGL_PMEM_ALIGN)
+		&& !((unsigned long)block->vaddr % FGL_PMEM_ALIGN)
+		&& !(block->paddr % FGL_PMEM_ALIGN);
+}
+
+/* Sizes are rounded up to size classes */
+static void testSizeClasses(void)
+{
+	CHECK(FGLPmemAllocator::roundSize(1) == 256);
+	CHECK(FGLPmemAllocator::roundSize(256) == 256);
+	CHECK(FGLPmemAllocator::roundSize(257) == 512);
+	CHECK(FGLPmemAllocator::roundSize(4096) == 4096);
+	CHECK(FGLPmemAllocator::roundSize(4097) == 5120);
+	CHECK(FGLPmemAllocator::roundSize(1 << 20) == 1 << 20);
+	CHECK(FGLPmemAllocator::roundSize((1 << 20) + 1)
+						== (1 << 20) + 64*1024);
+}
+
+/* Small blocks share a chunk and do not overlap */
+static void testSuballocation(void)
+{
+	FGLAnonPmem *pmem = new FGLAnonPmem;
+	FGLPmemAllocator alloc(pmem, CHUNK_SIZE);
+	FGLPmemBlock block[8];
+	int i;
+
+	for (i = 0; i < 8; ++i) {
+		CHECK(alloc.alloc(1000 + 100*i, &block[i]));
+		CHECK(aligned(&block[i]));
+		memset(block[i].vaddr, i, 1000 + 100*i);
+	}
+	CHECK(pmem->maps == 1);
+
+	for (i = 0; i < 8; ++i) {
+		const unsigned char *p = (const unsigned char *)block[i].vaddr;
+		CHECK(block[i].chunk == block[0].chunk);
+		CHECK(p[0] == i && p[999 + 100*i] == i);
+	}
+
+	for (i = 0; i < 8; ++i)
+		alloc.free(&block[i]);
+
+	/* Empty regular chunk is kept as spare */
+	CHECK(pmem->mapped == 1);
+}
+
+/* Freed space is merged and reused */
+static void testReuse(void)
+{
+	FGLAnonPmem *pmem = new FGLAnonPmem;
+	FGLPmemAllocator alloc(pmem, CHUNK_SIZE);
+	FGLPmemBlock a, b, c, d;
+
+	CHECK(alloc.alloc(4096, &a));
+	CHECK(alloc.alloc(4096, &b));
+	CHECK(alloc.alloc(4096, &c));
+
+	/* Hole between a and c is reused for a block of the same size */
+	unsigned long hole = b.offset;
+	alloc.free(&b);
+	CHECK(!b.chunk);
+	CHECK(alloc.alloc(4096, &d));
+	CHECK(d.offset == hole);
+	alloc.free(&d);
+
+	/* Freeing a merges with the hole, so twice the size fits there */
+	alloc.free(&a);
+	CHECK(alloc.alloc(8192, &a));
+	CHECK(a.offset == 0);
+	CHECK(pmem->maps == 1);
+
+	alloc.free(&a);
+	alloc.free(&c);
+	CHECK(pmem->mapped == 1);
+}
+
+/* Freeing a block is predicted to give back its free neighbours too */
+static void testFreeSpan(void)
+{
+	FGLAnonPmem *pmem = new FGLAnonPmem;
+	FGLPmemAllocator alloc(pmem, CHUNK_SIZE);
+	FGLPmemBlock a, b, c, d;
+
+	CHECK(alloc.alloc(4096, &a));
+	CHECK(alloc.alloc(4096, &b));
+	CHECK(alloc.alloc(4096, &c));
+	CHECK(alloc.alloc(4096, &d));
+	CHECK(alloc.chunkUsed(a.chunk) == 4*4096);
+
+	/* Used neighbours on both sides */
+	CHECK(alloc.freeSpan(&b) == 4096);
+
+	/* Free range before */
+	alloc.free(&a);
+	CHECK(alloc.freeSpan(&b) == 2*4096);
+	CHECK(alloc.chunkUsed(b.chunk) == 3*4096);
+
+	/* Free ranges on both sides */
+	alloc.free(&c);
+	CHECK(alloc.freeSpan(&b) == 3*4096);
+
+	/* Free range of c before and rest of chunk after */
+	CHECK(alloc.freeSpan(&d) == CHUNK_SIZE - 2*4096);
+
+	alloc.free(&b);
+	CHECK(alloc.chunkUsed(d.chunk) == 4096);
+	alloc.free(&d);
+	CHECK(alloc.freeSpan(&d) == 0);
+}
+
+/* Blocks not fitting any chunk get chunks of their own */
+static void testBigBlocks(void)
+{
+	FGLAnonPmem *pmem = new FGLAnonPmem;
+	FGLPmemAllocator alloc(pmem, CHUNK_SIZE);
+	FGLPmemBlock small, big;
+
+	CHECK(alloc.alloc(256, &small));
+	CHECK(alloc.alloc(CHUNK_SIZE + 1, &big));
+	CHECK(aligned(&big));
+	CHECK(big.chunk != small.chunk);
+	CHECK(pmem->mapped == 2);
+
+	alloc.free(&big);
+	CHECK(pmem->mapped == 1);
+	alloc.free(&small);
+	CHECK(pmem->mapped == 1);
+}
+
+/* Flushes are limited to the block */
+static void testFlush(void)
+{
+	FGLAnonPmem *pmem = new FGLAnonPmem;
+	FGLPmemAllocator alloc(pmem, CHUNK_SIZE);
+	FGLPmemBlock a, b;
+
+	CHECK(alloc.alloc(1024, &a));
+	CHECK(alloc.alloc(1024, &b));
+
+	alloc.flush(&b);
+	CHECK(pmem->lastOffset == b.offset && pmem->lastSize == b.size);
+
+	alloc.flush(&b, 100, 200);
+	CHECK(pmem->lastOffset == b.offset + 100 && pmem->lastSize == 200);
+
+	/* Range past the end of block is clamped */
+	alloc.flush(&b, 1000, 1000);
+	CHECK(pmem->lastOffset == b.offset + 1000 && pmem->lastSize == 24);
+
+	/* Range starting past the end of block is ignored */
+	pmem->lastSize = 0;
+	alloc.flush(&b, 1024, 1);
+	CHECK(pmem->lastSize == 0);
+
+	alloc.free(&a);
+	alloc.free(&b);
+}
+
+/* Running out of chunks fails the allocation cleanly */
+static void testExhaustion(void)
+{
+	FGLAnonPmem *pmem = new FGLAnonPmem;
+	FGLPmemAllocator alloc(pmem, CHUNK_SIZE);
+	FGLPmemBlock block[MAX_CHUNKS + 1];
+	int i;
+
+	for (i = 0; i < MAX_CHUNKS; ++i)
+		CHECK(alloc.alloc(CHUNK_SIZE, &block[i]));
+	CHECK(!alloc.alloc(CHUNK_SIZE, &block[i]));
+
+	for (i = 0; i < MAX_CHUNKS; ++i)
+		alloc.free(&block[i]);
+	/* One empty regular chunk is kept as spare */
+	CHECK(pmem->mapped == 1);
+}
+
+int main(void)
+{
+	testSizeClasses();
+	testSuballocation();
+	testReuse();
+	testFreeSpan();
+	testBigBlocks();
+	testFlush();
+	testExhaustion();
+
+	if (failures) {
+		fprintf(stderr, "fglpmem_test: %d check(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("fglpmem_test: passed\n");
+	return EXIT_SUCCESS;
+}